@@ -0,0 +1,811 @@
+#include "hp_fem_1d.h"
+#include <limits>
+
+BandMatrix::BandMatrix(int size, int kl, int ku)
+  : size(size), kl(kl), ku(ku), ldab(2 * kl + ku + 1), ab((2 * kl + ku + 1) * size, 0.0), pivots(size, 0), factorized(false)
+{
+}
+
+void BandMatrix::zero()
+{
+  std::fill(ab.begin(), ab.end(), 0.0);
+  factorized = false;
+}
+
+void BandMatrix::add(int i, int j, double value)
+{
+  if (factorized || i - j > kl || j - i > ku)
+    throw Hermes::Exceptions::Exception("Entry (%d, %d) out of the band of BandMatrix.", i, j);
+  entry(i, j) += value;
+}
+
+void BandMatrix::set_identity_row(int i)
+{
+  for (int j = std::max(0, i - kl); j <= std::min(size - 1, i + ku); j++)
+    entry(i, j) = 0.0;
+  entry(i, i) = 1.0;
+}
+
+void BandMatrix::set_linear_combination(double a, const BandMatrix& A, double b, const BandMatrix& B)
+{
+  if (A.size != size || B.size != size || A.kl != kl || B.kl != kl || A.ku != ku || B.ku != ku)
+    throw Hermes::Exceptions::Exception("Mismatched shapes in BandMatrix::set_linear_combination().");
+  for (unsigned int k = 0; k < ab.size(); k++)
+    ab[k] = a * A.ab[k] + b * B.ab[k];
+  factorized = false;
+}
+
+void BandMatrix::multiply_with_vector(const double* x, double* y) const
+{
+  for (int i = 0; i < size; i++)
+    y[i] = 0.0;
+  for (int j = 0; j < size; j++)
+    for (int i = std::max(0, j - ku); i <= std::min(size - 1, j + kl); i++)
+      y[i] += entry(i, j) * x[j];
+}
+
+void BandMatrix::factorize()
+{
+  // Gaussian elimination with row interchanges, the rows of U grow up to kl + ku entries.
+  int last_col = 0;
+  for (int j = 0; j < size; j++)
+  {
+    int num_below = std::min(kl, size - 1 - j);
+    int pivot = j;
+    for (int i = j + 1; i <= j + num_below; i++)
+      if (std::abs(entry(i, j)) > std::abs(entry(pivot, j)))
+        pivot = i;
+    pivots[j] = pivot;
+    if (entry(pivot, j) == 0.0)
+      throw Hermes::Exceptions::Exception("Singular matrix in BandMatrix::factorize().");
+
+    last_col = std::max(last_col, std::min(pivot + ku, size - 1));
+    if (pivot != j)
+      for (int c = j; c <= last_col; c++)
+        std::swap(entry(j, c), entry(pivot, c));
+
+    for (int i = j + 1; i <= j + num_below; i++)
+      entry(i, j) /= entry(j, j);
+    for (int c = j + 1; c <= last_col; c++)
+      if (entry(j, c) != 0.0)
+        for (int i = j + 1; i <= j + num_below; i++)
+          entry(i, c) -= entry(i, j) * entry(j, c);
+  }
+  factorized = true;
+}
+
+void BandMatrix::solve(double* rhs) const
+{
+  if (!factorized)
+    throw Hermes::Exceptions::Exception("BandMatrix::solve() called before factorize().");
+
+  for (int j = 0; j < size; j++)
+  {
+    std::swap(rhs[j], rhs[pivots[j]]);
+    for (int i = j + 1; i <= std::min(size - 1, j + kl); i++)
+      rhs[i] -= entry(i, j) * rhs[j];
+  }
+  for (int i = size - 1; i >= 0; i--)
+  {
+    for (int c = i + 1; c <= std::min(size - 1, i + kl + ku); c++)
+      rhs[i] -= entry(i, c) * rhs[c];
+    rhs[i] /= entry(i, i);
+  }
+}
+
+void get_gauss_lobatto_rule(int num_points, const double*& points, const double*& weights)
+{
+  static std::map<int, std::pair<std::vector<double>, std::vector<double> > > rules;
+  if (num_points < 2)
+    throw Hermes::Exceptions::Exception("Gauss-Lobatto rule needs at least 2 points.");
+
+  std::pair<std::vector<double>, std::vector<double> >& rule = rules[num_points];
+  if (rule.first.empty())
+  {
+    // The inner points are the roots of P'_{n-1}, by Newton's method from the Chebyshev-Gauss-Lobatto points.
+    int n = num_points - 1;
+    rule.first.resize(num_points);
+    rule.second.resize(num_points);
+    for (int i = 0; i <= n; i++)
+    {
+      double x = std::cos(M_PI * i / n), x_old, p_n, p_n_1;
+      int iter = 0;
+      do
+      {
+        double p_prev = 1.0;
+        p_n = x;
+        for (int k = 2; k <= n; k++)
+        {
+          double p_next = ((2 * k - 1) * x * p_n - (k - 1) * p_prev) / k;
+          p_prev = p_n;
+          p_n = p_next;
+        }
+        p_n_1 = p_prev;
+        x_old = x;
+        x = x_old - (x * p_n - p_n_1) / (num_points * p_n);
+      }
+      while (std::abs(x - x_old) > 1e-15 && ++iter < 100);
+      rule.first[i] = x;
+      rule.second[i] = 2.0 / (n * num_points * p_n * p_n);
+    }
+  }
+  points = &rule.first[0];
+  weights = &rule.second[0];
+}
+
+// Shape functions of an element of degree 'order' in the local numbering (0 left vertex, 1..order-1 bubbles,
+// order right vertex), with the derivatives with respect to xi.
+static void element_shape_fns(int order, double xi, double* values, double* derivatives)
+{
+  values[0] = (1.0 - xi) / 2.0;
+  derivatives[0] = -0.5;
+  values[order] = (1.0 + xi) / 2.0;
+  derivatives[order] = 0.5;
+
+  double p_prev = 1.0, p = xi;
+  for (int k = 2; k <= order; k++)
+  {
+    double p_next = ((2 * k - 1) * xi * p - (k - 1) * p_prev) / k;
+    values[k - 1] = (p_next - p_prev) / std::sqrt(2.0 * (2 * k - 1));
+    derivatives[k - 1] = std::sqrt((2 * k - 1) / 2.0) * p;
+    p_prev = p;
+    p = p_next;
+  }
+}
+
+void lobatto_shape_fn(int k, double xi, double& value, double& derivative)
+{
+  int order = std::max(k, 1);
+  std::vector<double> values(order + 1), derivatives(order + 1);
+  element_shape_fns(order, xi, &values[0], &derivatives[0]);
+  int local = k == 0 ? 0 : (k == 1 ? order : k - 1);
+  value = values[local];
+  derivative = derivatives[local];
+}
+
+// The end points of (a, b) and the vertices of 'space' inside it, so that a function
+// of 'space' is a polynomial on each of the sub-intervals.
+static void get_sub_intervals(double a, double b, const Space1D& space, std::vector<double>& points)
+{
+  double eps = 1e-12 * (b - a);
+  points.clear();
+  points.push_back(a);
+  for (int e = space.find_element(a); e < space.get_num_elements() && space.get_left(e) < b; e++)
+    if (space.get_right(e) > a + eps && space.get_right(e) < b - eps)
+      points.push_back(space.get_right(e));
+  points.push_back(b);
+}
+
+Space1D::Space1D(const std::vector<double>& vertices, int p_init, bool dirichlet_left, bool dirichlet_right,
+                 double bc_left, double bc_right)
+  : dirichlet_left(dirichlet_left), dirichlet_right(dirichlet_right), bc_left(bc_left), bc_right(bc_right)
+{
+  if (vertices.size() < 2)
+    throw Hermes::Exceptions::Exception("Space1D needs at least two vertices.");
+  for (unsigned int i = 0; i + 1 < vertices.size(); i++)
+  {
+    Element1D element = { vertices[i], vertices[i + 1], p_init, (int) i, 0, 0 };
+    elements.push_back(element);
+  }
+  assign_basis();
+}
+
+void Space1D::assign_basis()
+{
+  first_basis.resize(elements.size() + 1);
+  first_basis[0] = 0;
+  for (unsigned int e = 0; e < elements.size(); e++)
+    first_basis[e + 1] = first_basis[e] + elements[e].order;
+}
+
+int Space1D::get_max_order() const
+{
+  int max_order = 1;
+  for (unsigned int e = 0; e < elements.size(); e++)
+    max_order = std::max(max_order, elements[e].order);
+  return max_order;
+}
+
+int Space1D::find_element(double x) const
+{
+  int lo = 0, hi = elements.size() - 1;
+  while (lo < hi)
+  {
+    int mid = (lo + hi + 1) / 2;
+    if (elements[mid].left < x)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+int Space1D::get_num_dofs() const
+{
+  return get_num_basis() - (dirichlet_left ? 1 : 0) - (dirichlet_right ? 1 : 0);
+}
+
+bool Space1D::is_dirichlet(int basis) const
+{
+  return (basis == 0 && dirichlet_left) || (basis == first_basis.back() && dirichlet_right);
+}
+
+double Space1D::get_dirichlet_value(int basis) const
+{
+  return basis == 0 ? bc_left : bc_right;
+}
+
+void Space1D::refine_all_elements()
+{
+  std::vector<Element1D> sons;
+  for (unsigned int e = 0; e < elements.size(); e++)
+  {
+    Element1D son = elements[e];
+    son.level++;
+    son.index = 2 * elements[e].index;
+    son.right = (elements[e].left + elements[e].right) / 2.0;
+    sons.push_back(son);
+    son.index++;
+    son.left = son.right;
+    son.right = elements[e].right;
+    sons.push_back(son);
+  }
+  elements.swap(sons);
+  assign_basis();
+}
+
+void Space1D::split_element(int e, int order_left, int order_right)
+{
+  Element1D son = elements[e];
+  son.level++;
+  son.index = 2 * elements[e].index + 1;
+  son.left = (elements[e].left + elements[e].right) / 2.0;
+  son.order = order_right;
+  elements[e].level++;
+  elements[e].index *= 2;
+  elements[e].right = son.left;
+  elements[e].order = order_left;
+  elements.insert(elements.begin() + e + 1, son);
+  assign_basis();
+}
+
+void Space1D::set_element_order(int e, int order)
+{
+  elements[e].order = order;
+  assign_basis();
+}
+
+void Space1D::set_uniform_order(int order)
+{
+  for (unsigned int e = 0; e < elements.size(); e++)
+    elements[e].order = order;
+  assign_basis();
+}
+
+void Space1D::adjust_element_order(int change, int min_order)
+{
+  for (unsigned int e = 0; e < elements.size(); e++)
+    elements[e].order = std::max(min_order, std::min(H1D_MAX_ORDER, elements[e].order + change));
+  assign_basis();
+}
+
+void Space1D::unrefine_all_elements()
+{
+  std::vector<Element1D> fathers;
+  for (unsigned int e = 0; e < elements.size(); e++)
+  {
+    const Element1D& element = elements[e];
+    if (element.level > 0 && element.index % 2 == 0 && e + 1 < elements.size()
+        && elements[e + 1].base == element.base && elements[e + 1].level == element.level)
+    {
+      Element1D father = element;
+      father.right = elements[e + 1].right;
+      father.order = std::max(element.order, elements[e + 1].order);
+      father.level--;
+      father.index /= 2;
+      fathers.push_back(father);
+      e++;
+    }
+    else
+      fathers.push_back(element);
+  }
+  elements.swap(fathers);
+  assign_basis();
+}
+
+Space1D* Space1D::create_ref_space(int order_increase) const
+{
+  Space1D* ref_space = new Space1D(*this);
+  ref_space->refine_all_elements();
+  for (unsigned int e = 0; e < ref_space->elements.size(); e++)
+    ref_space->elements[e].order += order_increase;
+  ref_space->assign_basis();
+  return ref_space;
+}
+
+std::vector<double> Space1D::get_mesh_vertices(Mesh* mesh)
+{
+  std::vector<double> vertices;
+  Element* e;
+  for_all_active_elements(e, mesh)
+    for (int k = 0; k < (int) e->get_nvert(); k++)
+      vertices.push_back(e->vn[k]->x);
+  std::sort(vertices.begin(), vertices.end());
+
+  // The strip has two vertices at every x.
+  std::vector<double> unique_vertices;
+  double eps = 1e-12 * (vertices.back() - vertices.front());
+  for (unsigned int i = 0; i < vertices.size(); i++)
+    if (unique_vertices.empty() || vertices[i] > unique_vertices.back() + eps)
+      unique_vertices.push_back(vertices[i]);
+  return unique_vertices;
+}
+
+Solution1D::Solution1D() : space(std::vector<double>(2, 0.0), 1)
+{
+}
+
+Solution1D::Solution1D(const Space1D& space, const std::vector<double>& coeffs) : space(space), coeffs(coeffs)
+{
+  if ((int) coeffs.size() != space.get_num_basis())
+    throw Hermes::Exceptions::Exception("Wrong number of coefficients in Solution1D.");
+}
+
+Solution1D::Solution1D(const Space1D& space) : space(space), coeffs(space.get_num_basis(), 0.0)
+{
+  for (int i = 0; i < space.get_num_basis(); i++)
+    if (space.is_dirichlet(i))
+      coeffs[i] = space.get_dirichlet_value(i);
+}
+
+void Solution1D::value_and_derivative(double x, double& value, double& derivative) const
+{
+  int e = space.find_element(x);
+  int order = space.get_order(e);
+  double h = space.get_right(e) - space.get_left(e);
+  double xi = std::max(-1.0, std::min(1.0, (2.0 * x - space.get_left(e) - space.get_right(e)) / h));
+
+  double values[H1D_MAX_ORDER + 8], derivatives[H1D_MAX_ORDER + 8];
+  std::vector<double> long_values, long_derivatives;
+  double* vals = values;
+  double* ders = derivatives;
+  if (order >= H1D_MAX_ORDER + 8)
+  {
+    long_values.resize(order + 1);
+    long_derivatives.resize(order + 1);
+    vals = &long_values[0];
+    ders = &long_derivatives[0];
+  }
+  element_shape_fns(order, xi, vals, ders);
+
+  value = derivative = 0.0;
+  for (int k = 0; k <= order; k++)
+  {
+    value += coeffs[space.get_first_basis(e) + k] * vals[k];
+    derivative += coeffs[space.get_first_basis(e) + k] * ders[k];
+  }
+  derivative *= 2.0 / h;
+}
+
+double Solution1D::value(double x) const
+{
+  double value, derivative;
+  value_and_derivative(x, value, derivative);
+  return value;
+}
+
+double Solution1D::derivative(double x) const
+{
+  double value, derivative;
+  value_and_derivative(x, value, derivative);
+  return derivative;
+}
+
+void Solution1D::save(const char* filename, int num_samples) const
+{
+  FILE* f = fopen(filename, "w");
+  if (f == NULL)
+    throw Hermes::Exceptions::Exception("Could not open %s.", filename);
+  for (int e = 0; e < space.get_num_elements(); e++)
+    for (int s = 0; s <= num_samples; s++)
+    {
+      double x = space.get_left(e) + (space.get_right(e) - space.get_left(e)) * s / num_samples;
+      fprintf(f, "%g %g\n", x, value(x));
+    }
+  fclose(f);
+}
+
+Solution1D project_1d(const Space1D& space, const Solution1D& source)
+{
+  int p = space.get_max_order();
+  int num_points = std::max(p, source.get_space().get_max_order()) + 2;
+  const double* points;
+  const double* weights;
+  get_gauss_lobatto_rule(num_points, points, weights);
+
+  BandMatrix matrix(space.get_num_basis(), p, p);
+  std::vector<double> rhs(space.get_num_basis(), 0.0);
+  std::vector<double> values(p + 1), derivatives(p + 1), sub_intervals;
+  for (int e = 0; e < space.get_num_elements(); e++)
+  {
+    int order = space.get_order(e);
+    int first = space.get_first_basis(e);
+    double left = space.get_left(e), h = space.get_right(e) - left;
+    get_sub_intervals(left, space.get_right(e), source.get_space(), sub_intervals);
+    for (unsigned int s = 0; s + 1 < sub_intervals.size(); s++)
+    {
+      double a = sub_intervals[s], b = sub_intervals[s + 1];
+      for (int q = 0; q < num_points; q++)
+      {
+        double x = (a + b) / 2.0 + (b - a) / 2.0 * points[q];
+        double w = weights[q] * (b - a) / 2.0;
+        double u, du;
+        source.value_and_derivative(x, u, du);
+        element_shape_fns(order, 2.0 * (x - left) / h - 1.0, &values[0], &derivatives[0]);
+        for (int i = 0; i <= order; i++)
+        {
+          double dv_i = derivatives[i] * 2.0 / h;
+          rhs[first + i] += w * (u * values[i] + du * dv_i);
+          for (int j = 0; j <= order; j++)
+            matrix.add(first + i, first + j, w * (values[i] * values[j] + dv_i * derivatives[j] * 2.0 / h));
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < space.get_num_basis(); i++)
+    if (space.is_dirichlet(i))
+    {
+      matrix.set_identity_row(i);
+      rhs[i] = space.get_dirichlet_value(i);
+    }
+  matrix.factorize();
+  matrix.solve(&rhs[0]);
+  return Solution1D(space, rhs);
+}
+
+void assemble_1d(const Space1D& space, const Problem1D* problem, BandMatrix& matrix_M, BandMatrix& matrix_S)
+{
+  matrix_M.zero();
+  matrix_S.zero();
+  std::vector<double> values(space.get_max_order() + 1), derivatives(space.get_max_order() + 1);
+  for (int e = 0; e < space.get_num_elements(); e++)
+  {
+    int order = space.get_order(e);
+    int first = space.get_first_basis(e);
+    double h = space.get_right(e) - space.get_left(e);
+    const double* points;
+    const double* weights;
+    get_gauss_lobatto_rule(order + 3, points, weights);
+    for (int q = 0; q < order + 3; q++)
+    {
+      double x = space.get_left(e) + h / 2.0 * (points[q] + 1.0);
+      double w = weights[q] * h / 2.0;
+      double a = problem->diffusion(x, space.get_base_element(e)), c = problem->reaction(x, space.get_base_element(e));
+      element_shape_fns(order, points[q], &values[0], &derivatives[0]);
+      for (int i = 0; i <= order; i++)
+        for (int j = 0; j <= order; j++)
+        {
+          double mass = w * values[i] * values[j];
+          matrix_M.add(first + i, first + j, mass);
+          matrix_S.add(first + i, first + j, w * a * derivatives[i] * derivatives[j] * 4.0 / (h * h) + c * mass);
+        }
+    }
+  }
+}
+
+void assemble_source_1d(const Space1D& space, const Problem1D* problem, double t, double* rhs)
+{
+  std::vector<double> values(space.get_max_order() + 1), derivatives(space.get_max_order() + 1);
+  for (int i = 0; i < space.get_num_basis(); i++)
+    rhs[i] = 0.0;
+  for (int e = 0; e < space.get_num_elements(); e++)
+  {
+    int order = space.get_order(e);
+    double h = space.get_right(e) - space.get_left(e);
+    const double* points;
+    const double* weights;
+    get_gauss_lobatto_rule(order + 3, points, weights);
+    for (int q = 0; q < order + 3; q++)
+    {
+      double x = space.get_left(e) + h / 2.0 * (points[q] + 1.0);
+      double f = weights[q] * h / 2.0 * problem->source(x, t);
+      element_shape_fns(order, points[q], &values[0], &derivatives[0]);
+      for (int i = 0; i <= order; i++)
+        rhs[space.get_first_basis(e) + i] += f * values[i];
+    }
+  }
+}
+
+Solution1D solve_stationary_1d(const Space1D& space, const Problem1D* problem)
+{
+  int num_basis = space.get_num_basis();
+  int p = space.get_max_order();
+
+  BandMatrix matrix_M(num_basis, p, p), matrix_S(num_basis, p, p);
+  assemble_1d(space, problem, matrix_M, matrix_S);
+  std::vector<double> rhs(num_basis);
+  assemble_source_1d(space, problem, 0.0, &rhs[0]);
+  for (int d = 0; d < num_basis; d++)
+    if (space.is_dirichlet(d))
+    {
+      matrix_S.set_identity_row(d);
+      rhs[d] = space.get_dirichlet_value(d);
+    }
+  matrix_S.factorize();
+  matrix_S.solve(&rhs[0]);
+
+  Hermes::Mixins::Loggable::Static::info("1D stationary solve: ndof = %d, half-bandwidth = %d.", space.get_num_dofs(), p);
+  return Solution1D(space, rhs);
+}
+
+double calc_rel_error_1d(const Solution1D& sln, const ExactSolution1D* exact)
+{
+  const Space1D& space = sln.get_space();
+  // The exact solution is not a polynomial, a few more points than for the products of the shape functions.
+  int num_points = space.get_max_order() + 6;
+  const double* points;
+  const double* weights;
+  get_gauss_lobatto_rule(num_points, points, weights);
+
+  double error = 0.0, norm = 0.0;
+  for (int e = 0; e < space.get_num_elements(); e++)
+  {
+    double a = space.get_left(e), b = space.get_right(e);
+    for (int q = 0; q < num_points; q++)
+    {
+      double x = (a + b) / 2.0 + (b - a) / 2.0 * points[q];
+      double w = weights[q] * (b - a) / 2.0;
+      double u, du, u_exact, du_exact;
+      sln.value_and_derivative(x, u, du);
+      exact->value_and_derivative(x, u_exact, du_exact);
+      error += w * ((u_exact - u) * (u_exact - u) + (du_exact - du) * (du_exact - du));
+      norm += w * (u_exact * u_exact + du_exact * du_exact);
+    }
+  }
+  return norm > 0.0 ? std::sqrt(error / norm) : std::sqrt(error);
+}
+
+RungeKutta1D::RungeKutta1D(const Problem1D* problem, ButcherTable* bt) : problem(problem), bt(bt)
+{
+  for (unsigned int i = 0; i < bt->get_size(); i++)
+    for (unsigned int j = i + 1; j < bt->get_size(); j++)
+      if (bt->get_A(i, j) != 0.0)
+        throw Hermes::Exceptions::Exception("RungeKutta1D supports only explicit and diagonally implicit Butcher's tables.");
+}
+
+void RungeKutta1D::rk_time_step(const Space1D& space, double current_time, double time_step,
+                                const Solution1D& sln_time_prev, Solution1D& sln_time_new) const
+{
+  int num_basis = space.get_num_basis();
+  int p = space.get_max_order();
+  int num_stages = bt->get_size();
+
+  BandMatrix matrix_M(num_basis, p, p), matrix_S(num_basis, p, p), stage_matrix(num_basis, p, p);
+  assemble_1d(space, problem, matrix_M, matrix_S);
+  std::vector<double> Y = project_1d(space, sln_time_prev).get_coeffs();
+
+  // M K_i = F(t + c_i time_step, Y + time_step sum_j a_ij K_j), i.e.
+  // (M + time_step a_ii S) K_i = -S (Y + time_step sum_{j < i} a_ij K_j) + (f(t + c_i time_step), v).
+  std::vector<std::vector<double> > K(num_stages, std::vector<double>(num_basis));
+  std::vector<double> stage_state(num_basis), product(num_basis);
+  double factorized_a_ii = 0.0;
+  int num_factorizations = 0;
+  for (int i = 0; i < num_stages; i++)
+  {
+    stage_state = Y;
+    for (int j = 0; j < i; j++)
+      for (int d = 0; d < num_basis; d++)
+        stage_state[d] += time_step * bt->get_A(i, j) * K[j][d];
+    matrix_S.multiply_with_vector(&stage_state[0], &product[0]);
+    assemble_source_1d(space, problem, current_time + bt->get_C(i) * time_step, &K[i][0]);
+    for (int d = 0; d < num_basis; d++)
+      K[i][d] = space.is_dirichlet(d) ? 0.0 : K[i][d] - product[d];
+
+    if (num_factorizations == 0 || bt->get_A(i, i) != factorized_a_ii)
+    {
+      factorized_a_ii = bt->get_A(i, i);
+      stage_matrix.set_linear_combination(1.0, matrix_M, time_step * factorized_a_ii, matrix_S);
+      for (int d = 0; d < num_basis; d++)
+        if (space.is_dirichlet(d))
+          stage_matrix.set_identity_row(d);
+      stage_matrix.factorize();
+      num_factorizations++;
+    }
+    stage_matrix.solve(&K[i][0]);
+  }
+
+  for (int i = 0; i < num_stages; i++)
+    for (int d = 0; d < num_basis; d++)
+      Y[d] += time_step * bt->get_B(i) * K[i][d];
+  sln_time_new = Solution1D(space, Y);
+
+  Hermes::Mixins::Loggable::Static::info("1D R-K: %d stages, %d factorizations, ndof = %d.",
+      num_stages, num_factorizations, space.get_num_dofs());
+}
+
+Adapt1D::Adapt1D(Space1D* space) : space(space)
+{
+}
+
+double Adapt1D::calc_err_est(const Solution1D& sln, const Solution1D& ref_sln)
+{
+  if (sln.get_space().get_num_elements() != space->get_num_elements())
+    throw Hermes::Exceptions::Exception("The coarse solution of Adapt1D::calc_err_est() is not on the adapted space.");
+
+  int num_points = std::max(space->get_max_order(), ref_sln.get_space().get_max_order()) + 2;
+  const double* points;
+  const double* weights;
+  get_gauss_lobatto_rule(num_points, points, weights);
+
+  double total_error = 0.0, total_norm = 0.0;
+  std::vector<double> sub_intervals;
+  elem_errors.assign(space->get_num_elements(), 0.0);
+  for (int e = 0; e < space->get_num_elements(); e++)
+  {
+    get_sub_intervals(space->get_left(e), space->get_right(e), ref_sln.get_space(), sub_intervals);
+    for (unsigned int s = 0; s + 1 < sub_intervals.size(); s++)
+    {
+      double a = sub_intervals[s], b = sub_intervals[s + 1];
+      for (int q = 0; q < num_points; q++)
+      {
+        double x = (a + b) / 2.0 + (b - a) / 2.0 * points[q];
+        double w = weights[q] * (b - a) / 2.0;
+        double u, du, u_ref, du_ref;
+        sln.value_and_derivative(x, u, du);
+        ref_sln.value_and_derivative(x, u_ref, du_ref);
+        elem_errors[e] += w * ((u_ref - u) * (u_ref - u) + (du_ref - du) * (du_ref - du));
+        total_norm += w * (u_ref * u_ref + du_ref * du_ref);
+      }
+    }
+    total_error += elem_errors[e];
+  }
+
+  if (total_norm == 0.0)
+    total_norm = 1.0;
+  for (int e = 0; e < space->get_num_elements(); e++)
+    elem_errors[e] /= total_norm;
+  return std::sqrt(total_error / total_norm);
+}
+
+double Adapt1D::interpolation_error(const Solution1D& ref_sln, double a, double b, int order) const
+{
+  int num_points = std::max(order, ref_sln.get_space().get_max_order()) + 2;
+  const double* points;
+  const double* weights;
+  get_gauss_lobatto_rule(num_points, points, weights);
+
+  double h = b - a;
+  double u_a = ref_sln.value(a), u_b = ref_sln.value(b);
+  std::vector<double> values(order + 1), derivatives(order + 1), sub_intervals;
+  get_sub_intervals(a, b, ref_sln.get_space(), sub_intervals);
+
+  // The bubbles are orthonormal in the H1 seminorm on the reference interval, and orthogonal
+  // to the linear part, so their coefficients are the products with u'.
+  std::vector<double> bubbles(order + 1, 0.0);
+  for (unsigned int s = 0; s + 1 < sub_intervals.size(); s++)
+    for (int q = 0; q < num_points; q++)
+    {
+      double x = (sub_intervals[s] + sub_intervals[s + 1]) / 2.0 + (sub_intervals[s + 1] - sub_intervals[s]) / 2.0 * points[q];
+      double w = weights[q] * (sub_intervals[s + 1] - sub_intervals[s]) / 2.0;
+      element_shape_fns(order, 2.0 * (x - a) / h - 1.0, &values[0], &derivatives[0]);
+      double du = ref_sln.derivative(x);
+      for (int k = 1; k < order; k++)
+        bubbles[k] += w * du * derivatives[k];
+    }
+
+  double error = 0.0;
+  for (unsigned int s = 0; s + 1 < sub_intervals.size(); s++)
+    for (int q = 0; q < num_points; q++)
+    {
+      double x = (sub_intervals[s] + sub_intervals[s + 1]) / 2.0 + (sub_intervals[s + 1] - sub_intervals[s]) / 2.0 * points[q];
+      double w = weights[q] * (sub_intervals[s + 1] - sub_intervals[s]) / 2.0;
+      element_shape_fns(order, 2.0 * (x - a) / h - 1.0, &values[0], &derivatives[0]);
+      double v = u_a * values[0] + u_b * values[order];
+      double dv = (u_b - u_a) / h;
+      for (int k = 1; k < order; k++)
+      {
+        v += bubbles[k] * values[k];
+        dv += bubbles[k] * derivatives[k] * 2.0 / h;
+      }
+      double u, du;
+      ref_sln.value_and_derivative(x, u, du);
+      error += w * ((u - v) * (u - v) + (du - dv) * (du - dv));
+    }
+  return error;
+}
+
+bool Adapt1D::adapt(const Solution1D& ref_sln, double threshold, int strategy, double conv_exp)
+{
+  if ((int) elem_errors.size() != space->get_num_elements())
+    throw Hermes::Exceptions::Exception("Adapt1D::calc_err_est() must be called before adapt().");
+
+  std::vector<std::pair<double, int> > sorted;
+  double total_error = 0.0;
+  for (int e = 0; e < space->get_num_elements(); e++)
+  {
+    sorted.push_back(std::make_pair(-elem_errors[e], e));
+    total_error += elem_errors[e];
+  }
+  std::sort(sorted.begin(), sorted.end());
+  double max_error = -sorted[0].first;
+
+  std::vector<int> selected;
+  double processed_error = 0.0, last_error = 0.0;
+  for (unsigned int k = 0; k < sorted.size(); k++)
+  {
+    double error = -sorted[k].first;
+    if (error <= 0.0)
+      break;
+    // The errors are squared, the tests are those of Adapt<double>::adapt().
+    if (strategy == 0)
+    {
+      // Elements with errors similar to the last refined one are refined too, to keep the mesh symmetric.
+      if (k > 0 && processed_error > std::sqrt(threshold) * total_error
+          && std::fabs((error - last_error) / last_error) > 1e-3)
+        break;
+    }
+    else if (strategy == 1)
+    {
+      if (error < threshold * max_error)
+        break;
+    }
+    else if (strategy == 2)
+    {
+      if (error < threshold)
+        break;
+    }
+    else
+      throw Hermes::Exceptions::Exception("Unknown adaptive strategy %d.", strategy);
+    selected.push_back(sorted[k].second);
+    processed_error += error;
+    last_error = error;
+  }
+
+  // From the right, so that splitting an element does not shift the indices of the remaining ones.
+  std::sort(selected.begin(), selected.end());
+  for (int k = selected.size() - 1; k >= 0; k--)
+  {
+    int e = selected[k];
+    int order = space->get_order(e);
+    double left = space->get_left(e), right = space->get_right(e), mid = (left + right) / 2.0;
+    double error = interpolation_error(ref_sln, left, right, order);
+    if (error <= 0.0)
+      continue;
+
+    double best_score = -std::numeric_limits<double>::max();
+    int best_left = order + 1, best_right = -1;
+    for (int q = order + 1; q <= std::min(order + 2, H1D_MAX_ORDER); q++)
+    {
+      double score = (std::log(error) - std::log(std::max(interpolation_error(ref_sln, left, right, q), 1e-300)))
+        / std::pow((double) (q - order), conv_exp);
+      if (score > best_score)
+      {
+        best_score = score;
+        best_left = q;
+        best_right = -1;
+      }
+    }
+    int son_order = std::max(1, (order + 1) / 2);
+    for (int q_left = son_order; q_left <= std::min(son_order + 1, H1D_MAX_ORDER); q_left++)
+      for (int q_right = son_order; q_right <= std::min(son_order + 1, H1D_MAX_ORDER); q_right++)
+      {
+        double candidate_error = interpolation_error(ref_sln, left, mid, q_left) + interpolation_error(ref_sln, mid, right, q_right);
+        double score = (std::log(error) - std::log(std::max(candidate_error, 1e-300)))
+          / std::pow((double) std::max(q_left + q_right - order, 1), conv_exp);
+        if (score > best_score)
+        {
+          best_score = score;
+          best_left = q_left;
+          best_right = q_right;
+        }
+      }
+
+    if (best_right < 0)
+      space->set_element_order(e, std::min(best_left, H1D_MAX_ORDER));
+    else
+      space->split_element(e, best_left, best_right);
+  }
+
+  return selected.empty();
+}
@@ -0,0 +1,229 @@
+#ifndef HP_FEM_1D_H
+#define HP_FEM_1D_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// Highest polynomial degree the 1D hp-adaptivity proposes.
+#define H1D_MAX_ORDER 10
+
+/// \brief Banded matrix with a direct LU solver (partial pivoting, as LAPACK's dgbtrf).
+///
+/// A 1D hp-FEM matrix with the degrees of freedom numbered from left to right is block-tridiagonal
+/// with the half-bandwidth equal to the highest polynomial degree, so the factorization costs
+/// O(n p^2) operations and no sparse solver is needed. The storage has kl extra rows for the
+/// fill-in of the pivoting.
+class BandMatrix
+{
+public:
+  BandMatrix(int size, int kl, int ku);
+
+  int get_size() const { return size; }
+
+  void zero();
+  /// Only before factorize(). 'i', 'j' must lie in the band.
+  void add(int i, int j, double value);
+  /// Sets row 'i' to the identity row (Dirichlet conditions).
+  void set_identity_row(int i);
+  /// this = a * A + b * B, all three of the same shape.
+  void set_linear_combination(double a, const BandMatrix& A, double b, const BandMatrix& B);
+  /// y = this * x, only before factorize().
+  void multiply_with_vector(const double* x, double* y) const;
+
+  void factorize();
+  /// Overwrites 'rhs' by the solution, only after factorize().
+  void solve(double* rhs) const;
+
+private:
+  double& entry(int i, int j) { return ab[(kl + ku + i - j) + j * ldab]; }
+  double entry(int i, int j) const { return ab[(kl + ku + i - j) + j * ldab]; }
+
+  int size, kl, ku, ldab;
+  std::vector<double> ab;
+  std::vector<int> pivots;
+  bool factorized;
+};
+
+/// \brief H1 space on a 1D interval mesh with hierarchic (Lobatto) shape functions of variable degree.
+///
+/// The shape functions are numbered from left to right (left vertex, bubbles of the element, next vertex, ...),
+/// so that the element matrices form a banded global matrix. All shape functions including the end point
+/// vertices enter the matrices, the Dirichlet end points get an identity row instead of the equation.
+/// The refinements are recorded per element (base element, level, index on the level) instead of a tree.
+class Space1D
+{
+public:
+  Space1D(const std::vector<double>& vertices, int p_init, bool dirichlet_left = true, bool dirichlet_right = true,
+          double bc_left = 0.0, double bc_right = 0.0);
+
+  int get_num_elements() const { return elements.size(); }
+  double get_left(int e) const { return elements[e].left; }
+  double get_right(int e) const { return elements[e].right; }
+  int get_order(int e) const { return elements[e].order; }
+  /// Index of the element of the initial mesh that contains 'e'.
+  int get_base_element(int e) const { return elements[e].base; }
+  int get_max_order() const;
+  /// Index of the element containing 'x' (the left one at a vertex).
+  int find_element(double x) const;
+
+  /// Number of shape functions including the Dirichlet end points, and the unknowns without them.
+  int get_num_basis() const { return first_basis.back() + 1; }
+  int get_num_dofs() const;
+  /// Index of the shape function of the left vertex of 'e', its local shape function k is first + k
+  /// (k = 0 left vertex, 1..p-1 bubbles, p right vertex).
+  int get_first_basis(int e) const { return first_basis[e]; }
+
+  bool is_dirichlet(int basis) const;
+  double get_dirichlet_value(int basis) const;
+
+  void refine_all_elements();
+  /// Splits 'e' into halves of the degrees 'order_left', 'order_right'.
+  void split_element(int e, int order_left, int order_right);
+  void set_element_order(int e, int order);
+  void set_uniform_order(int order);
+  /// Adds 'change' to all degrees, keeping them between 'min_order' and H1D_MAX_ORDER.
+  void adjust_element_order(int change, int min_order);
+  /// Merges all pairs of sibling elements, the merged element gets the higher degree.
+  void unrefine_all_elements();
+
+  /// Every element split in two and the degrees increased by 'order_increase'.
+  Space1D* create_ref_space(int order_increase = 1) const;
+
+  /// Vertices of a mesh loaded by MeshReaderH1DXML, i.e. the x-coordinates of its strip of elements.
+  static std::vector<double> get_mesh_vertices(Mesh* mesh);
+
+private:
+  struct Element1D
+  {
+    double left, right;
+    int order;
+    int base, level, index;
+  };
+
+  void assign_basis();
+
+  std::vector<Element1D> elements;
+  std::vector<int> first_basis;
+  bool dirichlet_left, dirichlet_right;
+  double bc_left, bc_right;
+};
+
+/// Piecewise polynomial function on a Space1D (a copy of the space, so that the space may change).
+class Solution1D
+{
+public:
+  Solution1D();
+  Solution1D(const Space1D& space, const std::vector<double>& coeffs);
+  /// The space with all coefficients zero except the Dirichlet values.
+  Solution1D(const Space1D& space);
+
+  const Space1D& get_space() const { return space; }
+  const std::vector<double>& get_coeffs() const { return coeffs; }
+
+  double value(double x) const;
+  double derivative(double x) const;
+  void value_and_derivative(double x, double& value, double& derivative) const;
+
+  /// Writes 'x value' lines sampled at 'num_samples' points per element.
+  void save(const char* filename, int num_samples = 10) const;
+
+private:
+  Space1D space;
+  std::vector<double> coeffs;
+};
+
+/// \brief Coefficients of the linear problem dY/dt = (a Y')' - c Y + f(x, t) in weak form.
+///
+/// The problem is time-dependent through f only, and its weak form is
+/// M dY/dt = F(t, Y) = -(a Y', v') - (c Y, v) + (f(t), v).
+/// The coefficients get the index of the initial mesh element ('base') as well, so that materials may jump
+/// at its vertices (the quadrature points include the end points of the elements).
+class Problem1D
+{
+public:
+  virtual ~Problem1D() {};
+  virtual double diffusion(double x, int base) const { return 1.0; }
+  virtual double reaction(double x, int base) const { return 0.0; }
+  virtual double source(double x, double t) const { return 0.0; }
+};
+
+/// Exact solution for convergence studies.
+class ExactSolution1D
+{
+public:
+  virtual ~ExactSolution1D() {};
+  virtual void value_and_derivative(double x, double& value, double& derivative) const = 0;
+};
+
+/// \brief Gauss-Lobatto quadrature on (-1, 1) with 'num_points' points (at least 2), exact
+/// for polynomials of degree 2 * num_points - 3. The rules are computed once and cached.
+void get_gauss_lobatto_rule(int num_points, const double*& points, const double*& weights);
+
+/// \brief Lobatto shape function k (0, 1 vertex functions, k >= 2 bubbles) and its derivative
+/// on the reference interval (-1, 1).
+void lobatto_shape_fn(int k, double xi, double& value, double& derivative);
+
+/// Global H1 projection of 'source' onto 'space'.
+Solution1D project_1d(const Space1D& space, const Solution1D& source);
+
+/// \brief Assembles the mass matrix M and the stiffness matrix S (diffusion and reaction) of 'problem',
+/// with S Y = -F(t, Y) + (f(t), v).
+void assemble_1d(const Space1D& space, const Problem1D* problem, BandMatrix& matrix_M, BandMatrix& matrix_S);
+/// (f(t), v) for all shape functions.
+void assemble_source_1d(const Space1D& space, const Problem1D* problem, double t, double* rhs);
+
+/// Solves the stationary problem -(a u')' + c u = f(x, 0) by one banded solve.
+Solution1D solve_stationary_1d(const Space1D& space, const Problem1D* problem);
+
+/// Relative error of 'sln' in the H1 norm.
+double calc_rel_error_1d(const Solution1D& sln, const ExactSolution1D* exact);
+
+/// \brief Runge-Kutta time stepping of a Problem1D with explicit or diagonally implicit Butcher's tables.
+///
+/// The problem is linear, so every implicit stage is one banded solve with M + time_step * a_ii * S,
+/// and the factorization is reused by all stages with the same a_ii (all of them for SDIRK methods).
+class RungeKutta1D
+{
+public:
+  RungeKutta1D(const Problem1D* problem, ButcherTable* bt);
+
+  /// One step from 'sln_time_prev' (projected on 'space') to 'sln_time_new' on 'space'.
+  void rk_time_step(const Space1D& space, double current_time, double time_step,
+                    const Solution1D& sln_time_prev, Solution1D& sln_time_new) const;
+
+private:
+  const Problem1D* problem;
+  ButcherTable* bt;
+};
+
+/// \brief hp-adaptivity on 1D intervals driven by a reference solution.
+///
+/// Element errors are the squared H1 norms of the difference of the coarse and the reference solutions,
+/// relative to the norm of the reference solution. The candidates of an element are the p-refinements
+/// p + 1, p + 2 and the h-refinements into halves of the degrees around (p + 1) / 2, each evaluated by the
+/// projection-based interpolation of the reference solution (vertex values, bubbles by the H1 seminorm
+/// projection, which is diagonal for the Lobatto shape functions). The candidate with the best
+/// decrease of the log error per added degree of freedom (to the power 'conv_exp') is chosen.
+class Adapt1D
+{
+public:
+  Adapt1D(Space1D* space);
+
+  /// Relative error estimate in the H1 norm.
+  double calc_err_est(const Solution1D& sln, const Solution1D& ref_sln);
+
+  /// Same strategies and thresholds as Adapt<double>::adapt() on the squared element errors (strategy 0 processes
+  /// sqrt(threshold) of the total error). Returns true if no element was refined.
+  bool adapt(const Solution1D& ref_sln, double threshold, int strategy = 0, double conv_exp = 1.0);
+
+private:
+  // Squared H1 norm of the interpolation error of 'ref_sln' on (a, b) by the degree 'order'.
+  double interpolation_error(const Solution1D& ref_sln, double a, double b, int order) const;
+
+  Space1D* space;
+  std::vector<double> elem_errors;
+};
+
+#endif
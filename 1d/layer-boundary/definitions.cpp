@@ -75,3 +75,21 @@ CustomWeakForm::CustomWeakForm(CustomFunction* f) : WeakForm<double>(1)
                                                       new Hermes::Hermes2DFunction<double>(f->coeff1*f->coeff1)));
   add_vector_form(new Hermes::Hermes2D::WeakFormsH1::DefaultVectorFormVol<double>(0, HERMES_ANY, f));
 }
+
+
+double CustomProblem1D::reaction(double x, int base) const
+{
+  return f->coeff1 * f->coeff1;
+}
+
+double CustomProblem1D::source(double x, double t) const
+{
+  // The weak form has the residual (u', v') + K^2 (u, v) + (f, v).
+  return -f->value(x, 0.0);
+}
+
+void CustomExactSolution1D::value_and_derivative(double x, double& value, double& derivative) const
+{
+  value = cef.uhat(x);
+  derivative = cef.duhat_dx(x);
+}
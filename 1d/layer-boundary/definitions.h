@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "../common/hp_fem_1d.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
@@ -62,3 +63,27 @@ class CustomWeakForm : public WeakForm<double>
 public:
   CustomWeakForm(CustomFunction* f);
 };
+
+/* The problem and the exact solution for the native 1D engine */
+
+class CustomProblem1D : public Problem1D
+{
+public:
+  CustomProblem1D(CustomFunction* f) : Problem1D(), f(f) {};
+
+  virtual double reaction(double x, int base) const;
+
+  virtual double source(double x, double t) const;
+
+  CustomFunction* f;
+};
+
+class CustomExactSolution1D : public ExactSolution1D
+{
+public:
+  CustomExactSolution1D(double K) : ExactSolution1D(), cef(K) {};
+
+  virtual void value_and_derivative(double x, double& value, double& derivative) const;
+
+  mutable CustomExactFunction cef;
+};
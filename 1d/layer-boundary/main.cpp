@@ -16,8 +16,16 @@ using namespace RefinementSelectors;
 //
 //  Exact solution: U(x) = 1 - (exp(K*x) + exp(-K*x))/(exp(K) + exp(-K)).
 //
+//  The problem is solved either by the native 1D engine (common/hp_fem_1d.h), 
+//  which works on intervals with banded matrices, or by Hermes2D on a strip 
+//  of elements.
+//
 //  The following parameters can be changed:
 
+// Use the native 1D engine instead of Hermes2D. There is no visualization 
+// (the last solution is saved to solution_1d.dat).
+const bool NATIVE_1D = true;
+
 // Initial polynomial degree of mesh elements.
 const int P_INIT = 1;                             
 // Number of initial mesh refinements (the original mesh is just one element).
@@ -63,6 +71,103 @@ Hermes::MatrixSolverType matrix_solver = Hermes::SOLVER_UMFPACK;
 // Problem parameters.
 const double K = 1e2;
 
+// The same adaptivity loop by the native 1D engine.
+int solve_native_1d(Mesh* mesh)
+{
+  // Perform initial mesh refinements, the elements at the boundary are split INIT_REF_NUM_BDY times.
+  Space1D space(Space1D::get_mesh_vertices(mesh), P_INIT);
+  for (int i = 0; i < INIT_REF_NUM; i++) space.refine_all_elements();
+  for (int i = 0; i < INIT_REF_NUM_BDY; i++)
+  {
+    space.split_element(0, P_INIT, P_INIT);
+    space.split_element(space.get_num_elements() - 1, P_INIT, P_INIT);
+  }
+
+  CustomFunction f(K);
+  CustomProblem1D problem(&f);
+  CustomExactSolution1D exact_sln(K);
+
+  // DOF and CPU convergence graphs.
+  SimpleGraph graph_dof_est, graph_cpu_est, graph_dof_exact, graph_cpu_exact;
+
+  // Time measurement.
+  Hermes::Mixins::TimeMeasurable cpu_time;
+  cpu_time.tick();
+
+  // Adaptivity loop:
+  int as = 1; bool done = false;
+  Solution1D ref_sln;
+  do
+  {
+    cpu_time.tick();
+
+    // Construct the reference space (all elements split, degrees increased by one).
+    Space1D* ref_space = space.create_ref_space();
+    Hermes::Mixins::Loggable::Static::info("---- Adaptivity step %d (%d DOF):", as, ref_space->get_num_dofs());
+
+    Hermes::Mixins::Loggable::Static::info("Solving on reference mesh.");
+    ref_sln = solve_stationary_1d(*ref_space, &problem);
+
+    cpu_time.tick();
+    Hermes::Mixins::Loggable::Static::info("Solution: %g s", cpu_time.last());
+
+    // Project the fine mesh solution onto the coarse mesh.
+    Hermes::Mixins::Loggable::Static::info("Calculating error estimate and exact error.");
+    Solution1D sln = project_1d(space, ref_sln);
+
+    // Calculate element errors and total error estimate.
+    Adapt1D adaptivity(&space);
+    double err_est_rel = adaptivity.calc_err_est(sln, ref_sln) * 100;
+
+    // Calculate exact error.
+    double err_exact_rel = calc_rel_error_1d(sln, &exact_sln) * 100;
+
+    cpu_time.tick();
+    Hermes::Mixins::Loggable::Static::info("Error calculation: %g s", cpu_time.last());
+
+    // Report results.
+    Hermes::Mixins::Loggable::Static::info("ndof_coarse: %d, ndof_fine: %d", space.get_num_dofs(), ref_space->get_num_dofs());
+    Hermes::Mixins::Loggable::Static::info("err_est_rel: %g%%, err_exact_rel: %g%%", err_est_rel, err_exact_rel);
+
+    // Time measurement.
+    cpu_time.tick();
+    double accum_time = cpu_time.accumulated();
+
+    // Add entry to DOF and CPU convergence graphs.
+    graph_dof_est.add_values(space.get_num_dofs(), err_est_rel);
+    graph_dof_est.save("conv_dof_est.dat");
+    graph_cpu_est.add_values(accum_time, err_est_rel);
+    graph_cpu_est.save("conv_cpu_est.dat");
+    graph_dof_exact.add_values(space.get_num_dofs(), err_exact_rel);
+    graph_dof_exact.save("conv_dof_exact.dat");
+    graph_cpu_exact.add_values(accum_time, err_exact_rel);
+    graph_cpu_exact.save("conv_cpu_exact.dat");
+
+    cpu_time.tick(Hermes::Mixins::TimeMeasurable::HERMES_SKIP);
+
+    // If err_est too large, adapt the mesh.
+    if (err_exact_rel < ERR_STOP || space.get_num_dofs() >= NDOF_STOP)
+      done = true;
+    else
+      done = adaptivity.adapt(ref_sln, THRESHOLD, STRATEGY, CONV_EXP);
+
+    cpu_time.tick();
+    Hermes::Mixins::Loggable::Static::info("Adaptation: %g s", cpu_time.last());
+
+    // Increase the counter of adaptivity steps.
+    if (done == false)
+      as++;
+
+    delete ref_space;
+  }
+  while (done == false);
+
+  ref_sln.save("solution_1d.dat");
+
+  Hermes::Mixins::Loggable::Static::info("Total running time: %g s", cpu_time.accumulated());
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
   // Load the mesh.
@@ -70,6 +175,9 @@ int main(int argc, char* argv[])
   MeshReaderH1DXML mloader;
   mloader.load("domain.xml", &mesh);
 
+  if (NATIVE_1D)
+    return solve_native_1d(&mesh);
+
   // Perform initial mesh refinement.
   // Split elements vertically.
   int refinement_type = 2;                        
@@ -129,3 +129,9 @@ CustomWeakFormPoisson::CustomWeakFormPoisson(
   add_vector_form(new CustomVectorFormVol(0, f, area, gt));
 };
 
+
+double CustomProblem1D::source(double x, double t) const
+{
+  // The same right-hand side as in CustomVectorFormVol.
+  return f->value(x, 0.0, t);
+}
@@ -1,5 +1,6 @@
 #include "hermes2d.h"
 #include "runge_kutta.h"
+#include "../common/hp_fem_1d.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
@@ -74,3 +75,15 @@ public:
     GeomType gt = HERMES_PLANAR);
 };
 
+
+/* The problem for the native 1D engine */
+
+class CustomProblem1D : public Problem1D
+{
+public:
+  CustomProblem1D(CustomFunction* f) : Problem1D(), f(f) {};
+
+  virtual double source(double x, double t) const;
+
+  CustomFunction* f;
+};
@@ -17,8 +17,17 @@ using namespace RefinementSelectors;
 //
 //  IC: Zero.
 //
+//  The problem is solved either by the native 1D engine (common/hp_fem_1d.h), 
+//  which works on intervals with banded matrices, or by Hermes2D on a strip 
+//  of elements.
+//
 //  The following parameters can be changed:
 
+// Use the native 1D engine instead of Hermes2D. Only the R-K methods that are 
+// explicit or diagonally implicit are supported by it, and there is no 
+// visualization (the last solution is saved to solution_1d.dat).
+const bool NATIVE_1D = true;
+
 // Number of initial uniform mesh refinements.
 const int INIT_REF_NUM = 1;                       
 // Initial polynomial degree of mesh elements.
@@ -106,6 +115,110 @@ double c = 1000.0;
 // Current time.
 double current_time = 0.0;
 
+// The same adaptive time stepping by the native 1D engine.
+int solve_native_1d(Mesh* basemesh, ButcherTable* bt)
+{
+  Hermes::Mixins::TimeMeasurable cpu_time;
+  cpu_time.tick();
+
+  // Perform initial mesh refinements.
+  Space1D basespace(Space1D::get_mesh_vertices(basemesh), P_INIT);
+  for(int i = 0; i < INIT_REF_NUM; i++) basespace.refine_all_elements();
+  Space1D space(basespace);
+
+  CustomFunction f(x_0, x_1, y_0, y_1, s, c);
+  CustomProblem1D problem(&f);
+  RungeKutta1D runge_kutta(&problem, bt);
+
+  // Previous and next time level solution (zero initial condition).
+  Solution1D sln_time_prev(space), sln_time_new(space);
+
+  // Graph for dof history.
+  SimpleGraph dof_history_graph;
+
+  // Time stepping loop.
+  int ts = 1;
+  do 
+  {
+    // Periodic global derefinement.
+    if (ts > 1 && ts % UNREF_FREQ == 0) 
+    {
+      Hermes::Mixins::Loggable::Static::info("Global mesh derefinement.");
+      switch (UNREF_METHOD) {
+        case 1: space = basespace;
+                break;
+        case 2: space.unrefine_all_elements();
+                space.set_uniform_order(P_INIT);
+                break;
+        case 3: space.unrefine_all_elements();
+                space.adjust_element_order(-1, P_INIT);
+                break;
+        default: throw Hermes::Exceptions::Exception("Wrong global derefinement method.");
+      }
+    }
+
+    // Spatial adaptivity loop. Note: sln_time_prev must not be changed 
+    // during spatial adaptivity. 
+    bool done = false; int as = 1;
+    do {
+      Hermes::Mixins::Loggable::Static::info("Time step %d, adaptivity step %d:", ts, as);
+
+      // Construct the reference space (all elements split, degrees increased by one).
+      Space1D* ref_space = space.create_ref_space();
+
+      // Perform one Runge-Kutta time step according to the selected Butcher's table.
+      Hermes::Mixins::Loggable::Static::info("Runge-Kutta time step (t = %g s, tau = %g s, stages: %d).",
+          current_time, time_step, bt->get_size());
+      runge_kutta.rk_time_step(*ref_space, current_time, time_step, sln_time_prev, sln_time_new);
+
+      // Project the fine mesh solution onto the coarse mesh.
+      Solution1D sln_coarse = project_1d(space, sln_time_new);
+
+      // Calculate element errors and total error estimate.
+      Adapt1D adaptivity(&space);
+      double err_est_rel_total = adaptivity.calc_err_est(sln_coarse, sln_time_new) * 100;
+
+      // Report results.
+      Hermes::Mixins::Loggable::Static::info("ndof_coarse: %d, ndof_ref: %d, err_est_rel: %g%%", 
+           space.get_num_dofs(), ref_space->get_num_dofs(), err_est_rel_total);
+
+      // If err_est too large, adapt the mesh.
+      if (err_est_rel_total < ERR_STOP) done = true;
+      else 
+      {
+        Hermes::Mixins::Loggable::Static::info("Adapting the coarse mesh.");
+        done = adaptivity.adapt(sln_time_new, THRESHOLD, STRATEGY, CONV_EXP);
+
+        if (space.get_num_dofs() >= NDOF_STOP) 
+          done = true;
+        else
+          // Increase the counter of performed adaptivity steps.
+          as++;
+      }
+
+      delete ref_space;
+    }
+    while (done == false);
+
+    // Copy last reference solution into sln_time_prev.
+    sln_time_prev = sln_time_new;
+
+    dof_history_graph.add_values(current_time, space.get_num_dofs());
+    dof_history_graph.save("dof_history.dat");
+
+    // Increase current time and counter of time steps.
+    current_time += time_step;
+    ts++;
+  }
+  while (current_time < T_FINAL);
+
+  sln_time_new.save("solution_1d.dat");
+
+  cpu_time.tick();
+  Hermes::Mixins::Loggable::Static::info("Total running time: %g s", cpu_time.accumulated());
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
   // Choose a Butcher's table or define your own.
@@ -127,6 +240,9 @@ int main(int argc, char* argv[])
     return -1;
   }
 
+  if (NATIVE_1D)
+    return solve_native_1d(&basemesh, &bt);
+
   // Perform initial mesh refinements.
   int refinement_type = 2;                        // Split elements vertically.
   for(int i = 0; i < INIT_REF_NUM; i++) basemesh.refine_all_elements(refinement_type, true);
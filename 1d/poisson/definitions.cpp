@@ -15,3 +15,14 @@ CustomWeakFormPoisson::CustomWeakFormPoisson(std::string mat_al, Hermes::Hermes1
   add_vector_form(new Hermes::Hermes2D::WeakFormsH1::DefaultResidualDiffusion<double>(0, mat_cu, lambda_cu));
   add_vector_form(new Hermes::Hermes2D::WeakFormsH1::DefaultVectorFormVol<double>(0, HERMES_ANY, src_term));
 };
+
+double CustomProblem1D::diffusion(double x, int base) const
+{
+  return base == 0 ? lambda_cu : lambda_al;
+}
+
+double CustomProblem1D::source(double x, double t) const
+{
+  // -(lambda u')' = VOLUME_HEAT_SRC, the same as the weak form above.
+  return heat_src;
+}
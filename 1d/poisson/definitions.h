@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "../common/hp_fem_1d.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
@@ -12,3 +13,19 @@ public:
                         std::string mat_cu, Hermes::Hermes1DFunction<double>* lambda_cu,
                         Hermes::Hermes2DFunction<double>* src_term);
 };
+
+/* The problem for the native 1D engine */
+
+class CustomProblem1D : public Problem1D
+{
+public:
+  // The elements of the initial mesh are Cu (base element 0) and Al (1), as in domain.xml.
+  CustomProblem1D(double lambda_cu, double lambda_al, double heat_src)
+    : Problem1D(), lambda_cu(lambda_cu), lambda_al(lambda_al), heat_src(heat_src) {};
+
+  virtual double diffusion(double x, int base) const;
+
+  virtual double source(double x, double t) const;
+
+  double lambda_cu, lambda_al, heat_src;
+};
@@ -11,8 +11,16 @@ using namespace Hermes::Hermes2D;
 //
 // Geometry: Interval (0, 2*pi).
 //
+// The problem is solved either by the native 1D engine (common/hp_fem_1d.h), 
+// which works on intervals with banded matrices, or by Hermes2D on a strip 
+// of elements.
+//
 // The following parameters can be changed:
 
+// Use the native 1D engine instead of Hermes2D. There is no visualization 
+// (the solution is saved to solution_1d.dat).
+const bool NATIVE_1D = true;
+
 // Set to "false" to suppress Hermes OpenGL visualization. 
 const bool HERMES_VISUALIZATION = true;           
 // Set to "true" to enable VTK output.
@@ -36,6 +44,26 @@ const double VOLUME_HEAT_SRC = 5e3;
 // Fixed temperature on the boundary.
 const double FIXED_BDY_TEMP = 20.0;        
 
+// The same problem solved by the native 1D engine.
+int solve_native_1d(Mesh* mesh)
+{
+  Hermes::Mixins::TimeMeasurable cpu_time;
+  cpu_time.tick();
+
+  // Perform initial mesh refinements, Dirichlet conditions on both ends.
+  Space1D space(Space1D::get_mesh_vertices(mesh), P_INIT, true, true, FIXED_BDY_TEMP, FIXED_BDY_TEMP);
+  for (int i = 0; i < INIT_REF_NUM; i++) space.refine_all_elements();
+  Hermes::Mixins::Loggable::Static::info("ndof = %d", space.get_num_dofs());
+
+  CustomProblem1D problem(LAMBDA_CU, LAMBDA_AL, VOLUME_HEAT_SRC);
+  Solution1D sln = solve_stationary_1d(space, &problem);
+  sln.save("solution_1d.dat");
+
+  cpu_time.tick();
+  Hermes::Mixins::Loggable::Static::info("Total running time: %g s", cpu_time.accumulated());
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
   // Load the mesh.
@@ -43,6 +71,9 @@ int main(int argc, char* argv[])
   MeshReaderH1DXML mloader;
   mloader.load("domain.xml", &mesh);
 
+  if (NATIVE_1D)
+    return solve_native_1d(&mesh);
+
   // Perform initial mesh refinements (optional).
   // Split elements vertically.
   int refinement_type = 2;            
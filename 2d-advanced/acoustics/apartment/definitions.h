@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "../../common/frequency_sweep.h"
 
 /* Namespaces used */
 
@@ -69,6 +69,19 @@ const double OMEGA = 2 * M_PI * FREQ;
 const double SOUND_SPEED = 353.0;
 const std::complex<double> P_SOURCE(1.0, 0.0);
 
+// Frequency sweep on the final reference space.
+// Number of frequencies of the sweep, off by default (0 ... no sweep). Set e.g. to 50
+// to solve at as many frequencies in SWEEP_FREQ_MIN ... SWEEP_FREQ_MAX, the norms are saved to sweep.dat.
+const int SWEEP_NUM = 0;
+// Range of the sweep.
+const double SWEEP_FREQ_MIN = 4e2;
+const double SWEEP_FREQ_MAX = 6e2;
+// If true, the sweep uses the reduced (moment-matching) model about FREQ,
+// otherwise the full problem is solved for every frequency.
+const bool SWEEP_REDUCED = false;
+// Number of moments of the reduced model.
+const int SWEEP_MOMENTS = 12;
+
 int main(int argc, char* argv[])
 {
   // Time measurement.
@@ -190,6 +203,37 @@ int main(int argc, char* argv[])
     }
     if (Space<std::complex<double> >::get_num_dofs(&space) >= NDOF_STOP) done = true;
 
+    // Frequency sweep on the final reference space.
+    if (done && SWEEP_NUM > 0)
+    {
+      Hermes::Mixins::Loggable::Static::info("Frequency sweep.");
+      CustomWeakFormAcoustics wf_0("Wall", RHO, SOUND_SPEED, 0.0);
+      CustomWeakFormAcoustics wf_minus("Wall", RHO, SOUND_SPEED, -OMEGA);
+      FrequencySweep<std::complex<double> > sweep(Hermes::vector<WeakForm<std::complex<double> >*>(&wf_0, &wf, &wf_minus),
+                                                  OMEGA, ref_space);
+
+      std::vector<double> omegas;
+      for (int f = 0; f < SWEEP_NUM; f++)
+        omegas.push_back(2 * M_PI * (SWEEP_FREQ_MIN + (SWEEP_NUM > 1 ? f * (SWEEP_FREQ_MAX - SWEEP_FREQ_MIN) / (SWEEP_NUM - 1) : 0.0)));
+      std::vector<std::complex<double>*> coeff_vecs;
+      if (SWEEP_REDUCED)
+        sweep.solve_reduced(omegas, OMEGA, SWEEP_MOMENTS, coeff_vecs);
+      else
+        sweep.solve(omegas, coeff_vecs);
+
+      // L2 norm of the pressure as a function of the frequency.
+      SimpleGraph graph_sweep;
+      Solution<std::complex<double> > sweep_sln;
+      for (int f = 0; f < SWEEP_NUM; f++)
+      {
+        Solution<std::complex<double> >::vector_to_solution(coeff_vecs[f], ref_space, &sweep_sln);
+        graph_sweep.add_values(omegas[f] / (2 * M_PI), Global<std::complex<double> >::calc_norm(&sweep_sln, HERMES_L2_NORM));
+        delete [] coeff_vecs[f];
+      }
+      graph_sweep.save("sweep.dat");
+      Hermes::Mixins::Loggable::Static::info("Frequency sweep saved to file %s.", "sweep.dat");
+    }
+
     delete adaptivity;
     if(!done)
       delete ref_space->get_mesh();
@@ -1,4 +1,6 @@
 #include "hermes2d.h"
+#include "../../common/frequency_sweep.h"
+#include "../../common/pml.h"
 
 /* Namespaces used */
 
@@ -12,6 +14,8 @@ using namespace Hermes::Hermes2D::RefinementSelectors;
 class CustomWeakFormAcoustics : public WeakForm<std::complex<double> >
 {
 public:
+  // With 'pml', the volumetric forms are integrated with the perfectly matched layer (of the same GeomType).
   CustomWeakFormAcoustics(std::string bdy_newton, double rho,
-                          double sound_speed, double omega);
+                          double sound_speed, double omega,
+                          GeomType gt = HERMES_PLANAR, const PerfectlyMatchedLayer* pml = NULL);
 };
@@ -69,6 +69,36 @@ const double OMEGA = 2 * M_PI * FREQ;
 const double SOUND_SPEED = 353.0;
 const std::complex<double>  P_SOURCE(1.0, 0.0);
 
+// Geometry of the problem: HERMES_PLANAR, or HERMES_AXISYM_Y for the horn rotated
+// about the axis of symmetry x = 0.
+const GeomType GEOM_TYPE = HERMES_PLANAR;
+
+// Perfectly matched layer in front of the outlet, between the radii PML_RADIUS and
+// PML_RADIUS + PML_THICKNESS about the origin (the outlet keeps the matched condition).
+// The layer lies in the extension of the domain beyond the outlet (the material "Pml" of
+// domain_pml.mesh, which reaches the radius 0.4), PML_RADIUS is just outside the farthest point
+// of the original outlet (0.314). Off by default (the mesh domain.mesh without the extension).
+const bool USE_PML = false;
+const double PML_RADIUS = 0.32;
+const double PML_THICKNESS = 0.08;
+// Strength alpha and degree of the stretching profile 1 + j alpha (xi / thickness)^degree,
+// one pass through the layer attenuates the wave by exp(-k alpha thickness / (degree + 1)).
+const double PML_ALPHA = 4.0;
+const int PML_DEGREE = 2;
+
+// Frequency sweep on the final reference space.
+// Number of frequencies of the sweep, off by default (0 ... no sweep). Set e.g. to 50
+// to solve at as many frequencies in SWEEP_FREQ_MIN ... SWEEP_FREQ_MAX, the norms are saved to sweep.dat.
+const int SWEEP_NUM = 0;
+// Range of the sweep.
+const double SWEEP_FREQ_MIN = 4e3;
+const double SWEEP_FREQ_MAX = 6e3;
+// If true, the sweep uses the reduced (moment-matching) model about FREQ,
+// otherwise the full problem is solved for every frequency.
+const bool SWEEP_REDUCED = false;
+// Number of moments of the reduced model.
+const int SWEEP_MOMENTS = 12;
+
 int main(int argc, char* argv[])
 {
   // Time measurement.
@@ -78,7 +108,7 @@ int main(int argc, char* argv[])
   // Load the mesh.
   Mesh mesh;
   MeshReaderH2D mloader;
-  mloader.load("domain.mesh", &mesh);
+  mloader.load(USE_PML ? "domain_pml.mesh" : "domain.mesh", &mesh);
 
   //MeshView mv("Initial mesh", new WinGeom(0, 0, 400, 400));
   //mv.show(&mesh);
@@ -96,8 +126,12 @@ int main(int argc, char* argv[])
   int ndof = Space<std::complex<double> >::get_num_dofs(&space);
   Hermes::Mixins::Loggable::Static::info("ndof = %d", ndof);
 
+  // Initialize the perfectly matched layer (prepared for every reference mesh).
+  PerfectlyMatchedLayer pml_layer(0.0, 0.0, PML_RADIUS, PML_THICKNESS, PML_ALPHA, PML_DEGREE, GEOM_TYPE);
+  const PerfectlyMatchedLayer* pml = USE_PML ? &pml_layer : NULL;
+
   // Initialize the weak formulation.
-  CustomWeakFormAcoustics wf("Outlet", RHO, SOUND_SPEED, OMEGA);
+  CustomWeakFormAcoustics wf("Outlet", RHO, SOUND_SPEED, OMEGA, GEOM_TYPE, pml);
 
   // Initialize coarse and reference mesh solution.
   Solution<std::complex<double> > sln, ref_sln;
@@ -127,6 +161,7 @@ int main(int argc, char* argv[])
     // Construct globally refined reference mesh and setup reference space.
     Mesh::ReferenceMeshCreator refMeshCreator(&mesh);
     Mesh* ref_mesh = refMeshCreator.create_ref_mesh();
+    pml_layer.prepare(ref_mesh);
 
     Space<std::complex<double> >::ReferenceSpaceCreator refSpaceCreator(&space, ref_mesh);
     Space<std::complex<double> >* ref_space = refSpaceCreator.create_ref_space();
@@ -192,6 +227,37 @@ int main(int argc, char* argv[])
     }
     if (Space<std::complex<double> >::get_num_dofs(&space) >= NDOF_STOP) done = true;
 
+    // Frequency sweep on the final reference space.
+    if (done && SWEEP_NUM > 0)
+    {
+      Hermes::Mixins::Loggable::Static::info("Frequency sweep.");
+      CustomWeakFormAcoustics wf_0("Outlet", RHO, SOUND_SPEED, 0.0, GEOM_TYPE, pml);
+      CustomWeakFormAcoustics wf_minus("Outlet", RHO, SOUND_SPEED, -OMEGA, GEOM_TYPE, pml);
+      FrequencySweep<std::complex<double> > sweep(Hermes::vector<WeakForm<std::complex<double> >*>(&wf_0, &wf, &wf_minus),
+                                                  OMEGA, ref_space);
+
+      std::vector<double> omegas;
+      for (int f = 0; f < SWEEP_NUM; f++)
+        omegas.push_back(2 * M_PI * (SWEEP_FREQ_MIN + (SWEEP_NUM > 1 ? f * (SWEEP_FREQ_MAX - SWEEP_FREQ_MIN) / (SWEEP_NUM - 1) : 0.0)));
+      std::vector<std::complex<double>*> coeff_vecs;
+      if (SWEEP_REDUCED)
+        sweep.solve_reduced(omegas, OMEGA, SWEEP_MOMENTS, coeff_vecs);
+      else
+        sweep.solve(omegas, coeff_vecs);
+
+      // L2 norm of the pressure as a function of the frequency.
+      SimpleGraph graph_sweep;
+      Solution<std::complex<double> > sweep_sln;
+      for (int f = 0; f < SWEEP_NUM; f++)
+      {
+        Solution<std::complex<double> >::vector_to_solution(coeff_vecs[f], ref_space, &sweep_sln);
+        graph_sweep.add_values(omegas[f] / (2 * M_PI), Global<std::complex<double> >::calc_norm(&sweep_sln, HERMES_L2_NORM));
+        delete [] coeff_vecs[f];
+      }
+      graph_sweep.save("sweep.dat");
+      Hermes::Mixins::Loggable::Static::info("Frequency sweep saved to file %s.", "sweep.dat");
+    }
+
     delete adaptivity;
     if (done == false)
       delete ref_space->get_mesh();
@@ -0,0 +1,546 @@
+#include "binary_checkpoint.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static const char CHECKPOINT_MAGIC[8] = { 'H', '2', 'D', 'C', 'K', 'P', 'T', '\0' };
+static const unsigned int CHECKPOINT_BYTE_ORDER = 0x01020304;
+
+static unsigned long long align(unsigned long long offset)
+{
+  return (offset + 7) & ~7ULL;
+}
+
+BinaryCheckpoint::BinaryCheckpoint(const char* prefix) : prefix(prefix), num(0), writing(false), job(NULL)
+{
+}
+
+BinaryCheckpoint::~BinaryCheckpoint()
+{
+  if (writing)
+  {
+    pthread_join(writer, NULL);
+    if (job->failed)
+      Hermes::Mixins::Loggable::Static::warn("Saving of the checkpoint %s failed.", job->filename.c_str());
+    delete job;
+  }
+  for (std::map<int, MappedFile>::iterator it = files.begin(); it != files.end(); ++it)
+  {
+#ifdef _WIN32
+    delete [] it->second.data;
+#else
+    if (it->second.mapped)
+      munmap(it->second.data, it->second.size);
+#endif
+  }
+}
+
+std::string BinaryCheckpoint::record_filename(int record) const
+{
+  char number[16];
+  sprintf(number, "-%d.h2dbin", record);
+  return prefix + number;
+}
+
+std::string BinaryCheckpoint::index_filename() const
+{
+  return prefix + ".index";
+}
+
+bool BinaryCheckpoint::have_record_available()
+{
+  wait();
+  num = 0;
+  FILE* f = fopen(index_filename().c_str(), "r");
+  if (f == NULL)
+    return false;
+  if (fscanf(f, "%d", &num) != 1)
+    num = 0;
+  fclose(f);
+  return num > 0;
+}
+
+void BinaryCheckpoint::active_elements(Element* e, std::vector<Element*>& elements)
+{
+  if (e->active)
+    elements.push_back(e);
+  else
+    for (int k = 0; k < H2D_MAX_ELEMENT_SONS; k++)
+      if (e->sons[k] != NULL)
+        active_elements(e->sons[k], elements);
+}
+
+void BinaryCheckpoint::active_elements(Mesh* mesh, std::vector<Element*>& elements)
+{
+  elements.clear();
+  Element* e;
+  for_all_base_elements(e, mesh)
+    active_elements(e, elements);
+}
+
+void BinaryCheckpoint::encode_tree(Element* e, std::vector<char>& tree)
+{
+  // 0 for active elements, otherwise 1 + the refinement (0 both ways, 1 horizontal, 2 vertical).
+  if (e->active)
+  {
+    tree.push_back(0);
+    return;
+  }
+  if (e->sons[0] != NULL && e->sons[2] != NULL)
+    tree.push_back(1);
+  else if (e->sons[0] != NULL)
+    tree.push_back(2);
+  else
+    tree.push_back(3);
+  for (int k = 0; k < H2D_MAX_ELEMENT_SONS; k++)
+    if (e->sons[k] != NULL)
+      encode_tree(e->sons[k], tree);
+}
+
+void BinaryCheckpoint::decode_tree(Mesh* mesh, int id, const char* tree, unsigned long long length, unsigned long long& pos)
+{
+  if (pos >= length)
+    throw Hermes::Exceptions::Exception("The refinement tree of the checkpoint is truncated.");
+  int code = tree[pos++];
+  if (code == 0)
+    return;
+  if (code < 0 || code > 3)
+    throw Hermes::Exceptions::Exception("Invalid refinement %d in the checkpoint.", code);
+  mesh->refine_element_id(id, code - 1);
+
+  // Recurse by the ids of the sons, the refinements may reallocate the elements.
+  int sons[H2D_MAX_ELEMENT_SONS];
+  Element* e = mesh->get_element(id);
+  for (int k = 0; k < H2D_MAX_ELEMENT_SONS; k++)
+    sons[k] = e->sons[k] != NULL ? e->sons[k]->id : -1;
+  for (int k = 0; k < H2D_MAX_ELEMENT_SONS; k++)
+    if (sons[k] >= 0)
+      decode_tree(mesh, sons[k], tree, length, pos);
+}
+
+void BinaryCheckpoint::ordered_dofs(const Space<double>* space, std::vector<int>& dofs, unsigned long long& shape_hash)
+{
+  // Every dof has a coefficient 1 on some element (constrained functions of hanging nodes only combine
+  // the dofs of the constraining elements).
+  std::vector<Element*> elements;
+  active_elements(space->get_mesh(), elements);
+  std::vector<std::pair<int, int> > entries;
+  int first_dof = -1;
+  AsmList<double> al;
+  for (unsigned int k = 0; k < elements.size(); k++)
+  {
+    space->get_element_assembly_list(elements[k], &al);
+    for (unsigned int j = 0; j < al.get_cnt(); j++)
+      if (al.get_dof()[j] >= 0 && al.get_coef()[j] == 1.0)
+      {
+        entries.push_back(std::make_pair(al.get_dof()[j], al.get_idx()[j]));
+        if (first_dof < 0 || al.get_dof()[j] < first_dof)
+          first_dof = al.get_dof()[j];
+      }
+  }
+
+  int ndof = space->get_num_dofs();
+  std::vector<bool> seen(ndof, false);
+  dofs.clear();
+  shape_hash = hash(NULL, 0);
+  for (unsigned int k = 0; k < entries.size(); k++)
+  {
+    int dof = entries[k].first - first_dof;
+    if (dof >= ndof)
+      throw Hermes::Exceptions::Exception("The dofs of a space of the checkpoint are not contiguous.");
+    if (seen[dof])
+      continue;
+    seen[dof] = true;
+    dofs.push_back(dof);
+    shape_hash = hash(&entries[k].second, sizeof(int), shape_hash);
+  }
+  if ((int) dofs.size() != ndof)
+    throw Hermes::Exceptions::Exception("Only %d of %d dofs of a space of the checkpoint have a shape function.", (int) dofs.size(), ndof);
+}
+
+unsigned long long BinaryCheckpoint::hash(const void* data, size_t length, unsigned long long h)
+{
+  // FNV-1a.
+  const unsigned char* bytes = (const unsigned char*) data;
+  for (size_t i = 0; i < length; i++)
+  {
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+unsigned long long BinaryCheckpoint::base_hash(Mesh* mesh)
+{
+  unsigned long long h = hash(NULL, 0);
+  Element* e;
+  for_all_base_elements(e, mesh)
+  {
+    for (int k = 0; k < e->get_nvert(); k++)
+    {
+      h = hash(&e->vn[k]->x, sizeof(double), h);
+      h = hash(&e->vn[k]->y, sizeof(double), h);
+    }
+  }
+  return h;
+}
+
+void BinaryCheckpoint::add_record(double time, double time_step, Mesh* mesh, Hermes::vector<const Space<double>*> spaces,
+                                  Hermes::vector<const Space<double>*> ref_spaces, Hermes::vector<Solution<double>*> solutions)
+{
+  if (solutions.size() != ref_spaces.size())
+    throw Hermes::Exceptions::Exception("Mismatched numbers of spaces and solutions in BinaryCheckpoint::add_record().");
+  double* coeff_vec = new double[Space<double>::get_num_dofs(ref_spaces)];
+  OGProjection<double> ogProjection;
+  ogProjection.project_global(ref_spaces, solutions, coeff_vec);
+  try
+  {
+    add_record(time, time_step, mesh, spaces, ref_spaces, coeff_vec);
+  }
+  catch (...)
+  {
+    delete [] coeff_vec;
+    throw;
+  }
+  delete [] coeff_vec;
+}
+
+void BinaryCheckpoint::add_record(double time, double time_step, Mesh* mesh, Hermes::vector<const Space<double>*> spaces,
+                                  Hermes::vector<const Space<double>*> ref_spaces, const double* coeff_vec)
+{
+  if (ref_spaces.size() != spaces.size())
+    throw Hermes::Exceptions::Exception("Mismatched numbers of spaces and solutions in BinaryCheckpoint::add_record().");
+  for (unsigned int i = 0; i < spaces.size(); i++)
+    if (spaces[i]->get_mesh() != mesh)
+      throw Hermes::Exceptions::Exception("The space %d of the checkpoint is not on its mesh.", i);
+
+  // Gather the data, while the previous record may still be written.
+  std::vector<std::vector<int> > dofs(ref_spaces.size());
+  std::vector<unsigned long long> shape_hashes(ref_spaces.size());
+  for (unsigned int i = 0; i < ref_spaces.size(); i++)
+    ordered_dofs(ref_spaces[i], dofs[i], shape_hashes[i]);
+
+  int ndof = Space<double>::get_num_dofs(ref_spaces);
+
+  std::vector<char> tree;
+  Element* e;
+  for_all_base_elements(e, mesh)
+    encode_tree(e, tree);
+
+  std::vector<Element*> elements;
+  active_elements(mesh, elements);
+  int num_active = elements.size();
+  std::vector<int> orders(spaces.size() * num_active);
+  for (unsigned int i = 0; i < spaces.size(); i++)
+    for (int k = 0; k < num_active; k++)
+      orders[i * num_active + k] = spaces[i]->get_element_order(elements[k]->id);
+
+  // Offsets of the sections; the tree and the orders refer to the previous records if they did not change.
+  wait();
+  Header header;
+  memset(&header, 0, sizeof(Header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.byte_order = CHECKPOINT_BYTE_ORDER;
+  header.time = time;
+  header.time_step = time_step;
+  header.num_spaces = spaces.size();
+  header.num_base_elements = mesh->get_num_base_elements();
+  header.base_hash = base_hash(mesh);
+
+  unsigned long long offset = align(sizeof(Header));
+  bool new_tree = (num == 0 || tree != saved_tree);
+  if (new_tree)
+  {
+    header.tree.record = num;
+    header.tree.offset = offset;
+    header.tree.length = tree.size();
+    offset = align(offset + tree.size());
+    saved_tree.swap(tree);
+    saved_tree_section = header.tree;
+  }
+  else
+    header.tree = saved_tree_section;
+
+  bool new_orders = (new_tree || orders != saved_orders);
+  if (new_orders)
+  {
+    header.orders.record = num;
+    header.orders.offset = offset;
+    header.orders.length = sizeof(int) * (1 + orders.size());
+    offset = align(offset + header.orders.length);
+    saved_orders.swap(orders);
+    saved_orders_section = header.orders;
+  }
+  else
+    header.orders = saved_orders_section;
+
+  // Per space: the number of values, the hash of their shape functions and the values.
+  header.coefficients.record = num;
+  header.coefficients.offset = offset;
+  header.coefficients.length = (2 * sizeof(unsigned long long)) * spaces.size() + sizeof(double) * ndof;
+
+  job = new Job;
+  job->filename = record_filename(num);
+  job->index_filename = index_filename();
+  job->num = num + 1;
+  job->failed = false;
+  job->buffer.resize(offset + header.coefficients.length, 0);
+  char* buffer = &job->buffer[0];
+  memcpy(buffer, &header, sizeof(Header));
+  if (new_tree && !saved_tree.empty())
+    memcpy(buffer + header.tree.offset, &saved_tree[0], saved_tree.size());
+  if (new_orders)
+  {
+    memcpy(buffer + header.orders.offset, &num_active, sizeof(int));
+    if (!saved_orders.empty())
+      memcpy(buffer + header.orders.offset + sizeof(int), &saved_orders[0], sizeof(int) * saved_orders.size());
+  }
+
+  char* position = buffer + header.coefficients.offset;
+  int first_dof = 0;
+  for (unsigned int i = 0; i < ref_spaces.size(); i++)
+  {
+    unsigned long long info[2] = { dofs[i].size(), shape_hashes[i] };
+    memcpy(position, info, sizeof(info));
+    double* values = (double*) (position + sizeof(info));
+    for (unsigned int k = 0; k < dofs[i].size(); k++)
+      values[k] = coeff_vec[first_dof + dofs[i][k]];
+    position += sizeof(info) + sizeof(double) * dofs[i].size();
+    first_dof += ref_spaces[i]->get_num_dofs();
+  }
+
+  num++;
+  if (pthread_create(&writer, NULL, write, job) != 0)
+  {
+    // Write on this thread.
+    write(job);
+    bool failed = job->failed;
+    delete job;
+    job = NULL;
+    if (failed)
+      throw Hermes::Exceptions::Exception("Saving of the checkpoint %d failed.", num - 1);
+  }
+  else
+    writing = true;
+}
+
+void* BinaryCheckpoint::write(void* data)
+{
+  Job* job = (Job*) data;
+  std::string temporary = job->filename + ".tmp";
+  FILE* f = fopen(temporary.c_str(), "wb");
+  job->failed = (f == NULL);
+  if (f != NULL)
+  {
+    job->failed = (fwrite(&job->buffer[0], 1, job->buffer.size(), f) != job->buffer.size());
+    job->failed = (fclose(f) != 0) || job->failed;
+  }
+#ifdef _WIN32
+  remove(job->filename.c_str());
+#endif
+  if (!job->failed)
+    job->failed = (rename(temporary.c_str(), job->filename.c_str()) != 0);
+  if (job->failed)
+    return NULL;
+
+  // The index is updated only when the record is complete.
+  std::string index_temporary = job->index_filename + ".tmp";
+  f = fopen(index_temporary.c_str(), "w");
+  job->failed = (f == NULL);
+  if (f != NULL)
+  {
+    fprintf(f, "%d\n", job->num);
+    job->failed = (fclose(f) != 0);
+  }
+#ifdef _WIN32
+  remove(job->index_filename.c_str());
+#endif
+  if (!job->failed)
+    job->failed = (rename(index_temporary.c_str(), job->index_filename.c_str()) != 0);
+  return NULL;
+}
+
+void BinaryCheckpoint::wait()
+{
+  if (!writing)
+    return;
+  pthread_join(writer, NULL);
+  writing = false;
+  bool failed = job->failed;
+  std::string filename = job->filename;
+  delete job;
+  job = NULL;
+  if (failed)
+    throw Hermes::Exceptions::Exception("Saving of the checkpoint %s failed.", filename.c_str());
+}
+
+const BinaryCheckpoint::MappedFile& BinaryCheckpoint::map(int record)
+{
+  std::map<int, MappedFile>::iterator it = files.find(record);
+  if (it != files.end())
+    return it->second;
+
+  std::string filename = record_filename(record);
+  MappedFile file;
+  file.data = NULL;
+  file.size = 0;
+  file.mapped = false;
+#ifdef _WIN32
+  // No mapping, the file is read at once.
+  FILE* f = fopen(filename.c_str(), "rb");
+  if (f == NULL)
+    throw Hermes::Exceptions::Exception("The checkpoint %s could not be opened.", filename.c_str());
+  fseek(f, 0, SEEK_END);
+  file.size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  file.data = new char[file.size];
+  bool failed = (fread(file.data, 1, file.size, f) != file.size);
+  fclose(f);
+  if (failed)
+  {
+    delete [] file.data;
+    throw Hermes::Exceptions::Exception("The checkpoint %s could not be read.", filename.c_str());
+  }
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw Hermes::Exceptions::Exception("The checkpoint %s could not be opened.", filename.c_str());
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    throw Hermes::Exceptions::Exception("The checkpoint %s could not be read.", filename.c_str());
+  }
+  file.size = st.st_size;
+  void* data = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    throw Hermes::Exceptions::Exception("The checkpoint %s could not be mapped.", filename.c_str());
+  file.data = (char*) data;
+  file.mapped = true;
+#endif
+  return files[record] = file;
+}
+
+const BinaryCheckpoint::Header& BinaryCheckpoint::last_header()
+{
+  if (num == 0)
+    throw Hermes::Exceptions::Exception("No checkpoint record is available.");
+  const MappedFile& file = map(num - 1);
+  if (file.size < sizeof(Header))
+    throw Hermes::Exceptions::Exception("The checkpoint %d is truncated.", num - 1);
+  const Header& header = *((const Header*) file.data);
+  if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+    throw Hermes::Exceptions::Exception("The file of the checkpoint %d is not a checkpoint.", num - 1);
+  if (header.version != VERSION)
+    throw Hermes::Exceptions::Exception("Unsupported version %d of the checkpoint %d.", (int) header.version, num - 1);
+  if (header.byte_order != CHECKPOINT_BYTE_ORDER)
+    throw Hermes::Exceptions::Exception("The checkpoint %d was written on a machine of a different byte order.", num - 1);
+  return header;
+}
+
+const char* BinaryCheckpoint::section(const Section& section, unsigned long long min_length)
+{
+  if (section.record < 0 || section.record >= num)
+    throw Hermes::Exceptions::Exception("The checkpoint refers to a missing record %d.", section.record);
+  const MappedFile& file = map(section.record);
+  if (section.length < min_length || section.offset + section.length > file.size)
+    throw Hermes::Exceptions::Exception("The checkpoint %d is truncated.", section.record);
+  return file.data + section.offset;
+}
+
+double BinaryCheckpoint::get_time()
+{
+  return last_header().time;
+}
+
+double BinaryCheckpoint::get_time_step()
+{
+  return last_header().time_step;
+}
+
+void BinaryCheckpoint::load_mesh(Mesh* mesh)
+{
+  const Header& header = last_header();
+  if (header.num_base_elements != mesh->get_num_base_elements() || header.base_hash != base_hash(mesh))
+    throw Hermes::Exceptions::Exception("The base elements of the mesh differ from those of the checkpoint.");
+  const char* tree = section(header.tree, 0);
+
+  Mesh base;
+  base.copy_base(mesh);
+  mesh->copy(&base);
+
+  unsigned long long pos = 0;
+  for (int id = 0; id < header.num_base_elements; id++)
+    if (mesh->get_element(id)->used)
+      decode_tree(mesh, id, tree, header.tree.length, pos);
+  if (pos != header.tree.length)
+    throw Hermes::Exceptions::Exception("The refinement tree of the checkpoint does not match the mesh.");
+}
+
+void BinaryCheckpoint::load_spaces(Hermes::vector<Space<double>*> spaces)
+{
+  const Header& header = last_header();
+  if ((int) spaces.size() != header.num_spaces)
+    throw Hermes::Exceptions::Exception("The checkpoint has %d spaces, not %d.", header.num_spaces, (int) spaces.size());
+  const int* orders = (const int*) section(header.orders, sizeof(int));
+  int num_active = orders[0];
+  if (header.orders.length != sizeof(int) * (1 + (unsigned long long) num_active * spaces.size()))
+    throw Hermes::Exceptions::Exception("The checkpoint has inconsistent element orders.");
+
+  for (unsigned int i = 0; i < spaces.size(); i++)
+  {
+    std::vector<Element*> elements;
+    active_elements(spaces[i]->get_mesh(), elements);
+    if ((int) elements.size() != num_active)
+      throw Hermes::Exceptions::Exception("The mesh of the space %d does not match the checkpoint.", i);
+    for (int k = 0; k < num_active; k++)
+      spaces[i]->set_element_order(elements[k]->id, orders[1 + i * num_active + k]);
+    spaces[i]->assign_dofs();
+  }
+}
+
+void BinaryCheckpoint::load_solutions(Hermes::vector<Solution<double>*> solutions, Hermes::vector<const Space<double>*> ref_spaces)
+{
+  const Header& header = last_header();
+  if ((int) ref_spaces.size() != header.num_spaces || solutions.size() != ref_spaces.size())
+    throw Hermes::Exceptions::Exception("The checkpoint has %d solutions.", header.num_spaces);
+  const char* position = section(header.coefficients, 0);
+  const char* end = position + header.coefficients.length;
+
+  // The values are read from the mapped file directly into the coefficient vector.
+  int ndof = Space<double>::get_num_dofs(ref_spaces);
+  double* coeff_vec = new double[ndof];
+  int first_dof = 0;
+  std::vector<int> dofs;
+  for (unsigned int i = 0; i < ref_spaces.size(); i++)
+  {
+    unsigned long long info[2], shape_hash;
+    ordered_dofs(ref_spaces[i], dofs, shape_hash);
+    bool match = (position + sizeof(info) <= end);
+    if (match)
+    {
+      memcpy(info, position, sizeof(info));
+      match = (info[0] == dofs.size() && info[1] == shape_hash && position + sizeof(info) + sizeof(double) * info[0] <= end);
+    }
+    if (!match)
+    {
+      delete [] coeff_vec;
+      throw Hermes::Exceptions::Exception("The reference space %d does not match the checkpoint.", i);
+    }
+    const double* values = (const double*) (position + sizeof(info));
+    for (unsigned int k = 0; k < dofs.size(); k++)
+      coeff_vec[first_dof + dofs[k]] = values[k];
+    position += sizeof(info) + sizeof(double) * dofs.size();
+    first_dof += ref_spaces[i]->get_num_dofs();
+  }
+
+  Solution<double>::vector_to_solutions(coeff_vec, ref_spaces, solutions);
+  delete [] coeff_vec;
+}
@@ -0,0 +1,138 @@
+#ifndef BINARY_CHECKPOINT_H
+#define BINARY_CHECKPOINT_H
+
+#include "hermes2d.h"
+#include <pthread.h>
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Binary checkpoints of adaptive time-dependent computations, a replacement of CalculationContinuity
+/// for large runs.
+///
+/// A record is one file '<prefix>-<number>.h2dbin': a versioned header followed by the sections
+///  - the refinement tree of the mesh (one byte per element, base elements first, sons depth-first),
+///  - the element orders of the spaces (contiguous int arrays, the active elements in the order of the tree),
+///  - the coefficients of the solutions (contiguous double arrays, 8-byte aligned).
+/// The coefficients are stored per element in the order of the tree (every dof at its first occurrence) instead of
+/// by the dof numbers, so that they can be restored into spaces whose numbering differs from the saved one, as
+/// is the case when the mesh is rebuilt from the tree. The tree and the orders are written only when they changed
+/// since the previous record; otherwise the header refers to the record holding them. Saving is asynchronous:
+/// add_record() packs the data into a buffer and a background thread writes it (to a temporary file, renamed
+/// when complete, so that an interrupted save never leaves a broken last record). Loading maps the files
+/// into memory and reads the arrays in place.
+///
+/// All spaces of a record have to be on one mesh, and the mesh to be loaded into has to have the same base
+/// elements (i.e. be loaded from the same mesh file).
+class BinaryCheckpoint
+{
+public:
+  BinaryCheckpoint(const char* prefix = "checkpoint");
+  /// Waits for the pending save.
+  ~BinaryCheckpoint();
+
+  /// Looks for the last complete record on the disk (and makes it the one to load from).
+  bool have_record_available();
+
+  /// Number of records.
+  int get_num() const { return num; }
+
+  /// Saves the time level: the mesh, the element orders of the spaces (on 'mesh') and the solutions given by
+  /// their coefficient vector on the reference spaces 'ref_spaces' (e.g. the solution vector of the solver),
+  /// which is copied into the record.
+  void add_record(double time, double time_step, Mesh* mesh, Hermes::vector<const Space<double>*> spaces,
+                  Hermes::vector<const Space<double>*> ref_spaces, const double* coeff_vec);
+  /// The same for solutions without a coefficient vector (e.g. limited ones), which are projected on the
+  /// reference spaces (on which they are defined exactly) first; this costs a global projection.
+  void add_record(double time, double time_step, Mesh* mesh, Hermes::vector<const Space<double>*> spaces,
+                  Hermes::vector<const Space<double>*> ref_spaces, Hermes::vector<Solution<double>*> solutions);
+
+  /// Waits for the pending save; throws if it failed.
+  void wait();
+
+  /// Time and time step of the last record.
+  double get_time();
+  double get_time_step();
+
+  /// Rebuilds the mesh of the last record from the base elements of 'mesh'.
+  void load_mesh(Mesh* mesh);
+  /// Sets the element orders of the spaces (on the mesh from load_mesh()) and assigns their dofs.
+  void load_spaces(Hermes::vector<Space<double>*> spaces);
+  /// Sets the solutions of the last record on the reference spaces (created in the same way as those of add_record()).
+  void load_solutions(Hermes::vector<Solution<double>*> solutions, Hermes::vector<const Space<double>*> ref_spaces);
+
+private:
+  struct Section
+  {
+    int record;
+    int reserved;
+    unsigned long long offset, length;
+  };
+
+  struct Header
+  {
+    char magic[8];
+    unsigned int version;
+    unsigned int byte_order;
+    double time, time_step;
+    int num_spaces;
+    int num_base_elements;
+    unsigned long long base_hash;
+    Section tree, orders, coefficients;
+  };
+
+  // Read-only view of a record file.
+  struct MappedFile
+  {
+    char* data;
+    size_t size;
+    bool mapped;
+  };
+
+  // Record to be written by the background thread, followed by the index of the records.
+  struct Job
+  {
+    std::string filename, index_filename;
+    std::vector<char> buffer;
+    int num;
+    bool failed;
+  };
+
+  static const unsigned int VERSION = 1;
+
+  std::string record_filename(int record) const;
+  std::string index_filename() const;
+  const MappedFile& map(int record);
+  const Header& last_header();
+  // Pointer to the section of the last record (in whichever record it is stored).
+  const char* section(const Section& section, unsigned long long min_length);
+
+  static void encode_tree(Element* e, std::vector<char>& tree);
+  static void decode_tree(Mesh* mesh, int id, const char* tree, unsigned long long length, unsigned long long& pos);
+  // Active elements in the order of the tree.
+  static void active_elements(Element* e, std::vector<Element*>& elements);
+  static void active_elements(Mesh* mesh, std::vector<Element*>& elements);
+  // Dofs of the space in the order of the tree (every one at its first occurrence, relative to the first dof
+  // of the space), and the hash of the shape functions they belong to.
+  static void ordered_dofs(const Space<double>* space, std::vector<int>& dofs, unsigned long long& shape_hash);
+  static unsigned long long hash(const void* data, size_t length, unsigned long long h = 14695981039346656037ULL);
+  static unsigned long long base_hash(Mesh* mesh);
+
+  static void* write(void* job);
+
+  std::string prefix;
+  int num;
+
+  // Tree and orders of the last saved record, for the incremental saves.
+  std::vector<char> saved_tree;
+  std::vector<int> saved_orders;
+  Section saved_tree_section, saved_orders_section;
+
+  bool writing;
+  pthread_t writer;
+  Job* job;
+
+  std::map<int, MappedFile> files;
+};
+
+#endif
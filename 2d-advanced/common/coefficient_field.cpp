@@ -0,0 +1,54 @@
+#include "coefficient_field.h"
+
+// Tables kept per element: the element and its edges, with a few numbers of points. Beyond this they are
+// mostly left over from elements of earlier meshes with the same id, and are dropped.
+static const unsigned int MAX_TABLES_PER_ELEMENT = 16;
+
+CoefficientField::CoefficientField(double (*fn)(double x, double y), int order)
+  : fn(fn), order(order)
+{
+}
+
+void CoefficientField::prepare(const Mesh* mesh)
+{
+  if ((int) tables.size() < mesh->get_max_element_id() + 1)
+    tables.resize(mesh->get_max_element_id() + 1);
+}
+
+void CoefficientField::fill(int n, Geom<double>* e, std::vector<double>& values) const
+{
+  values.resize(n);
+  for (int i = 0; i < n; i++)
+    values[i] = fn(e->x[i], e->y[i]);
+}
+
+const double* CoefficientField::get_values(int n, Geom<double>* e, std::vector<double>& scratch) const
+{
+  if (e->id < 0 || e->id >= (int) tables.size())
+  {
+    fill(n, e, scratch);
+    return &scratch[0];
+  }
+
+  // The points of the element and of its edges are told apart (and the elements of an earlier mesh
+  // with the same id detected) by the first and the last point.
+  std::vector<Table>& element_tables = tables[e->id];
+  for (unsigned int k = 0; k < element_tables.size(); k++)
+  {
+    const Table& table = element_tables[k];
+    if (table.n == n && table.x0 == e->x[0] && table.y0 == e->y[0] && table.x1 == e->x[n - 1] && table.y1 == e->y[n - 1])
+      return &table.values[0];
+  }
+
+  if (element_tables.size() >= MAX_TABLES_PER_ELEMENT)
+    element_tables.clear();
+  element_tables.push_back(Table());
+  Table& table = element_tables.back();
+  table.n = n;
+  table.x0 = e->x[0];
+  table.y0 = e->y[0];
+  table.x1 = e->x[n - 1];
+  table.y1 = e->y[n - 1];
+  fill(n, e, table.values);
+  return &table.values[0];
+}
@@ -0,0 +1,50 @@
+#ifndef COEFFICIENT_FIELD_H
+#define COEFFICIENT_FIELD_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Stationary coefficient f(x, y) sampled at the quadrature points of the elements.
+///
+/// Forms with a spatially varying coefficient evaluate it at the same points in every Newton iteration, stage
+/// and time step; the field evaluates the function once per element and number of points (on the element or
+/// on one of its edges), and caches the values by the id of the element, checked against the first and the
+/// last point. prepare() has to be called for every new mesh before the assembly: it makes room for its
+/// elements, so that they can be assembled in parallel (every element by one thread). The values of elements
+/// that have not changed are kept. Elements beyond the prepared mesh are evaluated without caching.
+///
+/// Time-dependent data separable as f(x, y) g(t) are the field times the scalar g(t), evaluated once per form.
+class CoefficientField
+{
+public:
+  /// 'order' is the polynomial degree added to the integration order for the coefficient.
+  CoefficientField(double (*fn)(double x, double y), int order);
+
+  void prepare(const Mesh* mesh);
+
+  /// Values at the 'n' points of 'e'; 'scratch' holds them for elements that are not cached.
+  const double* get_values(int n, Geom<double>* e, std::vector<double>& scratch) const;
+
+  int get_order() const { return order; }
+
+private:
+  // Values at the points of an element or one of its edges.
+  struct Table
+  {
+    int n;
+    double x0, y0, x1, y1;
+    std::vector<double> values;
+  };
+
+  void fill(int n, Geom<double>* e, std::vector<double>& values) const;
+
+  double (*fn)(double x, double y);
+  int order;
+
+  // Tables [element id] (one per number of points and edge), mutable as a cache.
+  mutable std::vector<std::vector<Table> > tables;
+};
+
+#endif
@@ -0,0 +1,373 @@
+#include "frequency_sweep.h"
+
+template<typename Scalar>
+FrequencySweep<Scalar>::FrequencySweep(Hermes::vector<WeakForm<Scalar>*> wfs, double omega_ref,
+                                       Hermes::vector<const Space<Scalar>*> spaces) : Ap(NULL), Ai(NULL)
+{
+  if (wfs.size() != 3)
+    throw Hermes::Exceptions::Exception("FrequencySweep needs the weak forms for 0, omega_ref and -omega_ref.");
+  if (omega_ref == 0.0)
+    throw Hermes::Exceptions::Exception("FrequencySweep needs a nonzero reference frequency.");
+
+  ndof = Space<Scalar>::get_num_dofs(spaces);
+  Scalar* zero_vec = new Scalar[ndof];
+  memset(zero_vec, 0, ndof * sizeof(Scalar));
+
+  // Samples of the matrix entries and of the right-hand side -R at 0, omega_ref and -omega_ref.
+  Scalar* samples_Ax[3];
+  Scalar* samples_rhs[3];
+  for (int s = 0; s < 3; s++)
+  {
+    DiscreteProblem<Scalar> dp(wfs[s], spaces);
+    SparseMatrix<Scalar>* matrix = create_matrix<Scalar>();
+    Vector<Scalar>* residual = create_vector<Scalar>();
+    dp.assemble(zero_vec, matrix, residual);
+
+    CSCMatrix<Scalar>* csc = dynamic_cast<CSCMatrix<Scalar>*>(matrix);
+    if (csc == NULL)
+      throw Hermes::Exceptions::Exception("FrequencySweep needs a matrix solver with CSC matrices (e.g. UMFPACK).");
+
+    // The weak forms only differ in the coefficients, the sparsity patterns are the same.
+    if (s == 0)
+    {
+      nnz = csc->get_nnz();
+      Ap = new int[ndof + 1];
+      memcpy(Ap, csc->get_Ap(), (ndof + 1) * sizeof(int));
+      Ai = new int[nnz];
+      memcpy(Ai, csc->get_Ai(), nnz * sizeof(int));
+    }
+    else if ((int) csc->get_nnz() != nnz)
+      throw Hermes::Exceptions::Exception("FrequencySweep: the weak forms have different structure.");
+
+    samples_Ax[s] = new Scalar[nnz];
+    memcpy(samples_Ax[s], csc->get_Ax(), nnz * sizeof(Scalar));
+    samples_rhs[s] = new Scalar[ndof];
+    for (int i = 0; i < ndof; i++)
+      samples_rhs[s][i] = -residual->get(i);
+
+    delete matrix;
+    delete residual;
+  }
+  delete [] zero_vec;
+
+  // Coefficients of the quadratic polynomial in omega.
+  for (int k = 0; k < 3; k++)
+  {
+    Ax[k] = new Scalar[nnz];
+    rhs[k] = new Scalar[ndof];
+  }
+  for (int i = 0; i < nnz; i++)
+  {
+    Ax[0][i] = samples_Ax[0][i];
+    Ax[1][i] = (samples_Ax[1][i] - samples_Ax[2][i]) / (2 * omega_ref);
+    Ax[2][i] = (samples_Ax[1][i] + samples_Ax[2][i] - 2.0 * samples_Ax[0][i]) / (2 * omega_ref * omega_ref);
+  }
+  for (int i = 0; i < ndof; i++)
+  {
+    rhs[0][i] = samples_rhs[0][i];
+    rhs[1][i] = (samples_rhs[1][i] - samples_rhs[2][i]) / (2 * omega_ref);
+    rhs[2][i] = (samples_rhs[1][i] + samples_rhs[2][i] - 2.0 * samples_rhs[0][i]) / (2 * omega_ref * omega_ref);
+  }
+
+  for (int s = 0; s < 3; s++)
+  {
+    delete [] samples_Ax[s];
+    delete [] samples_rhs[s];
+  }
+
+  Hermes::Mixins::Loggable::Static::info("Frequency sweep: ndof = %d, nnz = %d.", ndof, nnz);
+}
+
+template<typename Scalar>
+FrequencySweep<Scalar>::~FrequencySweep()
+{
+  for (int k = 0; k < 3; k++)
+  {
+    delete [] Ax[k];
+    delete [] rhs[k];
+  }
+  delete [] Ap;
+  delete [] Ai;
+}
+
+template<typename Scalar>
+void FrequencySweep<Scalar>::combine(double omega, Scalar* ax, Scalar* b) const
+{
+  double omega_sq = omega * omega;
+  for (int i = 0; i < nnz; i++)
+    ax[i] = Ax[0][i] + omega * Ax[1][i] + omega_sq * Ax[2][i];
+  for (int i = 0; i < ndof; i++)
+    b[i] = rhs[0][i] + omega * rhs[1][i] + omega_sq * rhs[2][i];
+}
+
+template<typename Scalar>
+void FrequencySweep<Scalar>::multiply(const Scalar* ax, const Scalar* x, Scalar* y) const
+{
+  memset(y, 0, ndof * sizeof(Scalar));
+  for (int c = 0; c < ndof; c++)
+    for (int k = Ap[c]; k < Ap[c + 1]; k++)
+      y[Ai[k]] += ax[k] * x[c];
+}
+
+template<typename Scalar>
+void FrequencySweep<Scalar>::solve(const std::vector<double>& omegas, std::vector<Scalar*>& coeff_vecs)
+{
+  int num_omegas = omegas.size();
+  coeff_vecs.assign(num_omegas, (Scalar*) NULL);
+  bool failed = false;
+
+#pragma omp parallel
+  {
+    // Each thread has its own matrix and solver, the symbolic factorization is reused between its frequencies.
+    SparseMatrix<Scalar>* matrix = create_matrix<Scalar>();
+    Vector<Scalar>* vec = create_vector<Scalar>();
+    vec->alloc(ndof);
+    LinearMatrixSolver<Scalar>* solver = create_linear_solver<Scalar>(matrix, vec);
+    Scalar* ax = new Scalar[nnz];
+    Scalar* b = new Scalar[ndof];
+    bool first = true;
+
+    // Every thread records its own failures, they are combined at the end of the loop.
+#pragma omp for schedule(dynamic) reduction(||:failed)
+    for (int f = 0; f < num_omegas; f++)
+    {
+      combine(omegas[f], ax, b);
+      matrix->free();
+      static_cast<CSCMatrix<Scalar>*>(matrix)->create(ndof, nnz, Ap, Ai, ax);
+      for (int i = 0; i < ndof; i++)
+        vec->set(i, b[i]);
+
+      if (!first)
+        solver->set_factorization_scheme(HERMES_REUSE_MATRIX_REORDERING);
+      first = false;
+
+      if (!solver->solve())
+      {
+        failed = true;
+        continue;
+      }
+      coeff_vecs[f] = new Scalar[ndof];
+      memcpy(coeff_vecs[f], solver->get_sln_vector(), ndof * sizeof(Scalar));
+    }
+
+    delete solver;
+    delete matrix;
+    delete vec;
+    delete [] ax;
+    delete [] b;
+  }
+
+  if (failed)
+    throw Hermes::Exceptions::Exception("Matrix solver failed in the frequency sweep.");
+}
+
+template<typename Scalar>
+void FrequencySweep<Scalar>::solve_reduced(const std::vector<double>& omegas, double omega_0, int num_moments,
+                                           std::vector<Scalar*>& coeff_vecs)
+{
+  // Scaling of the shift omega - omega_0, so that the moments are of comparable size.
+  double scale = 0.0;
+  for (unsigned int f = 0; f < omegas.size(); f++)
+    scale = std::max(scale, std::abs(omegas[f] - omega_0));
+  if (scale == 0.0)
+    scale = std::abs(omega_0);
+
+  // Taylor coefficients of the matrix and of the right-hand side in (omega - omega_0) / scale.
+  Scalar* ax_0 = new Scalar[nnz];
+  Scalar* ax_1 = new Scalar[nnz];
+  Scalar* ax_2 = new Scalar[nnz];
+  Scalar* b_taylor[3];
+  for (int k = 0; k < 3; k++)
+    b_taylor[k] = new Scalar[ndof];
+  combine(omega_0, ax_0, b_taylor[0]);
+  for (int i = 0; i < nnz; i++)
+  {
+    ax_1[i] = scale * (Ax[1][i] + 2 * omega_0 * Ax[2][i]);
+    ax_2[i] = scale * scale * Ax[2][i];
+  }
+  for (int i = 0; i < ndof; i++)
+  {
+    b_taylor[1][i] = scale * (rhs[1][i] + 2 * omega_0 * rhs[2][i]);
+    b_taylor[2][i] = scale * scale * rhs[2][i];
+  }
+
+  // Factorize the matrix at omega_0 once.
+  CSCMatrix<Scalar>* matrix = static_cast<CSCMatrix<Scalar>*>(create_matrix<Scalar>());
+  matrix->create(ndof, nnz, Ap, Ai, ax_0);
+  Vector<Scalar>* vec = create_vector<Scalar>();
+  vec->alloc(ndof);
+  LinearMatrixSolver<Scalar>* solver = create_linear_solver<Scalar>(matrix, vec);
+
+  // Moments m_j = A^{-1} (b_j - A_1 m_{j-1} - A_2 m_{j-2}), orthonormalized into V.
+  std::vector<Scalar*> moments;
+  std::vector<Scalar*> V;
+  Scalar* tmp = new Scalar[ndof];
+  for (int j = 0; j < num_moments; j++)
+  {
+    Scalar* m = new Scalar[ndof];
+    for (int i = 0; i < ndof; i++)
+      m[i] = (j < 3) ? b_taylor[j][i] : Scalar(0);
+    if (j >= 1)
+    {
+      multiply(ax_1, moments[j - 1], tmp);
+      for (int i = 0; i < ndof; i++)
+        m[i] -= tmp[i];
+    }
+    if (j >= 2)
+    {
+      multiply(ax_2, moments[j - 2], tmp);
+      for (int i = 0; i < ndof; i++)
+        m[i] -= tmp[i];
+    }
+    for (int i = 0; i < ndof; i++)
+      vec->set(i, m[i]);
+    if (!solver->solve())
+      throw Hermes::Exceptions::Exception("Matrix solver failed in the reduced frequency sweep.");
+    solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    memcpy(m, solver->get_sln_vector(), ndof * sizeof(Scalar));
+    moments.push_back(m);
+
+    // Modified Gram-Schmidt, twice; nearly dependent moments are dropped.
+    Scalar* v = new Scalar[ndof];
+    memcpy(v, m, ndof * sizeof(Scalar));
+    double norm_m = 0.0;
+    for (int i = 0; i < ndof; i++)
+      norm_m += std::abs(v[i]) * std::abs(v[i]);
+    norm_m = std::sqrt(norm_m);
+    for (int pass = 0; pass < 2; pass++)
+      for (unsigned int q = 0; q < V.size(); q++)
+      {
+        Scalar dot = Scalar(0);
+        for (int i = 0; i < ndof; i++)
+          dot += conjugate(V[q][i]) * v[i];
+        for (int i = 0; i < ndof; i++)
+          v[i] -= dot * V[q][i];
+      }
+    double norm_v = 0.0;
+    for (int i = 0; i < ndof; i++)
+      norm_v += std::abs(v[i]) * std::abs(v[i]);
+    norm_v = std::sqrt(norm_v);
+    if (norm_v <= 1e-12 * norm_m)
+    {
+      delete [] v;
+      continue;
+    }
+    for (int i = 0; i < ndof; i++)
+      v[i] /= norm_v;
+    V.push_back(v);
+  }
+  int q = V.size();
+  if (q == 0)
+    throw Hermes::Exceptions::Exception("All moments are zero in the reduced frequency sweep (zero right-hand side?).");
+  Hermes::Mixins::Loggable::Static::info("Reduced frequency sweep: %d basis vectors.", q);
+
+  // Reduced matrices V^H A_k V and right-hand sides V^H b_k.
+  std::vector<Scalar> A_red(3 * q * q);
+  std::vector<Scalar> b_red(3 * q);
+  for (int k = 0; k < 3; k++)
+  {
+    for (int c = 0; c < q; c++)
+    {
+      multiply(Ax[k], V[c], tmp);
+      for (int r = 0; r < q; r++)
+      {
+        Scalar dot = Scalar(0);
+        for (int i = 0; i < ndof; i++)
+          dot += conjugate(V[r][i]) * tmp[i];
+        A_red[k * q * q + c * q + r] = dot;
+      }
+    }
+    for (int r = 0; r < q; r++)
+    {
+      Scalar dot = Scalar(0);
+      for (int i = 0; i < ndof; i++)
+        dot += conjugate(V[r][i]) * rhs[k][i];
+      b_red[k * q + r] = dot;
+    }
+  }
+
+  // Dense reduced problems for the individual frequencies.
+  int num_omegas = omegas.size();
+  coeff_vecs.assign(num_omegas, (Scalar*) NULL);
+  bool failed = false;
+#pragma omp parallel for schedule(dynamic) reduction(||:failed)
+  for (int f = 0; f < num_omegas; f++)
+  {
+    double omega = omegas[f];
+    std::vector<Scalar> A(q * q), y(q);
+    for (int i = 0; i < q * q; i++)
+      A[i] = A_red[i] + omega * A_red[q * q + i] + omega * omega * A_red[2 * q * q + i];
+    for (int r = 0; r < q; r++)
+      y[r] = b_red[r] + omega * b_red[q + r] + omega * omega * b_red[2 * q + r];
+    if (!dense_solve(&A[0], &y[0], q))
+    {
+      failed = true;
+      continue;
+    }
+
+    coeff_vecs[f] = new Scalar[ndof];
+    memset(coeff_vecs[f], 0, ndof * sizeof(Scalar));
+    for (int c = 0; c < q; c++)
+      for (int i = 0; i < ndof; i++)
+        coeff_vecs[f][i] += y[c] * V[c][i];
+  }
+
+  delete solver;
+  delete matrix;
+  delete vec;
+  delete [] tmp;
+  delete [] ax_0;
+  delete [] ax_1;
+  delete [] ax_2;
+  for (int k = 0; k < 3; k++)
+    delete [] b_taylor[k];
+  for (unsigned int j = 0; j < moments.size(); j++)
+    delete [] moments[j];
+  for (unsigned int j = 0; j < V.size(); j++)
+    delete [] V[j];
+
+  if (failed)
+  {
+    for (int f = 0; f < num_omegas; f++)
+      delete [] coeff_vecs[f];
+    coeff_vecs.clear();
+    throw Hermes::Exceptions::Exception("Singular reduced problem in the reduced frequency sweep.");
+  }
+}
+
+template<typename Scalar>
+bool FrequencySweep<Scalar>::dense_solve(Scalar* A, Scalar* b, int n)
+{
+  for (int k = 0; k < n; k++)
+  {
+    int pivot = k;
+    for (int r = k + 1; r < n; r++)
+      if (std::abs(A[k * n + r]) > std::abs(A[k * n + pivot]))
+        pivot = r;
+    if (pivot != k)
+    {
+      for (int c = 0; c < n; c++)
+        std::swap(A[c * n + k], A[c * n + pivot]);
+      std::swap(b[k], b[pivot]);
+    }
+    if (A[k * n + k] == Scalar(0))
+      return false;
+    for (int r = k + 1; r < n; r++)
+    {
+      Scalar factor = A[k * n + r] / A[k * n + k];
+      for (int c = k; c < n; c++)
+        A[c * n + r] -= factor * A[c * n + k];
+      b[r] -= factor * b[k];
+    }
+  }
+  for (int k = n - 1; k >= 0; k--)
+  {
+    for (int c = k + 1; c < n; c++)
+      b[k] -= A[c * n + k] * b[c];
+    b[k] /= A[k * n + k];
+  }
+  return true;
+}
+
+template class FrequencySweep<double>;
+template class FrequencySweep<std::complex<double> >;
@@ -0,0 +1,70 @@
+#ifndef FREQUENCY_SWEEP_H
+#define FREQUENCY_SWEEP_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Frequency sweep of a linear time-harmonic problem.
+///
+/// The discrete problem of the usual Helmholtz-type weak forms (stiffness, damping proportional
+/// to omega, mass proportional to omega^2, loads at most quadratic in omega) is a quadratic
+/// polynomial in the angular frequency,
+///
+///   (A_0 + omega A_1 + omega^2 A_2) Y = b_0 + omega b_1 + omega^2 b_2.
+///
+/// The coefficients are extracted from the weak form of the problem (Jacobian and residual as for
+/// the Newton's method, nonhomogeneous Dirichlet conditions are thus included in b) by assembling it
+/// for the angular frequencies 0, omega_ref and -omega_ref, which is exact up to round-off. The matrix
+/// for each frequency is then an entrywise linear combination of three arrays with the same sparsity
+/// pattern, so that nothing is reassembled during the sweep.
+///
+/// solve() solves the full problem for every frequency, the frequencies are distributed over the
+/// OpenMP threads and each thread reuses the symbolic factorization. solve_reduced() projects the problem
+/// onto the moments (derivatives with respect to omega) of the solution at one expansion frequency,
+/// which needs a single factorization; the reduced problems are dense and small, and the result is
+/// a Pade-type approximation accurate in a neighbourhood of the expansion frequency.
+template<typename Scalar>
+class FrequencySweep
+{
+public:
+  /// \param[in] wfs        Weak forms of the problem constructed for the angular frequencies
+  ///                       0, omega_ref and -omega_ref (in this order).
+  /// \param[in] omega_ref  Reference angular frequency, preferably in the middle of the sweep.
+  FrequencySweep(Hermes::vector<WeakForm<Scalar>*> wfs, double omega_ref, Hermes::vector<const Space<Scalar>*> spaces);
+  ~FrequencySweep();
+
+  /// Solves the problem for all angular frequencies 'omegas'. The coefficient vectors are allocated
+  /// here and have to be deleted by the caller.
+  void solve(const std::vector<double>& omegas, std::vector<Scalar*>& coeff_vecs);
+
+  /// Approximates the solutions by the Galerkin projection onto 'num_moments' moments of the solution
+  /// at 'omega_0'. The coefficient vectors are allocated here and have to be deleted by the caller.
+  void solve_reduced(const std::vector<double>& omegas, double omega_0, int num_moments, std::vector<Scalar*>& coeff_vecs);
+
+  int get_num_dofs() const { return ndof; }
+
+private:
+  // Matrix entries and right-hand side for one angular frequency.
+  void combine(double omega, Scalar* ax, Scalar* b) const;
+
+  // y = A x with the entries 'ax' in the common sparsity pattern.
+  void multiply(const Scalar* ax, const Scalar* x, Scalar* y) const;
+
+  // Solves the dense system A x = b (column-major, overwritten) by the Gaussian elimination,
+  // returns false if A is singular.
+  static bool dense_solve(Scalar* A, Scalar* b, int n);
+
+  static double conjugate(double a) { return a; }
+  static std::complex<double> conjugate(std::complex<double> a) { return std::conj(a); }
+
+  int ndof, nnz;
+  int* Ap;
+  int* Ai;
+  // Coefficients of omega^0, omega^1 and omega^2.
+  Scalar* Ax[3];
+  Scalar* rhs[3];
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "imex_rk.h"
+
+// Diagonal coefficient of ROS2.
+static const double GAMMA = 1.0 + 1.0 / std::sqrt(2.0);
+
+ImexRungeKutta::ImexRungeKutta(const WeakForm<double>* wf, Hermes::vector<const Space<double>*> spaces, std::vector<bool> differential)
+  : wf(wf), spaces(spaces), differential(differential), time_step(0.0), neq(spaces.size()), matrix_M(NULL), ndof(0)
+{
+  if (wf->get_neq() != neq || (int) differential.size() != neq)
+    throw Hermes::Exceptions::Exception("Mismatched number of equations in ImexRungeKutta.");
+}
+
+ImexRungeKutta::~ImexRungeKutta()
+{
+  delete matrix_M;
+}
+
+void ImexRungeKutta::set_spaces(Hermes::vector<const Space<double>*> spaces)
+{
+  // M is reassembled lazily in rk_time_step(), which compares the sequence numbers.
+  this->spaces = spaces;
+}
+
+void ImexRungeKutta::set_time_step(double time_step)
+{
+  this->time_step = time_step;
+}
+
+void ImexRungeKutta::update_mass()
+{
+  bool changed = matrix_M == NULL;
+  for (int i = 0; i < neq && !changed; i++)
+    changed = spaces[i] != mass_spaces[i] || spaces[i]->get_seq() != mass_seqs[i];
+  if (!changed)
+    return;
+
+  mass_spaces = spaces;
+  mass_seqs.clear();
+  first_dofs.clear();
+  ndof = 0;
+  for (int i = 0; i < neq; i++)
+  {
+    mass_seqs.push_back(spaces[i]->get_seq());
+    first_dofs.push_back(ndof);
+    ndof += spaces[i]->get_num_dofs();
+  }
+
+  WeakForm<double> mass_wf(neq);
+  for (int i = 0; i < neq; i++)
+    if (differential[i])
+      mass_wf.add_matrix_form(new WeakFormsH1::DefaultMatrixFormVol<double>(i, i, HERMES_ANY, new Hermes2DFunction<double>(1.0), HERMES_SYM));
+
+  double* zero_vec = new double[ndof];
+  memset(zero_vec, 0, ndof * sizeof(double));
+  DiscreteProblem<double> dp(&mass_wf, spaces);
+  delete matrix_M;
+  matrix_M = create_matrix<double>();
+  dp.assemble(zero_vec, matrix_M);
+  delete [] zero_vec;
+  if (dynamic_cast<CSCMatrix<double>*>(matrix_M) == NULL)
+    throw Hermes::Exceptions::Exception("ImexRungeKutta needs a matrix solver with CSC matrices (e.g. UMFPACK).");
+}
+
+SparseMatrix<double>* ImexRungeKutta::compose(CSCMatrix<double>* jacobian, double mass_factor, double jacobian_factor) const
+{
+  CSCMatrix<double>* mass = static_cast<CSCMatrix<double>*>(matrix_M);
+  std::vector<int> Ap(1, 0);
+  std::vector<int> Ai;
+  std::vector<double> Ax;
+  std::vector<std::pair<int, double> > column;
+  for (int c = 0; c < ndof; c++)
+  {
+    column.clear();
+    for (int k = mass->get_Ap()[c]; k < mass->get_Ap()[c + 1]; k++)
+      column.push_back(std::make_pair(mass->get_Ai()[k], mass_factor * mass->get_Ax()[k]));
+    for (int k = jacobian->get_Ap()[c]; k < jacobian->get_Ap()[c + 1]; k++)
+      column.push_back(std::make_pair(jacobian->get_Ai()[k], jacobian_factor * jacobian->get_Ax()[k]));
+
+    // Sorted rows, the two matrices may have different sparsity patterns.
+    std::sort(column.begin(), column.end());
+    for (unsigned int k = 0; k < column.size(); k++)
+      if (k > 0 && column[k].first == column[k - 1].first)
+        Ax.back() += column[k].second;
+      else
+      {
+        Ai.push_back(column[k].first);
+        Ax.push_back(column[k].second);
+      }
+    Ap.push_back(Ai.size());
+  }
+
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  static_cast<CSCMatrix<double>*>(matrix)->create(ndof, Ai.size(), &Ap[0], &Ai[0], &Ax[0]);
+  return matrix;
+}
+
+bool ImexRungeKutta::make_consistent(CSCMatrix<double>* jacobian, const double* residual, double* coeff_vec) const
+{
+  // Index of every dof among the algebraic ones (-1 for the differential ones).
+  std::vector<int> index(ndof, -1);
+  std::vector<int> dofs;
+  for (int i = 0; i < neq; i++)
+    if (!differential[i])
+      for (int d = first_dofs[i]; d < first_dofs[i] + spaces[i]->get_num_dofs(); d++)
+      {
+        index[d] = dofs.size();
+        dofs.push_back(d);
+      }
+  if (dofs.empty())
+    return false;
+
+  // dF_a/dY_a delta = -F_a.
+  std::vector<int> Ap(1, 0);
+  std::vector<int> Ai;
+  std::vector<double> Ax;
+  for (unsigned int c = 0; c < dofs.size(); c++)
+  {
+    for (int k = jacobian->get_Ap()[dofs[c]]; k < jacobian->get_Ap()[dofs[c] + 1]; k++)
+      if (index[jacobian->get_Ai()[k]] >= 0)
+      {
+        Ai.push_back(index[jacobian->get_Ai()[k]]);
+        Ax.push_back(jacobian->get_Ax()[k]);
+      }
+    Ap.push_back(Ai.size());
+  }
+  if (Ai.empty())
+    throw Hermes::Exceptions::Exception("The constraints do not depend on the algebraic components in ImexRungeKutta.");
+
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  static_cast<CSCMatrix<double>*>(matrix)->create(dofs.size(), Ai.size(), &Ap[0], &Ai[0], &Ax[0]);
+  Vector<double>* rhs = create_vector<double>();
+  rhs->alloc(dofs.size());
+  for (unsigned int c = 0; c < dofs.size(); c++)
+    rhs->set(c, -residual[dofs[c]]);
+
+  LinearMatrixSolver<double>* solver = create_linear_solver<double>(matrix, rhs);
+  if (!solver->solve())
+    throw Hermes::Exceptions::Exception("Matrix solver failed in ImexRungeKutta.");
+  for (unsigned int c = 0; c < dofs.size(); c++)
+    coeff_vec[dofs[c]] += solver->get_sln_vector()[c];
+
+  delete solver;
+  delete rhs;
+  delete matrix;
+  return true;
+}
+
+void ImexRungeKutta::assemble_residual(DiscreteProblem<double>* dp, double* coeff_vec, double* residual) const
+{
+  Vector<double>* vector = create_vector<double>();
+  dp->assemble(coeff_vec, vector);
+  for (int d = 0; d < ndof; d++)
+    residual[d] = vector->get(d);
+  delete vector;
+}
+
+void ImexRungeKutta::rk_time_step(Hermes::vector<Solution<double>*> slns_time_prev, Hermes::vector<Solution<double>*> slns_time_new,
+                                  Hermes::vector<Solution<double>*> error_fns)
+{
+  update_mass();
+
+  double* coeff_vec = new double[ndof];
+  for (int i = 0; i < neq; i++)
+  {
+    OGProjection<double> ogProjection; ogProjection.project_global(spaces[i], slns_time_prev[i], coeff_vec + first_dofs[i]);
+  }
+
+  // The Jacobian and F at the beginning of the step, F again after the constraints are solved.
+  DiscreteProblem<double> dp(wf, spaces);
+  SparseMatrix<double>* jacobian = create_matrix<double>();
+  Vector<double>* vector = create_vector<double>();
+  dp.assemble(coeff_vec, jacobian, vector);
+  CSCMatrix<double>* csc_J = dynamic_cast<CSCMatrix<double>*>(jacobian);
+  if (csc_J == NULL)
+    throw Hermes::Exceptions::Exception("ImexRungeKutta needs a matrix solver with CSC matrices (e.g. UMFPACK).");
+
+  double* residual = new double[ndof];
+  for (int d = 0; d < ndof; d++)
+    residual[d] = vector->get(d);
+  delete vector;
+  // The constraints factorize their own block of J, the stage matrix is the other factorization.
+  bool consistent = make_consistent(csc_J, residual, coeff_vec);
+  if (consistent)
+    assemble_residual(&dp, coeff_vec, residual);
+
+  SparseMatrix<double>* stage_matrix = compose(csc_J, 1.0, -GAMMA * time_step);
+  Vector<double>* stage_rhs = create_vector<double>();
+  stage_rhs->alloc(ndof);
+  LinearMatrixSolver<double>* solver = create_linear_solver<double>(stage_matrix, stage_rhs);
+
+  // (M - gamma time_step J) K_1 = F(Y_n).
+  double* K_1 = new double[ndof];
+  for (int d = 0; d < ndof; d++)
+    stage_rhs->set(d, residual[d]);
+  if (!solver->solve())
+    throw Hermes::Exceptions::Exception("Matrix solver failed in ImexRungeKutta.");
+  memcpy(K_1, solver->get_sln_vector(), ndof * sizeof(double));
+
+  // (M - gamma time_step J) K_2 = F(Y_n + time_step K_1) - 2 M K_1.
+  double* stage_state = new double[ndof];
+  double* mass_K_1 = new double[ndof];
+  for (int d = 0; d < ndof; d++)
+    stage_state[d] = coeff_vec[d] + time_step * K_1[d];
+  assemble_residual(&dp, stage_state, residual);
+  static_cast<CSCMatrix<double>*>(matrix_M)->multiply_with_vector(K_1, mass_K_1);
+  for (int d = 0; d < ndof; d++)
+    stage_rhs->set(d, residual[d] - 2.0 * mass_K_1[d]);
+  solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+  if (!solver->solve())
+    throw Hermes::Exceptions::Exception("Matrix solver failed in ImexRungeKutta.");
+  const double* K_2 = solver->get_sln_vector();
+
+  // The second order solution, and its difference from the first order one Y_n + time_step K_1.
+  for (int d = 0; d < ndof; d++)
+  {
+    stage_state[d] = time_step * 0.5 * (K_1[d] + K_2[d]);
+    coeff_vec[d] += time_step * K_1[d] + stage_state[d];
+  }
+  Solution<double>::vector_to_solutions(coeff_vec, spaces, slns_time_new);
+  if (!error_fns.empty())
+    Solution<double>::vector_to_solutions(stage_state, spaces, error_fns);
+
+  Hermes::Mixins::Loggable::Static::info("IMEX R-K: %d factorization(s), ndof = %d.", consistent ? 2 : 1, ndof);
+
+  delete solver;
+  delete stage_rhs;
+  delete stage_matrix;
+  delete jacobian;
+  delete [] coeff_vec;
+  delete [] residual;
+  delete [] K_1;
+  delete [] stage_state;
+  delete [] mass_K_1;
+}
@@ -0,0 +1,69 @@
+#ifndef IMEX_RK_H
+#define IMEX_RK_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Linearly implicit (IMEX) two-stage Runge-Kutta method with an embedded error estimate, for autonomous
+/// problems M dY/dt = F(Y) where some of the components have no time derivative (algebraic constraints).
+///
+/// The weak form is the same as for RungeKutta<double>, i.e. its vector forms define F(Y) and its matrix forms
+/// dF/dY. The stiff part of the problem, linearized as the Jacobian J at the beginning of the step, is treated
+/// implicitly and the rest F(Y) - J Y explicitly. This is the second order method ROS2, which is L-stable and
+/// keeps its order with an approximate J:
+///   (M - gamma time_step J) K_1 = F(Y_n),
+///   (M - gamma time_step J) K_2 = F(Y_n + time_step K_1) - 2 M K_1,
+///   Y_{n+1} = Y_n + time_step (3/2 K_1 + 1/2 K_2),   gamma = 1 + 1/sqrt(2).
+/// A step costs one assembly of the Jacobian, one factorization and two back-substitutions instead of
+/// a Newton's method. The first order solution Y_n + time_step K_1 is embedded, their difference estimates
+/// the temporal error.
+///
+/// M is the mass matrix of the differential components (scalar spaces). The algebraic components of the
+/// projected initial state are made consistent with the differential ones at the beginning of every step,
+/// by one Newton's step on the constraints with the Jacobian of the step (exact for constraints linear
+/// in the algebraic components). This factorizes the algebraic block of J as well, i.e. a step with algebraic
+/// components costs two factorizations (the smaller one of the size of the algebraic components).
+class ImexRungeKutta
+{
+public:
+  /// 'differential' marks the components with a time derivative.
+  ImexRungeKutta(const WeakForm<double>* wf, Hermes::vector<const Space<double>*> spaces, std::vector<bool> differential);
+  ~ImexRungeKutta();
+
+  void set_spaces(Hermes::vector<const Space<double>*> spaces);
+  void set_time_step(double time_step);
+
+  /// \brief One time step from 'slns_time_prev' (projected on the spaces) to 'slns_time_new'.
+  ///
+  /// 'error_fns' (if not empty) receive the difference of the second and the first order solutions
+  /// as the estimate of the temporal error.
+  void rk_time_step(Hermes::vector<Solution<double>*> slns_time_prev, Hermes::vector<Solution<double>*> slns_time_new,
+                    Hermes::vector<Solution<double>*> error_fns = Hermes::vector<Solution<double>*>());
+
+private:
+  // Reassembles M if the spaces changed.
+  void update_mass();
+  // mass_factor * M + jacobian_factor * J.
+  SparseMatrix<double>* compose(CSCMatrix<double>* jacobian, double mass_factor, double jacobian_factor) const;
+  // Solves the constraints for the algebraic components of 'coeff_vec', returns false if there are none.
+  bool make_consistent(CSCMatrix<double>* jacobian, const double* residual, double* coeff_vec) const;
+  // F(coeff_vec).
+  void assemble_residual(DiscreteProblem<double>* dp, double* coeff_vec, double* residual) const;
+
+  const WeakForm<double>* wf;
+  Hermes::vector<const Space<double>*> spaces;
+  std::vector<bool> differential;
+  double time_step;
+  int neq;
+
+  // M, and the spaces and their sequence numbers it was assembled for.
+  SparseMatrix<double>* matrix_M;
+  Hermes::vector<const Space<double>*> mass_spaces;
+  std::vector<int> mass_seqs;
+  int ndof;
+  std::vector<int> first_dofs;
+};
+
+#endif
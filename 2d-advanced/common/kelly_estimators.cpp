@@ -0,0 +1,180 @@
+#include "kelly_estimators.h"
+
+template<typename Real, typename Scalar>
+Scalar H1JumpEstimatorForm::estimator(int n, double *wt, Func<Scalar> *u_ext[], Func<Scalar> *u,
+                                      Geom<Real> *e, Func<Scalar>* *ext) const
+{
+  Scalar result = Scalar(0);
+  for (int i = 0; i < n; i++)
+    result += wt[i] * Hermes::sqr(e->nx[i] * (u->get_dx_central(i) - u->get_dx_neighbor(i)) +
+                                  e->ny[i] * (u->get_dy_central(i) - u->get_dy_neighbor(i)));
+  return result;
+}
+
+double H1JumpEstimatorForm::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                                  Geom<double> *e, Func<double>* *ext) const
+{
+  return estimator<double, double>(n, wt, u_ext, u, e, ext);
+}
+
+Ord H1JumpEstimatorForm::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                             Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return estimator<Ord, Ord>(n, wt, u_ext, u, e, ext);
+}
+
+template<typename Real, typename Scalar>
+Scalar HcurlJumpEstimatorForm::estimator(int n, double *wt, Func<Scalar> *u_ext[], Func<Scalar> *u,
+                                         Geom<Real> *e, Func<Scalar>* *ext) const
+{
+  // The values of vector-valued functions are only available on the two sides; the points
+  // of the neighbor may be in the reverse order.
+  DiscontinuousFunc<Scalar>* ud = static_cast<DiscontinuousFunc<Scalar>*>(u);
+  Func<Scalar>* c = ud->fn_central;
+  Func<Scalar>* nb = ud->fn_neighbor;
+  Scalar result = Scalar(0);
+  for (int i = 0; i < n; i++)
+  {
+    int j = ud->reverse_neighbor_side ? nb->num_gip - i - 1 : i;
+    result += wt[i] * (Hermes::sqr(e->nx[i] * (c->val0[i] - nb->val0[j]) + e->ny[i] * (c->val1[i] - nb->val1[j]))
+                       + Hermes::sqr(c->curl[i] - nb->curl[j]));
+  }
+  return result;
+}
+
+double HcurlJumpEstimatorForm::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                                     Geom<double> *e, Func<double>* *ext) const
+{
+  return estimator<double, double>(n, wt, u_ext, u, e, ext);
+}
+
+Ord HcurlJumpEstimatorForm::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                                Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return estimator<Ord, Ord>(n, wt, u_ext, u, e, ext);
+}
+
+template<typename Real, typename Scalar>
+Scalar L2JumpEstimatorForm::estimator(int n, double *wt, Func<Scalar> *u_ext[], Func<Scalar> *u,
+                                      Geom<Real> *e, Func<Scalar>* *ext) const
+{
+  Scalar result = Scalar(0);
+  for (int i = 0; i < n; i++)
+    result += wt[i] * Hermes::sqr(u->get_val_central(i) - u->get_val_neighbor(i));
+  return result;
+}
+
+double L2JumpEstimatorForm::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                                  Geom<double> *e, Func<double>* *ext) const
+{
+  return estimator<double, double>(n, wt, u_ext, u, e, ext);
+}
+
+Ord L2JumpEstimatorForm::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                             Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return estimator<Ord, Ord>(n, wt, u_ext, u, e, ext);
+}
+
+double H1ResidualEstimatorForm::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                                      Geom<double> *e, Func<double>* *ext) const
+{
+#ifdef H2D_SECOND_DERIVATIVES_ENABLED
+  double result = 0.0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * Hermes::sqr(diffusion * u->laplace[i] - (rhs != NULL ? rhs->value(e->x[i], e->y[i]) : 0.0));
+  return result * Hermes::sqr(e->diam);
+#else
+  throw Hermes::Exceptions::Exception("Define H2D_SECOND_DERIVATIVES_ENABLED in hermes2d_common_defs.h "
+                                      "if you want to use the residual estimator.");
+#endif
+}
+
+Ord H1ResidualEstimatorForm::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                                 Geom<Ord> *e, Func<Ord>* *ext) const
+{
+#ifdef H2D_SECOND_DERIVATIVES_ENABLED
+  if (rhs == NULL)
+    return Hermes::sqr(u->laplace[0]);
+  return Hermes::sqr(u->laplace[0] - rhs->value(e->x[0], e->y[0]));
+#else
+  throw Hermes::Exceptions::Exception("Define H2D_SECOND_DERIVATIVES_ENABLED in hermes2d_common_defs.h "
+                                      "if you want to use the residual estimator.");
+#endif
+}
+
+KellyTypeAdapt<double>* create_kelly_adapt(Hermes::vector<Space<double>*> spaces)
+{
+  KellyTypeAdapt<double>* adaptivity = new KellyTypeAdapt<double>(spaces);
+  for (unsigned int i = 0; i < spaces.size(); i++)
+  {
+    switch (spaces[i]->get_type())
+    {
+    case HERMES_H1_SPACE:
+      adaptivity->add_error_estimator_surf(new H1JumpEstimatorForm(i));
+      break;
+    case HERMES_HCURL_SPACE:
+      adaptivity->add_error_estimator_surf(new HcurlJumpEstimatorForm(i));
+      break;
+    case HERMES_L2_SPACE:
+      adaptivity->add_error_estimator_surf(new L2JumpEstimatorForm(i));
+      break;
+    default:
+      delete adaptivity;
+      throw Hermes::Exceptions::Exception("No interface estimator for the type of the space %d.", i);
+    }
+  }
+  return adaptivity;
+}
+
+SmoothnessSelector::SmoothnessSelector(const Space<double>* space, int max_order, double decay_threshold)
+  : Selector<double>(max_order), space(space), coeff_vec(NULL), decay_threshold(decay_threshold),
+    p_selector(max_order, 1, 1)
+{
+}
+
+bool SmoothnessSelector::is_smooth(Element* element) const
+{
+  if (coeff_vec == NULL)
+    throw Hermes::Exceptions::Exception("SmoothnessSelector needs the coefficient vector of the solution.");
+
+  int order = space->get_element_order(element->id);
+  int p = std::max(H2D_GET_H_ORDER(order), H2D_GET_V_ORDER(order));
+  if (p < 2)
+    return true;
+
+  // Norms of the coefficients of the two highest orders. The Dirichlet lift is a part of the solution
+  // (its coefficient is stored in the assembly list).
+  AsmList<double> al;
+  space->get_element_assembly_list(element, &al);
+  double top = 0.0, below = 0.0;
+  for (unsigned int j = 0; j < al.get_cnt(); j++)
+  {
+    int shape_order = space->get_shapeset()->get_order(al.get_idx()[j], element->get_mode());
+    int k = std::max(H2D_GET_H_ORDER(shape_order), H2D_GET_V_ORDER(shape_order));
+    double coef = al.get_coef()[j] * (al.get_dof()[j] >= 0 ? coeff_vec[al.get_dof()[j]] : 1.0);
+    if (k == p)
+      top += coef * coef;
+    else if (k == p - 1)
+      below += coef * coef;
+  }
+  if (below == 0.0)
+    return top == 0.0;
+  return std::sqrt(top / below) < decay_threshold;
+}
+
+bool SmoothnessSelector::select_refinement(Element* element, int quad_order, Solution<double>* rsln, ElementToRefine& refinement)
+{
+  if (is_smooth(element))
+    return p_selector.select_refinement(element, quad_order, rsln, refinement);
+  return h_selector.select_refinement(element, quad_order, rsln, refinement);
+}
+
+void SmoothnessSelector::generate_shared_mesh_orders(const Element* element, const int orig_quad_order, const int refinement,
+                                                     int tgt_quad_orders[H2D_MAX_ELEMENT_SONS], const int* suggested_quad_orders)
+{
+  if (refinement == H2D_REFINEMENT_P)
+    p_selector.generate_shared_mesh_orders(element, orig_quad_order, refinement, tgt_quad_orders, suggested_quad_orders);
+  else
+    h_selector.generate_shared_mesh_orders(element, orig_quad_order, refinement, tgt_quad_orders, suggested_quad_orders);
+}
@@ -0,0 +1,132 @@
+#ifndef KELLY_ESTIMATORS_H
+#define KELLY_ESTIMATORS_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+using namespace Hermes::Hermes2D::RefinementSelectors;
+
+/// \brief Interface estimator for H1 spaces, the jump of the normal derivative,
+///
+///   \int_edge [du/dn]^2.
+class H1JumpEstimatorForm : public KellyTypeAdapt<double>::ErrorEstimatorForm
+{
+public:
+  H1JumpEstimatorForm(int i) : KellyTypeAdapt<double>::ErrorEstimatorForm(i) { this->setAsInterface(); };
+
+  template<typename Real, typename Scalar>
+  Scalar estimator(int n, double *wt, Func<Scalar> *u_ext[], Func<Scalar> *u, Geom<Real> *e, Func<Scalar>* *ext) const;
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Geom<double> *e,
+                       Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Geom<Ord> *e,
+                  Func<Ord>* *ext) const;
+};
+
+/// \brief Interface estimator for Hcurl spaces. The tangential component is continuous, so that the normal
+/// component and the curl are the parts that jump,
+///
+///   \int_edge [n . E]^2 + [curl E]^2.
+class HcurlJumpEstimatorForm : public KellyTypeAdapt<double>::ErrorEstimatorForm
+{
+public:
+  HcurlJumpEstimatorForm(int i) : KellyTypeAdapt<double>::ErrorEstimatorForm(i) { this->setAsInterface(); };
+
+  template<typename Real, typename Scalar>
+  Scalar estimator(int n, double *wt, Func<Scalar> *u_ext[], Func<Scalar> *u, Geom<Real> *e, Func<Scalar>* *ext) const;
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Geom<double> *e,
+                       Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Geom<Ord> *e,
+                  Func<Ord>* *ext) const;
+};
+
+/// \brief Interface estimator for discontinuous (L2) spaces, the jump of the solution,
+///
+///   \int_edge [u]^2.
+class L2JumpEstimatorForm : public KellyTypeAdapt<double>::ErrorEstimatorForm
+{
+public:
+  L2JumpEstimatorForm(int i) : KellyTypeAdapt<double>::ErrorEstimatorForm(i) { this->setAsInterface(); };
+
+  template<typename Real, typename Scalar>
+  Scalar estimator(int n, double *wt, Func<Scalar> *u_ext[], Func<Scalar> *u, Geom<Real> *e, Func<Scalar>* *ext) const;
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Geom<double> *e,
+                       Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Geom<Ord> *e,
+                  Func<Ord>* *ext) const;
+};
+
+/// \brief Element residual estimator for H1 spaces and the equation -div(a grad u) + f = 0 with a constant 'a'
+/// (the sign convention of DefaultWeakFormPoisson),
+///
+///   diam(e)^2 \int_e (a laplace(u) - f)^2,
+///
+/// to be added by add_error_estimator_vol() to the jump estimator of create_kelly_adapt(). 'rhs' may be NULL
+/// for f = 0. Needs H2D_SECOND_DERIVATIVES_ENABLED.
+class H1ResidualEstimatorForm : public KellyTypeAdapt<double>::ErrorEstimatorForm
+{
+public:
+  H1ResidualEstimatorForm(int i, double diffusion, const Hermes2DFunction<double>* rhs)
+    : KellyTypeAdapt<double>::ErrorEstimatorForm(i), diffusion(diffusion), rhs(rhs) {};
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Geom<double> *e,
+                       Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Geom<Ord> *e,
+                  Func<Ord>* *ext) const;
+
+private:
+  double diffusion;
+  const Hermes2DFunction<double>* rhs;
+};
+
+/// \brief Error estimation without a reference solution.
+///
+/// Returns a KellyTypeAdapt for the spaces with the interface estimator matching the type of each space
+/// (scaled by the element diameter, as usual in KellyTypeAdapt). The element errors are computed from
+/// the solutions on the spaces themselves by calc_err_est(slns), so that every adaptivity step costs one
+/// solve on the coarse spaces instead of one on the globally refined reference spaces.
+/// Volumetric residual estimators of the particular problem can be added by add_error_estimator_vol().
+/// To be deleted by the caller.
+KellyTypeAdapt<double>* create_kelly_adapt(Hermes::vector<Space<double>*> spaces);
+
+/// \brief hp selector for adaptivity without a reference solution.
+///
+/// The projection-based selectors need the reference solution to evaluate the candidates. This selector
+/// decides between p- and h-refinement by the smoothness of the solution on the element instead, measured
+/// by the decay of its coefficients in the hierarchic basis: the element is refined in p if
+///
+///   |c_p| / |c_{p-1}| < decay_threshold,
+///
+/// where |c_k| is the norm of the coefficients of the shape functions of order k on the element,
+/// and in h otherwise. Elements of order 1 are refined in p.
+class SmoothnessSelector : public Selector<double>
+{
+public:
+  SmoothnessSelector(const Space<double>* space, int max_order = H2DRS_DEFAULT_ORDER, double decay_threshold = 0.5);
+
+  /// Coefficient vector of the solution on the space (to be set before every adaptation).
+  void set_coeff_vec(const double* coeff_vec) { this->coeff_vec = coeff_vec; }
+
+  virtual bool select_refinement(Element* element, int quad_order, Solution<double>* rsln, ElementToRefine& refinement);
+
+  virtual void generate_shared_mesh_orders(const Element* element, const int orig_quad_order, const int refinement,
+                                           int tgt_quad_orders[H2D_MAX_ELEMENT_SONS], const int* suggested_quad_orders);
+
+private:
+  bool is_smooth(Element* element) const;
+
+  const Space<double>* space;
+  const double* coeff_vec;
+  double decay_threshold;
+  HOnlySelector<double> h_selector;
+  POnlySelector<double> p_selector;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "leapfrog.h"
+
+LeapfrogIntegrator::LeapfrogIntegrator(const WeakForm<double>* wf, Hermes::vector<const Space<double>*> spaces,
+                                       const WeakForm<double>* energy_wf)
+  : spaces(spaces), matrix_energy(NULL)
+{
+  if (spaces.size() != 2 || wf->get_neq() != 2)
+    throw Hermes::Exceptions::Exception("LeapfrogIntegrator needs a system of two equations.");
+  if (!wf->get_mfsurf().empty())
+    throw Hermes::Exceptions::Exception("LeapfrogIntegrator does not support surface matrix forms.");
+  Hermes::vector<MatrixFormVol<double>*> mfvol = wf->get_mfvol();
+  for (unsigned int m = 0; m < mfvol.size(); m++)
+    if (mfvol[m]->i == mfvol[m]->j)
+      throw Hermes::Exceptions::Exception("LeapfrogIntegrator supports only the coupling forms (0, 1) and (1, 0).");
+
+  ndof[0] = spaces[0]->get_num_dofs();
+  ndof[1] = spaces[1]->get_num_dofs();
+  ndof_total = ndof[0] + ndof[1];
+
+  // The forms are linear, so that they can be evaluated at any state.
+  double* zero_vec = new double[ndof_total];
+  memset(zero_vec, 0, ndof_total * sizeof(double));
+
+  DiscreteProblem<double> dp(wf, spaces);
+  matrix_A = create_matrix<double>();
+  dp.assemble(zero_vec, matrix_A);
+  if (dynamic_cast<CSCMatrix<double>*>(matrix_A) == NULL)
+    throw Hermes::Exceptions::Exception("LeapfrogIntegrator needs a matrix solver with CSC matrices (e.g. UMFPACK).");
+
+  if (energy_wf != NULL)
+  {
+    DiscreteProblem<double> dp_energy(energy_wf, spaces);
+    matrix_energy = create_matrix<double>();
+    dp_energy.assemble(zero_vec, matrix_energy);
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    mass_wfs[i] = new WeakForm<double>(1);
+    mass_wfs[i]->add_matrix_form(new MassFormVol(0, spaces[i]->get_type() == HERMES_HCURL_SPACE
+                                                    || spaces[i]->get_type() == HERMES_HDIV_SPACE));
+    DiscreteProblem<double> dp_mass(mass_wfs[i], spaces[i]);
+    mass_matrices[i] = create_matrix<double>();
+    mass_rhss[i] = create_vector<double>();
+    dp_mass.assemble(zero_vec, mass_matrices[i], mass_rhss[i]);
+    mass_solvers[i] = create_linear_solver<double>(mass_matrices[i], mass_rhss[i]);
+  }
+
+  delete [] zero_vec;
+
+  coeff_vec = new double[ndof_total];
+  memset(coeff_vec, 0, ndof_total * sizeof(double));
+  kick = new double[ndof[1]];
+  memset(kick, 0, ndof[1] * sizeof(double));
+  work = new double[ndof_total];
+}
+
+LeapfrogIntegrator::~LeapfrogIntegrator()
+{
+  for (int i = 0; i < 2; i++)
+  {
+    delete mass_solvers[i];
+    delete mass_matrices[i];
+    delete mass_rhss[i];
+    delete mass_wfs[i];
+  }
+  delete matrix_A;
+  delete matrix_energy;
+  delete [] coeff_vec;
+  delete [] kick;
+  delete [] work;
+}
+
+double LeapfrogIntegrator::cfl_time_step(double wave_speed) const
+{
+  double min_ratio = std::numeric_limits<double>::max();
+  for (int i = 0; i < 2; i++)
+  {
+    Element* e;
+    for_all_active_elements(e, spaces[i]->get_mesh())
+    {
+      int order = spaces[i]->get_element_order(e->id);
+      int p = std::max(1, std::max(H2D_GET_H_ORDER(order), H2D_GET_V_ORDER(order)));
+      min_ratio = std::min(min_ratio, e->get_diameter() / (p * p));
+    }
+  }
+  return min_ratio / wave_speed;
+}
+
+void LeapfrogIntegrator::set_initial_condition(Hermes::vector<Solution<double>*> slns)
+{
+  Hermes::vector<MeshFunction<double>*> mfs;
+  for (unsigned int i = 0; i < slns.size(); i++)
+    mfs.push_back(slns[i]);
+  OGProjection<double> ogProjection; ogProjection.project_global(spaces, mfs, coeff_vec);
+  update_kick();
+}
+
+void LeapfrogIntegrator::multiply_block(SparseMatrix<double>* mat, int row_first, int row_count,
+                                        int col_first, int col_count, const double* in, double* out)
+{
+  CSCMatrix<double>* csc = static_cast<CSCMatrix<double>*>(mat);
+  int* Ap = csc->get_Ap();
+  int* Ai = csc->get_Ai();
+  double* Ax = csc->get_Ax();
+
+  memset(out, 0, row_count * sizeof(double));
+  for (int c = 0; c < col_count; c++)
+  {
+    double val = in[c];
+    if (val == 0.0) continue;
+    for (int k = Ap[col_first + c]; k < Ap[col_first + c + 1]; k++)
+    {
+      int row = Ai[k] - row_first;
+      if (row >= 0 && row < row_count)
+        out[row] += Ax[k] * val;
+    }
+  }
+}
+
+void LeapfrogIntegrator::apply_mass_inverse(int i, double* vec)
+{
+  for (int d = 0; d < ndof[i]; d++)
+    mass_rhss[i]->set(d, vec[d]);
+  if (!mass_solvers[i]->solve())
+    throw Hermes::Exceptions::Exception("Matrix solver failed in LeapfrogIntegrator.");
+  mass_solvers[i]->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+  memcpy(vec, mass_solvers[i]->get_sln_vector(), ndof[i] * sizeof(double));
+}
+
+void LeapfrogIntegrator::update_kick()
+{
+  multiply_block(matrix_A, ndof[0], ndof[1], 0, ndof[0], coeff_vec, kick);
+  apply_mass_inverse(1, kick);
+}
+
+void LeapfrogIntegrator::step(double time_step, Hermes::vector<Solution<double>*> slns)
+{
+  double* X = coeff_vec;
+  double* Y = coeff_vec + ndof[0];
+
+  // Half step of Y, full step of X.
+  for (int d = 0; d < ndof[1]; d++)
+    Y[d] += 0.5 * time_step * kick[d];
+  multiply_block(matrix_A, 0, ndof[0], ndof[0], ndof[1], Y, work);
+  apply_mass_inverse(0, work);
+  for (int d = 0; d < ndof[0]; d++)
+    X[d] += time_step * work[d];
+
+  // Second half step of Y; the kick is reused by the next step.
+  update_kick();
+  for (int d = 0; d < ndof[1]; d++)
+    Y[d] += 0.5 * time_step * kick[d];
+
+  Solution<double>::vector_to_solutions(coeff_vec, spaces, slns);
+}
+
+double LeapfrogIntegrator::energy() const
+{
+  if (matrix_energy == NULL)
+    throw Hermes::Exceptions::Exception("LeapfrogIntegrator::energy() needs the energy weak form.");
+
+  multiply_block(matrix_energy, 0, ndof_total, 0, ndof_total, coeff_vec, work);
+  double result = 0.0;
+  for (int d = 0; d < ndof_total; d++)
+    result += coeff_vec[d] * work[d];
+  return 0.5 * result;
+}
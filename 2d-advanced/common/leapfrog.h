@@ -0,0 +1,73 @@
+#ifndef LEAPFROG_H
+#define LEAPFROG_H
+
+#include "linear_rk.h"
+
+/// \brief Explicit leapfrog (Stoermer-Verlet) time stepping for first-order wave systems
+///
+///   M_0 dX/dt = A_01 Y,
+///   M_1 dY/dt = A_10 X,
+///
+/// such as the E-B or E-F formulations of the Maxwell's equations. The weak form is the same as for
+/// RungeKutta<double> and may only contain the coupling matrix forms (0, 1) and (1, 0). One step
+///
+///   Y_{n+1/2} = Y_n + time_step/2 M_1^{-1} A_10 X_n,
+///   X_{n+1}   = X_n + time_step M_0^{-1} A_01 Y_{n+1/2},
+///   Y_{n+1}   = Y_{n+1/2} + time_step/2 M_1^{-1} A_10 X_{n+1},
+///
+/// is symplectic and second order, so that for a non-dissipative problem the energy does not drift
+/// but only oscillates with an amplitude of O(time_step^2). The operators are assembled once, the last
+/// half-step of Y is merged with the first half-step of the next step, and a step thus costs two
+/// matrix-vector products and two applications of the inverse mass matrices, i.e. back-substitutions
+/// of the once factorized consistent mass matrices. (A diagonal mass matrix is not offered, the lumping
+/// of the hierarchic Hcurl shape functions is not consistent.)
+class LeapfrogIntegrator
+{
+public:
+  /// \param[in] energy_wf  Optional weak form with the matrix forms (0, 0) and (1, 1) of the energy
+  ///                       E = 1/2 (X, Y)^T W (X, Y), used by energy().
+  LeapfrogIntegrator(const WeakForm<double>* wf, Hermes::vector<const Space<double>*> spaces,
+                     const WeakForm<double>* energy_wf = NULL);
+  ~LeapfrogIntegrator();
+
+  /// Estimate of the largest stable time step, min_e diam(e) / (wave_speed * p_e^2),
+  /// over the elements of both spaces.
+  double cfl_time_step(double wave_speed) const;
+
+  /// Projects the initial condition onto the spaces.
+  void set_initial_condition(Hermes::vector<Solution<double>*> slns);
+
+  /// One time step, the result is stored in 'slns'.
+  void step(double time_step, Hermes::vector<Solution<double>*> slns);
+
+  /// Energy of the current state (requires 'energy_wf').
+  double energy() const;
+
+private:
+  // out = block (rows, cols) of the matrix times in.
+  static void multiply_block(SparseMatrix<double>* mat, int row_first, int row_count,
+                             int col_first, int col_count, const double* in, double* out);
+
+  // Applies the inverse of the mass matrix of the space 'i' to 'vec' (in place).
+  void apply_mass_inverse(int i, double* vec);
+
+  // M_1^{-1} A_10 X for the current X.
+  void update_kick();
+
+  Hermes::vector<const Space<double>*> spaces;
+  int ndof[2], ndof_total;
+
+  SparseMatrix<double>* matrix_A;
+  SparseMatrix<double>* matrix_energy;
+  SparseMatrix<double>* mass_matrices[2];
+  Vector<double>* mass_rhss[2];
+  LinearMatrixSolver<double>* mass_solvers[2];
+  WeakForm<double>* mass_wfs[2];
+
+  // State (X, Y) and M_1^{-1} A_10 X.
+  double* coeff_vec;
+  double* kick;
+  double* work;
+};
+
+#endif
@@ -0,0 +1,803 @@
+#include "linear_rk.h"
+
+LinearRungeKutta::LinearRungeKutta(const WeakForm<double>* wf, Hermes::vector<const Space<double>*> spaces, ButcherTable* bt)
+  : wf(wf), spaces(spaces), bt(bt), time(0.0), time_step(0.0), neq(spaces.size()), ndof(0), matrix_A(NULL),
+    block_solver(false), block_tol(1e-10), block_max_iters(100), has_source(false), time_ptr(NULL),
+    time_factor(NULL), num_sampled(0), source_wf(NULL), source_dp(NULL), coeff_vec(NULL), start_coeff_vec(NULL), state_time(0.0), start_time(0.0), state_valid(false)
+{
+  if (bt->is_fully_implicit())
+    throw Hermes::Exceptions::Exception("LinearRungeKutta supports only explicit and diagonally implicit methods, use RungeKutta::rk_time_step_newton().");
+  if (wf->get_neq() != neq)
+    throw Hermes::Exceptions::Exception("Mismatched number of equations in LinearRungeKutta.");
+
+  has_block.resize(neq * neq, false);
+  Hermes::vector<MatrixFormVol<double>*> mfvol = wf->get_mfvol();
+  for (unsigned int m = 0; m < mfvol.size(); m++)
+  {
+    has_block[mfvol[m]->i * neq + mfvol[m]->j] = true;
+    // A symmetric off-diagonal form is assembled into the transposed block as well.
+    if (mfvol[m]->sym != HERMES_NONSYM)
+      has_block[mfvol[m]->j * neq + mfvol[m]->i] = true;
+  }
+  Hermes::vector<MatrixFormSurf<double>*> mfsurf = wf->get_mfsurf();
+  for (unsigned int m = 0; m < mfsurf.size(); m++)
+    has_block[mfsurf[m]->i * neq + mfsurf[m]->j] = true;
+  blocks_A.resize(neq * neq);
+  blocks_M.resize(neq);
+}
+
+LinearRungeKutta::~LinearRungeKutta()
+{
+  free_operators();
+  free_diagonal_blocks(-1);
+  delete source_dp;
+  delete source_wf;
+  delete [] coeff_vec;
+  delete [] start_coeff_vec;
+}
+
+void LinearRungeKutta::set_spaces(Hermes::vector<const Space<double>*> spaces)
+{
+  // The operators are rebuilt lazily in rk_time_step(), which compares the sequence numbers.
+  this->spaces = spaces;
+}
+
+void LinearRungeKutta::set_time(double time)
+{
+  this->time = time;
+}
+
+void LinearRungeKutta::set_time_step(double time_step)
+{
+  // The blocks do not depend on the time step, only the stage matrices and their diagonal blocks do.
+  if (time_step != this->time_step)
+  {
+    free_operators();
+    free_diagonal_blocks(-1);
+  }
+  this->time_step = time_step;
+}
+
+void LinearRungeKutta::set_source(double* time_ptr, double (*time_factor)(double))
+{
+  has_source = true;
+  this->time_ptr = time_ptr;
+  this->time_factor = time_factor;
+  constant_source.clear();
+  num_sampled = 0;
+
+  if (source_wf == NULL)
+  {
+    source_wf = new WeakForm<double>(neq);
+    Hermes::vector<VectorFormVol<double>*> vfvol = wf->get_vfvol();
+    for (unsigned int m = 0; m < vfvol.size(); m++)
+      source_wf->add_vector_form(new BlockVectorFormVol(vfvol[m]));
+    Hermes::vector<VectorFormSurf<double>*> vfsurf = wf->get_vfsurf();
+    for (unsigned int m = 0; m < vfsurf.size(); m++)
+      source_wf->add_vector_form_surf(new BlockVectorFormSurf(vfsurf[m]));
+  }
+}
+
+void LinearRungeKutta::set_block_solver(double tol, int max_iters)
+{
+  free_operators();
+  block_solver = true;
+  block_tol = tol;
+  block_max_iters = max_iters;
+}
+
+bool LinearRungeKutta::component_changed(int i, const Hermes::vector<const Space<double>*>& old_spaces, const std::vector<int>& old_seqs) const
+{
+  if ((int) old_seqs.size() != neq)
+    return true;
+  return spaces[i] != old_spaces[i] || spaces[i]->get_seq() != old_seqs[i];
+}
+
+void LinearRungeKutta::free_operators()
+{
+  for (unsigned int k = 0; k < stage_solvers.size(); k++)
+  {
+    delete stage_solvers[k];
+    delete stage_matrices[k];
+    delete stage_rhss[k];
+  }
+  stage_solvers.clear();
+  stage_matrices.clear();
+  stage_rhss.clear();
+  diagonal.clear();
+  stage_operator.clear();
+  monolithic.clear();
+
+  delete matrix_A;
+  matrix_A = NULL;
+}
+
+void LinearRungeKutta::assemble_block(WeakForm<double>* block_wf, int i, int j, Block& block)
+{
+  Hermes::vector<const Space<double>*> block_spaces(spaces[i]);
+  if (i != j)
+    block_spaces.push_back(spaces[j]);
+  int block_ndof = Space<double>::get_num_dofs(block_spaces);
+
+  // The forms are linear, so that they can be evaluated at any state; zero is the natural choice.
+  double* zero_vec = new double[block_ndof];
+  memset(zero_vec, 0, block_ndof * sizeof(double));
+
+  DiscreteProblem<double> dp(block_wf, block_spaces);
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  dp.assemble(zero_vec, matrix);
+  CSCMatrix<double>* csc = dynamic_cast<CSCMatrix<double>*>(matrix);
+  if (csc == NULL)
+    throw Hermes::Exceptions::Exception("LinearRungeKutta needs a matrix solver with CSC matrices (e.g. UMFPACK).");
+
+  // The rows of the component i and the columns of the component j.
+  int rows = spaces[i]->get_num_dofs();
+  int cols = spaces[j]->get_num_dofs();
+  int first_col = (i == j) ? 0 : rows;
+  int* Ap = csc->get_Ap();
+  int* Ai = csc->get_Ai();
+  double* Ax = csc->get_Ax();
+  block.Ap.assign(1, 0);
+  block.Ai.clear();
+  block.Ax.clear();
+  for (int c = first_col; c < first_col + cols; c++)
+  {
+    for (int k = Ap[c]; k < Ap[c + 1]; k++)
+      if (Ai[k] < rows)
+      {
+        block.Ai.push_back(Ai[k]);
+        block.Ax.push_back(Ax[k]);
+      }
+    block.Ap.push_back(block.Ai.size());
+  }
+
+  delete matrix;
+  delete [] zero_vec;
+}
+
+void LinearRungeKutta::update_blocks()
+{
+  std::vector<bool> changed(neq);
+  bool any_changed = false;
+  for (int i = 0; i < neq; i++)
+  {
+    changed[i] = component_changed(i, operator_spaces, space_seqs);
+    any_changed = any_changed || changed[i];
+  }
+  if (!any_changed)
+    return;
+
+  // Any change of the blocks needs a new factorization of the stage matrices (and a new source),
+  // but only the diagonal blocks of the changed components.
+  free_operators();
+  constant_source.clear();
+  num_sampled = 0;
+  delete source_dp;
+  source_dp = NULL;
+  for (int i = 0; i < neq; i++)
+    if (changed[i])
+      free_diagonal_blocks(i);
+
+  for (int i = 0; i < neq; i++)
+    if (changed[i])
+    {
+      WeakForm<double> block_wf(1);
+      block_wf.add_matrix_form(new MassFormVol(0, spaces[i]->get_type() == HERMES_HCURL_SPACE
+                                                  || spaces[i]->get_type() == HERMES_HDIV_SPACE));
+      assemble_block(&block_wf, i, i, blocks_M[i]);
+    }
+
+  // Only the blocks in the rows and columns of the changed components; the coupling between
+  // two unchanged components is kept.
+  Hermes::vector<MatrixFormVol<double>*> mfvol = wf->get_mfvol();
+  Hermes::vector<MatrixFormSurf<double>*> mfsurf = wf->get_mfsurf();
+  int num_blocks = 0, num_assembled = 0;
+  for (int i = 0; i < neq; i++)
+    for (int j = 0; j < neq; j++)
+    {
+      if (!has_block[i * neq + j])
+        continue;
+      num_blocks++;
+      if (!changed[i] && !changed[j])
+        continue;
+
+      WeakForm<double> block_wf(i == j ? 1 : 2);
+      for (unsigned int m = 0; m < mfvol.size(); m++)
+        if (mfvol[m]->i == i && mfvol[m]->j == j)
+          block_wf.add_matrix_form(new BlockMatrixFormVol(mfvol[m], 0, i == j ? 0 : 1));
+        // The transposed part of a symmetric form of the block (j, i), the form keeps its flag.
+        else if (i != j && mfvol[m]->i == j && mfvol[m]->j == i && mfvol[m]->sym != HERMES_NONSYM)
+          block_wf.add_matrix_form(new BlockMatrixFormVol(mfvol[m], 1, 0));
+      for (unsigned int m = 0; m < mfsurf.size(); m++)
+        if (mfsurf[m]->i == i && mfsurf[m]->j == j)
+          block_wf.add_matrix_form_surf(new BlockMatrixFormSurf(mfsurf[m], 0, i == j ? 0 : 1));
+      assemble_block(&block_wf, i, j, blocks_A[i * neq + j]);
+      num_assembled++;
+    }
+
+  operator_spaces = spaces;
+  space_seqs.clear();
+  first_dofs.clear();
+  ndof = 0;
+  for (int i = 0; i < neq; i++)
+  {
+    space_seqs.push_back(spaces[i]->get_seq());
+    first_dofs.push_back(ndof);
+    ndof += spaces[i]->get_num_dofs();
+  }
+
+  Hermes::Mixins::Loggable::Static::info("Linear R-K: assembled %d of %d blocks of A, ndof = %d.", num_assembled, num_blocks, ndof);
+}
+
+SparseMatrix<double>* LinearRungeKutta::compose(double mass_factor, double a_factor) const
+{
+  std::vector<int> Ap(1, 0);
+  std::vector<int> Ai;
+  std::vector<double> Ax;
+  std::vector<std::pair<int, double> > column;
+  for (int j = 0; j < neq; j++)
+    for (int c = 0; c < spaces[j]->get_num_dofs(); c++)
+    {
+      column.clear();
+      if (mass_factor != 0.0)
+      {
+        const Block& block = blocks_M[j];
+        for (int k = block.Ap[c]; k < block.Ap[c + 1]; k++)
+          column.push_back(std::make_pair(first_dofs[j] + block.Ai[k], mass_factor * block.Ax[k]));
+      }
+      if (a_factor != 0.0)
+        for (int i = 0; i < neq; i++)
+        {
+          if (!has_block[i * neq + j])
+            continue;
+          const Block& block = blocks_A[i * neq + j];
+          for (int k = block.Ap[c]; k < block.Ap[c + 1]; k++)
+            column.push_back(std::make_pair(first_dofs[i] + block.Ai[k], a_factor * block.Ax[k]));
+        }
+
+      // Sorted rows, the mass and the diagonal blocks of A share their entries.
+      std::sort(column.begin(), column.end());
+      for (unsigned int k = 0; k < column.size(); k++)
+        if (k > 0 && column[k].first == column[k - 1].first)
+          Ax.back() += column[k].second;
+        else
+        {
+          Ai.push_back(column[k].first);
+          Ax.push_back(column[k].second);
+        }
+      Ap.push_back(Ai.size());
+    }
+
+  if (Ai.empty())
+    throw Hermes::Exceptions::Exception("Empty matrix in LinearRungeKutta.");
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  static_cast<CSCMatrix<double>*>(matrix)->create(ndof, Ai.size(), &Ap[0], &Ai[0], &Ax[0]);
+  return matrix;
+}
+
+void LinearRungeKutta::init_operators()
+{
+  free_operators();
+
+  // The operator A for the stage right-hand sides.
+  matrix_A = compose(0.0, 1.0);
+
+  // Stages with the same diagonal coefficient share the matrix M - time_step * a_ii * A.
+  for (unsigned int i = 0; i < bt->get_size(); i++)
+  {
+    double a_ii = bt->get_A(i, i);
+    unsigned int k = 0;
+    while (k < diagonal.size() && diagonal[k] != a_ii)
+      k++;
+    if (k == diagonal.size())
+      diagonal.push_back(a_ii);
+    stage_operator.push_back(k);
+  }
+
+  stage_matrices.assign(diagonal.size(), NULL);
+  stage_rhss.assign(diagonal.size(), NULL);
+  stage_solvers.assign(diagonal.size(), NULL);
+  monolithic.assign(diagonal.size(), !block_solver);
+  if (diagonal_blocks.size() < diagonal.size() * neq)
+    diagonal_blocks.resize(diagonal.size() * neq);
+
+  if (block_solver)
+    return;
+  for (unsigned int k = 0; k < diagonal.size(); k++)
+    init_stage_solver(k);
+  Hermes::Mixins::Loggable::Static::info("Linear R-K: composed %d stage operator(s), ndof = %d.", (int) diagonal.size(), ndof);
+}
+
+void LinearRungeKutta::init_stage_solver(int k)
+{
+  stage_matrices[k] = compose(1.0, -time_step * diagonal[k]);
+  stage_rhss[k] = create_vector<double>();
+  stage_rhss[k]->alloc(ndof);
+  stage_solvers[k] = create_linear_solver<double>(stage_matrices[k], stage_rhss[k]);
+}
+
+SparseMatrix<double>* LinearRungeKutta::compose_diagonal(int i, double mass_factor, double a_factor) const
+{
+  const Block& mass = blocks_M[i];
+  const Block* a = has_block[i * neq + i] ? &blocks_A[i * neq + i] : NULL;
+  int n = spaces[i]->get_num_dofs();
+
+  std::vector<int> Ap(1, 0);
+  std::vector<int> Ai;
+  std::vector<double> Ax;
+  std::vector<std::pair<int, double> > column;
+  for (int c = 0; c < n; c++)
+  {
+    column.clear();
+    for (int k = mass.Ap[c]; k < mass.Ap[c + 1]; k++)
+      column.push_back(std::make_pair(mass.Ai[k], mass_factor * mass.Ax[k]));
+    if (a != NULL && a_factor != 0.0)
+      for (int k = a->Ap[c]; k < a->Ap[c + 1]; k++)
+        column.push_back(std::make_pair(a->Ai[k], a_factor * a->Ax[k]));
+
+    std::sort(column.begin(), column.end());
+    for (unsigned int k = 0; k < column.size(); k++)
+      if (k > 0 && column[k].first == column[k - 1].first)
+        Ax.back() += column[k].second;
+      else
+      {
+        Ai.push_back(column[k].first);
+        Ax.push_back(column[k].second);
+      }
+    Ap.push_back(Ai.size());
+  }
+
+  if (Ai.empty())
+    throw Hermes::Exceptions::Exception("Empty diagonal block in LinearRungeKutta.");
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  static_cast<CSCMatrix<double>*>(matrix)->create(n, Ai.size(), &Ap[0], &Ai[0], &Ax[0]);
+  return matrix;
+}
+
+void LinearRungeKutta::free_diagonal_blocks(int i)
+{
+  for (unsigned int b = 0; b < diagonal_blocks.size(); b++)
+  {
+    if (i != -1 && (int) b % neq != i)
+      continue;
+    DiagonalBlock& block = diagonal_blocks[b];
+    delete block.solver;
+    delete block.matrix;
+    delete block.rhs;
+    block = DiagonalBlock();
+  }
+}
+
+void LinearRungeKutta::multiply_block(const Block& block, int j, const double* x, double factor, double* y) const
+{
+  int cols = spaces[j]->get_num_dofs();
+  for (int c = 0; c < cols; c++)
+  {
+    double fx = factor * x[c];
+    if (fx == 0.0) continue;
+    for (int k = block.Ap[c]; k < block.Ap[c + 1]; k++)
+      y[block.Ai[k]] += block.Ax[k] * fx;
+  }
+}
+
+void LinearRungeKutta::apply_stage_matrix(int k, const double* x, double* y) const
+{
+  static_cast<CSCMatrix<double>*>(matrix_A)->multiply_with_vector(const_cast<double*>(x), y);
+  double a_factor = -time_step * diagonal[k];
+  for (int d = 0; d < ndof; d++)
+    y[d] *= a_factor;
+  for (int i = 0; i < neq; i++)
+    multiply_block(blocks_M[i], i, x + first_dofs[i], 1.0, y + first_dofs[i]);
+}
+
+void LinearRungeKutta::apply_block_gauss_seidel(int k, const double* r, double* z)
+{
+  double a_factor = -time_step * diagonal[k];
+  for (int i = 0; i < neq; i++)
+  {
+    int n = spaces[i]->get_num_dofs();
+    DiagonalBlock& block = diagonal_blocks[k * neq + i];
+    if (block.solver == NULL)
+    {
+      block.matrix = compose_diagonal(i, 1.0, a_factor);
+      block.rhs = create_vector<double>();
+      block.rhs->alloc(n);
+      block.solver = create_linear_solver<double>(block.matrix, block.rhs);
+    }
+
+    // r_i minus the couplings to the components already swept.
+    double* r_i = z + first_dofs[i];
+    memcpy(r_i, r + first_dofs[i], n * sizeof(double));
+    for (int j = 0; j < i; j++)
+      if (has_block[i * neq + j] && a_factor != 0.0)
+        multiply_block(blocks_A[i * neq + j], j, z + first_dofs[j], -a_factor, r_i);
+
+    for (int d = 0; d < n; d++)
+      block.rhs->set(d, r_i[d]);
+    if (!block.solver->solve())
+      throw Hermes::Exceptions::Exception("Matrix solver failed in LinearRungeKutta.");
+    block.solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    memcpy(r_i, block.solver->get_sln_vector(), n * sizeof(double));
+  }
+}
+
+static double dot(const std::vector<double>& x, const std::vector<double>& y)
+{
+  double result = 0.0;
+  for (unsigned int d = 0; d < x.size(); d++)
+    result += x[d] * y[d];
+  return result;
+}
+
+int LinearRungeKutta::solve_block(int k, const double* rhs, double* x)
+{
+  std::vector<double> r(rhs, rhs + ndof), r0(r), p(ndof, 0.0), v(ndof, 0.0), s(ndof), t(ndof), p_hat(ndof), s_hat(ndof);
+  memset(x, 0, ndof * sizeof(double));
+  double rhs_norm = std::sqrt(dot(r, r));
+  if (rhs_norm == 0.0)
+    return 0;
+
+  // BiCGStab with the preconditioner on the right.
+  double rho = 1.0, alpha = 1.0, omega = 1.0;
+  for (int it = 1; it <= block_max_iters; it++)
+  {
+    double rho_new = dot(r0, r);
+    if (rho_new == 0.0)
+      return -1;
+    double beta = (rho_new / rho) * (alpha / omega);
+    rho = rho_new;
+    for (int d = 0; d < ndof; d++)
+      p[d] = r[d] + beta * (p[d] - omega * v[d]);
+
+    apply_block_gauss_seidel(k, &p[0], &p_hat[0]);
+    apply_stage_matrix(k, &p_hat[0], &v[0]);
+    double r0_v = dot(r0, v);
+    if (r0_v == 0.0)
+      return -1;
+    alpha = rho / r0_v;
+    for (int d = 0; d < ndof; d++)
+      s[d] = r[d] - alpha * v[d];
+    if (std::sqrt(dot(s, s)) <= block_tol * rhs_norm)
+    {
+      for (int d = 0; d < ndof; d++)
+        x[d] += alpha * p_hat[d];
+      return it;
+    }
+
+    apply_block_gauss_seidel(k, &s[0], &s_hat[0]);
+    apply_stage_matrix(k, &s_hat[0], &t[0]);
+    double t_t = dot(t, t);
+    if (t_t == 0.0)
+      return -1;
+    omega = dot(t, s) / t_t;
+    for (int d = 0; d < ndof; d++)
+    {
+      x[d] += alpha * p_hat[d] + omega * s_hat[d];
+      r[d] = s[d] - omega * t[d];
+    }
+    if (std::sqrt(dot(r, r)) <= block_tol * rhs_norm)
+      return it;
+    if (omega == 0.0)
+      return -1;
+  }
+  return -1;
+}
+
+void LinearRungeKutta::add_source(double stage_time, double* rhs)
+{
+  if (time_ptr == NULL)
+  {
+    if (constant_source.empty())
+      assemble_source(stage_time, constant_source);
+    for (int d = 0; d < ndof; d++)
+      rhs[d] += constant_source[d];
+    return;
+  }
+
+  if (time_factor == NULL)
+  {
+    std::vector<double> source;
+    assemble_source(stage_time, source);
+    for (int d = 0; d < ndof; d++)
+      rhs[d] += source[d];
+    return;
+  }
+
+  // b(t) = b_0 + time_factor(t) b_1 is interpolated (linearly in the factor) from the two assembled sources.
+  double factor = time_factor(stage_time);
+  if (num_sampled == 0 || (num_sampled == 1 && factor != sampled_factors[0]))
+  {
+    assemble_source(stage_time, sampled_sources[num_sampled]);
+    sampled_factors[num_sampled++] = factor;
+  }
+  if (num_sampled == 1)
+  {
+    for (int d = 0; d < ndof; d++)
+      rhs[d] += sampled_sources[0][d];
+    return;
+  }
+  double w = (factor - sampled_factors[0]) / (sampled_factors[1] - sampled_factors[0]);
+  for (int d = 0; d < ndof; d++)
+    rhs[d] += (1.0 - w) * sampled_sources[0][d] + w * sampled_sources[1][d];
+}
+
+void LinearRungeKutta::assemble_source(double stage_time, std::vector<double>& source)
+{
+  if (source_dp == NULL)
+    source_dp = new DiscreteProblem<double>(source_wf, spaces);
+
+  double saved_time = 0.0;
+  if (time_ptr != NULL)
+  {
+    saved_time = *time_ptr;
+    *time_ptr = stage_time;
+  }
+
+  // The residual of the vector forms at the zero state is the source alone.
+  double* zero_vec = new double[ndof];
+  memset(zero_vec, 0, ndof * sizeof(double));
+  Vector<double>* vector = create_vector<double>();
+  source_dp->assemble(zero_vec, vector);
+  if (time_ptr != NULL)
+    *time_ptr = saved_time;
+
+  source.resize(ndof);
+  for (int d = 0; d < ndof; d++)
+    source[d] = vector->get(d);
+
+  delete vector;
+  delete [] zero_vec;
+}
+
+void LinearRungeKutta::rk_time_step(Hermes::vector<Solution<double>*> slns_time_prev, Hermes::vector<Solution<double>*> slns_time_new,
+                                    Hermes::vector<Solution<double>*> error_fns)
+{
+  update_blocks();
+  if (matrix_A == NULL)
+    init_operators();
+
+  // Start from the result of the previous step if it is the current state, or from the beginning of
+  // the previous step if that step is being repeated (e.g. on adapted spaces).
+  const double* source = NULL;
+  if (state_valid && std::abs(time - state_time) <= 1e-10 * time_step)
+    source = coeff_vec;
+  else if (state_valid && std::abs(time - start_time) <= 1e-10 * time_step)
+    source = start_coeff_vec;
+
+  // The coefficients of the components on unchanged spaces are taken over exactly, the rest is projected.
+  double* initial_vec = new double[ndof];
+  int num_projected = 0;
+  for (int i = 0; i < neq; i++)
+  {
+    if (source != NULL && !component_changed(i, state_spaces, state_seqs))
+      memcpy(initial_vec + first_dofs[i], source + state_first_dofs[i], spaces[i]->get_num_dofs() * sizeof(double));
+    else
+    {
+      OGProjection<double> ogProjection; ogProjection.project_global(spaces[i], slns_time_prev[i], initial_vec + first_dofs[i]);
+      num_projected++;
+    }
+  }
+  if (num_projected > 0 && num_projected < neq)
+    Hermes::Mixins::Loggable::Static::info("Linear R-K: projected %d of %d components.", num_projected, neq);
+
+  delete [] start_coeff_vec;
+  start_coeff_vec = new double[ndof];
+  memcpy(start_coeff_vec, initial_vec, ndof * sizeof(double));
+  start_time = time;
+  delete [] coeff_vec;
+  coeff_vec = initial_vec;
+  state_spaces = spaces;
+  state_seqs = space_seqs;
+  state_first_dofs = first_dofs;
+
+  unsigned int num_stages = bt->get_size();
+  double* K = new double[num_stages * ndof];
+  double* stage_state = new double[ndof];
+  double* stage_residual = new double[ndof];
+  CSCMatrix<double>* csc_A = static_cast<CSCMatrix<double>*>(matrix_A);
+  int block_iterations = 0;
+
+  for (unsigned int i = 0; i < num_stages; i++)
+  {
+    // Stage state Y_n + time_step * \sum_{j < i} a_ij K_j.
+    memcpy(stage_state, coeff_vec, ndof * sizeof(double));
+    for (unsigned int j = 0; j < i; j++)
+    {
+      double a_ij = time_step * bt->get_A(i, j);
+      if (a_ij == 0.0) continue;
+      for (int d = 0; d < ndof; d++)
+        stage_state[d] += a_ij * K[j * ndof + d];
+    }
+
+    // (M - time_step * a_ii * A) K_i = A (stage state) + b(t + c_i time_step).
+    csc_A->multiply_with_vector(stage_state, stage_residual);
+    if (has_source)
+      add_source(time + bt->get_C(i) * time_step, stage_residual);
+    int k = stage_operator[i];
+    if (!monolithic[k])
+    {
+      int iterations = solve_block(k, stage_residual, K + i * ndof);
+      if (iterations >= 0)
+      {
+        block_iterations += iterations;
+        continue;
+      }
+      Hermes::Mixins::Loggable::Static::warn("Linear R-K: the block Gauss-Seidel BiCGStab did not converge in %d iterations, factorizing the stage matrix.",
+                                             block_max_iters);
+      monolithic[k] = true;
+      init_stage_solver(k);
+    }
+    for (int d = 0; d < ndof; d++)
+      stage_rhss[k]->set(d, stage_residual[d]);
+
+    if (!stage_solvers[k]->solve())
+      throw Hermes::Exceptions::Exception("Matrix solver failed in LinearRungeKutta.");
+    stage_solvers[k]->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    memcpy(K + i * ndof, stage_solvers[k]->get_sln_vector(), ndof * sizeof(double));
+  }
+
+  if (block_solver)
+    Hermes::Mixins::Loggable::Static::info("Linear R-K: %d block Gauss-Seidel BiCGStab iteration(s), ndof = %d.", block_iterations, ndof);
+
+  // Y_{n+1} = Y_n + time_step * \sum_i b_i K_i.
+  for (unsigned int i = 0; i < num_stages; i++)
+  {
+    double b_i = time_step * bt->get_B(i);
+    if (b_i == 0.0) continue;
+    for (int d = 0; d < ndof; d++)
+      coeff_vec[d] += b_i * K[i * ndof + d];
+  }
+
+  Solution<double>::vector_to_solutions(coeff_vec, spaces, slns_time_new);
+
+  // Difference of the solutions of the two methods of an embedded table.
+  if (!error_fns.empty())
+  {
+    if (!bt->is_embedded())
+      throw Hermes::Exceptions::Exception("The temporal error estimate in LinearRungeKutta needs an embedded table.");
+    memset(stage_state, 0, ndof * sizeof(double));
+    for (unsigned int i = 0; i < num_stages; i++)
+    {
+      double db_i = time_step * (bt->get_B(i) - bt->get_B2(i));
+      if (db_i == 0.0) continue;
+      for (int d = 0; d < ndof; d++)
+        stage_state[d] += db_i * K[i * ndof + d];
+    }
+    Solution<double>::vector_to_solutions(stage_state, spaces, error_fns);
+  }
+
+  state_time = time + time_step;
+  state_valid = true;
+
+  delete [] K;
+  delete [] stage_state;
+  delete [] stage_residual;
+}
+
+template<typename Real, typename Scalar>
+Scalar MassFormVol::matrix_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u,
+                                Func<Real> *v, Geom<Real> *e, Func<Scalar>* *ext) const
+{
+  Scalar result = Scalar(0);
+  if (vector_valued)
+    for (int i = 0; i < n; i++)
+      result += wt[i] * (u->val0[i] * v->val0[i] + u->val1[i] * v->val1[i]);
+  else
+    for (int i = 0; i < n; i++)
+      result += wt[i] * u->val[i] * v->val[i];
+  return result;
+}
+
+double MassFormVol::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                          Func<double> *v, Geom<double> *e, Func<double>* *ext) const
+{
+  return matrix_form<double, double>(n, wt, u_ext, u, v, e, ext);
+}
+
+Ord MassFormVol::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                     Func<Ord> *v, Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return matrix_form<Ord, Ord>(n, wt, u_ext, u, v, e, ext);
+}
+
+MatrixFormVol<double>* MassFormVol::clone() const
+{
+  return new MassFormVol(*this);
+}
+
+LinearRungeKutta::BlockMatrixFormVol::BlockMatrixFormVol(const MatrixFormVol<double>* form, int i, int j)
+  : MatrixFormVol<double>(i, j), form(form)
+{
+  this->set_areas(form->getAreas());
+  this->ext = form->ext;
+  this->setSymFlag(form->sym);
+}
+
+double LinearRungeKutta::BlockMatrixFormVol::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                                                   Func<double> *v, Geom<double> *e, Func<double>* *ext) const
+{
+  return form->value(n, wt, u_ext, u, v, e, ext);
+}
+
+Ord LinearRungeKutta::BlockMatrixFormVol::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                                              Func<Ord> *v, Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return form->ord(n, wt, u_ext, u, v, e, ext);
+}
+
+MatrixFormVol<double>* LinearRungeKutta::BlockMatrixFormVol::clone() const
+{
+  return new BlockMatrixFormVol(*this);
+}
+
+LinearRungeKutta::BlockMatrixFormSurf::BlockMatrixFormSurf(const MatrixFormSurf<double>* form, int i, int j)
+  : MatrixFormSurf<double>(i, j), form(form)
+{
+  this->set_areas(form->getAreas());
+  this->ext = form->ext;
+}
+
+double LinearRungeKutta::BlockMatrixFormSurf::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                                                    Func<double> *v, Geom<double> *e, Func<double>* *ext) const
+{
+  return form->value(n, wt, u_ext, u, v, e, ext);
+}
+
+Ord LinearRungeKutta::BlockMatrixFormSurf::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                                               Func<Ord> *v, Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return form->ord(n, wt, u_ext, u, v, e, ext);
+}
+
+MatrixFormSurf<double>* LinearRungeKutta::BlockMatrixFormSurf::clone() const
+{
+  return new BlockMatrixFormSurf(*this);
+}
+
+LinearRungeKutta::BlockVectorFormVol::BlockVectorFormVol(const VectorFormVol<double>* form)
+  : VectorFormVol<double>(form->i), form(form)
+{
+  this->set_areas(form->getAreas());
+  this->ext = form->ext;
+}
+
+double LinearRungeKutta::BlockVectorFormVol::value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                                                   Geom<double> *e, Func<double>* *ext) const
+{
+  return form->value(n, wt, u_ext, v, e, ext);
+}
+
+Ord LinearRungeKutta::BlockVectorFormVol::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                                              Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return form->ord(n, wt, u_ext, v, e, ext);
+}
+
+VectorFormVol<double>* LinearRungeKutta::BlockVectorFormVol::clone() const
+{
+  return new BlockVectorFormVol(*this);
+}
+
+LinearRungeKutta::BlockVectorFormSurf::BlockVectorFormSurf(const VectorFormSurf<double>* form)
+  : VectorFormSurf<double>(form->i), form(form)
+{
+  this->set_areas(form->getAreas());
+  this->ext = form->ext;
+}
+
+double LinearRungeKutta::BlockVectorFormSurf::value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                                                    Geom<double> *e, Func<double>* *ext) const
+{
+  return form->value(n, wt, u_ext, v, e, ext);
+}
+
+Ord LinearRungeKutta::BlockVectorFormSurf::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                                               Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return form->ord(n, wt, u_ext, v, e, ext);
+}
+
+VectorFormSurf<double>* LinearRungeKutta::BlockVectorFormSurf::clone() const
+{
+  return new BlockVectorFormSurf(*this);
+}
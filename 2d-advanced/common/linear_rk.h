@@ -0,0 +1,269 @@
+#ifndef LINEAR_RK_H
+#define LINEAR_RK_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// Mass matrix form for one equation, for both scalar (H1, L2) and vector-valued (Hcurl, Hdiv) spaces.
+class MassFormVol : public MatrixFormVol<double>
+{
+public:
+  MassFormVol(int i, bool vector_valued) : MatrixFormVol<double>(i, i), vector_valued(vector_valued)
+  {
+    this->setSymFlag(HERMES_SYM);
+  };
+
+  template<typename Real, typename Scalar>
+  Scalar matrix_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v,
+                     Geom<Real> *e, Func<Scalar>* *ext) const;
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v,
+                       Geom<double> *e, Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                  Geom<Ord> *e, Func<Ord>* *ext) const;
+
+  virtual MatrixFormVol<double>* clone() const;
+
+  bool vector_valued;
+};
+
+/// \brief Runge-Kutta time stepping for linear problems M dY/dt = A Y + b(t) with a time-invariant A.
+///
+/// The weak form is the same as for RungeKutta<double>, i.e. its vector forms define the right-hand
+/// side F(t, Y) = A Y + b(t) and its matrix forms (volumetric and surface) dF/dY = A. Since A does not depend on Y nor t,
+/// the matrices A and M - time_step * a_ii * A (one for each distinct diagonal entry of the Butcher's table)
+/// are assembled and factorized only once, and every stage of every time step then costs one
+/// matrix-vector product and one back-substitution instead of a Newton's method on the stage system.
+/// The operators are rebuilt only when the spaces or the time step change.
+///
+/// A is kept as blocks A_ij between the components, and M as its diagonal blocks. When only some of the spaces
+/// changed (e.g. the adaptivity refined one component of a multimesh problem), only the blocks in their rows
+/// and columns are reassembled; the stage matrices are composed from the blocks and have to be factorized again.
+/// Likewise, when a step is repeated from the same time on new spaces, the components whose spaces did not
+/// change start from their exact coefficients, and only the others are projected.
+///
+/// Only explicit and diagonally implicit tables are supported; fully implicit methods are left
+/// to RungeKutta<double>::rk_time_step_newton(). By default the vector forms of the weak form are not used,
+/// i.e. b = 0; set_source() enables b(t) = F(t, 0), for which only the vector forms are assembled in the stages.
+///
+/// For coupled problems, set_block_solver() replaces the factorization of the whole stage matrices by the
+/// factorizations of their diagonal blocks, each kept until the space of its own component changes.
+class LinearRungeKutta
+{
+public:
+  LinearRungeKutta(const WeakForm<double>* wf, Hermes::vector<const Space<double>*> spaces, ButcherTable* bt);
+  ~LinearRungeKutta();
+
+  void set_spaces(Hermes::vector<const Space<double>*> spaces);
+  void set_time(double time);
+  void set_time_step(double time_step);
+
+  /// \brief Enables the source b(t) = F(t, 0), assembled from the vector forms at the zero state.
+  ///
+  /// The forms read the time from *time_ptr, which is set to the time of every stage while b is assembled
+  /// and restored afterwards. If time_ptr is NULL, b is constant and assembled only once for the spaces.
+  /// If the forms depend on the time only through the scalar 'time_factor', i.e. b(t) = b_0 + time_factor(t) b_1,
+  /// b is assembled at two times with different factors and the other stages only combine the two vectors.
+  void set_source(double* time_ptr = NULL, double (*time_factor)(double) = NULL);
+
+  /// \brief Solves the stage systems by BiCGStab preconditioned with a block Gauss-Seidel sweep over the components.
+  ///
+  /// Only the diagonal blocks M_ii - time_step * a_kk * A_ii are factorized; a change of one component's space
+  /// refactorizes only its own blocks, and the couplings A_ij are applied as products with the stored blocks.
+  /// If BiCGStab does not reach the relative residual 'tol' within 'max_iters' iterations (strongly coupled
+  /// components), the stage operator falls back to the factorization of the whole stage matrix until the
+  /// operators are rebuilt.
+  void set_block_solver(double tol = 1e-10, int max_iters = 100);
+
+  /// \brief One time step according to the Butcher's table.
+  ///
+  /// The state is kept as a coefficient vector between the steps. A component of 'slns_time_prev' is projected
+  /// onto its space only if it cannot be taken from the previous step, i.e. when its space changed or the time
+  /// set by set_time() is neither the end nor the beginning of the previous step. 'slns_time_prev' and
+  /// 'slns_time_new' may be the same solutions. For embedded tables, 'error_fns' (if not empty) receive
+  /// the difference of the two solutions as the estimate of the temporal error.
+  void rk_time_step(Hermes::vector<Solution<double>*> slns_time_prev, Hermes::vector<Solution<double>*> slns_time_new,
+                    Hermes::vector<Solution<double>*> error_fns = Hermes::vector<Solution<double>*>());
+
+private:
+  // Matrix form of the problem moved to the block (i, j) of another weak form.
+  class BlockMatrixFormVol : public MatrixFormVol<double>
+  {
+  public:
+    BlockMatrixFormVol(const MatrixFormVol<double>* form, int i, int j);
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v,
+                         Geom<double> *e, Func<double>* *ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                    Geom<Ord> *e, Func<Ord>* *ext) const;
+
+    virtual MatrixFormVol<double>* clone() const;
+
+  private:
+    const MatrixFormVol<double>* form;
+  };
+
+  // Surface matrix form of the problem moved to the block (i, j) of another weak form.
+  class BlockMatrixFormSurf : public MatrixFormSurf<double>
+  {
+  public:
+    BlockMatrixFormSurf(const MatrixFormSurf<double>* form, int i, int j);
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v,
+                         Geom<double> *e, Func<double>* *ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                    Geom<Ord> *e, Func<Ord>* *ext) const;
+
+    virtual MatrixFormSurf<double>* clone() const;
+
+  private:
+    const MatrixFormSurf<double>* form;
+  };
+
+  // Vector form of the problem in another weak form.
+  class BlockVectorFormVol : public VectorFormVol<double>
+  {
+  public:
+    BlockVectorFormVol(const VectorFormVol<double>* form);
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                         Geom<double> *e, Func<double>* *ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                    Geom<Ord> *e, Func<Ord>* *ext) const;
+
+    virtual VectorFormVol<double>* clone() const;
+
+  private:
+    const VectorFormVol<double>* form;
+  };
+
+  // Surface vector form of the problem in another weak form.
+  class BlockVectorFormSurf : public VectorFormSurf<double>
+  {
+  public:
+    BlockVectorFormSurf(const VectorFormSurf<double>* form);
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                         Geom<double> *e, Func<double>* *ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                    Geom<Ord> *e, Func<Ord>* *ext) const;
+
+    virtual VectorFormSurf<double>* clone() const;
+
+  private:
+    const VectorFormSurf<double>* form;
+  };
+
+  // Block of a matrix between two components, in the CSC format with the dofs of the components.
+  struct Block
+  {
+    std::vector<int> Ap;
+    std::vector<int> Ai;
+    std::vector<double> Ax;
+  };
+
+  // Reassembles the blocks of A and M of the components whose spaces changed.
+  void update_blocks();
+  // Assembles the block of the matrix forms of 'block_wf' (moved to the block (0, 0) or (0, 1)) over the spaces
+  // of the components i and j.
+  void assemble_block(WeakForm<double>* block_wf, int i, int j, Block& block);
+  // mass_factor * M + a_factor * A.
+  SparseMatrix<double>* compose(double mass_factor, double a_factor) const;
+  // Composes A and the stage matrices.
+  void init_operators();
+  void free_operators();
+  bool component_changed(int i, const Hermes::vector<const Space<double>*>& old_spaces, const std::vector<int>& old_seqs) const;
+  // Adds b(stage_time) to 'rhs'.
+  void add_source(double stage_time, double* rhs);
+  // Assembles b(stage_time) by the vector forms alone into 'source'.
+  void assemble_source(double stage_time, std::vector<double>& source);
+
+  // Composes and factorizes (at the first solution) the stage matrix of the stage operator k.
+  void init_stage_solver(int k);
+  // mass_factor * M_ii + a_factor * A_ii.
+  SparseMatrix<double>* compose_diagonal(int i, double mass_factor, double a_factor) const;
+  // Frees the factorized diagonal blocks of the component i, or of all components if i is -1.
+  void free_diagonal_blocks(int i);
+  // y += factor * B x for the block B between the components i (rows) and j (columns).
+  void multiply_block(const Block& block, int j, const double* x, double factor, double* y) const;
+  // y = (M - time_step * a_kk * A) x.
+  void apply_stage_matrix(int k, const double* x, double* y) const;
+  // z = P^-1 r with the block lower triangle P of the stage matrix of the stage operator k.
+  void apply_block_gauss_seidel(int k, const double* r, double* z);
+  // Solves the stage system of the stage operator k by the preconditioned BiCGStab, returns the number
+  // of iterations, or -1 if it did not converge.
+  int solve_block(int k, const double* rhs, double* x);
+
+  const WeakForm<double>* wf;
+  Hermes::vector<const Space<double>*> spaces;
+  ButcherTable* bt;
+  double time, time_step;
+  int neq;
+
+  // Spaces and their sequence numbers the blocks were assembled for (empty if there are none).
+  Hermes::vector<const Space<double>*> operator_spaces;
+  std::vector<int> space_seqs;
+  int ndof;
+  std::vector<int> first_dofs;
+
+  // Blocks [i * neq + j] of A (empty where the weak form has no forms), and the diagonal blocks of M.
+  std::vector<bool> has_block;
+  std::vector<Block> blocks_A;
+  std::vector<Block> blocks_M;
+
+  // A, and for every distinct diagonal coefficient of the table the stage matrix, its right-hand side and solver.
+  SparseMatrix<double>* matrix_A;
+  std::vector<double> diagonal;
+  std::vector<SparseMatrix<double>*> stage_matrices;
+  std::vector<Vector<double>*> stage_rhss;
+  std::vector<LinearMatrixSolver<double>*> stage_solvers;
+  // Index of the stage matrix used by each stage.
+  std::vector<int> stage_operator;
+
+  // Block solver: its settings, the stage operators that fell back to the whole stage matrix, and the
+  // factorized diagonal blocks [k * neq + i] of every stage operator k (NULL solver where not composed yet).
+  struct DiagonalBlock
+  {
+    DiagonalBlock() : matrix(NULL), rhs(NULL), solver(NULL) {}
+    SparseMatrix<double>* matrix;
+    Vector<double>* rhs;
+    LinearMatrixSolver<double>* solver;
+  };
+  bool block_solver;
+  double block_tol;
+  int block_max_iters;
+  std::vector<bool> monolithic;
+  std::vector<DiagonalBlock> diagonal_blocks;
+
+  // Source: whether it is used, the time read by the forms, and b if it is constant (empty until assembled).
+  bool has_source;
+  double* time_ptr;
+  std::vector<double> constant_source;
+  // Separable source: the time factor, and b at (up to) two different factors assembled for the spaces.
+  double (*time_factor)(double);
+  std::vector<double> sampled_sources[2];
+  double sampled_factors[2];
+  int num_sampled;
+  // The vector forms of the problem, and their discrete problem kept until the spaces change.
+  WeakForm<double>* source_wf;
+  DiscreteProblem<double>* source_dp;
+
+  // Current state and the time it belongs to, and the state at the beginning of the last step,
+  // together with the spaces they belong to.
+  double* coeff_vec;
+  double* start_coeff_vec;
+  double state_time, start_time;
+  bool state_valid;
+  Hermes::vector<const Space<double>*> state_spaces;
+  std::vector<int> state_seqs;
+  std::vector<int> state_first_dofs;
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include "pml.h"
+
+PerfectlyMatchedLayer::PerfectlyMatchedLayer(double x_min, double x_max, double y_min, double y_max, double thickness,
+                                             double alpha, int degree, GeomType gt)
+  : type(PML_CARTESIAN), x_min(x_min), x_max(x_max), y_min(y_min), y_max(y_max), x_c(0.0), y_c(0.0), radius(0.0),
+    thickness(thickness), alpha(alpha), degree(degree), gt(gt)
+{
+  if (thickness <= 0.0)
+    throw Hermes::Exceptions::Exception("The thickness of the perfectly matched layer has to be positive.");
+  // The layer cannot lie between the box and the axis of symmetry.
+  if ((gt == HERMES_AXISYM_Y && x_min > 0.0) || (gt == HERMES_AXISYM_X && y_min > 0.0))
+    throw Hermes::Exceptions::Exception("Axisymmetric perfectly matched layer between the box and the axis.");
+}
+
+PerfectlyMatchedLayer::PerfectlyMatchedLayer(double x_c, double y_c, double radius, double thickness,
+                                             double alpha, int degree, GeomType gt)
+  : type(PML_RADIAL), x_min(0.0), x_max(0.0), y_min(0.0), y_max(0.0), x_c(x_c), y_c(y_c), radius(radius),
+    thickness(thickness), alpha(alpha), degree(degree), gt(gt)
+{
+  if (thickness <= 0.0)
+    throw Hermes::Exceptions::Exception("The thickness of the perfectly matched layer has to be positive.");
+  if ((gt == HERMES_AXISYM_Y && x_c != 0.0) || (gt == HERMES_AXISYM_X && y_c != 0.0))
+    throw Hermes::Exceptions::Exception("The center of an axisymmetric perfectly matched layer has to lie on the axis.");
+}
+
+void PerfectlyMatchedLayer::prepare(const Mesh* mesh)
+{
+  tables.clear();
+  tables.resize(mesh->get_max_element_id());
+}
+
+void PerfectlyMatchedLayer::stretching(double xi, std::complex<double>& s, std::complex<double>& shift) const
+{
+  double t = std::pow(xi / thickness, degree);
+  s = std::complex<double>(1.0, alpha * t);
+  shift = std::complex<double>(0.0, alpha * thickness * t * (xi / thickness) / (degree + 1));
+}
+
+const PerfectlyMatchedLayer::Table& PerfectlyMatchedLayer::get_table(int n, Geom<double>* e, Table& scratch) const
+{
+  if (e->id < 0 || e->id >= (int) tables.size())
+  {
+    fill_table(n, e, scratch);
+    return scratch;
+  }
+
+  // The same element may be integrated with several numbers of points (and, in multi-mesh problems,
+  // on several of its sub-elements).
+  std::vector<Table>& element_tables = tables[e->id];
+  for (unsigned int k = 0; k < element_tables.size(); k++)
+    if (element_tables[k].n == n && element_tables[k].x0 == e->x[0] && element_tables[k].y0 == e->y[0])
+      return element_tables[k];
+  element_tables.push_back(Table());
+  fill_table(n, e, element_tables.back());
+  return element_tables.back();
+}
+
+void PerfectlyMatchedLayer::fill_table(int n, Geom<double>* e, Table& table) const
+{
+  table.n = n;
+  table.x0 = e->x[0];
+  table.y0 = e->y[0];
+  table.stretched = false;
+  table.weight.clear();
+  table.lambda_xx.clear();
+  table.lambda_xy.clear();
+  table.lambda_yy.clear();
+  table.det.clear();
+
+  // Depths of the points in the layer.
+  std::vector<double> xi_x(n), xi_y(n);
+  for (int i = 0; i < n; i++)
+  {
+    if (type == PML_CARTESIAN)
+    {
+      xi_x[i] = std::max(0.0, std::max(x_min - e->x[i], e->x[i] - x_max));
+      xi_y[i] = std::max(0.0, std::max(y_min - e->y[i], e->y[i] - y_max));
+    }
+    else
+    {
+      xi_x[i] = std::max(0.0, std::sqrt(sqr(e->x[i] - x_c) + sqr(e->y[i] - y_c)) - radius);
+      xi_y[i] = 0.0;
+    }
+    if (xi_x[i] > 0.0 || xi_y[i] > 0.0)
+      table.stretched = true;
+  }
+
+  if (gt != HERMES_PLANAR)
+  {
+    table.weight.resize(n);
+    for (int i = 0; i < n; i++)
+      table.weight[i] = (gt == HERMES_AXISYM_X) ? e->y[i] : e->x[i];
+  }
+  if (!table.stretched)
+    return;
+
+  table.lambda_xx.resize(n);
+  table.lambda_xy.resize(n);
+  table.lambda_yy.resize(n);
+  table.det.resize(n);
+  for (int i = 0; i < n; i++)
+  {
+    double weight = table.weight.empty() ? 1.0 : table.weight[i];
+    if (type == PML_CARTESIAN)
+    {
+      std::complex<double> s_x, s_y, shift_x, shift_y;
+      stretching(xi_x[i], s_x, shift_x);
+      stretching(xi_y[i], s_y, shift_y);
+
+      // Ratio of the stretched and the real radius.
+      std::complex<double> out_of_plane(1.0, 0.0);
+      if (gt == HERMES_AXISYM_Y && xi_x[i] > 0.0)
+        out_of_plane = 1.0 + shift_x / e->x[i];
+      else if (gt == HERMES_AXISYM_X && xi_y[i] > 0.0)
+        out_of_plane = 1.0 + shift_y / e->y[i];
+
+      std::complex<double> det = s_x * s_y * out_of_plane * weight;
+      table.lambda_xx[i] = det / (s_x * s_x);
+      table.lambda_xy[i] = 0.0;
+      table.lambda_yy[i] = det / (s_y * s_y);
+      table.det[i] = det;
+    }
+    else
+    {
+      double rho = std::sqrt(sqr(e->x[i] - x_c) + sqr(e->y[i] - y_c));
+      double e_x = (rho > 0.0) ? (e->x[i] - x_c) / rho : 0.0;
+      double e_y = (rho > 0.0) ? (e->y[i] - y_c) / rho : 0.0;
+
+      // Radial stretching s, and the ratio q of the stretched and the real distance from the center
+      // (stretching the tangential and, in axisymmetric problems, the azimuthal direction).
+      std::complex<double> s, shift;
+      stretching(xi_x[i], s, shift);
+      std::complex<double> q = 1.0 + shift / rho;
+
+      std::complex<double> det = s * q * (gt == HERMES_PLANAR ? 1.0 : q) * weight;
+      std::complex<double> radial = 1.0 / (s * s), tangential = 1.0 / (q * q);
+      table.lambda_xx[i] = det * (e_x * e_x * radial + e_y * e_y * tangential);
+      table.lambda_xy[i] = det * e_x * e_y * (radial - tangential);
+      table.lambda_yy[i] = det * (e_y * e_y * radial + e_x * e_x * tangential);
+      table.det[i] = det;
+    }
+  }
+}
+
+template<typename T>
+std::complex<double> PerfectlyMatchedLayer::integrate(int n, double *wt, Func<T> *u, Func<double> *v, Geom<double> *e,
+                                                      std::complex<double> c_d, std::complex<double> c_m) const
+{
+  Table scratch;
+  const Table& table = get_table(n, e, scratch);
+
+  if (!table.stretched)
+  {
+    T diffusion = T(0), mass = T(0);
+    if (table.weight.empty())
+      for (int i = 0; i < n; i++)
+      {
+        diffusion += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
+        mass += wt[i] * u->val[i] * v->val[i];
+      }
+    else
+      for (int i = 0; i < n; i++)
+      {
+        diffusion += wt[i] * table.weight[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
+        mass += wt[i] * table.weight[i] * u->val[i] * v->val[i];
+      }
+    return c_d * std::complex<double>(diffusion) + c_m * std::complex<double>(mass);
+  }
+
+  std::complex<double> diffusion = 0.0, mass = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    diffusion += wt[i] * ((table.lambda_xx[i] * u->dx[i] + table.lambda_xy[i] * u->dy[i]) * v->dx[i]
+                          + (table.lambda_xy[i] * u->dx[i] + table.lambda_yy[i] * u->dy[i]) * v->dy[i]);
+    mass += wt[i] * table.det[i] * u->val[i] * v->val[i];
+  }
+  return c_d * diffusion + c_m * mass;
+}
+
+Ord PerfectlyMatchedLayer::integrate_ord(int n, double *wt, Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e) const
+{
+  Ord result = Ord(0);
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + u->val[i] * v->val[i]);
+  // The stretching profile (and the axisymmetric weight).
+  return result * Ord(gt == HERMES_PLANAR ? degree : degree + 1);
+}
+
+template std::complex<double> PerfectlyMatchedLayer::integrate<double>(int n, double *wt, Func<double> *u, Func<double> *v,
+                                                                       Geom<double> *e, std::complex<double> c_d, std::complex<double> c_m) const;
+template std::complex<double> PerfectlyMatchedLayer::integrate<std::complex<double> >(int n, double *wt, Func<std::complex<double> > *u,
+                                                                                      Func<double> *v, Geom<double> *e,
+                                                                                      std::complex<double> c_d, std::complex<double> c_m) const;
+
+std::complex<double> PmlMatrixFormVol::value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *u, Func<double> *v,
+                                             Geom<double> *e, Func<std::complex<double> >* *ext) const
+{
+  return pml->integrate<double>(n, wt, u, v, e, c_d, c_m);
+}
+
+Ord PmlMatrixFormVol::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                          Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return pml->integrate_ord(n, wt, u, v, e);
+}
+
+MatrixFormVol<std::complex<double> >* PmlMatrixFormVol::clone() const
+{
+  return new PmlMatrixFormVol(*this);
+}
+
+std::complex<double> PmlVectorFormVol::value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *v,
+                                             Geom<double> *e, Func<std::complex<double> >* *ext) const
+{
+  return pml->integrate<std::complex<double> >(n, wt, u_ext[this->i], v, e, c_d, c_m);
+}
+
+Ord PmlVectorFormVol::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                          Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return pml->integrate_ord(n, wt, u_ext[this->i], v, e);
+}
+
+VectorFormVol<std::complex<double> >* PmlVectorFormVol::clone() const
+{
+  return new PmlVectorFormVol(*this);
+}
+
+double PmlMatrixFormVolSplit::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v,
+                                    Geom<double> *e, Func<double>* *ext) const
+{
+  std::complex<double> result = pml->integrate<double>(n, wt, u, v, e, c_d, c_m);
+  if (imag_equation == imag_unknown)
+    return result.real();
+  return imag_equation ? result.imag() : -result.imag();
+}
+
+Ord PmlMatrixFormVolSplit::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                               Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return pml->integrate_ord(n, wt, u, v, e);
+}
+
+MatrixFormVol<double>* PmlMatrixFormVolSplit::clone() const
+{
+  return new PmlMatrixFormVolSplit(*this);
+}
+
+double PmlVectorFormVolSplit::value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                                    Geom<double> *e, Func<double>* *ext) const
+{
+  std::complex<double> result = pml->integrate<double>(n, wt, u_ext[re], v, e, c_d, c_m)
+    + std::complex<double>(0.0, 1.0) * pml->integrate<double>(n, wt, u_ext[im], v, e, c_d, c_m);
+  return imag_equation ? result.imag() : result.real();
+}
+
+Ord PmlVectorFormVolSplit::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                               Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return pml->integrate_ord(n, wt, u_ext[re], v, e);
+}
+
+VectorFormVol<double>* PmlVectorFormVolSplit::clone() const
+{
+  return new PmlVectorFormVolSplit(*this);
+}
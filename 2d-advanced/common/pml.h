@@ -0,0 +1,175 @@
+#ifndef PML_H
+#define PML_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Perfectly matched layer by complex coordinate stretching for Helmholtz-type problems
+///
+///   -div(c_d grad u) + c_m u = 0.
+///
+/// In the layer the coordinate normal to it is stretched with the factor s(xi) = 1 + i alpha (xi / thickness)^degree,
+/// xi being the depth in the layer, and the weak form becomes
+///
+///   \int c_d (Lambda grad u) . grad v + c_m det(J) u v,   Lambda = det(J) J^{-1} J^{-T},
+///
+/// J being the Jacobian of the stretching (including the azimuthal direction in axisymmetric problems).
+/// Outgoing waves exp(i k x), i.e. the convention of the matched boundary dp/dn = i k p, are then attenuated by
+/// exp(-k alpha thickness / (degree + 1)) over one pass through the layer, without reflection at its interface.
+/// The stretching does not depend on the frequency, so that the forms keep the polynomial dependence
+/// on omega that FrequencySweep relies on.
+///
+/// The layer is either Cartesian, outside of a box (sides at +-infinity have no layer), or radial, outside
+/// of a circle; in axisymmetric problems the latter is a sphere and its center has to lie on the axis.
+///
+/// Lambda and det(J) (with the axisymmetric weight) at the quadrature points are computed once per element and
+/// number of points, and cached by the id of the element, checked against the first point. Elements outside
+/// of the layer are marked so and integrated with the plain coefficients. prepare() has to be called for every
+/// new mesh before the assembly: it allocates the cache, so that the elements can be assembled in parallel
+/// (every element by one thread). Elements beyond the prepared mesh are computed without caching.
+class PerfectlyMatchedLayer
+{
+public:
+  enum LayerType
+  {
+    PML_CARTESIAN,
+    PML_RADIAL
+  };
+
+  /// Cartesian layer outside of the box [x_min, x_max] x [y_min, y_max].
+  PerfectlyMatchedLayer(double x_min, double x_max, double y_min, double y_max, double thickness,
+                        double alpha, int degree = 2, GeomType gt = HERMES_PLANAR);
+  /// Radial layer outside of the circle with the center (x_c, y_c) and the radius 'radius'.
+  PerfectlyMatchedLayer(double x_c, double y_c, double radius, double thickness,
+                        double alpha, int degree = 2, GeomType gt = HERMES_PLANAR);
+
+  void prepare(const Mesh* mesh);
+
+  GeomType get_geom_type() const { return gt; }
+
+  /// \int c_d (Lambda grad u) . grad v + c_m det(J) u v over the element.
+  template<typename T>
+  std::complex<double> integrate(int n, double *wt, Func<T> *u, Func<double> *v, Geom<double> *e,
+                                 std::complex<double> c_d, std::complex<double> c_m) const;
+  Ord integrate_ord(int n, double *wt, Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e) const;
+
+private:
+  // Coefficients at the quadrature points of an element.
+  struct Table
+  {
+    int n;
+    double x0, y0;
+    bool stretched;
+    // Axisymmetric weight (empty for planar problems) for the elements outside of the layer.
+    std::vector<double> weight;
+    std::vector<std::complex<double> > lambda_xx, lambda_xy, lambda_yy, det;
+  };
+
+  const Table& get_table(int n, Geom<double>* e, Table& scratch) const;
+  void fill_table(int n, Geom<double>* e, Table& table) const;
+  // Stretching factor s(xi) and the imaginary shift of the stretched coordinate, \int_0^xi s - xi.
+  void stretching(double xi, std::complex<double>& s, std::complex<double>& shift) const;
+
+  LayerType type;
+  double x_min, x_max, y_min, y_max;
+  double x_c, y_c, radius;
+  double thickness, alpha;
+  int degree;
+  GeomType gt;
+
+  // Tables [element id] (one per number of points), mutable as a cache.
+  mutable std::vector<std::vector<Table> > tables;
+};
+
+/// Jacobian of -div(c_d grad u) + c_m u with the layer, for complex problems.
+class PmlMatrixFormVol : public MatrixFormVol<std::complex<double> >
+{
+public:
+  PmlMatrixFormVol(int i, int j, const PerfectlyMatchedLayer* pml, std::complex<double> c_d, std::complex<double> c_m)
+    : MatrixFormVol<std::complex<double> >(i, j), pml(pml), c_d(c_d), c_m(c_m) { this->setSymFlag(HERMES_SYM); };
+
+  virtual std::complex<double> value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *u, Func<double> *v,
+                                     Geom<double> *e, Func<std::complex<double> >* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                  Geom<Ord> *e, Func<Ord>* *ext) const;
+
+  virtual MatrixFormVol<std::complex<double> >* clone() const;
+
+private:
+  const PerfectlyMatchedLayer* pml;
+  std::complex<double> c_d, c_m;
+};
+
+/// Residual of -div(c_d grad u) + c_m u with the layer, for complex problems.
+class PmlVectorFormVol : public VectorFormVol<std::complex<double> >
+{
+public:
+  PmlVectorFormVol(int i, const PerfectlyMatchedLayer* pml, std::complex<double> c_d, std::complex<double> c_m)
+    : VectorFormVol<std::complex<double> >(i), pml(pml), c_d(c_d), c_m(c_m) {};
+
+  virtual std::complex<double> value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *v,
+                                     Geom<double> *e, Func<std::complex<double> >* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                  Geom<Ord> *e, Func<Ord>* *ext) const;
+
+  virtual VectorFormVol<std::complex<double> >* clone() const;
+
+private:
+  const PerfectlyMatchedLayer* pml;
+  std::complex<double> c_d, c_m;
+};
+
+/// \brief Jacobian of -div(c_d grad u) + c_m u with the layer, for problems split into the real and imaginary parts.
+///
+/// The block (i, j) is the real or imaginary part of the complex form, according to whether the equation i
+/// and the unknown j are the real or imaginary parts of u.
+class PmlMatrixFormVolSplit : public MatrixFormVol<double>
+{
+public:
+  PmlMatrixFormVolSplit(int i, int j, bool imag_equation, bool imag_unknown, const PerfectlyMatchedLayer* pml,
+                        std::complex<double> c_d, std::complex<double> c_m)
+    : MatrixFormVol<double>(i, j), imag_equation(imag_equation), imag_unknown(imag_unknown), pml(pml), c_d(c_d), c_m(c_m) {};
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v,
+                       Geom<double> *e, Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                  Geom<Ord> *e, Func<Ord>* *ext) const;
+
+  virtual MatrixFormVol<double>* clone() const;
+
+private:
+  bool imag_equation, imag_unknown;
+  const PerfectlyMatchedLayer* pml;
+  std::complex<double> c_d, c_m;
+};
+
+/// Residual of -div(c_d grad u) + c_m u with the layer, for problems split into the real part (unknown 're')
+/// and the imaginary part (unknown 'im').
+class PmlVectorFormVolSplit : public VectorFormVol<double>
+{
+public:
+  PmlVectorFormVolSplit(int i, bool imag_equation, int re, int im, const PerfectlyMatchedLayer* pml,
+                        std::complex<double> c_d, std::complex<double> c_m)
+    : VectorFormVol<double>(i), imag_equation(imag_equation), re(re), im(im), pml(pml), c_d(c_d), c_m(c_m) {};
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                       Geom<double> *e, Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                  Geom<Ord> *e, Func<Ord>* *ext) const;
+
+  virtual VectorFormVol<double>* clone() const;
+
+private:
+  bool imag_equation;
+  int re, im;
+  const PerfectlyMatchedLayer* pml;
+  std::complex<double> c_d, c_m;
+};
+
+#endif
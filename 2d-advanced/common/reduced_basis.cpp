@@ -0,0 +1,424 @@
+#include "reduced_basis.h"
+
+template<typename Scalar>
+ReducedBasis<Scalar>::ReducedBasis(Hermes::vector<WeakForm<Scalar>*> affine_wfs, const AffineParametrization<Scalar>* parametrization,
+                                   WeakForm<Scalar>* inner_product_wf, Hermes::vector<const Space<Scalar>*> spaces)
+  : parametrization(parametrization), num_terms(affine_wfs.size()), solver_truth(NULL)
+{
+  ndof = Space<Scalar>::get_num_dofs(spaces);
+  Scalar* zero_vec = new Scalar[ndof];
+  memset(zero_vec, 0, ndof * sizeof(Scalar));
+
+  // Matrices and right-hand sides of the terms.
+  std::vector<CSCMatrix<Scalar>*> term_matrices;
+  for (int q = 0; q < num_terms; q++)
+  {
+    DiscreteProblem<Scalar> dp(affine_wfs[q], spaces);
+    SparseMatrix<Scalar>* matrix = create_matrix<Scalar>();
+    Vector<Scalar>* residual = create_vector<Scalar>();
+    dp.assemble(zero_vec, matrix, residual);
+    CSCMatrix<Scalar>* csc = dynamic_cast<CSCMatrix<Scalar>*>(matrix);
+    if (csc == NULL)
+      throw Hermes::Exceptions::Exception("ReducedBasis needs a matrix solver with CSC matrices (e.g. UMFPACK).");
+    term_matrices.push_back(csc);
+
+    Scalar* rhs = new Scalar[ndof];
+    for (int i = 0; i < ndof; i++)
+      rhs[i] = -residual->get(i);
+    term_rhs.push_back(rhs);
+    delete residual;
+  }
+
+  // Union of the sparsity patterns (the terms may live on different parts of the domain
+  // and some of them may have no matrix at all).
+  std::vector<int> ap(ndof + 1, 0), ai;
+  std::vector<int> rows;
+  for (int c = 0; c < ndof; c++)
+  {
+    rows.clear();
+    for (int q = 0; q < num_terms; q++)
+      if (term_matrices[q]->get_nnz() > 0)
+        for (int k = term_matrices[q]->get_Ap()[c]; k < term_matrices[q]->get_Ap()[c + 1]; k++)
+          rows.push_back(term_matrices[q]->get_Ai()[k]);
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    ai.insert(ai.end(), rows.begin(), rows.end());
+    ap[c + 1] = ai.size();
+  }
+  nnz = ai.size();
+  if (nnz == 0)
+    throw Hermes::Exceptions::Exception("ReducedBasis: none of the affine terms has a matrix.");
+  Ap = new int[ndof + 1];
+  memcpy(Ap, &ap[0], (ndof + 1) * sizeof(int));
+  Ai = new int[nnz];
+  memcpy(Ai, &ai[0], nnz * sizeof(int));
+
+  for (int q = 0; q < num_terms; q++)
+  {
+    Scalar* ax = new Scalar[nnz];
+    memset(ax, 0, nnz * sizeof(Scalar));
+    if (term_matrices[q]->get_nnz() > 0)
+      for (int c = 0; c < ndof; c++)
+      {
+        int pos = Ap[c];
+        for (int k = term_matrices[q]->get_Ap()[c]; k < term_matrices[q]->get_Ap()[c + 1]; k++)
+        {
+          while (Ai[pos] != term_matrices[q]->get_Ai()[k])
+            pos++;
+          ax[pos] = term_matrices[q]->get_Ax()[k];
+        }
+      }
+    term_Ax.push_back(ax);
+    delete term_matrices[q];
+  }
+
+  // Inner product, factorized once.
+  DiscreteProblem<Scalar> dp_X(inner_product_wf, spaces);
+  matrix_X = create_matrix<Scalar>();
+  rhs_X = create_vector<Scalar>();
+  dp_X.assemble(zero_vec, matrix_X, rhs_X);
+  solver_X = create_linear_solver<Scalar>(matrix_X, rhs_X);
+  delete [] zero_vec;
+
+  matrix_truth = create_matrix<Scalar>();
+  rhs_truth = create_vector<Scalar>();
+  rhs_truth->alloc(ndof);
+
+  reduced_A.resize(num_terms);
+  reduced_b.resize(num_terms);
+
+  // Riesz representers of the right-hand sides.
+  for (int q = 0; q < num_terms; q++)
+  {
+    Scalar* f = new Scalar[ndof];
+    memcpy(f, term_rhs[q], ndof * sizeof(Scalar));
+    riesz(f);
+    riesz_b.push_back(f);
+  }
+  gram_bb.resize(num_terms * num_terms);
+  for (int q = 0; q < num_terms; q++)
+    for (int qq = 0; qq < num_terms; qq++)
+      gram_bb[q * num_terms + qq] = inner_product(riesz_b[q], riesz_b[qq]);
+}
+
+template<typename Scalar>
+ReducedBasis<Scalar>::~ReducedBasis()
+{
+  for (int q = 0; q < num_terms; q++)
+  {
+    delete [] term_Ax[q];
+    delete [] term_rhs[q];
+    delete [] riesz_b[q];
+  }
+  for (unsigned int n = 0; n < basis.size(); n++)
+    delete [] basis[n];
+  for (unsigned int r = 0; r < riesz_A.size(); r++)
+    delete [] riesz_A[r];
+  delete [] Ap;
+  delete [] Ai;
+  delete solver_X;
+  delete matrix_X;
+  delete rhs_X;
+  delete solver_truth;
+  delete matrix_truth;
+  delete rhs_truth;
+}
+
+template<typename Scalar>
+void ReducedBasis<Scalar>::multiply(int q, const Scalar* x, Scalar* y) const
+{
+  memset(y, 0, ndof * sizeof(Scalar));
+  const Scalar* ax = term_Ax[q];
+  for (int c = 0; c < ndof; c++)
+    for (int k = Ap[c]; k < Ap[c + 1]; k++)
+      y[Ai[k]] += ax[k] * x[c];
+}
+
+template<typename Scalar>
+Scalar ReducedBasis<Scalar>::inner_product(const Scalar* x, const Scalar* y) const
+{
+  CSCMatrix<Scalar>* X = static_cast<CSCMatrix<Scalar>*>(matrix_X);
+  Scalar result = Scalar(0);
+  for (int c = 0; c < ndof; c++)
+  {
+    Scalar Xy = Scalar(0);
+    for (int k = X->get_Ap()[c]; k < X->get_Ap()[c + 1]; k++)
+      Xy += X->get_Ax()[k] * y[X->get_Ai()[k]];
+    // X is symmetric, so that column c equals row c.
+    result += conjugate(x[c]) * Xy;
+  }
+  return result;
+}
+
+template<typename Scalar>
+void ReducedBasis<Scalar>::riesz(Scalar* vec)
+{
+  for (int i = 0; i < ndof; i++)
+    rhs_X->set(i, vec[i]);
+  if (!solver_X->solve())
+    throw Hermes::Exceptions::Exception("Matrix solver failed for the inner product in ReducedBasis.");
+  solver_X->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+  memcpy(vec, solver_X->get_sln_vector(), ndof * sizeof(Scalar));
+}
+
+template<typename Scalar>
+Scalar* ReducedBasis<Scalar>::solve_truth(const std::vector<double>& mu)
+{
+  std::vector<Scalar> theta(num_terms);
+  parametrization->theta(mu, &theta[0]);
+
+  Scalar* ax = new Scalar[nnz];
+  memset(ax, 0, nnz * sizeof(Scalar));
+  for (int q = 0; q < num_terms; q++)
+    for (int k = 0; k < nnz; k++)
+      ax[k] += theta[q] * term_Ax[q][k];
+  matrix_truth->free();
+  static_cast<CSCMatrix<Scalar>*>(matrix_truth)->create(ndof, nnz, Ap, Ai, ax);
+  delete [] ax;
+  for (int i = 0; i < ndof; i++)
+  {
+    Scalar b = Scalar(0);
+    for (int q = 0; q < num_terms; q++)
+      b += theta[q] * term_rhs[q][i];
+    rhs_truth->set(i, b);
+  }
+
+  // The pattern is the same for all parameters, its ordering is computed only once.
+  if (solver_truth == NULL)
+    solver_truth = create_linear_solver<Scalar>(matrix_truth, rhs_truth);
+  else
+    solver_truth->set_factorization_scheme(HERMES_REUSE_MATRIX_REORDERING);
+  if (!solver_truth->solve())
+    throw Hermes::Exceptions::Exception("Matrix solver failed in ReducedBasis::solve_truth().");
+
+  Scalar* coeff_vec = new Scalar[ndof];
+  memcpy(coeff_vec, solver_truth->get_sln_vector(), ndof * sizeof(Scalar));
+  return coeff_vec;
+}
+
+template<typename Scalar>
+void ReducedBasis<Scalar>::add_basis_function(Scalar* coeff_vec)
+{
+  double norm_snapshot = std::sqrt(std::abs(inner_product(coeff_vec, coeff_vec)));
+
+  // Gram-Schmidt in the X inner product, twice for stability.
+  for (int pass = 0; pass < 2; pass++)
+    for (unsigned int n = 0; n < basis.size(); n++)
+    {
+      Scalar proj = inner_product(basis[n], coeff_vec);
+      for (int i = 0; i < ndof; i++)
+        coeff_vec[i] -= proj * basis[n][i];
+    }
+  double norm = std::sqrt(std::abs(inner_product(coeff_vec, coeff_vec)));
+  if (norm <= 1e-12 * norm_snapshot)
+  {
+    Hermes::Mixins::Loggable::Static::warn("ReducedBasis: the snapshot is already in the basis.");
+    delete [] coeff_vec;
+    return;
+  }
+  for (int i = 0; i < ndof; i++)
+    coeff_vec[i] /= norm;
+
+  int N_old = basis.size();
+  int N = N_old + 1;
+  basis.push_back(coeff_vec);
+
+  // Reduced matrices and vectors, extended by one row and column.
+  Scalar* A_z = new Scalar[ndof];
+  for (int q = 0; q < num_terms; q++)
+  {
+    std::vector<Scalar> A_new(N * N);
+    for (int m = 0; m < N_old; m++)
+      for (int n = 0; n < N_old; n++)
+        A_new[m * N + n] = reduced_A[q][m * N_old + n];
+
+    // Column N - 1: z_m^H A_q z_{N-1}, row N - 1: z_{N-1}^H A_q z_n.
+    multiply(q, coeff_vec, A_z);
+    for (int m = 0; m < N; m++)
+    {
+      Scalar dot = Scalar(0);
+      for (int i = 0; i < ndof; i++)
+        dot += conjugate(basis[m][i]) * A_z[i];
+      A_new[m * N + N - 1] = dot;
+    }
+    for (int n = 0; n < N_old; n++)
+    {
+      multiply(q, basis[n], A_z);
+      Scalar dot = Scalar(0);
+      for (int i = 0; i < ndof; i++)
+        dot += conjugate(coeff_vec[i]) * A_z[i];
+      A_new[(N - 1) * N + n] = dot;
+    }
+    reduced_A[q] = A_new;
+
+    Scalar dot = Scalar(0);
+    for (int i = 0; i < ndof; i++)
+      dot += conjugate(coeff_vec[i]) * term_rhs[q][i];
+    reduced_b[q].push_back(dot);
+  }
+
+  // Riesz representers of A_q z_{N-1} and their inner products.
+  int num_old = riesz_A.size();
+  for (int q = 0; q < num_terms; q++)
+  {
+    multiply(q, coeff_vec, A_z);
+    riesz(A_z);
+    Scalar* r = new Scalar[ndof];
+    memcpy(r, A_z, ndof * sizeof(Scalar));
+    riesz_A.push_back(r);
+  }
+  delete [] A_z;
+
+  int num_reps = riesz_A.size();
+  gram_AA.resize(num_reps);
+  for (int r = 0; r < num_reps; r++)
+    gram_AA[r].resize(num_reps);
+  for (int r = num_old; r < num_reps; r++)
+    for (int rr = 0; rr < num_reps; rr++)
+    {
+      Scalar val = inner_product(riesz_A[r], riesz_A[rr]);
+      gram_AA[r][rr] = val;
+      gram_AA[rr][r] = conjugate(val);
+    }
+
+  std::vector<Scalar> bA(num_terms * num_terms);
+  for (int q = 0; q < num_terms; q++)
+    for (int qq = 0; qq < num_terms; qq++)
+      bA[q * num_terms + qq] = inner_product(riesz_b[q], riesz_A[num_old + qq]);
+  gram_bA.push_back(bA);
+}
+
+template<typename Scalar>
+double ReducedBasis<Scalar>::residual_dual_norm(const Scalar* theta, const std::vector<Scalar>& y) const
+{
+  int N = basis.size();
+  int Q = num_terms;
+  Scalar result = Scalar(0);
+  for (int q = 0; q < Q; q++)
+    for (int qq = 0; qq < Q; qq++)
+      result += conjugate(theta[q]) * theta[qq] * gram_bb[q * Q + qq];
+
+  Scalar cross = Scalar(0);
+  for (int n = 0; n < N; n++)
+    for (int q = 0; q < Q; q++)
+      for (int qq = 0; qq < Q; qq++)
+        cross += conjugate(theta[q]) * theta[qq] * y[n] * gram_bA[n][q * Q + qq];
+  result -= cross + conjugate(cross);
+
+  for (int r = 0; r < N * Q; r++)
+  {
+    Scalar c_r = theta[r % Q] * y[r / Q];
+    for (int rr = 0; rr < N * Q; rr++)
+      result += conjugate(c_r) * theta[rr % Q] * y[rr / Q] * gram_AA[r][rr];
+  }
+  // Round-off may make the difference of large numbers slightly negative.
+  return std::sqrt(std::max(0.0, real_part(result)));
+}
+
+template<typename Scalar>
+void ReducedBasis<Scalar>::solve_online(const std::vector<double>& mu, std::vector<Scalar>& y, double& error_bound) const
+{
+  int N = basis.size();
+  if (N == 0)
+    throw Hermes::Exceptions::Exception("ReducedBasis: the basis is empty, call offline_greedy() first.");
+
+  std::vector<Scalar> theta(num_terms);
+  parametrization->theta(mu, &theta[0]);
+
+  // Dense reduced system, stored column-major.
+  std::vector<Scalar> A(N * N, Scalar(0));
+  y.assign(N, Scalar(0));
+  for (int q = 0; q < num_terms; q++)
+  {
+    for (int m = 0; m < N; m++)
+      for (int n = 0; n < N; n++)
+        A[n * N + m] += theta[q] * reduced_A[q][m * N + n];
+    for (int m = 0; m < N; m++)
+      y[m] += theta[q] * reduced_b[q][m];
+  }
+  dense_solve(A, y, N);
+
+  error_bound = residual_dual_norm(&theta[0], y) / parametrization->stability_lower_bound(mu);
+}
+
+template<typename Scalar>
+void ReducedBasis<Scalar>::reconstruct(const std::vector<Scalar>& y, Scalar* coeff_vec) const
+{
+  memset(coeff_vec, 0, ndof * sizeof(Scalar));
+  for (unsigned int n = 0; n < basis.size(); n++)
+    for (int i = 0; i < ndof; i++)
+      coeff_vec[i] += y[n] * basis[n][i];
+}
+
+template<typename Scalar>
+void ReducedBasis<Scalar>::offline_greedy(const std::vector<std::vector<double> >& training_set, int max_size, double tol)
+{
+  if (training_set.empty())
+    throw Hermes::Exceptions::Exception("ReducedBasis: empty training set.");
+
+  unsigned int next = 0;
+  while ((int) basis.size() < max_size)
+  {
+    int N_old = basis.size();
+    add_basis_function(solve_truth(training_set[next]));
+    if ((int) basis.size() == N_old)
+      break;
+
+    // Relative error bound over the training set; the norm of the reduced solution is
+    // its Euclidean norm since the basis is X-orthonormal.
+    double max_bound = 0.0;
+    for (unsigned int s = 0; s < training_set.size(); s++)
+    {
+      std::vector<Scalar> y;
+      double bound;
+      solve_online(training_set[s], y, bound);
+      double norm = 0.0;
+      for (unsigned int n = 0; n < y.size(); n++)
+        norm += std::abs(y[n]) * std::abs(y[n]);
+      norm = std::sqrt(norm);
+      double rel_bound = (norm > 0.0) ? bound / norm : bound;
+      if (rel_bound > max_bound)
+      {
+        max_bound = rel_bound;
+        next = s;
+      }
+    }
+    Hermes::Mixins::Loggable::Static::info("Reduced basis: N = %d, max. relative error bound %g.", (int) basis.size(), max_bound);
+    if (max_bound < tol)
+      break;
+  }
+}
+
+template<typename Scalar>
+void ReducedBasis<Scalar>::dense_solve(std::vector<Scalar>& A, std::vector<Scalar>& b, int n)
+{
+  for (int k = 0; k < n; k++)
+  {
+    int pivot = k;
+    for (int r = k + 1; r < n; r++)
+      if (std::abs(A[k * n + r]) > std::abs(A[k * n + pivot]))
+        pivot = r;
+    if (pivot != k)
+    {
+      for (int c = 0; c < n; c++)
+        std::swap(A[c * n + k], A[c * n + pivot]);
+      std::swap(b[k], b[pivot]);
+    }
+    for (int r = k + 1; r < n; r++)
+    {
+      Scalar factor = A[k * n + r] / A[k * n + k];
+      for (int c = k; c < n; c++)
+        A[c * n + r] -= factor * A[c * n + k];
+      b[r] -= factor * b[k];
+    }
+  }
+  for (int k = n - 1; k >= 0; k--)
+  {
+    for (int c = k + 1; c < n; c++)
+      b[k] -= A[c * n + k] * b[c];
+    b[k] /= A[k * n + k];
+  }
+}
+
+template class ReducedBasis<double>;
+template class ReducedBasis<std::complex<double> >;
@@ -0,0 +1,117 @@
+#ifndef REDUCED_BASIS_H
+#define REDUCED_BASIS_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// Parameter dependence of an affine problem, see ReducedBasis.
+template<typename Scalar>
+class AffineParametrization
+{
+public:
+  virtual ~AffineParametrization() {}
+
+  /// Coefficients theta_q(mu) of the affine terms.
+  virtual void theta(const std::vector<double>& mu, Scalar* theta) const = 0;
+
+  /// Lower bound of the coercivity (or inf-sup) constant of the problem with respect to the inner product
+  /// of the reduced basis. With a true lower bound the error bound of ReducedBasis is rigorous,
+  /// otherwise it is an error indicator.
+  virtual double stability_lower_bound(const std::vector<double>& mu) const { return 1.0; }
+};
+
+/// \brief Reduced-basis method for linear problems with an affine parameter dependence,
+///
+///   sum_q theta_q(mu) A_q Y = sum_q theta_q(mu) b_q.
+///
+/// Every affine term is given by a weak form (Jacobian and residual as for the Newton's method), which is
+/// assembled once at zero, so that nonhomogeneous Dirichlet conditions enter b_q through the lift as usual.
+/// A term may also consist of the residual only (e.g. a source).
+///
+/// Offline, the greedy algorithm solves the full problem for the parameter of the training set with the largest
+/// error bound, adds the solution to the basis (orthonormalized in the inner product X), and precomputes the reduced
+/// matrices Z^H A_q Z, vectors Z^H b_q and the inner products of the Riesz representers X^{-1} A_q z_n and
+/// X^{-1} b_q. Online, for a given parameter only a dense system of the size of the basis is assembled and
+/// solved, and the dual norm of the residual, divided by the stability lower bound, bounds the error in
+/// the X-norm. Neither depends on the number of degrees of freedom.
+template<typename Scalar>
+class ReducedBasis
+{
+public:
+  /// \param[in] affine_wfs        Weak forms of the affine terms.
+  /// \param[in] inner_product_wf  Weak form with a symmetric positive definite matrix form (e.g. the H1 seminorm
+  ///                              for homogeneous Dirichlet conditions), the matrix X.
+  ReducedBasis(Hermes::vector<WeakForm<Scalar>*> affine_wfs, const AffineParametrization<Scalar>* parametrization,
+               WeakForm<Scalar>* inner_product_wf, Hermes::vector<const Space<Scalar>*> spaces);
+  ~ReducedBasis();
+
+  /// Greedy construction of the basis over the training set. Stops when the relative error bound drops
+  /// below 'tol' over the whole training set or the basis has 'max_size' functions.
+  void offline_greedy(const std::vector<std::vector<double> >& training_set, int max_size, double tol);
+
+  /// Solution of the full problem (allocated here, to be deleted by the caller).
+  Scalar* solve_truth(const std::vector<double>& mu);
+
+  /// Reduced solution for the parameter 'mu' and the bound of its error in the X-norm.
+  void solve_online(const std::vector<double>& mu, std::vector<Scalar>& y, double& error_bound) const;
+
+  /// Coefficient vector of the reduced solution 'y' in the full space.
+  void reconstruct(const std::vector<Scalar>& y, Scalar* coeff_vec) const;
+
+  int get_basis_size() const { return basis.size(); }
+  int get_num_dofs() const { return ndof; }
+
+private:
+  // y = A_q x.
+  void multiply(int q, const Scalar* x, Scalar* y) const;
+  // (x, y)_X.
+  Scalar inner_product(const Scalar* x, const Scalar* y) const;
+  // In-place application of X^{-1}.
+  void riesz(Scalar* vec);
+  void add_basis_function(Scalar* coeff_vec);
+  double residual_dual_norm(const Scalar* theta, const std::vector<Scalar>& y) const;
+
+  static void dense_solve(std::vector<Scalar>& A, std::vector<Scalar>& b, int n);
+  static double conjugate(double a) { return a; }
+  static std::complex<double> conjugate(std::complex<double> a) { return std::conj(a); }
+  static double real_part(double a) { return a; }
+  static double real_part(std::complex<double> a) { return a.real(); }
+
+  const AffineParametrization<Scalar>* parametrization;
+  int ndof, num_terms;
+
+  // The matrices of the terms in the union of their sparsity patterns, and the right-hand sides.
+  int nnz;
+  int* Ap;
+  int* Ai;
+  std::vector<Scalar*> term_Ax;
+  std::vector<Scalar*> term_rhs;
+
+  // Inner product and its factorization.
+  SparseMatrix<Scalar>* matrix_X;
+  Vector<Scalar>* rhs_X;
+  LinearMatrixSolver<Scalar>* solver_X;
+
+  // Truth solver.
+  SparseMatrix<Scalar>* matrix_truth;
+  Vector<Scalar>* rhs_truth;
+  LinearMatrixSolver<Scalar>* solver_truth;
+
+  // Orthonormal basis, reduced matrices [q][m * N + n] and vectors [q][n].
+  std::vector<Scalar*> basis;
+  std::vector<std::vector<Scalar> > reduced_A;
+  std::vector<std::vector<Scalar> > reduced_b;
+
+  // Riesz representers X^{-1} b_q and X^{-1} A_q z_n [n * Q + q], and their inner products.
+  std::vector<Scalar*> riesz_b;
+  std::vector<Scalar*> riesz_A;
+  std::vector<Scalar> gram_bb;
+  // [n][q * Q + q'] = (X^{-1} b_q, X^{-1} A_q' z_n)_X.
+  std::vector<std::vector<Scalar> > gram_bA;
+  // [n Q + q][m Q + q'] = (X^{-1} A_q z_n, X^{-1} A_q' z_m)_X.
+  std::vector<std::vector<Scalar> > gram_AA;
+};
+
+#endif
@@ -0,0 +1,368 @@
+#include "shifted_laplacian.h"
+
+template<typename Scalar>
+ShiftedLaplacianSolver<Scalar>::ShiftedLaplacianSolver(SparseMatrix<Scalar>* matrix, SparseMatrix<Scalar>* precond_matrix,
+                                                       Method method)
+  : op(NULL), method(method), tol(1e-8), max_iters(1000), restart(50), num_iters(0), residual(0.0)
+{
+  this->matrix = dynamic_cast<CSCMatrix<Scalar>*>(matrix);
+  CSCMatrix<Scalar>* precond = dynamic_cast<CSCMatrix<Scalar>*>(precond_matrix);
+  if (this->matrix == NULL || precond == NULL)
+    throw Hermes::Exceptions::Exception("ShiftedLaplacianSolver needs CSC matrices (e.g. SOLVER_UMFPACK).");
+  size = this->matrix->get_size();
+  if ((int) precond->get_size() != size)
+    throw Hermes::Exceptions::Exception("ShiftedLaplacianSolver: the matrix and the preconditioner differ in size.");
+
+  factorize_ilu(precond);
+}
+
+template<typename Scalar>
+ShiftedLaplacianSolver<Scalar>::ShiftedLaplacianSolver(const MatrixFreeOperator<Scalar>* op, SparseMatrix<Scalar>* precond_matrix,
+                                                       Method method)
+  : matrix(NULL), op(op), method(method), tol(1e-8), max_iters(1000), restart(50), num_iters(0), residual(0.0)
+{
+  CSCMatrix<Scalar>* precond = dynamic_cast<CSCMatrix<Scalar>*>(precond_matrix);
+  if (precond == NULL)
+    throw Hermes::Exceptions::Exception("ShiftedLaplacianSolver needs CSC matrices (e.g. SOLVER_UMFPACK).");
+  size = op->get_size();
+  if ((int) precond->get_size() != size)
+    throw Hermes::Exceptions::Exception("ShiftedLaplacianSolver: the matrix and the preconditioner differ in size.");
+
+  factorize_ilu(precond);
+}
+
+template<typename Scalar>
+ShiftedLaplacianSolver<Scalar>::~ShiftedLaplacianSolver()
+{
+  delete [] ilu_row_ptr;
+  delete [] ilu_col;
+  delete [] ilu_diag;
+  delete [] ilu_val;
+}
+
+template<typename Scalar>
+void ShiftedLaplacianSolver<Scalar>::factorize_ilu(CSCMatrix<Scalar>* precond)
+{
+  int* Ap = precond->get_Ap();
+  int* Ai = precond->get_Ai();
+  Scalar* Ax = precond->get_Ax();
+  int nnz = Ap[size];
+
+  // Transpose the CSC storage into CSR; the column indices of every row come out sorted.
+  ilu_row_ptr = new int[size + 1];
+  ilu_col = new int[nnz];
+  ilu_val = new Scalar[nnz];
+  ilu_diag = new int[size];
+  memset(ilu_row_ptr, 0, (size + 1) * sizeof(int));
+  for (int k = 0; k < nnz; k++)
+    ilu_row_ptr[Ai[k] + 1]++;
+  for (int r = 0; r < size; r++)
+    ilu_row_ptr[r + 1] += ilu_row_ptr[r];
+  int* next = new int[size];
+  memcpy(next, ilu_row_ptr, size * sizeof(int));
+  for (int c = 0; c < size; c++)
+    for (int k = Ap[c]; k < Ap[c + 1]; k++)
+    {
+      int pos = next[Ai[k]]++;
+      ilu_col[pos] = c;
+      ilu_val[pos] = Ax[k];
+    }
+  delete [] next;
+
+  for (int r = 0; r < size; r++)
+  {
+    ilu_diag[r] = -1;
+    for (int k = ilu_row_ptr[r]; k < ilu_row_ptr[r + 1]; k++)
+      if (ilu_col[k] == r)
+        ilu_diag[r] = k;
+    if (ilu_diag[r] == -1)
+      throw Hermes::Exceptions::Exception("ShiftedLaplacianSolver: missing diagonal entry in the preconditioner.");
+  }
+
+  // ILU(0), IKJ variant restricted to the pattern of the matrix.
+  int* position = new int[size];
+  for (int c = 0; c < size; c++)
+    position[c] = -1;
+  for (int r = 0; r < size; r++)
+  {
+    for (int k = ilu_row_ptr[r]; k < ilu_row_ptr[r + 1]; k++)
+      position[ilu_col[k]] = k;
+    for (int k = ilu_row_ptr[r]; k < ilu_diag[r]; k++)
+    {
+      int c = ilu_col[k];
+      if (ilu_val[ilu_diag[c]] == Scalar(0))
+        throw Hermes::Exceptions::Exception("ShiftedLaplacianSolver: zero pivot in the incomplete factorization.");
+      ilu_val[k] /= ilu_val[ilu_diag[c]];
+      for (int kk = ilu_diag[c] + 1; kk < ilu_row_ptr[c + 1]; kk++)
+        if (position[ilu_col[kk]] != -1)
+          ilu_val[position[ilu_col[kk]]] -= ilu_val[k] * ilu_val[kk];
+    }
+    for (int k = ilu_row_ptr[r]; k < ilu_row_ptr[r + 1]; k++)
+      position[ilu_col[k]] = -1;
+  }
+  delete [] position;
+}
+
+template<typename Scalar>
+void ShiftedLaplacianSolver<Scalar>::apply_preconditioner(const Scalar* in, Scalar* out) const
+{
+  for (int r = 0; r < size; r++)
+  {
+    Scalar val = in[r];
+    for (int k = ilu_row_ptr[r]; k < ilu_diag[r]; k++)
+      val -= ilu_val[k] * out[ilu_col[k]];
+    out[r] = val;
+  }
+  for (int r = size - 1; r >= 0; r--)
+  {
+    Scalar val = out[r];
+    for (int k = ilu_diag[r] + 1; k < ilu_row_ptr[r + 1]; k++)
+      val -= ilu_val[k] * out[ilu_col[k]];
+    out[r] = val / ilu_val[ilu_diag[r]];
+  }
+}
+
+template<typename Scalar>
+void ShiftedLaplacianSolver<Scalar>::multiply(const Scalar* x, Scalar* y) const
+{
+  if (op != NULL)
+  {
+    op->multiply(x, y);
+    return;
+  }
+  int* Ap = matrix->get_Ap();
+  int* Ai = matrix->get_Ai();
+  Scalar* Ax = matrix->get_Ax();
+  memset(y, 0, size * sizeof(Scalar));
+  for (int c = 0; c < size; c++)
+    for (int k = Ap[c]; k < Ap[c + 1]; k++)
+      y[Ai[k]] += Ax[k] * x[c];
+}
+
+template<typename Scalar>
+Scalar ShiftedLaplacianSolver<Scalar>::dot(const Scalar* x, const Scalar* y) const
+{
+  Scalar result = Scalar(0);
+  for (int i = 0; i < size; i++)
+    result += conjugate(x[i]) * y[i];
+  return result;
+}
+
+template<typename Scalar>
+double ShiftedLaplacianSolver<Scalar>::norm(const Scalar* x) const
+{
+  double result = 0.0;
+  for (int i = 0; i < size; i++)
+    result += std::abs(x[i]) * std::abs(x[i]);
+  return std::sqrt(result);
+}
+
+template<typename Scalar>
+bool ShiftedLaplacianSolver<Scalar>::solve(Vector<Scalar>* rhs, Scalar* sln)
+{
+  Scalar* b = new Scalar[size];
+  for (int i = 0; i < size; i++)
+    b[i] = rhs->get(i);
+
+  bool converged = (method == GMRES) ? solve_gmres(b, sln) : solve_bicgstab(b, sln);
+  delete [] b;
+
+  Hermes::Mixins::Loggable::Static::info("%s: %d iterations, relative residual %g.",
+    method == GMRES ? "GMRES" : "BiCGStab", num_iters, residual);
+  return converged;
+}
+
+template<typename Scalar>
+bool ShiftedLaplacianSolver<Scalar>::solve_gmres(const Scalar* b, Scalar* x)
+{
+  int m = restart;
+  double norm_b = norm(b);
+  if (norm_b == 0.0)
+    norm_b = 1.0;
+
+  std::vector<Scalar*> V(m + 1);
+  for (int j = 0; j <= m; j++)
+    V[j] = new Scalar[size];
+  Scalar* w = new Scalar[size];
+  Scalar* z = new Scalar[size];
+  std::vector<Scalar> H((m + 1) * m), g(m + 1), s(m);
+  std::vector<double> c(m);
+
+  num_iters = 0;
+  bool converged = false;
+  while (!converged && num_iters < max_iters)
+  {
+    // r = b - A x.
+    multiply(x, V[0]);
+    for (int i = 0; i < size; i++)
+      V[0][i] = b[i] - V[0][i];
+    double beta = norm(V[0]);
+    residual = beta / norm_b;
+    if (residual <= tol)
+    {
+      converged = true;
+      break;
+    }
+    for (int i = 0; i < size; i++)
+      V[0][i] /= beta;
+    std::fill(g.begin(), g.end(), Scalar(0));
+    g[0] = beta;
+
+    // Arnoldi process for A P^{-1} with the Givens rotations.
+    int j = 0;
+    for (; j < m && num_iters < max_iters; j++)
+    {
+      num_iters++;
+      apply_preconditioner(V[j], z);
+      multiply(z, w);
+      for (int q = 0; q <= j; q++)
+      {
+        H[j * (m + 1) + q] = dot(V[q], w);
+        for (int i = 0; i < size; i++)
+          w[i] -= H[j * (m + 1) + q] * V[q][i];
+      }
+      double h_next = norm(w);
+      H[j * (m + 1) + j + 1] = h_next;
+      if (h_next != 0.0)
+        for (int i = 0; i < size; i++)
+          V[j + 1][i] = w[i] / h_next;
+
+      for (int q = 0; q < j; q++)
+      {
+        Scalar h_q = H[j * (m + 1) + q], h_q1 = H[j * (m + 1) + q + 1];
+        H[j * (m + 1) + q] = c[q] * h_q + s[q] * h_q1;
+        H[j * (m + 1) + q + 1] = -conjugate(s[q]) * h_q + c[q] * h_q1;
+      }
+      Scalar a = H[j * (m + 1) + j], bb = H[j * (m + 1) + j + 1];
+      double abs_a = std::abs(a), r = std::sqrt(abs_a * abs_a + std::abs(bb) * std::abs(bb));
+      if (abs_a == 0.0)
+      {
+        c[j] = 0.0;
+        s[j] = Scalar(1);
+      }
+      else
+      {
+        c[j] = abs_a / r;
+        s[j] = (a / abs_a) * conjugate(bb) / r;
+      }
+      H[j * (m + 1) + j] = c[j] * a + s[j] * bb;
+      H[j * (m + 1) + j + 1] = Scalar(0);
+      g[j + 1] = -conjugate(s[j]) * g[j];
+      g[j] = c[j] * g[j];
+
+      residual = std::abs(g[j + 1]) / norm_b;
+      if (residual <= tol || h_next == 0.0)
+      {
+        j++;
+        converged = residual <= tol;
+        break;
+      }
+    }
+
+    // x += P^{-1} V y, where H y = g.
+    std::vector<Scalar> y(j);
+    for (int q = j - 1; q >= 0; q--)
+    {
+      y[q] = g[q];
+      for (int k = q + 1; k < j; k++)
+        y[q] -= H[k * (m + 1) + q] * y[k];
+      y[q] /= H[q * (m + 1) + q];
+    }
+    memset(w, 0, size * sizeof(Scalar));
+    for (int q = 0; q < j; q++)
+      for (int i = 0; i < size; i++)
+        w[i] += y[q] * V[q][i];
+    apply_preconditioner(w, z);
+    for (int i = 0; i < size; i++)
+      x[i] += z[i];
+  }
+
+  for (int j = 0; j <= m; j++)
+    delete [] V[j];
+  delete [] w;
+  delete [] z;
+  return converged;
+}
+
+template<typename Scalar>
+bool ShiftedLaplacianSolver<Scalar>::solve_bicgstab(const Scalar* b, Scalar* x)
+{
+  double norm_b = norm(b);
+  if (norm_b == 0.0)
+    norm_b = 1.0;
+
+  Scalar* r = new Scalar[size];
+  Scalar* r_hat = new Scalar[size];
+  Scalar* p = new Scalar[size];
+  Scalar* v = new Scalar[size];
+  Scalar* p_hat = new Scalar[size];
+  Scalar* t = new Scalar[size];
+
+  multiply(x, r);
+  for (int i = 0; i < size; i++)
+  {
+    r[i] = b[i] - r[i];
+    r_hat[i] = r[i];
+    p[i] = v[i] = Scalar(0);
+  }
+  Scalar rho = Scalar(1), alpha = Scalar(1), omega = Scalar(1);
+
+  num_iters = 0;
+  residual = norm(r) / norm_b;
+  bool converged = residual <= tol;
+  while (!converged && num_iters < max_iters)
+  {
+    num_iters++;
+    Scalar rho_new = dot(r_hat, r);
+    if (rho_new == Scalar(0))
+      break;
+    Scalar beta = (rho_new / rho) * (alpha / omega);
+    rho = rho_new;
+    for (int i = 0; i < size; i++)
+      p[i] = r[i] + beta * (p[i] - omega * v[i]);
+    apply_preconditioner(p, p_hat);
+    multiply(p_hat, v);
+    alpha = rho / dot(r_hat, v);
+
+    // s = r - alpha v is stored in r.
+    for (int i = 0; i < size; i++)
+    {
+      x[i] += alpha * p_hat[i];
+      r[i] -= alpha * v[i];
+    }
+    residual = norm(r) / norm_b;
+    if (residual <= tol)
+    {
+      converged = true;
+      break;
+    }
+
+    // p_hat is reused for P^{-1} s.
+    apply_preconditioner(r, p_hat);
+    multiply(p_hat, t);
+    Scalar tt = dot(t, t);
+    if (tt == Scalar(0))
+      break;
+    omega = dot(t, r) / tt;
+    for (int i = 0; i < size; i++)
+    {
+      x[i] += omega * p_hat[i];
+      r[i] -= omega * t[i];
+    }
+    residual = norm(r) / norm_b;
+    converged = residual <= tol;
+    if (omega == Scalar(0))
+      break;
+  }
+
+  delete [] r;
+  delete [] r_hat;
+  delete [] p;
+  delete [] v;
+  delete [] p_hat;
+  delete [] t;
+  return converged;
+}
+
+template class ShiftedLaplacianSolver<double>;
+template class ShiftedLaplacianSolver<std::complex<double> >;
@@ -0,0 +1,97 @@
+#ifndef SHIFTED_LAPLACIAN_H
+#define SHIFTED_LAPLACIAN_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// Matrix of a linear system applied without storing it (e.g. SumFactorizedOperator).
+template<typename Scalar>
+class MatrixFreeOperator
+{
+public:
+  virtual ~MatrixFreeOperator() {}
+
+  virtual int get_size() const = 0;
+
+  /// y = A x.
+  virtual void multiply(const Scalar* x, Scalar* y) const = 0;
+};
+
+/// \brief Krylov solver for indefinite Helmholtz-type systems with a complex shifted Laplacian preconditioner.
+///
+/// The system matrix A = K - k^2 M is solved by the right-preconditioned restarted GMRES or BiCGStab.
+/// The preconditioner is the same operator with the complex shifted wave number,
+///
+///   P = K - (beta_1 +- i beta_2) k^2 M,
+///
+/// which is assembled by the caller from the weak form of the problem with the shifted coefficients.
+/// The imaginary shift acts as an artificial damping and takes the sign of the physical damping
+/// of the formulation; in real-split formulations it becomes the coupling of the real and imaginary
+/// equations. P is approximately inverted by its incomplete LU factorization
+/// with no fill-in, ILU(0), so that the memory is linear in the size of the problem: the two matrices,
+/// one copy of the pattern of P, and restart + 2 Krylov vectors for GMRES (6 vectors for BiCGStab).
+///
+/// Both matrices have to be CSC (e.g. created with SOLVER_UMFPACK), they are only read.
+/// The system matrix may also be given as a MatrixFreeOperator, only the preconditioner is then stored.
+template<typename Scalar>
+class ShiftedLaplacianSolver
+{
+public:
+  enum Method
+  {
+    GMRES,
+    BICGSTAB
+  };
+
+  ShiftedLaplacianSolver(SparseMatrix<Scalar>* matrix, SparseMatrix<Scalar>* precond_matrix, Method method = GMRES);
+  ShiftedLaplacianSolver(const MatrixFreeOperator<Scalar>* op, SparseMatrix<Scalar>* precond_matrix, Method method = GMRES);
+  ~ShiftedLaplacianSolver();
+
+  /// Relative tolerance of the residual, maximum number of iterations and the restart of GMRES.
+  void set_tolerance(double tol) { this->tol = tol; }
+  void set_max_iters(int max_iters) { this->max_iters = max_iters; }
+  void set_restart(int restart) { this->restart = restart; }
+
+  /// Solves A x = rhs, 'sln' holds the initial guess on input (e.g. the solution on the previous
+  /// mesh projected onto the current space, or zero). Returns false if the tolerance was not reached.
+  bool solve(Vector<Scalar>* rhs, Scalar* sln);
+
+  int get_num_iters() const { return num_iters; }
+  double get_residual() const { return residual; }
+
+private:
+  // Incomplete factorization of the preconditioner in the CSR format (L has a unit diagonal).
+  void factorize_ilu(CSCMatrix<Scalar>* precond);
+  void apply_preconditioner(const Scalar* in, Scalar* out) const;
+
+  // y = A x.
+  void multiply(const Scalar* x, Scalar* y) const;
+
+  bool solve_gmres(const Scalar* b, Scalar* x);
+  bool solve_bicgstab(const Scalar* b, Scalar* x);
+
+  Scalar dot(const Scalar* x, const Scalar* y) const;
+  double norm(const Scalar* x) const;
+
+  static double conjugate(double a) { return a; }
+  static std::complex<double> conjugate(std::complex<double> a) { return std::conj(a); }
+
+  CSCMatrix<Scalar>* matrix;
+  const MatrixFreeOperator<Scalar>* op;
+  Method method;
+  int size;
+  double tol;
+  int max_iters, restart;
+
+  int* ilu_row_ptr;
+  int* ilu_col;
+  int* ilu_diag;
+  Scalar* ilu_val;
+
+  int num_iters;
+  double residual;
+};
+
+#endif
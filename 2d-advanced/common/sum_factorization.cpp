@@ -0,0 +1,603 @@
+#include "sum_factorization.h"
+
+// Number of the sample points for the comparison of the 1D factors (more than the maximum polynomial degree).
+static const int NUM_SAMPLES = 12;
+// Relative tolerance of the comparison.
+static const double FACTOR_TOL = 1e-10;
+
+template<typename Scalar>
+SumFactorizedOperator<Scalar>::SumFactorizedOperator(Hermes::vector<const Space<Scalar>*> spaces, const std::string& area)
+  : spaces(spaces), neq(spaces.size()), ndof(0), remainder(NULL)
+{
+  for (int i = 0; i < neq; i++)
+  {
+    if (spaces[i]->get_mesh() != spaces[0]->get_mesh())
+      throw Hermes::Exceptions::Exception("SumFactorizedOperator: the spaces have to be on the same mesh.");
+    first_dofs.push_back(ndof);
+    ndof += spaces[i]->get_num_dofs();
+  }
+
+  Coefficients zero;
+  zero.active = false;
+  zero.diffusion = zero.mass = zero.convection_x = zero.convection_y = Scalar(0);
+  blocks.resize(neq * neq, zero);
+
+  std::vector<double> sample_weights(NUM_SAMPLES);
+  sample_points.resize(NUM_SAMPLES);
+  gauss_legendre(NUM_SAMPLES, &sample_points[0], &sample_weights[0]);
+
+  const Mesh* mesh = spaces[0]->get_mesh();
+  int marker = -1;
+  if (area != HERMES_ANY)
+  {
+    Mesh::MarkersConversion::IntValid internal = mesh->get_element_markers_conversion().get_internal_marker(area);
+    if (!internal.valid)
+      throw Hermes::Exceptions::Exception("SumFactorizedOperator: unknown material %s.", area.c_str());
+    marker = internal.marker;
+  }
+
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    if (area != HERMES_ANY && e->elem_marker != marker)
+      continue;
+    if (!e->is_quad() || e->is_curved())
+      throw Hermes::Exceptions::Exception("SumFactorizedOperator: element %d is not a straight-edged quadrilateral.", e->id);
+    elements.push_back(ElementData());
+    prepare_element(e, elements.back());
+  }
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::set_block(int i, int j, Scalar diffusion, Scalar mass, Scalar convection_x, Scalar convection_y)
+{
+  if (i < 0 || i >= neq || j < 0 || j >= neq)
+    throw Hermes::Exceptions::Exception("SumFactorizedOperator: block (%d, %d) out of range.", i, j);
+  Coefficients& c = blocks[i * neq + j];
+  c.diffusion = diffusion;
+  c.mass = mass;
+  c.convection_x = convection_x;
+  c.convection_y = convection_y;
+  c.active = (diffusion != Scalar(0) || mass != Scalar(0) || convection_x != Scalar(0) || convection_y != Scalar(0));
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::set_remainder(SparseMatrix<Scalar>* remainder)
+{
+  this->remainder = dynamic_cast<CSCMatrix<Scalar>*>(remainder);
+  if (remainder != NULL && this->remainder == NULL)
+    throw Hermes::Exceptions::Exception("SumFactorizedOperator needs a CSC remainder matrix (e.g. SOLVER_UMFPACK).");
+  if (this->remainder != NULL && (int) this->remainder->get_size() != ndof)
+    throw Hermes::Exceptions::Exception("SumFactorizedOperator: the remainder matrix differs in size.");
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::gauss_legendre(int n, double* points, double* weights)
+{
+  for (int i = 0; i < (n + 1) / 2; i++)
+  {
+    // Newton's method for the i-th root of P_n from the asymptotic guess.
+    double x = std::cos(M_PI * (i + 0.75) / (n + 0.5));
+    double dp = 1.0;
+    for (int it = 0; it < 100; it++)
+    {
+      double p0 = 1.0, p1 = x;
+      for (int k = 2; k <= n; k++)
+      {
+        double p2 = ((2 * k - 1) * x * p1 - (k - 1) * p0) / k;
+        p0 = p1;
+        p1 = p2;
+      }
+      dp = n * (x * p1 - p0) / (x * x - 1.0);
+      double dx = p1 / dp;
+      x -= dx;
+      if (std::abs(dx) < 1e-15)
+        break;
+    }
+    points[i] = -x;
+    points[n - 1 - i] = x;
+    weights[i] = weights[n - 1 - i] = 2.0 / ((1.0 - x * x) * dp * dp);
+  }
+}
+
+template<typename Scalar>
+double SumFactorizedOperator<Scalar>::factor_value(const Factor& factor, double t, bool derivative) const
+{
+  double x = factor.y_factor ? factor.fixed : t;
+  double y = factor.y_factor ? t : factor.fixed;
+  double value;
+  if (!derivative)
+    value = factor.shapeset->get_fn_value(factor.index, x, y, 0, HERMES_MODE_QUAD);
+  else if (factor.y_factor)
+    value = factor.shapeset->get_dy_value(factor.index, x, y, 0, HERMES_MODE_QUAD);
+  else
+    value = factor.shapeset->get_dx_value(factor.index, x, y, 0, HERMES_MODE_QUAD);
+  return value / factor.scale;
+}
+
+template<typename Scalar>
+int SumFactorizedOperator<Scalar>::find_factor(const Factor& factor, double& ratio)
+{
+  std::vector<double> sample(NUM_SAMPLES);
+  double norm = 0.0;
+  for (int q = 0; q < NUM_SAMPLES; q++)
+  {
+    sample[q] = factor_value(factor, sample_points[q], false);
+    norm = std::max(norm, std::abs(sample[q]));
+  }
+
+  // The factors of different shape functions (e.g. of the two orientations of an edge function)
+  // may be multiples of each other.
+  for (unsigned int k = 0; k < samples.size(); k++)
+  {
+    double dot = 0.0, norm_k = 0.0;
+    for (int q = 0; q < NUM_SAMPLES; q++)
+    {
+      dot += sample[q] * samples[k][q];
+      norm_k += samples[k][q] * samples[k][q];
+    }
+    double c = dot / norm_k;
+    double diff = 0.0;
+    for (int q = 0; q < NUM_SAMPLES; q++)
+      diff = std::max(diff, std::abs(sample[q] - c * samples[k][q]));
+    if (diff <= FACTOR_TOL * norm)
+    {
+      ratio = c;
+      return k;
+    }
+  }
+
+  factors.push_back(factor);
+  samples.push_back(sample);
+  ratio = 1.0;
+  return factors.size() - 1;
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::decompose(Shapeset* shapeset, int index, int& x_factor, int& y_factor, double& scale)
+{
+  std::pair<Shapeset*, int> key(shapeset, index);
+  typename std::map<std::pair<Shapeset*, int>, std::pair<std::pair<int, int>, double> >::const_iterator it = decompositions.find(key);
+  if (it != decompositions.end())
+  {
+    x_factor = it->second.first.first;
+    y_factor = it->second.first.second;
+    scale = it->second.second;
+    return;
+  }
+
+  // phi(xi, eta) = phi(xi, eta*) phi(xi*, eta) / phi(xi*, eta*) for a product, (xi*, eta*) being the sample
+  // point with the largest value.
+  std::vector<double> phi(NUM_SAMPLES * NUM_SAMPLES);
+  int q_max = 0, r_max = 0;
+  for (int q = 0; q < NUM_SAMPLES; q++)
+    for (int r = 0; r < NUM_SAMPLES; r++)
+    {
+      phi[q * NUM_SAMPLES + r] = shapeset->get_fn_value(index, sample_points[q], sample_points[r], 0, HERMES_MODE_QUAD);
+      if (std::abs(phi[q * NUM_SAMPLES + r]) > std::abs(phi[q_max * NUM_SAMPLES + r_max]))
+      {
+        q_max = q;
+        r_max = r;
+      }
+    }
+  double phi_max = phi[q_max * NUM_SAMPLES + r_max];
+  if (phi_max == 0.0)
+    throw Hermes::Exceptions::Exception("SumFactorizedOperator: the shape function %d vanishes.", index);
+
+  for (int q = 0; q < NUM_SAMPLES; q++)
+    for (int r = 0; r < NUM_SAMPLES; r++)
+      if (std::abs(phi[q * NUM_SAMPLES + r] - phi[q * NUM_SAMPLES + r_max] * phi[q_max * NUM_SAMPLES + r] / phi_max)
+          > FACTOR_TOL * std::abs(phi_max))
+        throw Hermes::Exceptions::Exception("SumFactorizedOperator: the shape function %d is not a tensor product.", index);
+
+  Factor f_x = { shapeset, index, false, sample_points[r_max], 1.0 };
+  Factor f_y = { shapeset, index, true, sample_points[q_max], phi_max };
+  double ratio_x, ratio_y;
+  x_factor = find_factor(f_x, ratio_x);
+  y_factor = find_factor(f_y, ratio_y);
+  scale = ratio_x * ratio_y;
+  decompositions[key] = std::make_pair(std::make_pair(x_factor, y_factor), scale);
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::tabulate(int n)
+{
+  if ((int) tables.size() <= n)
+  {
+    tables.resize(n + 1);
+    gauss_points.resize(n + 1);
+    gauss_weights.resize(n + 1);
+  }
+  if (gauss_points[n].empty())
+  {
+    gauss_points[n].resize(n);
+    gauss_weights[n].resize(n);
+    gauss_legendre(n, &gauss_points[n][0], &gauss_weights[n][0]);
+  }
+  for (unsigned int k = tables[n].size() / 2; k < factors.size(); k++)
+  {
+    std::vector<double> val(n), der(n);
+    for (int q = 0; q < n; q++)
+    {
+      val[q] = factor_value(factors[k], gauss_points[n][q], false);
+      der[q] = factor_value(factors[k], gauss_points[n][q], true);
+    }
+    tables[n].push_back(val);
+    tables[n].push_back(der);
+  }
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::prepare_element(Element* e, ElementData& data)
+{
+  int p = 1;
+  data.spaces.resize(neq);
+  for (int i = 0; i < neq; i++)
+  {
+    AsmList<Scalar> al;
+    spaces[i]->get_element_assembly_list(e, &al);
+    Shapeset* shapeset = spaces[i]->get_shapeset();
+    ElementSpace& es = data.spaces[i];
+    for (unsigned int k = 0; k < al.get_cnt(); k++)
+    {
+      // The Dirichlet lift is in the right-hand side.
+      if (al.get_dof()[k] < 0)
+        continue;
+      int order = shapeset->get_order(al.get_idx()[k], HERMES_MODE_QUAD);
+      p = std::max(p, std::max(H2D_GET_H_ORDER(order), H2D_GET_V_ORDER(order)));
+
+      int x_factor, y_factor;
+      double scale;
+      decompose(shapeset, al.get_idx()[k], x_factor, y_factor, scale);
+      Shape shape;
+      shape.a = std::find(es.x_factors.begin(), es.x_factors.end(), x_factor) - es.x_factors.begin();
+      if (shape.a == (int) es.x_factors.size())
+        es.x_factors.push_back(x_factor);
+      shape.b = std::find(es.y_factors.begin(), es.y_factors.end(), y_factor) - es.y_factors.begin();
+      if (shape.b == (int) es.y_factors.size())
+        es.y_factors.push_back(y_factor);
+      shape.dof = al.get_dof()[k];
+      shape.coef = scale * al.get_coef()[k];
+      es.shapes.push_back(shape);
+    }
+  }
+
+  // Bilinear map of the reference square, exact Gauss rule for the mass matrix of a parallelogram
+  // and one more point otherwise.
+  double X[4], Y[4];
+  for (int k = 0; k < 4; k++)
+  {
+    X[k] = e->vn[k]->x;
+    Y[k] = e->vn[k]->y;
+  }
+  double skew = std::abs(X[0] - X[1] + X[2] - X[3]) + std::abs(Y[0] - Y[1] + Y[2] - Y[3]);
+  bool parallelogram = skew <= 1e-12 * e->get_diameter();
+  int n = parallelogram ? p + 1 : p + 2;
+  data.n = n;
+  tabulate(n);
+
+  data.metric.resize(METRIC_SIZE * n * n);
+  for (int q = 0; q < n; q++)
+    for (int r = 0; r < n; r++)
+    {
+      double xi = gauss_points[n][q], eta = gauss_points[n][r];
+      double x_xi = ((X[1] - X[0]) * (1 - eta) + (X[2] - X[3]) * (1 + eta)) / 4;
+      double y_xi = ((Y[1] - Y[0]) * (1 - eta) + (Y[2] - Y[3]) * (1 + eta)) / 4;
+      double x_eta = ((X[3] - X[0]) * (1 - xi) + (X[2] - X[1]) * (1 + xi)) / 4;
+      double y_eta = ((Y[3] - Y[0]) * (1 - xi) + (Y[2] - Y[1]) * (1 + xi)) / 4;
+      double det = x_xi * y_eta - x_eta * y_xi;
+      // Rows of J^{-1}.
+      double r1x = y_eta / det, r1y = -x_eta / det;
+      double r2x = -y_xi / det, r2y = x_xi / det;
+      double w = gauss_weights[n][q] * gauss_weights[n][r] * std::abs(det);
+
+      double* m = &data.metric[METRIC_SIZE * (q * n + r)];
+      m[0] = w * (r1x * r1x + r1y * r1y);
+      m[1] = w * (r1x * r2x + r1y * r2y);
+      m[2] = w * (r2x * r2x + r2y * r2y);
+      m[3] = w;
+      m[4] = w * r1x;
+      m[5] = w * r1y;
+      m[6] = w * r2x;
+      m[7] = w * r2y;
+    }
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::interpolate(const ElementData& data, int j, const Scalar* x,
+                                                Scalar* val, Scalar* dxi, Scalar* deta) const
+{
+  const ElementSpace& es = data.spaces[j];
+  int n = data.n;
+  int nx = es.x_factors.size(), ny = es.y_factors.size();
+
+  // Coefficients of the products of the 1D factors.
+  std::vector<Scalar> U(nx * ny, Scalar(0));
+  for (unsigned int k = 0; k < es.shapes.size(); k++)
+    U[es.shapes[k].a * ny + es.shapes[k].b] += es.shapes[k].coef * x[first_dofs[j] + es.shapes[k].dof];
+
+  // Contraction in eta, then in xi.
+  std::vector<Scalar> T(nx * n, Scalar(0)), T_eta(nx * n, Scalar(0));
+  for (int b = 0; b < ny; b++)
+  {
+    const double* g = values(n, es.y_factors[b]);
+    const double* dg = derivatives(n, es.y_factors[b]);
+    for (int a = 0; a < nx; a++)
+    {
+      Scalar u = U[a * ny + b];
+      if (u == Scalar(0)) continue;
+      for (int r = 0; r < n; r++)
+      {
+        T[a * n + r] += u * g[r];
+        T_eta[a * n + r] += u * dg[r];
+      }
+    }
+  }
+
+  memset(val, 0, n * n * sizeof(Scalar));
+  memset(dxi, 0, n * n * sizeof(Scalar));
+  memset(deta, 0, n * n * sizeof(Scalar));
+  for (int a = 0; a < nx; a++)
+  {
+    const double* f = values(n, es.x_factors[a]);
+    const double* df = derivatives(n, es.x_factors[a]);
+    for (int q = 0; q < n; q++)
+      for (int r = 0; r < n; r++)
+      {
+        val[q * n + r] += f[q] * T[a * n + r];
+        dxi[q * n + r] += df[q] * T[a * n + r];
+        deta[q * n + r] += f[q] * T_eta[a * n + r];
+      }
+  }
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::integrate(const ElementData& data, int i, const Scalar* f_xi, const Scalar* f_eta,
+                                              const Scalar* f_0, Scalar* y) const
+{
+  const ElementSpace& es = data.spaces[i];
+  int n = data.n;
+  int nx = es.x_factors.size(), ny = es.y_factors.size();
+
+  // Contraction in eta (P goes with the derivative in xi, Q with the value), then in xi.
+  std::vector<Scalar> P(n * ny, Scalar(0)), Q(n * ny, Scalar(0));
+  for (int b = 0; b < ny; b++)
+  {
+    const double* g = values(n, es.y_factors[b]);
+    const double* dg = derivatives(n, es.y_factors[b]);
+    for (int q = 0; q < n; q++)
+    {
+      Scalar p = Scalar(0), s = Scalar(0);
+      for (int r = 0; r < n; r++)
+      {
+        p += f_xi[q * n + r] * g[r];
+        s += f_eta[q * n + r] * dg[r] + f_0[q * n + r] * g[r];
+      }
+      P[q * ny + b] = p;
+      Q[q * ny + b] = s;
+    }
+  }
+
+  std::vector<Scalar> R(nx * ny, Scalar(0));
+  for (int a = 0; a < nx; a++)
+  {
+    const double* f = values(n, es.x_factors[a]);
+    const double* df = derivatives(n, es.x_factors[a]);
+    for (int q = 0; q < n; q++)
+      for (int b = 0; b < ny; b++)
+        R[a * ny + b] += df[q] * P[q * ny + b] + f[q] * Q[q * ny + b];
+  }
+
+  for (unsigned int k = 0; k < es.shapes.size(); k++)
+    y[first_dofs[i] + es.shapes[k].dof] += es.shapes[k].coef * R[es.shapes[k].a * ny + es.shapes[k].b];
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::multiply(const Scalar* x, Scalar* y) const
+{
+  memset(y, 0, ndof * sizeof(Scalar));
+
+  std::vector<std::vector<Scalar> > val(neq), dxi(neq), deta(neq);
+  std::vector<Scalar> f_xi, f_eta, f_0;
+  for (unsigned int el = 0; el < elements.size(); el++)
+  {
+    const ElementData& data = elements[el];
+    int np = data.n * data.n;
+
+    for (int j = 0; j < neq; j++)
+    {
+      bool needed = false;
+      for (int i = 0; i < neq; i++)
+        needed = needed || blocks[i * neq + j].active;
+      if (!needed) continue;
+      val[j].resize(np);
+      dxi[j].resize(np);
+      deta[j].resize(np);
+      interpolate(data, j, x, &val[j][0], &dxi[j][0], &deta[j][0]);
+    }
+
+    for (int i = 0; i < neq; i++)
+    {
+      f_xi.assign(np, Scalar(0));
+      f_eta.assign(np, Scalar(0));
+      f_0.assign(np, Scalar(0));
+      bool any = false;
+      for (int j = 0; j < neq; j++)
+      {
+        const Coefficients& c = blocks[i * neq + j];
+        if (!c.active) continue;
+        any = true;
+        for (int k = 0; k < np; k++)
+        {
+          const double* m = &data.metric[METRIC_SIZE * k];
+          f_xi[k] += c.diffusion * (m[0] * dxi[j][k] + m[1] * deta[j][k]);
+          f_eta[k] += c.diffusion * (m[1] * dxi[j][k] + m[2] * deta[j][k]);
+          f_0[k] += c.mass * m[3] * val[j][k]
+                    + (c.convection_x * m[4] + c.convection_y * m[5]) * dxi[j][k]
+                    + (c.convection_x * m[6] + c.convection_y * m[7]) * deta[j][k];
+        }
+      }
+      if (any)
+        integrate(data, i, &f_xi[0], &f_eta[0], &f_0[0], y);
+    }
+  }
+
+  if (remainder != NULL)
+  {
+    int* Ap = remainder->get_Ap();
+    int* Ai = remainder->get_Ai();
+    Scalar* Ax = remainder->get_Ax();
+    for (int c = 0; c < ndof; c++)
+      for (int k = Ap[c]; k < Ap[c + 1]; k++)
+        y[Ai[k]] += Ax[k] * x[c];
+  }
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::add_term(const ElementData& data, const ElementSpace& test, const ElementSpace& trial,
+                                             const Scalar* weights, bool test_dxi, bool test_deta, bool trial_dxi,
+                                             bool trial_deta, Scalar* K) const
+{
+  int n = data.n;
+  int nx_test = test.x_factors.size(), ny_test = test.y_factors.size();
+  int nx_trial = trial.x_factors.size(), ny_trial = trial.y_factors.size();
+
+  // A[c][a][r] = sum_q W(q, r) f_c(xi_q) f_a(xi_q).
+  std::vector<Scalar> A(nx_test * nx_trial * n, Scalar(0));
+  for (int c = 0; c < nx_test; c++)
+  {
+    const double* f_c = test_dxi ? derivatives(n, test.x_factors[c]) : values(n, test.x_factors[c]);
+    for (int a = 0; a < nx_trial; a++)
+    {
+      const double* f_a = trial_dxi ? derivatives(n, trial.x_factors[a]) : values(n, trial.x_factors[a]);
+      Scalar* A_ca = &A[(c * nx_trial + a) * n];
+      for (int q = 0; q < n; q++)
+      {
+        double ff = f_c[q] * f_a[q];
+        if (ff == 0.0) continue;
+        for (int r = 0; r < n; r++)
+          A_ca[r] += ff * weights[q * n + r];
+      }
+    }
+  }
+
+  // K[(c, d)][(a, b)] += sum_r A[c][a][r] g_d(eta_r) g_b(eta_r).
+  int cols = nx_trial * ny_trial;
+  for (int d = 0; d < ny_test; d++)
+  {
+    const double* g_d = test_deta ? derivatives(n, test.y_factors[d]) : values(n, test.y_factors[d]);
+    for (int b = 0; b < ny_trial; b++)
+    {
+      const double* g_b = trial_deta ? derivatives(n, trial.y_factors[b]) : values(n, trial.y_factors[b]);
+      std::vector<double> gg(n);
+      for (int r = 0; r < n; r++)
+        gg[r] = g_d[r] * g_b[r];
+      for (int c = 0; c < nx_test; c++)
+        for (int a = 0; a < nx_trial; a++)
+        {
+          const Scalar* A_ca = &A[(c * nx_trial + a) * n];
+          Scalar sum = Scalar(0);
+          for (int r = 0; r < n; r++)
+            sum += A_ca[r] * gg[r];
+          K[(c * ny_test + d) * cols + a * ny_trial + b] += sum;
+        }
+    }
+  }
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::assemble_element(const ElementData& data, int i, int j, SparseMatrix<Scalar>* matrix) const
+{
+  const Coefficients& c = blocks[i * neq + j];
+  const ElementSpace& test = data.spaces[i];
+  const ElementSpace& trial = data.spaces[j];
+  int n = data.n, np = n * n;
+  int rows = test.x_factors.size() * test.y_factors.size();
+  int cols = trial.x_factors.size() * trial.y_factors.size();
+  std::vector<Scalar> K(rows * cols, Scalar(0));
+
+  std::vector<Scalar> W(np);
+  if (c.diffusion != Scalar(0))
+  {
+    for (int k = 0; k < np; k++) W[k] = c.diffusion * data.metric[METRIC_SIZE * k];
+    add_term(data, test, trial, &W[0], true, false, true, false, &K[0]);
+    for (int k = 0; k < np; k++) W[k] = c.diffusion * data.metric[METRIC_SIZE * k + 1];
+    add_term(data, test, trial, &W[0], true, false, false, true, &K[0]);
+    add_term(data, test, trial, &W[0], false, true, true, false, &K[0]);
+    for (int k = 0; k < np; k++) W[k] = c.diffusion * data.metric[METRIC_SIZE * k + 2];
+    add_term(data, test, trial, &W[0], false, true, false, true, &K[0]);
+  }
+  if (c.mass != Scalar(0))
+  {
+    for (int k = 0; k < np; k++) W[k] = c.mass * data.metric[METRIC_SIZE * k + 3];
+    add_term(data, test, trial, &W[0], false, false, false, false, &K[0]);
+  }
+  if (c.convection_x != Scalar(0) || c.convection_y != Scalar(0))
+  {
+    for (int k = 0; k < np; k++)
+      W[k] = c.convection_x * data.metric[METRIC_SIZE * k + 4] + c.convection_y * data.metric[METRIC_SIZE * k + 5];
+    add_term(data, test, trial, &W[0], false, false, true, false, &K[0]);
+    for (int k = 0; k < np; k++)
+      W[k] = c.convection_x * data.metric[METRIC_SIZE * k + 6] + c.convection_y * data.metric[METRIC_SIZE * k + 7];
+    add_term(data, test, trial, &W[0], false, false, false, true, &K[0]);
+  }
+
+  int ny_test = test.y_factors.size(), ny_trial = trial.y_factors.size();
+  for (unsigned int s = 0; s < test.shapes.size(); s++)
+  {
+    const Shape& v = test.shapes[s];
+    for (unsigned int t = 0; t < trial.shapes.size(); t++)
+    {
+      const Shape& u = trial.shapes[t];
+      matrix->add(first_dofs[i] + v.dof, first_dofs[j] + u.dof,
+                  v.coef * u.coef * K[(v.a * ny_test + v.b) * cols + u.a * ny_trial + u.b]);
+    }
+  }
+}
+
+template<typename Scalar>
+void SumFactorizedOperator<Scalar>::assemble(SparseMatrix<Scalar>* matrix) const
+{
+  matrix->free();
+  matrix->prealloc(ndof);
+  for (unsigned int el = 0; el < elements.size(); el++)
+    for (int i = 0; i < neq; i++)
+      for (int j = 0; j < neq; j++)
+      {
+        if (!blocks[i * neq + j].active) continue;
+        const std::vector<Shape>& test = elements[el].spaces[i].shapes;
+        const std::vector<Shape>& trial = elements[el].spaces[j].shapes;
+        for (unsigned int s = 0; s < test.size(); s++)
+          for (unsigned int t = 0; t < trial.size(); t++)
+            matrix->pre_add_ij(first_dofs[i] + test[s].dof, first_dofs[j] + trial[t].dof);
+      }
+  if (remainder != NULL)
+  {
+    int* Ap = remainder->get_Ap();
+    int* Ai = remainder->get_Ai();
+    for (int c = 0; c < ndof; c++)
+      for (int k = Ap[c]; k < Ap[c + 1]; k++)
+        matrix->pre_add_ij(Ai[k], c);
+  }
+  matrix->alloc();
+  matrix->zero();
+
+  for (unsigned int el = 0; el < elements.size(); el++)
+    for (int i = 0; i < neq; i++)
+      for (int j = 0; j < neq; j++)
+        if (blocks[i * neq + j].active)
+          assemble_element(elements[el], i, j, matrix);
+  if (remainder != NULL)
+  {
+    int* Ap = remainder->get_Ap();
+    int* Ai = remainder->get_Ai();
+    Scalar* Ax = remainder->get_Ax();
+    for (int c = 0; c < ndof; c++)
+      for (int k = Ap[c]; k < Ap[c + 1]; k++)
+        matrix->add(Ai[k], c, Ax[k]);
+  }
+  matrix->finish();
+}
+
+template class SumFactorizedOperator<double>;
+template class SumFactorizedOperator<std::complex<double> >;
@@ -0,0 +1,136 @@
+#ifndef SUM_FACTORIZATION_H
+#define SUM_FACTORIZATION_H
+
+#include "hermes2d.h"
+#include "shifted_laplacian.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Sum-factorized volumetric operator for H1 spaces on quadrilateral meshes,
+///
+///   A_ij = \int c_d^ij grad u_j . grad v_i + (c^ij . grad u_j) v_i + c_m^ij u_j v_i
+///
+/// with constant coefficients of every block (i, j) of the spaces.
+///
+/// The shape functions on quadrilaterals are products of 1D functions, phi(xi, eta) = f(xi) g(eta).
+/// The factors are recovered from the shapeset once per shape function (and verified), and the values
+/// of u and of its reference derivatives at the tensor-product Gauss points are computed by two 1D
+/// contractions, as are the integrals against the test functions. With the polynomial degree p, the
+/// matrix-free application costs O(p^3) per element instead of the O(p^4) of a stored element
+/// matrix (and the O(p^6) of its assembly point by point), and assemble() computes the element
+/// matrices by 1D contractions in O(p^5). The geometry of the elements (bilinear maps), the
+/// decomposition of their assembly lists and the 1D tables are precomputed in the constructor, so that
+/// multiply() only does arithmetic. Surface terms (and whatever else is not of the above form) are
+/// assembled as usual into a sparse matrix and added by set_remainder().
+///
+/// All spaces have to be on the same mesh of straight-edged quadrilaterals; the operator has to be
+/// constructed again when the mesh or the spaces change. With 'area', only the elements of that material
+/// are covered (and have to be such quadrilaterals), the volumetric terms of the other elements (e.g. of
+/// a perfectly matched layer) are left to the remainder.
+template<typename Scalar>
+class SumFactorizedOperator : public MatrixFreeOperator<Scalar>
+{
+public:
+  SumFactorizedOperator(Hermes::vector<const Space<Scalar>*> spaces, const std::string& area = HERMES_ANY);
+
+  /// Coefficients of the block (i, j), blocks not set are zero.
+  void set_block(int i, int j, Scalar diffusion, Scalar mass, Scalar convection_x = Scalar(0), Scalar convection_y = Scalar(0));
+
+  /// Sparse (CSC) matrix added to the operator, e.g. the surface forms of the weak form assembled by DiscreteProblem.
+  void set_remainder(SparseMatrix<Scalar>* remainder);
+
+  virtual int get_size() const { return ndof; }
+
+  /// y = A x (the remainder included).
+  virtual void multiply(const Scalar* x, Scalar* y) const;
+
+  /// Assembles A (the remainder included) into 'matrix', e.g. the preconditioner of an iterative solver.
+  void assemble(SparseMatrix<Scalar>* matrix) const;
+
+private:
+  // 1D factor, the shape function 'index' restricted to the line y = 'fixed' (x-factor) or x = 'fixed'
+  // (y-factor), divided by 'scale'.
+  struct Factor
+  {
+    Shapeset* shapeset;
+    int index;
+    bool y_factor;
+    double fixed;
+    double scale;
+  };
+
+  // Shape function of the element in terms of its local 1D factors.
+  struct Shape
+  {
+    int a, b;
+    int dof;
+    Scalar coef;
+  };
+
+  // Assembly list of one space on one element.
+  struct ElementSpace
+  {
+    std::vector<int> x_factors, y_factors;
+    std::vector<Shape> shapes;
+  };
+
+  struct ElementData
+  {
+    int n;
+    // Per point: w G_11, w G_12, w G_22, w |J|, and w |J| J^{-1} (row-wise), G = |J| J^{-1} J^{-T}.
+    std::vector<double> metric;
+    std::vector<ElementSpace> spaces;
+  };
+
+  struct Coefficients
+  {
+    bool active;
+    Scalar diffusion, mass, convection_x, convection_y;
+  };
+
+  static const int METRIC_SIZE = 8;
+
+  void prepare_element(Element* e, ElementData& data);
+  void decompose(Shapeset* shapeset, int index, int& x_factor, int& y_factor, double& scale);
+  int find_factor(const Factor& factor, double& ratio);
+  double factor_value(const Factor& factor, double t, bool derivative) const;
+  void tabulate(int n);
+
+  // Values and reference derivatives of the functions of the space j on the element at the points.
+  void interpolate(const ElementData& data, int j, const Scalar* x, Scalar* val, Scalar* dxi, Scalar* deta) const;
+  // Adds the integrals of F_xi dv/dxi + F_eta dv/deta + F_0 v over the element for the functions of the space i to y.
+  void integrate(const ElementData& data, int i, const Scalar* f_xi, const Scalar* f_eta, const Scalar* f_0, Scalar* y) const;
+  // Adds the element matrix of the block (i, j) to 'matrix'.
+  void assemble_element(const ElementData& data, int i, int j, SparseMatrix<Scalar>* matrix) const;
+  // Adds \int W (test factors) (trial factors) to the element matrix K, the factors being the values
+  // or the derivatives.
+  void add_term(const ElementData& data, const ElementSpace& test, const ElementSpace& trial, const Scalar* weights,
+                bool test_dxi, bool test_deta, bool trial_dxi, bool trial_deta, Scalar* K) const;
+
+  // Values and derivatives of the factor 'k' at the n-point Gauss rule.
+  const double* values(int n, int k) const { return &tables[n][2 * k][0]; }
+  const double* derivatives(int n, int k) const { return &tables[n][2 * k + 1][0]; }
+
+  static void gauss_legendre(int n, double* points, double* weights);
+
+  Hermes::vector<const Space<Scalar>*> spaces;
+  int neq, ndof;
+  std::vector<int> first_dofs;
+
+  std::vector<Factor> factors;
+  // Samples of the factors (at the Gauss points 'sample_points') for the comparison, and the decompositions
+  // (x-factor, y-factor, scale) of the shape functions [shapeset, index].
+  std::vector<double> sample_points;
+  std::vector<std::vector<double> > samples;
+  std::map<std::pair<Shapeset*, int>, std::pair<std::pair<int, int>, double> > decompositions;
+  // [n][2 k] values, [n][2 k + 1] derivatives of the factor k at the n-point Gauss rule.
+  std::vector<std::vector<std::vector<double> > > tables;
+  std::vector<std::vector<double> > gauss_points, gauss_weights;
+
+  std::vector<ElementData> elements;
+  std::vector<Coefficients> blocks;
+  CSCMatrix<Scalar>* remainder;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "uniform_spline.h"
+
+UniformCubicSpline::UniformCubicSpline(const Hermes::vector<double>& points, const Hermes::vector<double>& values,
+                                       double bc_left, double bc_right, bool first_der_left, bool first_der_right,
+                                       bool extrapolate_der_left, bool extrapolate_der_right,
+                                       int num_cells, GridType grid_type)
+  : CubicSpline(points, values, bc_left, bc_right, first_der_left, first_der_right, extrapolate_der_left, extrapolate_der_right),
+    grid_type(grid_type), num_cells(num_cells), resampling_error(0.0)
+{
+  if (points.size() < 2 || num_cells < 1)
+    throw Hermes::Exceptions::Exception("UniformCubicSpline needs at least two points and one cell.");
+  this->calculate_coeffs();
+
+  x_min = points[0];
+  x_max = points[points.size() - 1];
+  x_ref = x_max - x_min;
+  for (unsigned int i = 1; i < points.size(); i++)
+    x_ref = std::min(x_ref, points[i] - points[i - 1]);
+  if (x_ref <= 0.0)
+    throw Hermes::Exceptions::Exception("UniformCubicSpline needs increasing points.");
+
+  // Nodes of the grid.
+  std::vector<double> nodes(num_cells + 1);
+  if (grid_type == GRID_UNIFORM)
+  {
+    inv_step = num_cells / (x_max - x_min);
+    for (int k = 0; k <= num_cells; k++)
+      nodes[k] = x_min + k * (x_max - x_min) / num_cells;
+  }
+  else
+  {
+    double s_max = std::log1p((x_max - x_min) / x_ref);
+    inv_step = num_cells / s_max;
+    for (int k = 0; k <= num_cells; k++)
+      nodes[k] = x_min + x_ref * std::expm1(k * s_max / num_cells);
+  }
+  nodes[num_cells] = x_max;
+
+  // Hermite cubic on every cell from the values and derivatives of the spline.
+  cell_x.resize(num_cells);
+  cell_inv_width.resize(num_cells);
+  coeff_0.resize(num_cells);
+  coeff_1.resize(num_cells);
+  coeff_2.resize(num_cells);
+  coeff_3.resize(num_cells);
+  for (int k = 0; k < num_cells; k++)
+  {
+    double width = nodes[k + 1] - nodes[k];
+    double f_0 = CubicSpline::value(nodes[k]), f_1 = CubicSpline::value(nodes[k + 1]);
+    double d_0 = width * CubicSpline::derivative(nodes[k]), d_1 = width * CubicSpline::derivative(nodes[k + 1]);
+    cell_x[k] = nodes[k];
+    cell_inv_width[k] = 1.0 / width;
+    coeff_0[k] = f_0;
+    coeff_1[k] = d_0;
+    coeff_2[k] = 3 * (f_1 - f_0) - 2 * d_0 - d_1;
+    coeff_3[k] = 2 * (f_0 - f_1) + d_0 + d_1;
+  }
+
+  for (int k = 0; k < num_cells; k++)
+  {
+    double x_mid = 0.5 * (nodes[k] + nodes[k + 1]);
+    resampling_error = std::max(resampling_error, std::abs(value(x_mid) - CubicSpline::value(x_mid)));
+  }
+}
+
+int UniformCubicSpline::cell(double x) const
+{
+  int k = (grid_type == GRID_UNIFORM) ? (int) ((x - x_min) * inv_step)
+                                      : (int) (std::log1p((x - x_min) / x_ref) * inv_step);
+  // Round-off at the nodes.
+  k = std::max(0, std::min(num_cells - 1, k));
+  if (k > 0 && x < cell_x[k])
+    k--;
+  else if (k < num_cells - 1 && x >= cell_x[k + 1])
+    k++;
+  return k;
+}
+
+double UniformCubicSpline::value(double x) const
+{
+  if (x < x_min || x > x_max)
+    return CubicSpline::value(x);
+  int k = cell(x);
+  double t = (x - cell_x[k]) * cell_inv_width[k];
+  return coeff_0[k] + t * (coeff_1[k] + t * (coeff_2[k] + t * coeff_3[k]));
+}
+
+double UniformCubicSpline::derivative(double x) const
+{
+  if (x < x_min || x > x_max)
+    return CubicSpline::derivative(x);
+  int k = cell(x);
+  double t = (x - cell_x[k]) * cell_inv_width[k];
+  return (coeff_1[k] + t * (2 * coeff_2[k] + t * 3 * coeff_3[k])) * cell_inv_width[k];
+}
+
+void UniformCubicSpline::value_and_derivative(double x, double& val, double& der) const
+{
+  if (x < x_min || x > x_max)
+  {
+    val = CubicSpline::value(x);
+    der = CubicSpline::derivative(x);
+    return;
+  }
+  int k = cell(x);
+  double t = (x - cell_x[k]) * cell_inv_width[k];
+  val = coeff_0[k] + t * (coeff_1[k] + t * (coeff_2[k] + t * coeff_3[k]));
+  der = (coeff_1[k] + t * (2 * coeff_2[k] + t * 3 * coeff_3[k])) * cell_inv_width[k];
+}
+
+void UniformCubicSpline::evaluate(int n, const double* x, double* val, double* der) const
+{
+  const double* c_x = &cell_x[0];
+  const double* c_w = &cell_inv_width[0];
+  const double* c_0 = &coeff_0[0];
+  const double* c_1 = &coeff_1[0];
+  const double* c_2 = &coeff_2[0];
+  const double* c_3 = &coeff_3[0];
+  bool out_of_range = false;
+
+  // Branch-free pass over all points; the index is clamped to the grid, so that the points
+  // outside of the interval are evaluated (wrongly, but safely) and fixed below.
+  if (grid_type == GRID_UNIFORM)
+  {
+#pragma omp simd reduction(||:out_of_range)
+    for (int i = 0; i < n; i++)
+    {
+      double s = (x[i] - x_min) * inv_step;
+      int k = (int) std::max(0.0, std::min((double) (num_cells - 1), s));
+      double t = (x[i] - c_x[k]) * c_w[k];
+      val[i] = c_0[k] + t * (c_1[k] + t * (c_2[k] + t * c_3[k]));
+      der[i] = (c_1[k] + t * (2 * c_2[k] + t * 3 * c_3[k])) * c_w[k];
+      out_of_range = out_of_range || x[i] < x_min || x[i] > x_max;
+    }
+  }
+  else
+  {
+    for (int i = 0; i < n; i++)
+    {
+      if (x[i] < x_min || x[i] > x_max)
+      {
+        out_of_range = true;
+        continue;
+      }
+      int k = cell(x[i]);
+      double t = (x[i] - c_x[k]) * c_w[k];
+      val[i] = c_0[k] + t * (c_1[k] + t * (c_2[k] + t * c_3[k]));
+      der[i] = (c_1[k] + t * (2 * c_2[k] + t * 3 * c_3[k])) * c_w[k];
+    }
+  }
+
+  if (out_of_range)
+    for (int i = 0; i < n; i++)
+      if (x[i] < x_min || x[i] > x_max)
+      {
+        val[i] = CubicSpline::value(x[i]);
+        der[i] = CubicSpline::derivative(x[i]);
+      }
+}
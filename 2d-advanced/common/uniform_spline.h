@@ -0,0 +1,65 @@
+#ifndef UNIFORM_SPLINE_H
+#define UNIFORM_SPLINE_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Cubic spline with constant-time evaluation.
+///
+/// The spline is constructed as the usual CubicSpline and then resampled into a piecewise cubic Hermite
+/// interpolant (values and derivatives of the spline at the nodes) on a grid that is either uniform or
+/// uniform in log(1 + (x - x_min) / x_ref), x_ref being the shortest interval of the original spline; the
+/// latter places more cells close to x_min, where magnetization curves change fast. The cell containing x
+/// is then found by one multiplication (and a logarithm for the log grid) instead of a search over the
+/// breakpoints. Outside of the interval of the original breakpoints the extrapolation of CubicSpline is used.
+///
+/// value() and derivative() override those of CubicSpline, so that the spline can be passed to the default
+/// weak forms; value_and_derivative() evaluates both at once and evaluate() does so for a whole array
+/// of points (e.g. all quadrature points of an element), the in-range part of which is vectorized.
+class UniformCubicSpline : public CubicSpline
+{
+public:
+  enum GridType
+  {
+    GRID_UNIFORM,
+    GRID_LOG
+  };
+
+  /// The first eight parameters are those of CubicSpline, 'num_cells' is the number of cells of the grid.
+  UniformCubicSpline(const Hermes::vector<double>& points, const Hermes::vector<double>& values,
+                     double bc_left, double bc_right, bool first_der_left, bool first_der_right,
+                     bool extrapolate_der_left, bool extrapolate_der_right,
+                     int num_cells = 1024, GridType grid_type = GRID_UNIFORM);
+
+  using CubicSpline::value;
+  using CubicSpline::derivative;
+  virtual double value(double x) const;
+  virtual double derivative(double x) const;
+
+  void value_and_derivative(double x, double& val, double& der) const;
+
+  /// Values and derivatives at the 'n' points 'x'.
+  void evaluate(int n, const double* x, double* val, double* der) const;
+
+  /// Largest difference from the original spline at the cell midpoints.
+  double get_resampling_error() const { return resampling_error; }
+
+private:
+  // Cell containing x (x must lie in [x_min, x_max]).
+  int cell(double x) const;
+
+  GridType grid_type;
+  int num_cells;
+  double x_min, x_max, x_ref;
+  // Inverse of the grid step in x (uniform grid) or in log(1 + (x - x_min) / x_ref) (log grid).
+  double inv_step;
+
+  // For every cell: left node, inverse width and the coefficients of the cubic in the local coordinate.
+  std::vector<double> cell_x, cell_inv_width, coeff_0, coeff_1, coeff_2, coeff_3;
+
+  double resampling_error;
+};
+
+#endif
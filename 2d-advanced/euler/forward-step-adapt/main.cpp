@@ -1,6 +1,7 @@
 #define HERMES_REPORT_INFO
 #define HERMES_REPORT_FILE "application.log"
 #include "hermes2d.h"
+#include "../../common/binary_checkpoint.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
@@ -182,20 +183,16 @@ int main(int argc, char* argv[])
   CFLCalculation CFL(CFL_NUMBER, KAPPA);
 
   // Look for a saved solution on the disk.
-  CalculationContinuity<double> continuity(CalculationContinuity<double>::onlyTime);
+  BinaryCheckpoint continuity("forward-step");
   int iteration = 0; double t = 0;
   bool loaded_now = false;
 
   if(REUSE_SOLUTION && continuity.have_record_available())
   {
-    continuity.get_last_record()->load_mesh(&mesh);
-    Hermes::vector<Space<double> *> spaceVector = continuity.get_last_record()->load_spaces(Hermes::vector<Mesh *>(&mesh, &mesh, &mesh, &mesh));
-    space_rho.copy(spaceVector[0], &mesh);
-    space_rho_v_x.copy(spaceVector[1], &mesh);
-    space_rho_v_y.copy(spaceVector[2], &mesh);
-    space_e.copy(spaceVector[3], &mesh);
-    continuity.get_last_record()->load_time_step_length(time_step);
-    t = continuity.get_last_record()->get_time() + time_step;
+    continuity.load_mesh(&mesh);
+    continuity.load_spaces(Hermes::vector<Space<double> *>(&space_rho, &space_rho_v_x, &space_rho_v_y, &space_e));
+    time_step = continuity.get_time_step();
+    t = continuity.get_time() + time_step;
     iteration = (continuity.get_num()) * EVERY_NTH_STEP + 1;
     loaded_now = true;
   }
@@ -263,8 +260,7 @@ int main(int argc, char* argv[])
       {
         loaded_now = false;
 
-        continuity.get_last_record()->load_solutions(Hermes::vector<Solution<double>*>(&prev_rho, &prev_rho_v_x, &prev_rho_v_y, &prev_e),
-            Hermes::vector<Space<double> *>(ref_space_rho, ref_space_rho_v_x, ref_space_rho_v_y, ref_space_e));
+        continuity.load_solutions(Hermes::vector<Solution<double>*>(&prev_rho, &prev_rho_v_x, &prev_rho_v_y, &prev_e), ref_spaces_const);
       }
       else
       {
@@ -416,10 +412,15 @@ int main(int argc, char* argv[])
         }
 
         // Save the progress.
+        // The solution vector is the reference solution unless it has been limited.
         if(iteration > 1)
         {
-          continuity.add_record(t, Hermes::vector<Mesh*>(&mesh, &mesh, &mesh, &mesh), Hermes::vector<Space<double>*>(&space_rho, &space_rho_v_x, &space_rho_v_y, &space_e), 
-            Hermes::vector<Solution<double> *>(&rsln_rho, &rsln_rho_v_x, &rsln_rho_v_y, &rsln_e), time_step);
+          if(!SHOCK_CAPTURING)
+            continuity.add_record(t, time_step, &mesh, Hermes::vector<const Space<double>*>(&space_rho, &space_rho_v_x, &space_rho_v_y, &space_e), 
+              ref_spaces_const, solver->get_sln_vector());
+          else
+            continuity.add_record(t, time_step, &mesh, Hermes::vector<const Space<double>*>(&space_rho, &space_rho_v_x, &space_rho_v_y, &space_e), 
+              ref_spaces_const, Hermes::vector<Solution<double> *>(&rsln_rho, &rsln_rho_v_x, &rsln_rho_v_y, &rsln_e));
         }
       }
 
@@ -1,6 +1,7 @@
 #define HERMES_REPORT_ALL
 #define HERMES_REPORT_FILE "application.log"
 #include "definitions.h"
+#include "../../common/linear_rk.h"
 
 using namespace RefinementSelectors;
 
@@ -11,6 +12,12 @@ using namespace RefinementSelectors;
 // PDE: Lengthy. See the paper P. Solin, L. Dubcova, J. Kruis: Adaptive hp-FEM with Dynamical 
 // Meshes for Transient Heat and Moisture Transfer Problems, J. Comput. Appl. Math. 233 (2010) 3103-3112.
 //
+// The problem is linear with constant coefficients, so the default is the LinearRungeKutta stepper
+// (see common/linear_rk.h): the blocks T-T, T-w, w-T and w-w are assembled once per pair of reference
+// spaces, and those of a component are reassembled only when the adaptivity changed its own mesh. With
+// the block solver, only the diagonal blocks of the stage matrix are factorized (each until its own
+// space changes), and the stages are solved by BiCGStab with a block Gauss-Seidel preconditioner.
+//
 // The following parameters can be changed:
 
 // Scaling factor for moisture. Since temperature is in hundreds of Kelvins and moisture between
@@ -66,6 +73,15 @@ const int NDOF_STOP = 100000;
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 MatrixSolverType matrix_solver = SOLVER_UMFPACK;  
 
+// Use the linear R-K stepper (the problem is linear) instead of Newton's method on the stages.
+bool LINEAR_RK = true;
+// Solve the stage systems by the block Gauss-Seidel preconditioned BiCGStab instead of factorizing
+// the whole coupled stage matrix.
+const bool BLOCK_SOLVER = true;
+// Relative residual and maximum number of iterations of the BiCGStab.
+const double BLOCK_SOLVER_TOL = 1e-10;
+const int BLOCK_SOLVER_MAX_ITER = 100;
+
 // Newton's method
 // Stopping criterion for Newton on fine mesh.
 const double NEWTON_TOL = 1e-5;                   
@@ -124,6 +140,23 @@ const double REACTOR_START_TIME = 3600*24;
 // Physical time in seconds.
 double current_time = 0.0;
 
+// Returns true if the mesh or the element orders of the space differ from those of the previous call
+// (always for empty 'orders'), and records them.
+static bool coarse_space_changed(const Space<double>* space, unsigned int& mesh_seq, std::vector<int>& orders)
+{
+  std::vector<int> new_orders;
+  Element* e;
+  for_all_active_elements(e, space->get_mesh())
+  {
+    new_orders.push_back(e->id);
+    new_orders.push_back(space->get_element_order(e->id));
+  }
+  bool changed = orders.empty() || space->get_mesh()->get_seq() != mesh_seq || new_orders != orders;
+  mesh_seq = space->get_mesh()->get_seq();
+  orders = new_orders;
+  return changed;
+}
+
 int main(int argc, char* argv[])
 {
   // Choose a Butcher's table or define your own.
@@ -131,6 +164,10 @@ int main(int argc, char* argv[])
   if (bt.is_explicit()) Hermes::Mixins::Loggable::Static::info("Using a %d-stage explicit R-K method.", bt.get_size());
   if (bt.is_diagonally_implicit()) Hermes::Mixins::Loggable::Static::info("Using a %d-stage diagonally implicit R-K method.", bt.get_size());
   if (bt.is_fully_implicit()) Hermes::Mixins::Loggable::Static::info("Using a %d-stage fully implicit R-K method.", bt.get_size());
+  if (bt.is_fully_implicit() && LINEAR_RK == true) {
+    Hermes::Mixins::Loggable::Static::warn("R-K method fully implicit, turning off the linear R-K stepper.");
+    LINEAR_RK = false;
+  }
 
   // Load the mesh.
   Mesh basemesh, T_mesh, w_mesh;
@@ -164,6 +201,17 @@ int main(int argc, char* argv[])
   const CustomWeakFormHeatMoistureRK wf(c_TT, c_ww, d_TT, d_Tw, d_wT, d_ww, 
 				  k_TT, k_ww, T_EXTERIOR, W_EXTERIOR, "bdy_ext");
 
+  // Initialize the linear R-K stepper. The sources (and the Dirichlet lift) do not depend on time
+  // within a step, the boundary condition is evaluated at the beginning of the step.
+  LinearRungeKutta* linear_rk = NULL;
+  if (LINEAR_RK)
+  {
+    linear_rk = new LinearRungeKutta(&wf, Hermes::vector<const Space<double>*>(&T_space, &w_space), &bt);
+    linear_rk->set_source();
+    if (BLOCK_SOLVER)
+      linear_rk->set_block_solver(BLOCK_SOLVER_TOL, BLOCK_SOLVER_MAX_ITER);
+  }
+
   // Initialize refinement selector.
   H1ProjBasedSelector<double> selector(CAND_LIST, CONV_EXP, H2DRS_DEFAULT_ORDER);
 
@@ -185,6 +233,16 @@ int main(int argc, char* argv[])
   T_order_view.show(&T_space);
   w_order_view.show(&w_space);
 
+  // Reference meshes and spaces of T and w (kept over the adaptivity and time steps), and the state
+  // of the coarse spaces they belong to.
+  Space<double>* coarse_spaces[2] = { &T_space, &w_space };
+  Solution<double>* slns_time_prev[2] = { &T_time_prev, &w_time_prev };
+  Solution<double>* slns_time_new[2] = { &T_time_new, &w_time_new };
+  Mesh* ref_meshes[2] = { NULL, NULL };
+  Space<double>* ref_spaces[2] = { NULL, NULL };
+  unsigned int coarse_mesh_seqs[2] = { 0, 0 };
+  std::vector<int> coarse_orders[2];
+
   // Time stepping loop:
   int ts = 1;
   while (current_time < SIMULATION_TIME)
@@ -197,6 +255,11 @@ int main(int argc, char* argv[])
     if (current_time <= REACTOR_START_TIME) {
       Hermes::Mixins::Loggable::Static::info("Updating time-dependent essential BC.");
       Space<double>::update_essential_bc_values(Hermes::vector<Space<double>*>(&T_space, &w_space), current_time);
+      // A kept reference space needs the new values too, and the stepper a new Dirichlet lift.
+      if (ref_spaces[0] != NULL)
+        Space<double>::update_essential_bc_values(ref_spaces[0], current_time);
+      if (LINEAR_RK)
+        linear_rk->set_source();
     }
 
     // Uniform mesh derefinement.
@@ -233,39 +296,50 @@ int main(int argc, char* argv[])
     {
       Hermes::Mixins::Loggable::Static::info("Time step %d, adaptivity step %d:", ts, as);
 
-      // Construct globally refined reference mesh and setup reference space.
-      Mesh::ReferenceMeshCreator refMeshCreatorU(&T_mesh);
-      Mesh* ref_T_mesh = refMeshCreatorU.create_ref_mesh();
-
-      Space<double>::ReferenceSpaceCreator refSpaceCreatorT(&T_space, ref_T_mesh);
-      Space<double>* ref_T_space = refSpaceCreatorT.create_ref_space();
-
-      Mesh::ReferenceMeshCreator refMeshCreatorW(&w_mesh);
-      Mesh* ref_w_mesh = refMeshCreatorW.create_ref_mesh();
-
-      Space<double>::ReferenceSpaceCreator refSpaceCreatorW(&w_space, ref_w_mesh);
-      Space<double>* ref_w_space = refSpaceCreatorW.create_ref_space();
+      // Construct globally refined reference meshes and setup reference spaces, only for the components
+      // whose coarse spaces were changed since the last time (by the adaptivity or the derefinement).
+      // The unchanged reference spaces keep their blocks and factorizations in LinearRungeKutta.
+      for (int c = 0; c < 2; c++)
+      {
+        if (!coarse_space_changed(coarse_spaces[c], coarse_mesh_seqs[c], coarse_orders[c]))
+          continue;
+        delete ref_spaces[c];
+        // The mesh of the previous solution is deleted after the time step.
+        if (ref_meshes[c] != slns_time_prev[c]->get_mesh())
+          delete ref_meshes[c];
+        Mesh::ReferenceMeshCreator refMeshCreator(coarse_spaces[c]->get_mesh());
+        ref_meshes[c] = refMeshCreator.create_ref_mesh();
+        Space<double>::ReferenceSpaceCreator refSpaceCreator(coarse_spaces[c], ref_meshes[c]);
+        ref_spaces[c] = refSpaceCreator.create_ref_space();
+      }
+      Space<double>* ref_T_space = ref_spaces[0];
+      Space<double>* ref_w_space = ref_spaces[1];
 
-      Hermes::vector<Space<double>*> ref_spaces(ref_T_space, ref_w_space);
       Hermes::vector<const Space<double>*> ref_spaces_const(ref_T_space, ref_w_space);
 
-      // Initialize discrete problem on reference meshes.
-      DiscreteProblem<double> dp(&wf, ref_spaces_const);
-
-      // Initialize Runge-Kutta time stepping.
-      RungeKutta<double> runge_kutta(&wf, ref_spaces_const, &bt);
-
       // Perform one Runge-Kutta time step according to the selected Butcher's table.
       Hermes::Mixins::Loggable::Static::info("Runge-Kutta time step (t = %g s, tau = %g s, stages: %d).",
            current_time, time_step, bt.get_size());
       try
       {
-        runge_kutta.set_time(current_time);
-        runge_kutta.set_time_step(time_step);
-        runge_kutta.set_newton_max_iter(NEWTON_MAX_ITER);
-        runge_kutta.set_newton_tol(NEWTON_TOL);
-        runge_kutta.rk_time_step_newton(Hermes::vector<Solution<double> *>(&T_time_prev, &w_time_prev), 
-            Hermes::vector<Solution<double> *>(&T_time_new, &w_time_new));
+        if (LINEAR_RK)
+        {
+          linear_rk->set_spaces(ref_spaces_const);
+          linear_rk->set_time(current_time);
+          linear_rk->set_time_step(time_step);
+          linear_rk->rk_time_step(Hermes::vector<Solution<double> *>(&T_time_prev, &w_time_prev), 
+              Hermes::vector<Solution<double> *>(&T_time_new, &w_time_new));
+        }
+        else
+        {
+          RungeKutta<double> runge_kutta(&wf, ref_spaces_const, &bt);
+          runge_kutta.set_time(current_time);
+          runge_kutta.set_time_step(time_step);
+          runge_kutta.set_newton_max_iter(NEWTON_MAX_ITER);
+          runge_kutta.set_newton_tol(NEWTON_TOL);
+          runge_kutta.rk_time_step_newton(Hermes::vector<Solution<double> *>(&T_time_prev, &w_time_prev), 
+              Hermes::vector<Solution<double> *>(&T_time_new, &w_time_new));
+        }
       }
       catch(Exceptions::Exception& e)
       {
@@ -316,15 +390,8 @@ int main(int argc, char* argv[])
           as++;
       }
  
-      // Clean up.
+      // Clean up. The reference meshes and spaces are deleted when the coarse spaces change.
       delete adaptivity;
-      if(!done)
-      {
-        delete ref_T_space;
-        delete ref_w_space;
-        delete T_time_new.get_mesh();
-        delete w_time_new.get_mesh();
-      }
     }
     while (done == false);
 
@@ -342,13 +409,22 @@ int main(int argc, char* argv[])
     T_order_view.show(&T_space);
     w_order_view.show(&w_space);
 
-    // Save fine mesh solutions for the next time step.
+    // Save fine mesh solutions for the next time step. The reference meshes are kept for the next
+    // time step unless the next adaptivity step changes them.
+    if (ts > 1)
+      for (int c = 0; c < 2; c++)
+        if (slns_time_prev[c]->get_mesh() != slns_time_new[c]->get_mesh())
+          delete slns_time_prev[c]->get_mesh();
     T_time_prev.copy(&T_time_new);
     w_time_prev.copy(&w_time_new);
 
     ts++;
   }
 
+  delete linear_rk;
+  for (int c = 0; c < 2; c++)
+    delete ref_spaces[c];
+
   // Wait for all views to be closed.
   View::wait();
   return 0;
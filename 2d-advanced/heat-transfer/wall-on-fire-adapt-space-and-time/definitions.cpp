@@ -25,38 +25,56 @@ Real T_fire_t(Real t)
   return 0.;
 }
 
+// The time factor of the source for LinearRungeKutta::set_source().
+template double T_fire_t<double>(double t);
+
+// T_fire_x as a coefficient field.
+static double T_fire_x_field(double x, double y)
+{
+  return T_fire_x(x);
+}
+
 
 CustomWeakFormHeatRK::CustomWeakFormHeatRK(std::string bdy_fire, std::string bdy_air,
                                            double alpha_fire, double alpha_air, double rho, double heatcap,
-                                           double temp_ext_air, double temp_init, double* current_time_ptr) : WeakForm<double>(1)
+                                           double temp_ext_air, double temp_init, double* current_time_ptr) : WeakForm<double>(1),
+                                           lambda_field(lambda, 5), t_fire_x_field(T_fire_x_field, 3)
 {
   // Jacobian - volumetric part.
-  add_matrix_form(new CustomJacobianVol(0, 0, rho, heatcap));
+  add_matrix_form(new CustomJacobianVol(0, 0, rho, heatcap, &lambda_field));
 
   // Jacobian - surface part.
   add_matrix_form_surf(new WeakFormsH1::DefaultMatrixFormSurf<double>(0, 0, bdy_fire, new Hermes2DFunction<double>(-alpha_fire/(rho*heatcap))));
   add_matrix_form_surf(new WeakFormsH1::DefaultMatrixFormSurf<double>(0, 0, bdy_air, new Hermes2DFunction<double>(-alpha_air/(rho*heatcap))));
 
   // Residual - volumetric part.
-  add_vector_form(new CustomFormResidualVol(0, rho, heatcap));
+  add_vector_form(new CustomFormResidualVol(0, rho, heatcap, &lambda_field));
 
   // Surface residual - bottom boundary.
   CustomFormResidualSurfFire* vec_form_surf_1
-    = new CustomFormResidualSurfFire(0, bdy_fire, alpha_fire, rho, heatcap, current_time_ptr);
+    = new CustomFormResidualSurfFire(0, bdy_fire, alpha_fire, rho, heatcap, current_time_ptr, &t_fire_x_field);
   add_vector_form_surf(vec_form_surf_1);
 
   // Surface residual - top boundary.
-  add_vector_form_surf(new WeakFormsH1::DefaultResidualSurf<double>(0, HERMES_ANY, new Hermes2DFunction<double>(-alpha_air / (rho*heatcap))));
-  add_vector_form_surf(new WeakFormsH1::DefaultVectorFormSurf<double>(0, HERMES_ANY, new Hermes2DFunction<double>(alpha_air* temp_ext_air / (rho*heatcap))));
+  add_vector_form_surf(new WeakFormsH1::DefaultResidualSurf<double>(0, bdy_air, new Hermes2DFunction<double>(-alpha_air / (rho*heatcap))));
+  add_vector_form_surf(new WeakFormsH1::DefaultVectorFormSurf<double>(0, bdy_air, new Hermes2DFunction<double>(alpha_air* temp_ext_air / (rho*heatcap))));
+}
+
+void CustomWeakFormHeatRK::prepare(const Mesh* mesh)
+{
+  lambda_field.prepare(mesh);
+  t_fire_x_field.prepare(mesh);
 }
 
 double CustomWeakFormHeatRK::CustomJacobianVol::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, 
                                                       Geom<double> *e, Func<double>* *ext) const 
 {
+  std::vector<double> scratch;
+  const double* lambda_values = lambda_field->get_values(n, e, scratch);
   double result = 0.;
   for (int i = 0; i < n; i++) 
   {
-    result += wt[i] * lambda(e->x[i], e->y[i]) * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
+    result += wt[i] * lambda_values[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
   }
 
   return -result / heatcap / rho;
@@ -65,7 +83,7 @@ double CustomWeakFormHeatRK::CustomJacobianVol::value(int n, double *wt, Func<do
 Ord CustomWeakFormHeatRK::CustomJacobianVol::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, 
                                                  Geom<Ord> *e, Func<Ord>* *ext) const 
 {
-  return (u->dx[0] * v->dx[0] + u->dy[0] * v->dy[0]) * Ord(5);
+  return (u->dx[0] * v->dx[0] + u->dy[0] * v->dy[0]) * Ord(lambda_field->get_order());
 }
 
 MatrixFormVol<double>* CustomWeakFormHeatRK::CustomJacobianVol::clone() const 
@@ -78,10 +96,12 @@ double CustomWeakFormHeatRK::CustomFormResidualVol::value(int n, double *wt, Fun
                                                           Geom<double> *e, Func<double>* *ext) const 
 {
   Func<double>* u_prev_newton = u_ext[0];
+  std::vector<double> scratch;
+  const double* lambda_values = lambda_field->get_values(n, e, scratch);
   double result = 0.;
   for (int i = 0; i < n; i++) 
   {
-    result += wt[i] * lambda(e->x[i], e->y[i])
+    result += wt[i] * lambda_values[i]
                     * (u_prev_newton->dx[i] * v->dx[i] + u_prev_newton->dy[i] * v->dy[i]);
   }
 
@@ -92,8 +112,8 @@ Ord CustomWeakFormHeatRK::CustomFormResidualVol::ord(int n, double *wt, Func<Ord
                                                      Geom<Ord> *e, Func<Ord>* *ext) const 
 {
   Func<Ord>* u_prev_newton = u_ext[0];
-  // Return the polynomial order of the gradient increased by five to account for lambda(x, y).
-  return (u_prev_newton->dx[0] * v->dx[0] + u_prev_newton->dy[0] * v->dy[0]) * Ord(5);
+  // Return the polynomial order of the gradient increased to account for lambda(x, y).
+  return (u_prev_newton->dx[0] * v->dx[0] + u_prev_newton->dy[0] * v->dy[0]) * Ord(lambda_field->get_order());
 }
 
 VectorFormVol<double>* CustomWeakFormHeatRK::CustomFormResidualVol::clone() const 
@@ -102,32 +122,30 @@ VectorFormVol<double>* CustomWeakFormHeatRK::CustomFormResidualVol::clone() cons
 }
 
 
-template<typename Real, typename Scalar>
-Scalar CustomWeakFormHeatRK::CustomFormResidualSurfFire::vector_form_surf(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *v,
-                                                                          Geom<Real> *e, Func<Scalar>* *ext) const 
+double CustomWeakFormHeatRK::CustomFormResidualSurfFire::value(int n, double *wt, Func<double> *u_ext[], Func<double> *v, 
+                                                               Geom<double> *e, Func<double>* *ext) const 
 {
-  Func<Scalar>* sln_prev = u_ext[0];
+  Func<double>* sln_prev = u_ext[0];
+
+  // T_fire = T_fire_x(x) * T_fire_t(t) + 20, the spatial factor is cached.
+  std::vector<double> scratch;
+  const double* t_fire_x = t_fire_x_field->get_values(n, e, scratch);
+  double t_fire_t = T_fire_t(*current_time_ptr);
 
-  Scalar result = Scalar(0);
+  double result = 0.;
   for (int i = 0; i < n; i++) 
   {
-    result += wt[i] * (T_fire(e->x[i], *current_time_ptr) - sln_prev->val[i]) * v->val[i];
+    result += wt[i] * (t_fire_x[i] * t_fire_t + 20. - sln_prev->val[i]) * v->val[i];
   }
 
   return result / heatcap / rho * alpha_fire;
 }
 
-double CustomWeakFormHeatRK::CustomFormResidualSurfFire::value(int n, double *wt, Func<double> *u_ext[], Func<double> *v, 
-                                                               Geom<double> *e, Func<double>* *ext) const 
-{
-    return vector_form_surf<double, double>(n, wt, u_ext, v, e, ext);
-}
-
 Ord CustomWeakFormHeatRK::CustomFormResidualSurfFire::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v, 
                                                           Geom<Ord> *e, Func<Ord>* *ext) const 
 {
   // Return the polynomial order of the test function 'v' plus three for T_fire_x(x)
-  return v->val[0] * Ord(3);
+  return v->val[0] * Ord(t_fire_x_field->get_order());
 }
 
 VectorFormSurf<double>* CustomWeakFormHeatRK::CustomFormResidualSurfFire::clone() const 
@@ -135,11 +153,5 @@ VectorFormSurf<double>* CustomWeakFormHeatRK::CustomFormResidualSurfFire::clone(
   return new CustomFormResidualSurfFire(*this);
 }
 
-template<typename Real>
-Real CustomWeakFormHeatRK::CustomFormResidualSurfFire::T_fire(Real x, Real t) const 
-{
-  return T_fire_x(x) * T_fire_t(t) + 20.;
-}
-
 
 
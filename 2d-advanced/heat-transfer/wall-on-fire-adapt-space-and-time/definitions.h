@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "../../common/coefficient_field.h"
 
 /* Namespaces used */
 
@@ -26,13 +27,16 @@ public:
                        double alpha_fire, double alpha_air, double rho, double heatcap,
                        double temp_ext_air, double temp_init, double* current_time_ptr);
 
+  /// Has to be called for every new mesh before the assembly (see CoefficientField).
+  void prepare(const Mesh* mesh);
+
 private:
   // This form is custom since it contains space-dependent thermal conductivity.
   class CustomJacobianVol : public MatrixFormVol<double>
   {
   public:
-    CustomJacobianVol(int i, int j, double rho, double heatcap)
-          : MatrixFormVol<double>(i, j), rho(rho), heatcap(heatcap) {};
+    CustomJacobianVol(int i, int j, double rho, double heatcap, const CoefficientField* lambda_field)
+          : MatrixFormVol<double>(i, j), rho(rho), heatcap(heatcap), lambda_field(lambda_field) {};
 
     virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e,
                          Func<double>* *ext) const;
@@ -43,14 +47,15 @@ private:
     virtual MatrixFormVol<double>* clone() const;
 
     double rho, heatcap;
+    const CoefficientField* lambda_field;
   };
 
   // This form is custom since it contains space-dependent thermal conductivity.
   class CustomFormResidualVol : public VectorFormVol<double>
   {
   public:
-    CustomFormResidualVol(int i, double rho, double heatcap)
-          : VectorFormVol<double>(i), rho(rho), heatcap(heatcap) {};
+    CustomFormResidualVol(int i, double rho, double heatcap, const CoefficientField* lambda_field)
+          : VectorFormVol<double>(i), rho(rho), heatcap(heatcap), lambda_field(lambda_field) {};
 
     virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v, Geom<double> *e,
                          Func<double>* *ext) const;
@@ -61,20 +66,17 @@ private:
     virtual VectorFormVol<double>* clone() const;
 
     double rho, heatcap;
+    const CoefficientField* lambda_field;
   };
 
-  // Custom due to time-dependent exterior temperature.
+  // Custom due to time-dependent exterior temperature T_fire_x(x) * T_fire_t(t) + 20.
   class CustomFormResidualSurfFire : public VectorFormSurf<double>
   {
   public:
     CustomFormResidualSurfFire(int i, std::string area, double alpha_fire, double rho,
-                               double heatcap, double* current_time_ptr)
+                               double heatcap, double* current_time_ptr, const CoefficientField* t_fire_x_field)
           : VectorFormSurf<double>(i), alpha_fire(alpha_fire), rho(rho),
-          heatcap(heatcap), current_time_ptr(current_time_ptr) { this->set_area(area); };
-
-    template<typename Real, typename Scalar>
-    Scalar vector_form_surf(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *v,
-                            Geom<Real> *e, Func<Scalar>* *ext) const;
+          heatcap(heatcap), current_time_ptr(current_time_ptr), t_fire_x_field(t_fire_x_field) { this->set_area(area); };
 
     virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v, Geom<double> *e,
                          Func<double>* *ext) const;
@@ -84,11 +86,11 @@ private:
     // Needed for the rk_time_step_newton() method.
     virtual VectorFormSurf<double>* clone() const;
 
-    // Fire temperature as function of x and t.
-    template<typename Real>
-    Real T_fire(Real x, Real t) const;
-
     double alpha_fire, rho, heatcap, *current_time_ptr;
+    const CoefficientField* t_fire_x_field;
   };
+
+  // Thermal conductivity and the spatial factor of the fire temperature, sampled once per mesh.
+  CoefficientField lambda_field, t_fire_x_field;
 };
 
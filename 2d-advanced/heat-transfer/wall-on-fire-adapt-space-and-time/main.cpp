@@ -1,6 +1,7 @@
 #define HERMES_REPORT_ALL
 #define HERMES_REPORT_FILE "application.log"
 #include "definitions.h"
+#include "../../common/linear_rk.h"
 
 //  This example models a nonstationary distribution of temperature within a wall
 //  exposed to ISO fire. Spatial adaptivity is ON by default, adaptivity in time 
@@ -23,7 +24,11 @@
 //       Top edge: LAMBDA * dT/dn = ALPHA_TOP*(TEMP_EXT_AIR - T)
 //
 //  Time-stepping: Arbitrary Runge-Kutta methods (choose one of the predefined 
-//                 Butcher's tables below or create your own).
+//                 Butcher's tables below or create your own). The problem is linear,
+//                 dT/dt = A T + b(t), so the default is the LinearRungeKutta stepper
+//                 (see common/linear_rk.h): A and the mass matrix are assembled once per
+//                 reference mesh, the stage matrices factorized once per mesh and time step,
+//                 and only b(t) is assembled in the stages.
 //
 //  The following parameters can be changed:
 
@@ -101,6 +106,9 @@ const double NEWTON_TOL_COARSE = 0.001;
 const double NEWTON_TOL_FINE = 0.005;             
 // Maximum allowed number of Newton iterations.
 const int NEWTON_MAX_ITER = 100;                  
+// Use the linear R-K stepper (explicit and diagonally implicit methods only), 
+// otherwise the Newton's method is used in each time step.
+bool LINEAR_RK = true;
 
 // Choose one of the following time-integration methods, or define your own Butcher's table. The last number 
 // in the name of each method is its order. The one before last, if present, is the number of stages.
@@ -156,6 +164,12 @@ int main(int argc, char* argv[])
     ADAPTIVE_TIME_STEP_ON = false;
   }
 
+  // Turn off the linear R-K stepper if the R-K method is fully implicit.
+  if (bt.is_fully_implicit() && LINEAR_RK == true) {
+    Hermes::Mixins::Loggable::Static::warn("R-K method fully implicit, turning off the linear R-K stepper.");
+    LINEAR_RK = false;
+  }
+
   // Load the mesh.
   Mesh mesh, basemesh;
   MeshReaderH2D mloader;
@@ -186,6 +200,15 @@ int main(int argc, char* argv[])
   // Initialize the FE problem.
   DiscreteProblem<double> dp(&wf, &space);
 
+  // Initialize the linear R-K stepper, the fire temperature is its time-dependent source.
+  LinearRungeKutta* linear_rk = NULL;
+  if (LINEAR_RK)
+  {
+    linear_rk = new LinearRungeKutta(&wf, Hermes::vector<const Space<double>*>(&space), &bt);
+    // The fire boundary is the only time-dependent source, and it is affine in T_fire_t(t).
+    linear_rk->set_source(&current_time, T_fire_t<double>);
+  }
+
   // Create a refinement selector.
   H1ProjBasedSelector<double> selector(CAND_LIST, CONV_EXP, H2DRS_DEFAULT_ORDER);
 
@@ -240,31 +263,36 @@ int main(int argc, char* argv[])
     Solution<double> time_error_fn(&mesh);
     bool done = false; int as = 1;
     double err_est;
+    Space<double>* ref_space = NULL;
     do {
-      // Construct globally refined reference mesh and setup reference space.
-      Mesh::ReferenceMeshCreator refMeshCreator(&mesh);
-      Mesh* ref_mesh = refMeshCreator.create_ref_mesh();
+      // Construct globally refined reference mesh and setup reference space. A time step repeated
+      // with a shorter time step keeps them (and the linear R-K stepper its assembled operators).
+      if (ref_space == NULL)
+      {
+        Mesh::ReferenceMeshCreator refMeshCreator(&mesh);
+        Mesh* ref_mesh = refMeshCreator.create_ref_mesh();
 
-      Space<double>::ReferenceSpaceCreator refSpaceCreator(&space, ref_mesh);
-      Space<double>* ref_space = refSpaceCreator.create_ref_space();
+        Space<double>::ReferenceSpaceCreator refSpaceCreator(&space, ref_mesh);
+        ref_space = refSpaceCreator.create_ref_space();
 
-      // Initialize Runge-Kutta time stepping on the reference mesh.
-      RungeKutta<double> runge_kutta(&wf, ref_space, &bt);
+        // Make room for the coefficients on the new reference mesh (elements that did not change keep theirs).
+        wf.prepare(ref_mesh);
 
-      try
-      {
-        ogProjection.project_global(ref_space, &sln_prev_time, 
-                                   &sln_prev_time);
-        if(ts > 1)
-          delete sln_prev_time.get_mesh();
-      }
-      catch(Exceptions::Exception& e)
-      {
-        std::cout << e.what() << std::endl;
-        Hermes::Mixins::Loggable::Static::error("Projection failed.");
-        delete ref_space->get_mesh();
-        delete ref_space;
-        return -1;
+        try
+        {
+          ogProjection.project_global(ref_space, &sln_prev_time, 
+                                     &sln_prev_time);
+          if(ts > 1)
+            delete sln_prev_time.get_mesh();
+        }
+        catch(Exceptions::Exception& e)
+        {
+          std::cout << e.what() << std::endl;
+          Hermes::Mixins::Loggable::Static::error("Projection failed.");
+          delete ref_space->get_mesh();
+          delete ref_space;
+          return -1;
+        }
       }
 
       // Runge-Kutta step on the fine mesh.
@@ -275,11 +303,27 @@ int main(int argc, char* argv[])
 
       try
       {
-        runge_kutta.set_time(current_time);
-        runge_kutta.set_time_step(time_step);
-        runge_kutta.set_newton_max_iter(NEWTON_MAX_ITER);
-        runge_kutta.set_newton_tol(NEWTON_TOL_FINE);
-        runge_kutta.rk_time_step_newton(&sln_prev_time, &ref_sln, bt.is_embedded() ? &time_error_fn : NULL);
+        if (LINEAR_RK)
+        {
+          Hermes::vector<Solution<double>*> error_fns;
+          if (bt.is_embedded())
+            error_fns.push_back(&time_error_fn);
+          linear_rk->set_spaces(Hermes::vector<const Space<double>*>(ref_space));
+          linear_rk->set_time(current_time);
+          linear_rk->set_time_step(time_step);
+          linear_rk->rk_time_step(Hermes::vector<Solution<double>*>(&sln_prev_time),
+                                  Hermes::vector<Solution<double>*>(&ref_sln), error_fns);
+        }
+        else
+        {
+          // Initialize Runge-Kutta time stepping on the reference mesh.
+          RungeKutta<double> runge_kutta(&wf, ref_space, &bt);
+          runge_kutta.set_time(current_time);
+          runge_kutta.set_time_step(time_step);
+          runge_kutta.set_newton_max_iter(NEWTON_MAX_ITER);
+          runge_kutta.set_newton_tol(NEWTON_TOL_FINE);
+          runge_kutta.rk_time_step_newton(&sln_prev_time, &ref_sln, bt.is_embedded() ? &time_error_fn : NULL);
+        }
       }
       catch(Exceptions::Exception& e)
       {
@@ -379,7 +423,10 @@ int main(int argc, char* argv[])
       
       // Clean up.
       if(!done)
+      {
         delete ref_space;
+        ref_space = NULL;
+      }
       delete adaptivity;
     }
     while (done == false);
@@ -403,6 +450,8 @@ int main(int argc, char* argv[])
   }
   while (current_time < T_FINAL);
 
+  delete linear_rk;
+
   // Wait for all views to be closed.
   View::wait();
   return 0;
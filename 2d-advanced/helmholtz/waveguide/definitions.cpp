@@ -17,19 +17,50 @@ double EssentialBCNonConst::value(double x, double y, double n_x, double n_y, do
 }
 
 WeakFormHelmholtz::WeakFormHelmholtz(double eps, double mu, double omega, double sigma, double beta, 
-    double E0, double h) : WeakForm<double>(2)
+    double E0, double h, const PerfectlyMatchedLayer* pml, bool volume_jacobian, const std::string& pml_area) : WeakForm<double>(2)
 {
   // Jacobian.
-  add_matrix_form(new MatrixFormHelmholtzEquation_real_real(0, 0, eps, omega, mu));
-  add_matrix_form(new MatrixFormHelmholtzEquation_real_imag(0, 1, mu, omega, sigma));
-  add_matrix_form(new MatrixFormHelmholtzEquation_imag_real(1, 0, mu, omega, sigma));
-  add_matrix_form(new MatrixFormHelmholtzEquation_imag_imag(1, 1, eps, mu, omega));
+  if (volume_jacobian && pml == NULL)
+  {
+    add_matrix_form(new MatrixFormHelmholtzEquation_real_real(0, 0, eps, omega, mu));
+    add_matrix_form(new MatrixFormHelmholtzEquation_real_imag(0, 1, mu, omega, sigma));
+    add_matrix_form(new MatrixFormHelmholtzEquation_imag_real(1, 0, mu, omega, sigma));
+    add_matrix_form(new MatrixFormHelmholtzEquation_imag_imag(1, 1, eps, mu, omega));
+  }
+  else if (volume_jacobian || (pml != NULL && pml_area != HERMES_ANY))
+  {
+    // The complex coefficient of the mass term, -omega^2 mu eps + j omega mu sigma.
+    std::complex<double> c_m(-sqr(omega) * mu * eps, omega * mu * sigma);
+    MatrixFormVol<double>* forms[4] =
+    {
+      new PmlMatrixFormVolSplit(0, 0, false, false, pml, 1.0, c_m),
+      new PmlMatrixFormVolSplit(0, 1, false, true, pml, 1.0, c_m),
+      new PmlMatrixFormVolSplit(1, 0, true, false, pml, 1.0, c_m),
+      new PmlMatrixFormVolSplit(1, 1, true, true, pml, 1.0, c_m)
+    };
+    for (int k = 0; k < 4; k++)
+    {
+      // Only the layer, the rest is applied by the sum-factorized operator.
+      if (!volume_jacobian)
+        forms[k]->set_area(pml_area);
+      add_matrix_form(forms[k]);
+    }
+  }
   add_matrix_form_surf(new  MatrixFormSurfHelmholtz_real_imag(0, 1, "Bdy_impedance", beta));
   add_matrix_form_surf(new  MatrixFormSurfHelmholtz_imag_real(1, 0, "Bdy_impedance", beta));
 
   // Residual.
-  add_vector_form(new VectorFormHelmholtzEquation_real(0, eps, omega, mu, sigma));
-  add_vector_form(new VectorFormHelmholtzEquation_imag(1, eps, omega, mu, sigma));
+  if (pml == NULL)
+  {
+    add_vector_form(new VectorFormHelmholtzEquation_real(0, eps, omega, mu, sigma));
+    add_vector_form(new VectorFormHelmholtzEquation_imag(1, eps, omega, mu, sigma));
+  }
+  else
+  {
+    std::complex<double> c_m(-sqr(omega) * mu * eps, omega * mu * sigma);
+    add_vector_form(new PmlVectorFormVolSplit(0, false, 0, 1, pml, 1.0, c_m));
+    add_vector_form(new PmlVectorFormVolSplit(1, true, 0, 1, pml, 1.0, c_m));
+  }
   add_vector_form_surf(new VectorFormSurfHelmholtz_real(0, "Bdy_impedance", beta));
   add_vector_form_surf(new VectorFormSurfHelmholtz_imag(1, "Bdy_impedance", beta));  
 }
@@ -1,4 +1,8 @@
 #include "hermes2d.h"
+#include "../../common/frequency_sweep.h"
+#include "../../common/shifted_laplacian.h"
+#include "../../common/pml.h"
+#include "../../common/sum_factorization.h"
 
 
 /* Namespaces used */
@@ -27,7 +31,12 @@ public:
 class WeakFormHelmholtz : public WeakForm<double>
 {
 public:
-    WeakFormHelmholtz(double eps, double mu, double omega, double sigma, double beta, double E0, double h);
+    // With 'pml', the volumetric forms are integrated with the perfectly matched layer. Without
+    // 'volume_jacobian', the volumetric Jacobian forms are left out (e.g. applied by SumFactorizedOperator),
+    // except in the material 'pml_area' of the layer if there is one.
+    WeakFormHelmholtz(double eps, double mu, double omega, double sigma, double beta, double E0, double h,
+                      const PerfectlyMatchedLayer* pml = NULL, bool volume_jacobian = true,
+                      const std::string& pml_area = HERMES_ANY);
 
 private:
     class MatrixFormHelmholtzEquation_real_real : public MatrixFormVol<double>
@@ -37,6 +37,36 @@ MatrixSolverType matrix_solver = SOLVER_UMFPACK;
 const double NEWTON_TOL = 1e-8;
 const int NEWTON_MAX_ITER = 100;
 
+// Iterative solver preconditioned by the complex shifted Laplacian (ILU(0) of the shifted problem),
+// its memory is linear in ndof; the solve fails if it does not converge. If false, the Newton's method
+// with the direct solver is used.
+const bool SHIFTED_LAPLACIAN = false;
+// Shift beta_1 + i beta_2 of the wave number squared in the preconditioner.
+const double SHIFT_BETA_1 = 1.0;
+const double SHIFT_BETA_2 = 0.5;
+// Krylov method: GMRES, BICGSTAB.
+const ShiftedLaplacianSolver<double>::Method ITERATIVE_METHOD = ShiftedLaplacianSolver<double>::GMRES;
+// Relative tolerance of the residual and maximum number of iterations.
+const double ITERATIVE_TOL = 1e-8;
+const int ITERATIVE_MAX_ITER = 2000;
+
+// If true, the volumetric terms of the iterative solver are applied matrix-free by the sum-factorized
+// quadrilateral kernels, which also assemble the preconditioner; only the surface terms (and with USE_PML
+// the volumetric terms of the layer, whose coefficients vary) are assembled as usual.
+const bool SUM_FACTORIZATION = false;
+
+// Perfectly matched layer in front of the impedance boundary (the impedance condition is exact
+// for the dominant mode only, the layer absorbs the other components of the field as well).
+// The layer extends the waveguide beyond x = 0.5 (the material "Pml" of domain_pml.mesh),
+// the impedance condition is then at its end. Off by default (the mesh domain.mesh without the layer).
+const bool USE_PML = false;
+// Thickness of the layer, that of the extension in domain_pml.mesh.
+const double PML_THICKNESS = 0.125;
+// Strength alpha and degree of the stretching profile 1 + j alpha (xi / thickness)^degree,
+// one pass through the layer attenuates the wave by exp(-beta alpha thickness / (degree + 1)).
+const double PML_ALPHA = 4.0;
+const int PML_DEGREE = 2;
+
 // Problem parameters.
 // Relative permittivity.
 const double epsr = 1.0;                    
@@ -61,12 +91,34 @@ const double E0 = 100;
 // Height of waveguide.
 const double h = 0.1;                       
 
+// Frequency sweep.
+// Number of frequencies of the sweep, off by default (0 ... no sweep). Set e.g. to 50
+// to solve at as many frequencies in SWEEP_FREQ_MIN ... SWEEP_FREQ_MAX, the norms are saved to sweep.dat.
+const int SWEEP_NUM = 0;
+// Range of the sweep.
+const double SWEEP_FREQ_MIN = 2.5e9;
+const double SWEEP_FREQ_MAX = 3.5e9;
+// If true, the sweep uses the reduced (moment-matching) model about 'frequency',
+// otherwise the full problem is solved for every frequency.
+const bool SWEEP_REDUCED = false;
+// Number of moments of the reduced model.
+const int SWEEP_MOMENTS = 12;
+
+// Blocks of the volumetric operator of the real-split Helmholtz equation.
+static void set_helmholtz_blocks(SumFactorizedOperator<double>& op, double eps, double mu, double omega, double sigma)
+{
+  op.set_block(0, 0, 1.0, -sqr(omega) * mu * eps);
+  op.set_block(0, 1, 0.0, -omega * mu * sigma);
+  op.set_block(1, 0, 0.0, omega * mu * sigma);
+  op.set_block(1, 1, 1.0, -sqr(omega) * mu * eps);
+}
+
 int main(int argc, char* argv[])
 {
     // Load the mesh.
   Mesh mesh;
   MeshReaderH2D mloader;
-  mloader.load("domain.mesh", &mesh);
+  mloader.load(USE_PML ? "domain_pml.mesh" : "domain.mesh", &mesh);
 
   // Perform uniform mesh refinement.
   // 2 is for vertical split.
@@ -85,8 +137,13 @@ int main(int argc, char* argv[])
   int ndof = Space<double>::get_num_dofs(&e_r_space);
   Hermes::Mixins::Loggable::Static::info("ndof = %d", ndof);
 
+  // Initialize the perfectly matched layer at x > 0.5.
+  PerfectlyMatchedLayer pml_layer(-1e10, 0.5, -1e10, 1e10, PML_THICKNESS, PML_ALPHA, PML_DEGREE);
+  pml_layer.prepare(&mesh);
+  const PerfectlyMatchedLayer* pml = USE_PML ? &pml_layer : NULL;
+
   // Initialize the weak formulation.
-  WeakFormHelmholtz wf(eps, mu, omega, sigma, beta, E0, h);
+  WeakFormHelmholtz wf(eps, mu, omega, sigma, beta, E0, h, pml);
 
   // Initialize the FE problem.
   DiscreteProblem<double> dp(&wf, Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space));
@@ -97,22 +154,127 @@ int main(int argc, char* argv[])
   // Initial coefficient vector for the Newton's method.  
   ndof = Space<double>::get_num_dofs(Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space));
 
-  Hermes::Hermes2D::NewtonSolver<double> newton(&dp);
-  try
+  double* coeff_vec = new double[ndof];
+  memset(coeff_vec, 0, ndof * sizeof(double));
+
+  if (SHIFTED_LAPLACIAN && SUM_FACTORIZATION)
   {
-    newton.set_newton_tol(NEWTON_TOL);
-    newton.set_newton_max_iter(NEWTON_MAX_ITER);
-    newton.solve();
+    // The kernels cover the waveguide, the layer (if any) is assembled with the surface terms.
+    std::string pml_area = USE_PML ? "Pml" : HERMES_ANY;
+
+    // Surface terms (and the layer) and the right-hand side (the residual at zero).
+    WeakFormHelmholtz wf_surf(eps, mu, omega, sigma, beta, E0, h, pml, false, pml_area);
+    DiscreteProblem<double> dp_surf(&wf_surf, Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space));
+    SparseMatrix<double>* surf_matrix = create_matrix<double>();
+    Vector<double>* rhs = create_vector<double>();
+    dp_surf.assemble(coeff_vec, surf_matrix, rhs);
+    rhs->change_sign();
+
+    SumFactorizedOperator<double> op(Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space), USE_PML ? "Mat" : HERMES_ANY);
+
+    // Preconditioner with the shifted coefficients, as below (in the layer as well).
+    WeakFormHelmholtz wf_surf_shifted(SHIFT_BETA_1 * eps, mu, omega, sigma + SHIFT_BETA_2 * omega * eps, beta, E0, h, pml, false, pml_area);
+    DiscreteProblem<double> dp_surf_shifted(&wf_surf_shifted, Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space));
+    SparseMatrix<double>* surf_matrix_shifted = create_matrix<double>();
+    dp_surf_shifted.assemble(coeff_vec, surf_matrix_shifted);
+    op.set_remainder(surf_matrix_shifted);
+    set_helmholtz_blocks(op, SHIFT_BETA_1 * eps, mu, omega, sigma + SHIFT_BETA_2 * omega * eps);
+    SparseMatrix<double>* precond_matrix = create_matrix<double>();
+    op.assemble(precond_matrix);
+    op.set_remainder(surf_matrix);
+    set_helmholtz_blocks(op, eps, mu, omega, sigma);
+
+    ShiftedLaplacianSolver<double> solver(&op, precond_matrix, ITERATIVE_METHOD);
+    solver.set_tolerance(ITERATIVE_TOL);
+    solver.set_max_iters(ITERATIVE_MAX_ITER);
+    if (!solver.solve(rhs, coeff_vec))
+      throw Hermes::Exceptions::Exception("Iterative solver did not converge, relative residual %g.", solver.get_residual());
+
+    delete surf_matrix;
+    delete surf_matrix_shifted;
+    delete precond_matrix;
+    delete rhs;
+  }
+  else if (SHIFTED_LAPLACIAN)
+  {
+    // The problem is linear: the Jacobian at zero is the matrix and minus the residual the right-hand side.
+    SparseMatrix<double>* matrix = create_matrix<double>();
+    Vector<double>* rhs = create_vector<double>();
+    dp.assemble(coeff_vec, matrix, rhs);
+    rhs->change_sign();
+
+    // Preconditioner: the same problem with the wave number squared times beta_1 + i beta_2,
+    // the imaginary part of the shift is realized as an artificial conductivity.
+    WeakFormHelmholtz wf_shifted(SHIFT_BETA_1 * eps, mu, omega, sigma + SHIFT_BETA_2 * omega * eps, beta, E0, h, pml);
+    DiscreteProblem<double> dp_shifted(&wf_shifted, Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space));
+    SparseMatrix<double>* precond_matrix = create_matrix<double>();
+    dp_shifted.assemble(coeff_vec, precond_matrix);
+
+    ShiftedLaplacianSolver<double> solver(matrix, precond_matrix, ITERATIVE_METHOD);
+    solver.set_tolerance(ITERATIVE_TOL);
+    solver.set_max_iters(ITERATIVE_MAX_ITER);
+    if (!solver.solve(rhs, coeff_vec))
+      throw Hermes::Exceptions::Exception("Iterative solver did not converge, relative residual %g.", solver.get_residual());
+
+    delete matrix;
+    delete precond_matrix;
+    delete rhs;
   }
-  catch(Hermes::Exceptions::Exception e)
+  else
   {
-    e.print_msg();
-    throw Hermes::Exceptions::Exception("Newton's iteration failed.");
-  };
+    Hermes::Hermes2D::NewtonSolver<double> newton(&dp);
+    try
+    {
+      newton.set_newton_tol(NEWTON_TOL);
+      newton.set_newton_max_iter(NEWTON_MAX_ITER);
+      newton.solve();
+    }
+    catch(Hermes::Exceptions::Exception e)
+    {
+      e.print_msg();
+      throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+    };
+    memcpy(coeff_vec, newton.get_sln_vector(), ndof * sizeof(double));
+  }
 
   // Translate the resulting coefficient vector into Solutions.
-  Solution<double>::vector_to_solutions(newton.get_sln_vector(), Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space), 
+  Solution<double>::vector_to_solutions(coeff_vec, Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space), 
       Hermes::vector<Solution<double>*>(&e_r_sln, &e_i_sln));
+  delete [] coeff_vec;
+
+  // Frequency sweep.
+  if (SWEEP_NUM > 0)
+  {
+    Hermes::Mixins::Loggable::Static::info("Frequency sweep.");
+    WeakFormHelmholtz wf_0(eps, mu, 0.0, sigma, beta, E0, h, pml);
+    WeakFormHelmholtz wf_minus(eps, mu, -omega, sigma, beta, E0, h, pml);
+    FrequencySweep<double> sweep(Hermes::vector<WeakForm<double>*>(&wf_0, &wf, &wf_minus), omega,
+                                 Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space));
+
+    std::vector<double> omegas;
+    for (int f = 0; f < SWEEP_NUM; f++)
+      omegas.push_back(2 * M_PI * (SWEEP_FREQ_MIN + (SWEEP_NUM > 1 ? f * (SWEEP_FREQ_MAX - SWEEP_FREQ_MIN) / (SWEEP_NUM - 1) : 0.0)));
+    std::vector<double*> coeff_vecs;
+    if (SWEEP_REDUCED)
+      sweep.solve_reduced(omegas, omega, SWEEP_MOMENTS, coeff_vecs);
+    else
+      sweep.solve(omegas, coeff_vecs);
+
+    // L2 norm of the electric field as a function of the frequency.
+    SimpleGraph graph_sweep;
+    Solution<double> sweep_r_sln, sweep_i_sln;
+    for (int f = 0; f < SWEEP_NUM; f++)
+    {
+      Solution<double>::vector_to_solutions(coeff_vecs[f], Hermes::vector<const Space<double>*>(&e_r_space, &e_i_space), 
+          Hermes::vector<Solution<double>*>(&sweep_r_sln, &sweep_i_sln));
+      double norm = std::sqrt(sqr(Global<double>::calc_norm(&sweep_r_sln, HERMES_L2_NORM))
+                              + sqr(Global<double>::calc_norm(&sweep_i_sln, HERMES_L2_NORM)));
+      graph_sweep.add_values(omegas[f] / (2 * M_PI), norm);
+      delete [] coeff_vecs[f];
+    }
+    graph_sweep.save("sweep.dat");
+    Hermes::Mixins::Loggable::Static::info("Frequency sweep saved to file %s.", "sweep.dat");
+  }
 
   // Visualize the solution.
   ScalarView viewEr("Er [V/m]", new WinGeom(0, 0, 800, 400));
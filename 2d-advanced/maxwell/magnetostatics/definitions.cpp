@@ -1,7 +1,108 @@
 #include "definitions.h"
 
+// Buffer for the quadrature point values of the reluctivity, larger element quadratures use the heap.
+static const int NU_BUFFER_SIZE = 512;
+
+CustomJacobianMagnetostatics::CustomJacobianMagnetostatics(int i, int j, Hermes::vector<std::string> areas,
+                                                           UniformCubicSpline* nu, int order_inc)
+  : MatrixFormVol<double>(i, j), nu(nu), order_inc(order_inc)
+{
+  this->set_areas(areas);
+}
+
+double CustomJacobianMagnetostatics::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v,
+                                           Geom<double> *e, Func<double>* *ext) const
+{
+  double buffer[3 * NU_BUFFER_SIZE];
+  double* B = (n <= NU_BUFFER_SIZE) ? buffer : new double[3 * n];
+  double* nu_val = B + n;
+  double* nu_der = B + 2 * n;
+
+  for (int i = 0; i < n; i++)
+    B[i] = std::sqrt(sqr(u_ext[0]->dx[i]) + sqr(u_ext[0]->dy[i]));
+  nu->evaluate(n, B, nu_val, nu_der);
+
+  double planar_part = 0.0, axisym_part = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    double grad_u_ext_u = u_ext[0]->dx[i] * u->dx[i] + u_ext[0]->dy[i] * u->dy[i];
+    if (std::abs(B[i]) > 1e-12)
+    {
+      double factor = wt[i] * nu_der[i] / B[i] * grad_u_ext_u;
+      planar_part += factor * (u_ext[0]->dx[i] * v->dx[i] + u_ext[0]->dy[i] * v->dy[i]);
+      axisym_part += factor / e->x[i] * u_ext[0]->val[i] * v->dx[i];
+    }
+    planar_part += wt[i] * nu_val[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
+    axisym_part += wt[i] * nu_val[i] / e->x[i] * u->val[i] * v->dx[i];
+  }
+
+  if (B != buffer)
+    delete [] B;
+  return planar_part + axisym_part;
+}
+
+Ord CustomJacobianMagnetostatics::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                                      Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  Ord result = Ord(0);
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u_ext[0]->dx[i] * u->dx[i] + u_ext[0]->dy[i] * u->dy[i])
+              * (u_ext[0]->dx[i] * v->dx[i] + u_ext[0]->dy[i] * v->dy[i]);
+  return result * Ord(order_inc);
+}
+
+MatrixFormVol<double>* CustomJacobianMagnetostatics::clone() const
+{
+  return new CustomJacobianMagnetostatics(*this);
+}
+
+CustomResidualMagnetostatics::CustomResidualMagnetostatics(int i, Hermes::vector<std::string> areas,
+                                                           UniformCubicSpline* nu, int order_inc)
+  : VectorFormVol<double>(i), nu(nu), order_inc(order_inc)
+{
+  this->set_areas(areas);
+}
+
+double CustomResidualMagnetostatics::value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                                           Geom<double> *e, Func<double>* *ext) const
+{
+  double buffer[3 * NU_BUFFER_SIZE];
+  double* B = (n <= NU_BUFFER_SIZE) ? buffer : new double[3 * n];
+  double* nu_val = B + n;
+  double* nu_der = B + 2 * n;
+
+  for (int i = 0; i < n; i++)
+    B[i] = std::sqrt(sqr(u_ext[0]->dx[i]) + sqr(u_ext[0]->dy[i]));
+  nu->evaluate(n, B, nu_val, nu_der);
+
+  double planar_part = 0.0, axisym_part = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    planar_part += wt[i] * nu_val[i] * (u_ext[0]->dx[i] * v->dx[i] + u_ext[0]->dy[i] * v->dy[i]);
+    axisym_part += wt[i] * nu_val[i] / e->x[i] * u_ext[0]->val[i] * v->dx[i];
+  }
+
+  if (B != buffer)
+    delete [] B;
+  return planar_part + axisym_part;
+}
+
+Ord CustomResidualMagnetostatics::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                                      Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  Ord result = Ord(0);
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u_ext[0]->dx[i] * v->dx[i] + u_ext[0]->dy[i] * v->dy[i]);
+  return result * Ord(order_inc);
+}
+
+VectorFormVol<double>* CustomResidualMagnetostatics::clone() const
+{
+  return new CustomResidualMagnetostatics(*this);
+}
+
 CustomWeakFormMagnetostatics::CustomWeakFormMagnetostatics(std::string material_iron_1, std::string material_iron_2,
-  CubicSpline* mu_inv_iron, std::string material_air,
+  UniformCubicSpline* mu_inv_iron, std::string material_air,
   std::string material_copper, double mu_vacuum,
   double current_density, int order_inc) : WeakForm<double>(1) 
 {
@@ -9,13 +110,13 @@ CustomWeakFormMagnetostatics::CustomWeakFormMagnetostatics(std::string material_
   // Jacobian.
   add_matrix_form(new DefaultJacobianMagnetostatics<double>(0, 0, Hermes::vector<std::string>(material_air, material_copper), 
     1.0, HERMES_DEFAULT_SPLINE, HERMES_NONSYM, HERMES_AXISYM_Y, order_inc));
-  add_matrix_form(new DefaultJacobianMagnetostatics<double>(0, 0, Hermes::vector<std::string>(material_iron_1, material_iron_2), 1.0,
-    mu_inv_iron, HERMES_NONSYM, HERMES_AXISYM_Y, order_inc));
+  add_matrix_form(new CustomJacobianMagnetostatics(0, 0, Hermes::vector<std::string>(material_iron_1, material_iron_2),
+    mu_inv_iron, order_inc));
   // Residual.
   add_vector_form(new DefaultResidualMagnetostatics<double>(0, Hermes::vector<std::string>(material_air, material_copper), 
     1.0, HERMES_ONE, HERMES_AXISYM_Y, order_inc));
-  add_vector_form(new DefaultResidualMagnetostatics<double>(0, Hermes::vector<std::string>(material_iron_1, material_iron_2), 1.0, 
-    mu_inv_iron, HERMES_AXISYM_Y, order_inc));
+  add_vector_form(new CustomResidualMagnetostatics(0, Hermes::vector<std::string>(material_iron_1, material_iron_2),
+    mu_inv_iron, order_inc));
   add_vector_form(new DefaultVectorFormVol<double>(0, material_copper, new Hermes2DFunction<double>(-current_density * mu_vacuum)));
 }
 
@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "../../common/uniform_spline.h"
 
 /* Namespaces used */
 
@@ -11,11 +12,51 @@ using namespace Hermes::Hermes2D::WeakFormsMaxwell;
 
 /* Weak forms */
 
+// Jacobian and residual of the axisymmetric (HERMES_AXISYM_Y) magnetostatics with a nonlinear reluctivity,
+// as DefaultJacobianMagnetostatics and DefaultResidualMagnetostatics, but the reluctivity and its derivative
+// are evaluated for all quadrature points at once by UniformCubicSpline::evaluate().
+
+class CustomJacobianMagnetostatics : public MatrixFormVol<double>
+{
+public:
+  CustomJacobianMagnetostatics(int i, int j, Hermes::vector<std::string> areas, UniformCubicSpline* nu, int order_inc = 3);
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v,
+                       Geom<double> *e, Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                  Geom<Ord> *e, Func<Ord>* *ext) const;
+
+  virtual MatrixFormVol<double>* clone() const;
+
+private:
+  UniformCubicSpline* nu;
+  int order_inc;
+};
+
+class CustomResidualMagnetostatics : public VectorFormVol<double>
+{
+public:
+  CustomResidualMagnetostatics(int i, Hermes::vector<std::string> areas, UniformCubicSpline* nu, int order_inc = 3);
+
+  virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                       Geom<double> *e, Func<double>* *ext) const;
+
+  virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                  Geom<Ord> *e, Func<Ord>* *ext) const;
+
+  virtual VectorFormVol<double>* clone() const;
+
+private:
+  UniformCubicSpline* nu;
+  int order_inc;
+};
+
 class CustomWeakFormMagnetostatics : public WeakForm<double>
 {
 public:
   CustomWeakFormMagnetostatics(std::string material_iron_1, std::string material_iron_2,
-                               CubicSpline* mu_inv_iron, std::string material_air,
+                               UniformCubicSpline* mu_inv_iron, std::string material_air,
                                std::string material_copper, double mu_vacuum,
                                double current_density, int order_inc = 3);
 };
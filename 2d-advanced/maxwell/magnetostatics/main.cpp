@@ -27,6 +27,10 @@ const int INIT_REF_NUM = 0;
 // Matrix solver: SOLVER_AMESOS, SOLVER_AZTECOO, SOLVER_MUMPS,
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 MatrixSolverType matrix_solver = SOLVER_UMFPACK;  
+// Number of cells of the grid the reluctivity spline is resampled on, and the grid:
+// GRID_UNIFORM, GRID_LOG (cells concentrated at small flux densities).
+const int SPLINE_CELLS = 1024;
+const UniformCubicSpline::GridType SPLINE_GRID = UniformCubicSpline::GRID_UNIFORM;
 
 // Problem parameters.
 double MU_VACUUM = 4. * M_PI * 1e-7;
@@ -57,14 +61,16 @@ int main(int argc, char* argv[])
   bool first_der_right = false;
   bool extrapolate_der_left = false;
   bool extrapolate_der_right = false;
-  CubicSpline mu_inv_iron(mu_inv_pts, mu_inv_val, bc_left, bc_right, first_der_left, first_der_right,
-                          extrapolate_der_left, extrapolate_der_right);
+  // The spline is resampled on a grid of SPLINE_CELLS cells for constant-time evaluation.
+  UniformCubicSpline mu_inv_iron(mu_inv_pts, mu_inv_val, bc_left, bc_right, first_der_left, first_der_right,
+                                 extrapolate_der_left, extrapolate_der_right, SPLINE_CELLS, SPLINE_GRID);
+  Hermes::Mixins::Loggable::Static::info("Spline resampled on %d cells, max. difference %g.", 
+      SPLINE_CELLS, mu_inv_iron.get_resampling_error());
   Hermes::Mixins::Loggable::Static::info("Saving cubic spline into a Pylab file spline.dat.");
   // The interval of definition of the spline will be
   // extended by "interval_extension" on both sides.
   double interval_extension = 1.0; 
   bool plot_derivative = false;
-  mu_inv_iron.calculate_coeffs();
   mu_inv_iron.plot("spline.dat", interval_extension, plot_derivative);
   plot_derivative = true;
   mu_inv_iron.plot("spline_der.dat", interval_extension, plot_derivative);
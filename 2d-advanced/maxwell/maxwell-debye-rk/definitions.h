@@ -1,4 +1,6 @@
 #include "hermes2d.h"
+#include "../../common/linear_rk.h"
+#include "../../common/kelly_estimators.h"
 
 /* Namespaces used */
 
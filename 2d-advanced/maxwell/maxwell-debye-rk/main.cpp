@@ -6,6 +6,9 @@
 // E, H and P. Here E is electric field (vector), H magnetic field (scalar), and P 
 // electric polarization (vector). The example comes with a known exact solution. 
 // Time discretization is performed using an arbitrary Runge-Kutta method.
+// Since the problem is linear and time-invariant, the default is the LinearRungeKutta
+// stepper (see common/linear_rk.h), which only assembles and factorizes the stage 
+// matrices when the reference spaces change.
 //
 // PDE system:
 //
@@ -35,6 +38,9 @@ const double T_FINAL = 35.0;
 const double NEWTON_TOL = 1e-4;                  
 // Maximum allowed number of Newton iterations.
 const int NEWTON_MAX_ITER = 100;                   
+// Use the linear R-K stepper (explicit and diagonally implicit methods only), 
+// otherwise the Newton's method is used in each time step.
+const bool LINEAR_RK = true;
 
 // Choose one of the following time-integration methods, or define your own Butcher's table. The last number 
 // in the name of each method is its order. The one before last, if present, is the number of stages.
@@ -99,6 +105,13 @@ const double CONV_EXP = 1;
 // fine mesh and coarse mesh solution in percent).
 const double ERR_STOP = 0.5;  
 
+// Estimate the error by the jumps of the solutions across the element edges (KellyTypeAdapt),
+// without the solutions on globally refined reference meshes. The hp decisions are then made
+// by the decay of the coefficients, see common/kelly_estimators.h.
+const bool REFERENCE_FREE_ESTIMATOR = false;
+// Decay of the coefficients below which an element is refined in p (reference-free estimator only).
+const double SMOOTHNESS_THRESHOLD = 0.5;
+
 // Stopping criterion for adaptivity (number of adaptivity steps).
 const int ADAPTIVITY_STEPS = 5;
 
@@ -128,6 +141,23 @@ const double OMEGA = 1.5;
 double K_x = 1.0;
 double K_y = 1.0;
 
+// Returns true if the mesh or the element orders of the space differ from those of the previous call
+// (always for empty 'orders'), and records them.
+static bool coarse_space_changed(const Space<double>* space, unsigned int& mesh_seq, std::vector<int>& orders)
+{
+  std::vector<int> new_orders;
+  Element* e;
+  for_all_active_elements(e, space->get_mesh())
+  {
+    new_orders.push_back(e->id);
+    new_orders.push_back(space->get_element_order(e->id));
+  }
+  bool changed = orders.empty() || space->get_mesh()->get_seq() != mesh_seq || new_orders != orders;
+  mesh_seq = space->get_mesh()->get_seq();
+  orders = new_orders;
+  return changed;
+}
+
 int main(int argc, char* argv[])
 {
 	try
@@ -226,10 +256,23 @@ int main(int argc, char* argv[])
     runge_kutta.set_newton_max_iter(NEWTON_MAX_ITER);
 		runge_kutta.set_newton_tol(NEWTON_TOL);
 		runge_kutta.set_verbose_output(true);
+		LinearRungeKutta* linear_rk = NULL;
+		if (LINEAR_RK)
+			linear_rk = new LinearRungeKutta(&wf, spaces_const, &bt);
 
 		// Initialize refinement selector.
 		H1ProjBasedSelector<double> H1selector(CAND_LIST, CONV_EXP, MAX_P_ORDER);
 		HcurlProjBasedSelector<double> HcurlSelector(CAND_LIST, CONV_EXP, MAX_P_ORDER);
+		SmoothnessSelector E_smoothness(&E_space, MAX_P_ORDER, SMOOTHNESS_THRESHOLD);
+		SmoothnessSelector H_smoothness(&H_space, MAX_P_ORDER, SMOOTHNESS_THRESHOLD);
+		SmoothnessSelector P_smoothness(&P_space, MAX_P_ORDER, SMOOTHNESS_THRESHOLD);
+
+		// Reference meshes and spaces of the components E, H, P (kept over the adaptivity and time steps),
+		// and the state of the coarse spaces they belong to.
+		Mesh* ref_meshes[3] = { NULL, NULL, NULL };
+		Space<double>* ref_spaces[3] = { NULL, NULL, NULL };
+		unsigned int coarse_mesh_seqs[3] = { 0, 0, 0 };
+		std::vector<int> coarse_orders[3];
 
 		// Time stepping loop.
 		int ts = 1;
@@ -261,32 +304,57 @@ int main(int argc, char* argv[])
 			{
 				Hermes::Mixins::Loggable::Static::info("Adaptivity step %d:", as);
 
-				// Construct globally refined reference mesh and setup reference space.
-				int order_increase = 1;
+				// Construct globally refined reference meshes and setup reference spaces, only for the components
+				// whose coarse spaces were changed since the last time (by the adaptivity or the derefinement).
+				// The unchanged reference spaces keep their blocks of the linear operator and their part of the state
+				// in LinearRungeKutta. With the reference-free estimator, the "reference" mesh is a copy of the coarse
+				// one, on which the solutions stay valid when the adaptivity changes the coarse mesh.
+				int order_increase = REFERENCE_FREE_ESTIMATOR ? 0 : 1;
 
-				Mesh::ReferenceMeshCreator refMeshCreatorE(&E_mesh);
-				Mesh::ReferenceMeshCreator refMeshCreatorH(&H_mesh);
-				Mesh::ReferenceMeshCreator refMeshCreatorP(&P_mesh);
-				Mesh* ref_mesh_E = refMeshCreatorE.create_ref_mesh();
-				Mesh* ref_mesh_H = refMeshCreatorH.create_ref_mesh();
-				Mesh* ref_mesh_P = refMeshCreatorP.create_ref_mesh();
-
-				Space<double>::ReferenceSpaceCreator refSpaceCreatorE(&E_space, ref_mesh_E, order_increase);
-				Space<double>* ref_space_E = refSpaceCreatorE.create_ref_space();
-				Space<double>::ReferenceSpaceCreator refSpaceCreatorH(&H_space, ref_mesh_H, order_increase);
-				Space<double>* ref_space_H = refSpaceCreatorH.create_ref_space();
-				Space<double>::ReferenceSpaceCreator refSpaceCreatorP(&P_space, ref_mesh_P, order_increase);
-				Space<double>* ref_space_P = refSpaceCreatorP.create_ref_space();
+				for (int c = 0; c < 3; c++)
+				{
+					if (!coarse_space_changed(spaces[c], coarse_mesh_seqs[c], coarse_orders[c]))
+						continue;
+					delete ref_spaces[c];
+					// The mesh of the previous solution is deleted after the time step.
+					if (ref_meshes[c] != slns_time_prev[c]->get_mesh())
+						delete ref_meshes[c];
+					if (REFERENCE_FREE_ESTIMATOR)
+					{
+						ref_meshes[c] = new Mesh;
+						ref_meshes[c]->copy(spaces[c]->get_mesh());
+					}
+					else
+					{
+						Mesh::ReferenceMeshCreator refMeshCreator(spaces[c]->get_mesh());
+						ref_meshes[c] = refMeshCreator.create_ref_mesh();
+					}
+					Space<double>::ReferenceSpaceCreator refSpaceCreator(spaces[c], ref_meshes[c], order_increase);
+					ref_spaces[c] = refSpaceCreator.create_ref_space();
+				}
+				Space<double>* ref_space_E = ref_spaces[0];
+				Space<double>* ref_space_H = ref_spaces[1];
+				Space<double>* ref_space_P = ref_spaces[2];
 
         int ndof = Space<double>::get_num_dofs(Hermes::vector<const Space<double>*>(ref_space_E, ref_space_H, ref_space_P));
 		    Hermes::Mixins::Loggable::Static::info("ndof = %d.", ndof);
 
 				try
 				{
-          runge_kutta.set_spaces(Hermes::vector<const Space<double>*>(ref_space_E, ref_space_H, ref_space_P));
-					runge_kutta.set_time(current_time);
-					runge_kutta.set_time_step(time_step);
-					runge_kutta.rk_time_step_newton(slns_time_prev, slns_time_new);
+          if (LINEAR_RK)
+          {
+            linear_rk->set_spaces(Hermes::vector<const Space<double>*>(ref_space_E, ref_space_H, ref_space_P));
+            linear_rk->set_time(current_time);
+            linear_rk->set_time_step(time_step);
+            linear_rk->rk_time_step(slns_time_prev, slns_time_new);
+          }
+          else
+          {
+            runge_kutta.set_spaces(Hermes::vector<const Space<double>*>(ref_space_E, ref_space_H, ref_space_P));
+					  runge_kutta.set_time(current_time);
+					  runge_kutta.set_time_step(time_step);
+					  runge_kutta.rk_time_step_newton(slns_time_prev, slns_time_new);
+          }
 				}
 				catch(Exceptions::Exception& e)
 				{
@@ -314,17 +382,29 @@ int main(int argc, char* argv[])
 			  P2_view.set_title(title);
 			  P2_view.show(&P_time_new, H2D_FN_VAL_1);
 
-				// Project the fine mesh solution onto the coarse mesh.
-				Hermes::Mixins::Loggable::Static::info("Projecting reference solution on coarse mesh.");
-				OGProjection<double> ogProjection; ogProjection.project_global(Hermes::vector<const Space<double> *>(&E_space, &H_space, 
-					&P_space), Hermes::vector<Solution<double>*>(&E_time_new, &H_time_new, &P_time_new), Hermes::vector<Solution<double>*>(&E_time_new_coarse, &H_time_new_coarse, &P_time_new_coarse));
-
 				// Calculate element errors and total error estimate.
-				Hermes::Mixins::Loggable::Static::info("Calculating error estimate.");
-				Adapt<double>* adaptivity = new Adapt<double>(Hermes::vector<Space<double> *>(&E_space, &H_space, &P_space));
+				Adapt<double>* adaptivity;
+				double err_est_rel_total;
+				if (REFERENCE_FREE_ESTIMATOR)
+				{
+					Hermes::Mixins::Loggable::Static::info("Calculating error estimate (reference-free).");
+					KellyTypeAdapt<double>* kelly_adaptivity = create_kelly_adapt(Hermes::vector<Space<double> *>(&E_space, &H_space, &P_space));
+					err_est_rel_total = kelly_adaptivity->calc_err_est(Hermes::vector<Solution<double>*>(&E_time_new, &H_time_new, &P_time_new)) * 100;
+					adaptivity = kelly_adaptivity;
+				}
+				else
+				{
+					// Project the fine mesh solution onto the coarse mesh.
+					Hermes::Mixins::Loggable::Static::info("Projecting reference solution on coarse mesh.");
+					OGProjection<double> ogProjection; ogProjection.project_global(Hermes::vector<const Space<double> *>(&E_space, &H_space, 
+						&P_space), Hermes::vector<Solution<double>*>(&E_time_new, &H_time_new, &P_time_new), Hermes::vector<Solution<double>*>(&E_time_new_coarse, &H_time_new_coarse, &P_time_new_coarse));
 
-				double err_est_rel_total = adaptivity->calc_err_est(Hermes::vector<Solution<double>*>(&E_time_new_coarse, &H_time_new_coarse, &P_time_new_coarse),
-					Hermes::vector<Solution<double>*>(&E_time_new, &H_time_new, &P_time_new)) * 100;
+					Hermes::Mixins::Loggable::Static::info("Calculating error estimate.");
+					adaptivity = new Adapt<double>(Hermes::vector<Space<double> *>(&E_space, &H_space, &P_space));
+
+					err_est_rel_total = adaptivity->calc_err_est(Hermes::vector<Solution<double>*>(&E_time_new_coarse, &H_time_new_coarse, &P_time_new_coarse),
+						Hermes::vector<Solution<double>*>(&E_time_new, &H_time_new, &P_time_new)) * 100;
+				}
 
 				// Report results.
 				Hermes::Mixins::Loggable::Static::info("Error estimate: %g%%", err_est_rel_total);
@@ -342,20 +422,26 @@ int main(int argc, char* argv[])
 				{
 					Hermes::Mixins::Loggable::Static::info("Adapting coarse mesh.");
 					REFINEMENT_COUNT++;
-					done = adaptivity->adapt(Hermes::vector<RefinementSelectors::Selector<double> *>(&HcurlSelector, &H1selector, &HcurlSelector), 
-						THRESHOLD, STRATEGY, MESH_REGULARITY);
-
-          delete ref_mesh_E;
-          delete ref_mesh_H;
-          delete ref_mesh_P;
+					if (REFERENCE_FREE_ESTIMATOR)
+					{
+						// The solutions lie in the coarse spaces, the projection only gives their coefficients.
+						double* coarse_coeff_vec = new double[Space<double>::get_num_dofs(spaces_const)];
+						OGProjection<double> ogProjection; ogProjection.project_global(spaces_const, 
+							Hermes::vector<MeshFunction<double>*>(&E_time_new, &H_time_new, &P_time_new), coarse_coeff_vec);
+						E_smoothness.set_coeff_vec(coarse_coeff_vec);
+						H_smoothness.set_coeff_vec(coarse_coeff_vec + E_space.get_num_dofs());
+						P_smoothness.set_coeff_vec(coarse_coeff_vec + E_space.get_num_dofs() + H_space.get_num_dofs());
+						done = adaptivity->adapt(Hermes::vector<RefinementSelectors::Selector<double> *>(&E_smoothness, &H_smoothness, &P_smoothness), 
+							THRESHOLD, STRATEGY, MESH_REGULARITY);
+						delete [] coarse_coeff_vec;
+					}
+					else
+						done = adaptivity->adapt(Hermes::vector<RefinementSelectors::Selector<double> *>(&HcurlSelector, &H1selector, &HcurlSelector), 
+							THRESHOLD, STRATEGY, MESH_REGULARITY);
 
           if(!done)
 						as++;
 				}
-          
-        delete ref_space_E;
-        delete ref_space_H;
-        delete ref_space_P;
 
         delete adaptivity;
 			} while(!done);
@@ -363,12 +449,11 @@ int main(int argc, char* argv[])
 			//View::wait();
 
 			// Update solutions.
+      // The reference meshes are kept for the next time step unless the next adaptivity step changes them.
       if(ts > 1)
-      {
-        delete E_time_prev.get_mesh();
-        delete H_time_prev.get_mesh();
-        delete P_time_prev.get_mesh();
-      }
+        for (int c = 0; c < 3; c++)
+          if (slns_time_prev[c]->get_mesh() != slns_time_new[c]->get_mesh())
+            delete slns_time_prev[c]->get_mesh();
 
 			E_time_prev.copy(&E_time_new);
 			H_time_prev.copy(&H_time_new);
@@ -380,6 +465,10 @@ int main(int argc, char* argv[])
 
 		} while (current_time < T_FINAL);
 
+		delete linear_rk;
+		for (int c = 0; c < 3; c++)
+			delete ref_spaces[c];
+
 		// Wait for the view to be closed.
 		View::wait();
 	}
@@ -14,7 +14,7 @@ Scalar CustomMatrixForm::matrix_form(int n, double *wt, Func<Scalar> *u_ext[], F
     result2 += wt[i] * er(e->elem_marker, e->x[i], e->y[i]) * (u->val0[i] * conj(v->val0[i]) + u->val1[i] * conj(v->val1[i]));
   for (int i = 0; i < n; i++)
     result3 += wt[i] * (u->curl[i] * conj(v->curl[i]));
-  return 1.0/mu_r * result3 - ikappa * Hermes::sqrt(mu_0 / e_0) * result1 - sqr(kappa) * result2;
+  return 1.0/mu_r * result3 - ikappa * Hermes::sqrt(mu_0 / e_0) * result1 - shift * sqr(kappa) * result2;
 }
 
 std::complex<double> CustomMatrixForm::value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *u, 
@@ -48,7 +48,7 @@ Ord CustomMatrixForm::gamma(int marker, Ord x, Ord y) const
 
 MatrixFormVol<std::complex<double> >* CustomMatrixForm::clone() const 
 {
-  CustomMatrixForm* form = new CustomMatrixForm(i, j, e_0, mu_0, mu_r, kappa, omega, J, align_mesh);
+  CustomMatrixForm* form = new CustomMatrixForm(i, j, e_0, mu_0, mu_r, kappa, omega, J, align_mesh, shift);
   form->wf = this->wf;
   return form;
 }
@@ -183,10 +183,10 @@ Ord CustomVectorFormSurf::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *
 
 
 CustomWeakForm::CustomWeakForm(double e_0, double mu_0, double mu_r, double kappa, double omega, 
-  double J, bool align_mesh, Mesh* mesh, std::string current_bdy) : WeakForm<std::complex<double> >(1), marker(mesh->get_element_markers_conversion().get_internal_marker("e1").marker)
+  double J, bool align_mesh, Mesh* mesh, std::string current_bdy, std::complex<double> shift) : WeakForm<std::complex<double> >(1), marker(mesh->get_element_markers_conversion().get_internal_marker("e1").marker)
 {
   // Jacobian forms - volumetric.
-  add_matrix_form(new CustomMatrixForm(0, 0, e_0, mu_0, mu_r, kappa, omega, J, align_mesh));
+  add_matrix_form(new CustomMatrixForm(0, 0, e_0, mu_0, mu_r, kappa, omega, J, align_mesh, shift));
 
   // Residual forms - volumetric.
   add_vector_form(new CustomResidualForm(0, e_0, mu_0, mu_r, kappa, omega, J, align_mesh));
@@ -1,4 +1,6 @@
 #include "hermes2d.h"
+#include "../../common/frequency_sweep.h"
+#include "../../common/shifted_laplacian.h"
 
 /* Namespaces used */
 
@@ -14,9 +16,10 @@ using namespace Hermes::Hermes2D::RefinementSelectors;
 class CustomMatrixForm : public MatrixFormVol<std::complex<double> >
 {
 public:
-  CustomMatrixForm(int i, int j, double e_0, double mu_0, double mu_r, double kappa, double omega, double J, bool align_mesh) 
+  CustomMatrixForm(int i, int j, double e_0, double mu_0, double mu_r, double kappa, double omega, double J, bool align_mesh,
+                   std::complex<double> shift = 1.0) 
         : MatrixFormVol<std::complex<double> >(i, j), e_0(e_0), mu_0(mu_0), 
-        mu_r(mu_r), kappa(kappa), omega(omega), J(J), align_mesh(align_mesh) { this->setSymFlag(HERMES_SYM);};
+        mu_r(mu_r), kappa(kappa), omega(omega), J(J), align_mesh(align_mesh), shift(shift) { this->setSymFlag(HERMES_SYM);};
 
   template<typename Real, typename Scalar>
   Scalar matrix_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u,
@@ -46,6 +49,8 @@ public:
   private:
   double e_0, mu_0, mu_r, kappa, omega, J;
   bool align_mesh;
+  // Factor of kappa^2 (complex for the shifted Laplacian preconditioner).
+  std::complex<double> shift;
 };
 
 // Residual.
@@ -111,8 +116,9 @@ public:
 class CustomWeakForm : public WeakForm<std::complex<double> >
 {
 public:
+  // 'shift' multiplies kappa^2 in the Jacobian, see ShiftedLaplacianSolver.
   CustomWeakForm(double e_0, double mu_0, double mu_r, double kappa, double omega, 
-                 double J, bool align_mesh, Mesh* mesh, std::string current_bdy);
+                 double J, bool align_mesh, Mesh* mesh, std::string current_bdy, std::complex<double> shift = 1.0);
   int get_marker();
 
 private:
@@ -77,6 +77,19 @@ MatrixSolverType matrix_solver = SOLVER_UMFPACK;
 const double NEWTON_TOL = 1e-6;
 const int NEWTON_MAX_ITER = 100;
 
+// Iterative solver preconditioned by the complex shifted Laplacian (ILU(0) of the shifted problem),
+// its memory is linear in ndof; the solve fails if it does not converge. If false, the Newton's method
+// with the direct solver is used.
+const bool SHIFTED_LAPLACIAN = false;
+// Shift beta_1 + i beta_2 of the wave number squared in the preconditioner.
+const double SHIFT_BETA_1 = 1.0;
+const double SHIFT_BETA_2 = 0.5;
+// Krylov method: GMRES, BICGSTAB.
+const ShiftedLaplacianSolver<std::complex<double> >::Method ITERATIVE_METHOD = ShiftedLaplacianSolver<std::complex<double> >::GMRES;
+// Relative tolerance of the residual and maximum number of iterations.
+const double ITERATIVE_TOL = 1e-8;
+const int ITERATIVE_MAX_ITER = 2000;
+
 // Problem parameters.
 const double e_0 = 8.8541878176 * 1e-12;
 const double mu_0 = 1.256 * 1e-6;
@@ -90,6 +103,19 @@ const double c = 1 / std::sqrt(e_0 * mu_0);
 const double kappa  = 2 * M_PI * freq * std::sqrt(e_0 * mu_0);
 const double J = 0.0000033333;
 
+// Frequency sweep on the final reference space.
+// Number of frequencies of the sweep, off by default (0 ... no sweep). Set e.g. to 50
+// to solve at as many frequencies in SWEEP_FREQ_MIN ... SWEEP_FREQ_MAX, the norms are saved to sweep.dat.
+const int SWEEP_NUM = 0;
+// Range of the sweep.
+const double SWEEP_FREQ_MIN = 2.4e9;
+const double SWEEP_FREQ_MAX = 2.5e9;
+// If true, the sweep uses the reduced (moment-matching) model about 'freq',
+// otherwise the full problem is solved for every frequency.
+const bool SWEEP_REDUCED = false;
+// Number of moments of the reduced model.
+const int SWEEP_MOMENTS = 12;
+
 //  Boundary markers.
 const std::string BDY_PERFECT_CONDUCTOR = "b2";
 const std::string BDY_CURRENT = "b1";
@@ -158,21 +184,55 @@ int main(int argc, char* argv[])
     // Time measurement.
     cpu_time.tick();
 
-    // Perform Newton's iteration.
-    Hermes::Hermes2D::NewtonSolver<std::complex<double> > newton(&dp);
-    try
+    std::complex<double>* coeff_vec = new std::complex<double>[ndof_ref];
+    memset(coeff_vec, 0, ndof_ref * sizeof(std::complex<double>));
+
+    if (SHIFTED_LAPLACIAN)
     {
-      newton.set_newton_max_iter(NEWTON_MAX_ITER);
-      newton.set_newton_tol(NEWTON_TOL);
-      newton.solve();
+      // The problem is linear: the Jacobian at zero is the matrix and minus the residual the right-hand side.
+      SparseMatrix<std::complex<double> >* matrix = create_matrix<std::complex<double> >();
+      Vector<std::complex<double> >* rhs = create_vector<std::complex<double> >();
+      dp.assemble(coeff_vec, matrix, rhs);
+      rhs->change_sign();
+
+      // Preconditioner: the same problem with kappa^2 times beta_1 + i beta_2.
+      CustomWeakForm wf_shifted(e_0, mu_0, mu_r, kappa, omega, J, ALIGN_MESH, &mesh, BDY_CURRENT,
+                                std::complex<double>(SHIFT_BETA_1, SHIFT_BETA_2));
+      DiscreteProblem<std::complex<double> > dp_shifted(&wf_shifted, ref_space);
+      SparseMatrix<std::complex<double> >* precond_matrix = create_matrix<std::complex<double> >();
+      dp_shifted.assemble(coeff_vec, precond_matrix);
+
+      ShiftedLaplacianSolver<std::complex<double> > solver(matrix, precond_matrix, ITERATIVE_METHOD);
+      solver.set_tolerance(ITERATIVE_TOL);
+      solver.set_max_iters(ITERATIVE_MAX_ITER);
+      if (!solver.solve(rhs, coeff_vec))
+        throw Hermes::Exceptions::Exception("Iterative solver did not converge, relative residual %g.", solver.get_residual());
+
+      delete matrix;
+      delete precond_matrix;
+      delete rhs;
     }
-    catch(Hermes::Exceptions::Exception e)
+    else
     {
-      e.print_msg();
-      throw Hermes::Exceptions::Exception("Newton's iteration failed.");
-    };
+      // Perform Newton's iteration.
+      Hermes::Hermes2D::NewtonSolver<std::complex<double> > newton(&dp);
+      try
+      {
+        newton.set_newton_max_iter(NEWTON_MAX_ITER);
+        newton.set_newton_tol(NEWTON_TOL);
+        newton.solve();
+      }
+      catch(Hermes::Exceptions::Exception e)
+      {
+        e.print_msg();
+        throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+      };
+      memcpy(coeff_vec, newton.get_sln_vector(), ndof_ref * sizeof(std::complex<double>));
+    }
+
     // Translate the resulting coefficient vector into the Solution<std::complex<double> > sln.
-    Hermes::Hermes2D::Solution<std::complex<double> >::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
+    Hermes::Hermes2D::Solution<std::complex<double> >::vector_to_solution(coeff_vec, ref_space, &ref_sln);
+    delete [] coeff_vec;
   
     // Project the fine mesh solution onto the coarse mesh.
     Hermes::Mixins::Loggable::Static::info("Projecting reference solution on coarse mesh.");
@@ -223,6 +283,37 @@ int main(int argc, char* argv[])
     }
     if (space.get_num_dofs() >= NDOF_STOP) done = true;
 
+    // Frequency sweep on the final reference space. The wave number is proportional to omega.
+    if (done && SWEEP_NUM > 0)
+    {
+      Hermes::Mixins::Loggable::Static::info("Frequency sweep.");
+      CustomWeakForm wf_0(e_0, mu_0, mu_r, 0.0, 0.0, J, ALIGN_MESH, &mesh, BDY_CURRENT);
+      CustomWeakForm wf_minus(e_0, mu_0, mu_r, -kappa, -omega, J, ALIGN_MESH, &mesh, BDY_CURRENT);
+      FrequencySweep<std::complex<double> > sweep(Hermes::vector<WeakForm<std::complex<double> >*>(&wf_0, &wf, &wf_minus),
+                                                  omega, ref_space);
+
+      std::vector<double> omegas;
+      for (int f = 0; f < SWEEP_NUM; f++)
+        omegas.push_back(2 * M_PI * (SWEEP_FREQ_MIN + (SWEEP_NUM > 1 ? f * (SWEEP_FREQ_MAX - SWEEP_FREQ_MIN) / (SWEEP_NUM - 1) : 0.0)));
+      std::vector<std::complex<double>*> coeff_vecs;
+      if (SWEEP_REDUCED)
+        sweep.solve_reduced(omegas, omega, SWEEP_MOMENTS, coeff_vecs);
+      else
+        sweep.solve(omegas, coeff_vecs);
+
+      // Hcurl norm of the electric field as a function of the frequency.
+      SimpleGraph graph_sweep;
+      Solution<std::complex<double> > sweep_sln;
+      for (int f = 0; f < SWEEP_NUM; f++)
+      {
+        Solution<std::complex<double> >::vector_to_solution(coeff_vecs[f], ref_space, &sweep_sln);
+        graph_sweep.add_values(omegas[f] / (2 * M_PI), Global<std::complex<double> >::calc_norm(&sweep_sln, HERMES_HCURL_NORM));
+        delete [] coeff_vecs[f];
+      }
+      graph_sweep.save("sweep.dat");
+      Hermes::Mixins::Loggable::Static::info("Frequency sweep saved to file %s.", "sweep.dat");
+    }
+
     delete adaptivity;
     if(!done)
     {
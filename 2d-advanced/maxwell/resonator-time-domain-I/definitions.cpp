@@ -156,3 +156,8 @@ VectorFormVol<double>* CustomWeakFormWave::VectorFormVolWave_1::clone() const
   return new VectorFormVolWave_1(*this);
 }
 
+CustomWeakFormWaveEnergy::CustomWeakFormWaveEnergy(double c_squared) : WeakForm<double>(2)
+{
+  add_matrix_form(new MassFormVol(0, true));
+  add_matrix_form(new WeakFormsH1::DefaultMatrixFormVol<double>(1, 1, HERMES_ANY, new Hermes2DFunction<double>(c_squared), HERMES_SYM));
+}
@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "../../common/leapfrog.h"
 
 /* Namespaces used */
 
@@ -111,3 +112,11 @@ private:
     virtual VectorFormVol<double>* clone() const;
   };
 };
+
+/* Energy 1/2 (|E|^2 + c_squared |B|^2), conserved by the problem */
+
+class CustomWeakFormWaveEnergy : public WeakForm<double>
+{
+public:
+  CustomWeakFormWaveEnergy(double c_squared);
+};
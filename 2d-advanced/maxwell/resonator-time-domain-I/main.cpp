@@ -16,6 +16,9 @@
 //
 // BC: perfect conductor for E on the entire boundary, no BC for B.
 //
+// The energy 1/2 (|E|^2 + SPEED_OF_LIGHT**2 |B|^2) is conserved, and with the default 
+// leapfrog method its relative drift is reported in every time step.
+//
 // The following parameters can be changed:
 
 // Initial polynomial degree of mesh elements.
@@ -29,6 +32,12 @@ const double T_FINAL = 35.0;
 // Matrix solver: SOLVER_AMESOS, SOLVER_AZTECOO, SOLVER_MUMPS,
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 MatrixSolverType matrix_solver = SOLVER_UMFPACK;   
+// Use the explicit leapfrog (Stoermer-Verlet) method instead of the R-K method below.
+// It needs only back-substitutions with the once factorized mass matrices, conserves energy, 
+// but is only conditionally stable (see common/leapfrog.h).
+const bool LEAPFROG = true;
+// The leapfrog time step is limited to CFL_NUMBER times the CFL estimate.
+const double CFL_NUMBER = 0.5;
 
 // Choose one of the following time-integration methods, or define your own Butcher's table. The last number 
 // in the name of each method is its order. The one before last, if present, is the number of stages.
@@ -98,21 +107,48 @@ int main(int argc, char* argv[])
   // Initialize Runge-Kutta time stepping.
   RungeKutta<double> runge_kutta(&wf, spaces, &bt);
 
+  // Initialize the leapfrog time stepping, adjust the time step to the CFL condition.
+  double current_time_step = time_step;
+  CustomWeakFormWaveEnergy wf_energy(C_SQUARED);
+  LeapfrogIntegrator* leapfrog = NULL;
+  double initial_energy = 0.0;
+  if (LEAPFROG)
+  {
+    leapfrog = new LeapfrogIntegrator(&wf, spaces, &wf_energy);
+    double cfl_time_step = CFL_NUMBER * leapfrog->cfl_time_step(std::sqrt(C_SQUARED));
+    if (cfl_time_step < current_time_step)
+    {
+      Hermes::Mixins::Loggable::Static::info("Time step reduced to %g s by the CFL condition.", cfl_time_step);
+      current_time_step = cfl_time_step;
+    }
+    leapfrog->set_initial_condition(slns);
+    initial_energy = leapfrog->energy();
+  }
+
   // Time stepping loop.
-  double current_time = time_step; int ts = 1;
+  double current_time = current_time_step; int ts = 1;
   do
   {
-    // Perform one Runge-Kutta time step according to the selected Butcher's table.
-    Hermes::Mixins::Loggable::Static::info("Runge-Kutta time step (t = %g s, time_step = %g s, stages: %d).", 
-         current_time, time_step, bt.get_size());
     bool jacobian_changed = false;
     bool verbose = true;
     
     try
     {
-      runge_kutta.set_time(current_time);
-      runge_kutta.set_time_step(time_step);
-      runge_kutta.rk_time_step_newton(slns, slns);
+      if (LEAPFROG)
+      {
+        Hermes::Mixins::Loggable::Static::info("Leapfrog time step (t = %g s, time_step = %g s).", current_time, current_time_step);
+        leapfrog->step(current_time_step, slns);
+        Hermes::Mixins::Loggable::Static::info("Relative energy drift: %g.", (leapfrog->energy() - initial_energy) / initial_energy);
+      }
+      else
+      {
+        // Perform one Runge-Kutta time step according to the selected Butcher's table.
+        Hermes::Mixins::Loggable::Static::info("Runge-Kutta time step (t = %g s, time_step = %g s, stages: %d).", 
+             current_time, current_time_step, bt.get_size());
+        runge_kutta.set_time(current_time);
+        runge_kutta.set_time_step(current_time_step);
+        runge_kutta.rk_time_step_newton(slns, slns);
+      }
     }
     catch(Exceptions::Exception& e)
     {
@@ -133,10 +169,12 @@ int main(int argc, char* argv[])
     B_view.show(&B_sln, HERMES_EPS_NORMAL, H2D_FN_VAL_0);
 
     // Update time.
-    current_time += time_step;
+    current_time += current_time_step;
   
   } while (current_time < T_FINAL);
 
+  delete leapfrog;
+
   // Wait for the view to be closed.
   View::wait();
 
@@ -105,3 +105,25 @@ VectorFormVol<double>* CustomWeakFormWaveRK::VectorFormVolWave_1::clone() const
   return new VectorFormVolWave_1(*this);
 }
 
+CustomWeakFormWaveEnergy::CustomWeakFormWaveEnergy(double c_squared) : WeakForm<double>(2)
+{
+  add_matrix_form(new MatrixFormVolEnergy_0_0(c_squared));
+  add_matrix_form(new MassFormVol(1, true));
+}
+
+double CustomWeakFormWaveEnergy::MatrixFormVolEnergy_0_0::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, 
+                                                                Func<double> *v, Geom<double> *e, Func<double>* *ext) const 
+{
+  return c_squared * int_curl_e_curl_f<double, double>(n, wt, u, v);
+}
+
+Ord CustomWeakFormWaveEnergy::MatrixFormVolEnergy_0_0::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, 
+                                                           Geom<Ord> *e, Func<Ord>* *ext) const 
+{
+  return c_squared * int_curl_e_curl_f<Ord, Ord>(n, wt, u, v);
+}
+
+MatrixFormVol<double>* CustomWeakFormWaveEnergy::MatrixFormVolEnergy_0_0::clone() const 
+{
+  return new MatrixFormVolEnergy_0_0(*this);
+}
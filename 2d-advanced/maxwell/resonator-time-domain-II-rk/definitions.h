@@ -1,4 +1,6 @@
 #include "hermes2d.h"
+#include "../../common/linear_rk.h"
+#include "../../common/leapfrog.h"
 
 /* Namespaces used */
 
@@ -94,3 +96,29 @@ private:
     double c_squared;
   };
 };
+
+/* Energy 1/2 (c_squared |curl E|^2 + |F|^2), conserved by the problem */
+
+class CustomWeakFormWaveEnergy : public WeakForm<double>
+{
+public:
+  CustomWeakFormWaveEnergy(double c_squared);
+
+private:
+  class MatrixFormVolEnergy_0_0 : public MatrixFormVol<double>
+  {
+  public:
+    MatrixFormVolEnergy_0_0(double c_squared) 
+      : MatrixFormVol<double>(0, 0), c_squared(c_squared) { this->setSymFlag(HERMES_SYM); };
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, 
+                         Geom<double> *e, Func<double>* *ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, 
+                    Geom<Ord> *e, Func<Ord>* *ext) const;
+
+    virtual MatrixFormVol<double>* clone() const;
+
+    double c_squared;
+  };
+};
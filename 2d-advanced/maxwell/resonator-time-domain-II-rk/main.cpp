@@ -12,7 +12,9 @@
 // hermes_common/tables.h.
 //
 // The function rk_time_step_newton() needs more optimisation, see a todo list at 
-// the beginning of file src/runge-kutta.h.
+// the beginning of file src/runge-kutta.h. Since the problem is linear and 
+// time-invariant, the default is the LinearRungeKutta stepper that assembles 
+// and factorizes the stage matrices only once (see common/linear_rk.h).
 //
 // PDE: \frac{1}{SPEED_OF_LIGHT**2}\frac{\partial^2 E}{\partial t^2} + curl curl E = 0,
 // converted into
@@ -27,6 +29,9 @@
 //
 // IC:  Prescribed wave for E, zero for F.
 //
+// The energy 1/2 (SPEED_OF_LIGHT**2 |curl E|^2 + |F|^2) is conserved, and with the default 
+// leapfrog method its relative drift is reported in every time step.
+//
 // The following parameters can be changed:
 
 // Initial polynomial degree of mesh elements.
@@ -37,6 +42,15 @@ const int INIT_REF_NUM = 1;
 const double time_step = 0.05;                     
 // Final time.
 const double T_FINAL = 35.0;                       
+// Use the linear R-K stepper (explicit and diagonally implicit methods only), 
+// otherwise the Newton's method is used in each time step.
+const bool LINEAR_RK = true;
+// Use the explicit leapfrog (Stoermer-Verlet) method instead of the R-K method below.
+// It needs only back-substitutions with the once factorized mass matrices, conserves energy, 
+// but is only conditionally stable (see common/leapfrog.h).
+const bool LEAPFROG = true;
+// The leapfrog time step is limited to CFL_NUMBER times the CFL estimate.
+const double CFL_NUMBER = 0.5;
 // Stopping criterion for the Newton's method.
 const double NEWTON_TOL = 1e-5;                  
 // Maximum allowed number of Newton iterations.
@@ -114,23 +128,67 @@ int main(int argc, char* argv[])
   ScalarView F2_view("Solution F2", new WinGeom(410, 410, 400, 350));
   F2_view.fix_scale_width(50);
 
-  // Initialize Runge-Kutta time stepping.
-  RungeKutta<double> runge_kutta(&wf, spaces, &bt);
+  // Initialize Runge-Kutta time stepping (only the integrator that is used).
+  RungeKutta<double>* runge_kutta = NULL;
+  LinearRungeKutta* linear_rk = NULL;
+  if (!LEAPFROG)
+  {
+    if (LINEAR_RK)
+      linear_rk = new LinearRungeKutta(&wf, spaces, &bt);
+    else
+      runge_kutta = new RungeKutta<double>(&wf, spaces, &bt);
+  }
+
+  // Initialize the leapfrog time stepping, adjust the time step to the CFL condition.
+  double current_time_step = time_step;
+  CustomWeakFormWaveEnergy wf_energy(C_SQUARED);
+  LeapfrogIntegrator* leapfrog = NULL;
+  double initial_energy = 0.0;
+  if (LEAPFROG)
+  {
+    leapfrog = new LeapfrogIntegrator(&wf, spaces, &wf_energy);
+    double cfl_time_step = CFL_NUMBER * leapfrog->cfl_time_step(std::sqrt(C_SQUARED));
+    if (cfl_time_step < current_time_step)
+    {
+      Hermes::Mixins::Loggable::Static::info("Time step reduced to %g s by the CFL condition.", cfl_time_step);
+      current_time_step = cfl_time_step;
+    }
+    leapfrog->set_initial_condition(slns_time_prev);
+    initial_energy = leapfrog->energy();
+  }
 
   // Time stepping loop.
   double current_time = 0; int ts = 1;
   do
   {
-    // Perform one Runge-Kutta time step according to the selected Butcher's table.
-    Hermes::Mixins::Loggable::Static::info("Runge-Kutta time step (t = %g s, time_step = %g s, stages: %d).", 
-         current_time, time_step, bt.get_size());
     try
     {
-      runge_kutta.set_time(current_time);
-      runge_kutta.set_time_step(time_step);
-      runge_kutta.set_newton_max_iter(NEWTON_MAX_ITER);
-      runge_kutta.set_newton_tol(NEWTON_TOL);
-      runge_kutta.rk_time_step_newton(slns_time_prev, slns_time_new);
+      if (LEAPFROG)
+      {
+        Hermes::Mixins::Loggable::Static::info("Leapfrog time step (t = %g s, time_step = %g s).", current_time, current_time_step);
+        leapfrog->step(current_time_step, slns_time_new);
+        Hermes::Mixins::Loggable::Static::info("Relative energy drift: %g.", (leapfrog->energy() - initial_energy) / initial_energy);
+      }
+      else
+      {
+        // Perform one Runge-Kutta time step according to the selected Butcher's table.
+        Hermes::Mixins::Loggable::Static::info("Runge-Kutta time step (t = %g s, time_step = %g s, stages: %d).", 
+             current_time, current_time_step, bt.get_size());
+        if (LINEAR_RK)
+        {
+          linear_rk->set_time(current_time);
+          linear_rk->set_time_step(current_time_step);
+          linear_rk->rk_time_step(slns_time_prev, slns_time_new);
+        }
+        else
+        {
+          runge_kutta->set_time(current_time);
+          runge_kutta->set_time_step(current_time_step);
+          runge_kutta->set_newton_max_iter(NEWTON_MAX_ITER);
+          runge_kutta->set_newton_tol(NEWTON_TOL);
+          runge_kutta->rk_time_step_newton(slns_time_prev, slns_time_new);
+        }
+      }
     }
     catch(Exceptions::Exception& e)
     {
@@ -140,17 +198,17 @@ int main(int argc, char* argv[])
 
     // Visualize the solutions.
     char title[100];
-    sprintf(title, "E1, t = %g", current_time + time_step);
+    sprintf(title, "E1, t = %g", current_time + current_time_step);
     E1_view.set_title(title);
     E1_view.show(&E_time_new, HERMES_EPS_NORMAL, H2D_FN_VAL_0);
-    sprintf(title, "E2, t = %g", current_time + time_step);
+    sprintf(title, "E2, t = %g", current_time + current_time_step);
     E2_view.set_title(title);
     E2_view.show(&E_time_new, HERMES_EPS_NORMAL, H2D_FN_VAL_1);
 
-    sprintf(title, "F1, t = %g", current_time + time_step);
+    sprintf(title, "F1, t = %g", current_time + current_time_step);
     F1_view.set_title(title);
     F1_view.show(&F_time_new, HERMES_EPS_NORMAL, H2D_FN_VAL_0);
-    sprintf(title, "F2, t = %g", current_time + time_step);
+    sprintf(title, "F2, t = %g", current_time + current_time_step);
     F2_view.set_title(title);
     F2_view.show(&F_time_new, HERMES_EPS_NORMAL, H2D_FN_VAL_1);
 
@@ -161,10 +219,14 @@ int main(int argc, char* argv[])
     F_time_prev.copy(&F_time_new);
 
     // Update time.
-    current_time += time_step;
+    current_time += current_time_step;
   
   } while (current_time < T_FINAL);
 
+  delete runge_kutta;
+  delete linear_rk;
+  delete leapfrog;
+
   // Wait for the view to be closed.
   View::wait();
 
@@ -15,3 +15,31 @@ CustomWeakFormPoisson::CustomWeakFormPoisson(std::string mat_al, Hermes1DFunctio
   add_vector_form(new DefaultResidualDiffusion<double>(0, mat_cu, lambda_cu));
   add_vector_form(new DefaultVectorFormVol<double>(0, HERMES_ANY, src_term));
 };
+
+CustomWeakFormDiffusionTerm::CustomWeakFormDiffusionTerm(std::string mat) : WeakForm<double>(1)
+{
+  add_matrix_form(new DefaultJacobianDiffusion<double>(0, 0, mat, new Hermes1DFunction<double>(1.0)));
+  add_vector_form(new DefaultResidualDiffusion<double>(0, mat, new Hermes1DFunction<double>(1.0)));
+}
+
+CustomWeakFormSourceTerm::CustomWeakFormSourceTerm() : WeakForm<double>(1)
+{
+  add_vector_form(new DefaultVectorFormVol<double>(0, HERMES_ANY, new Hermes2DFunction<double>(-1.0)));
+}
+
+CustomWeakFormInnerProduct::CustomWeakFormInnerProduct() : WeakForm<double>(1)
+{
+  add_matrix_form(new DefaultJacobianDiffusion<double>(0, 0, HERMES_ANY, new Hermes1DFunction<double>(1.0), HERMES_SYM));
+}
+
+void CustomParametrization::theta(const std::vector<double>& mu, double* theta) const
+{
+  theta[0] = mu[0];
+  theta[1] = mu[1];
+  theta[2] = mu[2];
+}
+
+double CustomParametrization::stability_lower_bound(const std::vector<double>& mu) const
+{
+  return std::min(mu[0], mu[1]);
+}
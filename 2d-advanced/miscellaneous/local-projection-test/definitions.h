@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "../../common/reduced_basis.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
@@ -14,3 +15,34 @@ public:
                         std::string mat_cu, Hermes1DFunction<double>* lambda_cu,
                         Hermes2DFunction<double>* src_term);
 };
+
+/* Affine decomposition for the reduced basis: the parameters are (lambda_al, lambda_cu, heat source),
+   each term is the corresponding part of CustomWeakFormPoisson with a unit coefficient. */
+
+class CustomWeakFormDiffusionTerm : public WeakForm<double>
+{
+public:
+  CustomWeakFormDiffusionTerm(std::string mat);
+};
+
+class CustomWeakFormSourceTerm : public WeakForm<double>
+{
+public:
+  CustomWeakFormSourceTerm();
+};
+
+// Inner product of the reduced basis, the H1 seminorm.
+class CustomWeakFormInnerProduct : public WeakForm<double>
+{
+public:
+  CustomWeakFormInnerProduct();
+};
+
+class CustomParametrization : public AffineParametrization<double>
+{
+public:
+  virtual void theta(const std::vector<double>& mu, double* theta) const;
+
+  // The problem is coercive in the H1 seminorm with the constant min(lambda_al, lambda_cu).
+  virtual double stability_lower_bound(const std::vector<double>& mu) const;
+};
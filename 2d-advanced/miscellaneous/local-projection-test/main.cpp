@@ -49,6 +49,20 @@ const double VOLUME_HEAT_SRC = 5e3;
 // Fixed temperature on the boundary.
 const double FIXED_BDY_TEMP = 20.0;        
 
+// Reduced basis for the parameters (LAMBDA_AL, LAMBDA_CU, VOLUME_HEAT_SRC), off by default.
+const bool REDUCED_BASIS = false;
+// Parameter ranges, the training set is a uniform grid of RB_TRAINING_POINTS^3 points.
+const double RB_LAMBDA_MIN = 100.0;
+const double RB_LAMBDA_MAX = 500.0;
+const double RB_SRC_MIN = 1e3;
+const double RB_SRC_MAX = 1e4;
+const int RB_TRAINING_POINTS = 8;
+// Maximum size of the basis and the tolerance of the relative error bound.
+const int RB_MAX_SIZE = 50;
+const double RB_TOL = 1e-6;
+// Number of random parameters for the timing of the online phase.
+const int RB_ONLINE_SAMPLES = 10000;
+
 int main(int argc, char* argv[])
 {
   // Load the mesh.
@@ -106,6 +120,64 @@ int main(int argc, char* argv[])
   Solution<double> sln;
   Solution<double>::vector_to_solution(newton.get_sln_vector(), &space, &sln);
 
+  if (REDUCED_BASIS)
+  {
+    // Offline phase.
+    Hermes::Mixins::TimeMeasurable cpu_time;
+    cpu_time.tick();
+    CustomWeakFormDiffusionTerm wf_al("Aluminum"), wf_cu("Copper");
+    CustomWeakFormSourceTerm wf_src;
+    CustomWeakFormInnerProduct wf_inner;
+    CustomParametrization parametrization;
+    ReducedBasis<double> rb(Hermes::vector<WeakForm<double>*>(&wf_al, &wf_cu, &wf_src), &parametrization, &wf_inner, &space);
+
+    std::vector<std::vector<double> > training_set;
+    for (int i = 0; i < RB_TRAINING_POINTS; i++)
+      for (int j = 0; j < RB_TRAINING_POINTS; j++)
+        for (int k = 0; k < RB_TRAINING_POINTS; k++)
+        {
+          std::vector<double> mu(3);
+          mu[0] = RB_LAMBDA_MIN + i * (RB_LAMBDA_MAX - RB_LAMBDA_MIN) / (RB_TRAINING_POINTS - 1);
+          mu[1] = RB_LAMBDA_MIN + j * (RB_LAMBDA_MAX - RB_LAMBDA_MIN) / (RB_TRAINING_POINTS - 1);
+          mu[2] = RB_SRC_MIN + k * (RB_SRC_MAX - RB_SRC_MIN) / (RB_TRAINING_POINTS - 1);
+          training_set.push_back(mu);
+        }
+    rb.offline_greedy(training_set, RB_MAX_SIZE, RB_TOL);
+    cpu_time.tick();
+    Hermes::Mixins::Loggable::Static::info("Reduced basis offline phase: N = %d, %g s.", rb.get_basis_size(), cpu_time.last());
+
+    // Online phase for the parameters of the example, compared with the full solution.
+    std::vector<double> mu(3);
+    mu[0] = LAMBDA_AL;
+    mu[1] = LAMBDA_CU;
+    mu[2] = VOLUME_HEAT_SRC;
+    std::vector<double> y;
+    double error_bound;
+    rb.solve_online(mu, y, error_bound);
+    double* rb_coeff_vec = new double[ndof];
+    rb.reconstruct(y, rb_coeff_vec);
+    Solution<double> rb_sln;
+    Solution<double>::vector_to_solution(rb_coeff_vec, &space, &rb_sln);
+    delete [] rb_coeff_vec;
+    Hermes::Mixins::Loggable::Static::info("Reduced basis: error bound %g, relative H1 error %g%%.", error_bound,
+        Global<double>::calc_rel_error(&rb_sln, &sln, HERMES_H1_NORM) * 100);
+
+    // Timing of the online phase.
+    cpu_time.tick();
+    double max_bound = 0.0;
+    for (int s = 0; s < RB_ONLINE_SAMPLES; s++)
+    {
+      mu[0] = RB_LAMBDA_MIN + (RB_LAMBDA_MAX - RB_LAMBDA_MIN) * std::rand() / RAND_MAX;
+      mu[1] = RB_LAMBDA_MIN + (RB_LAMBDA_MAX - RB_LAMBDA_MIN) * std::rand() / RAND_MAX;
+      mu[2] = RB_SRC_MIN + (RB_SRC_MAX - RB_SRC_MIN) * std::rand() / RAND_MAX;
+      rb.solve_online(mu, y, error_bound);
+      max_bound = std::max(max_bound, error_bound);
+    }
+    cpu_time.tick();
+    Hermes::Mixins::Loggable::Static::info("Reduced basis online phase: %g us per parameter, max. error bound %g.",
+        cpu_time.last() / RB_ONLINE_SAMPLES * 1e6, max_bound);
+  }
+
   Solution<double> sln_proj;
   LocalProjection<double>::project_local(&space, &sln, &sln_proj, HERMES_H1_NORM);
   ScalarView view1("Projection", new WinGeom(0, 0, 440, 350));
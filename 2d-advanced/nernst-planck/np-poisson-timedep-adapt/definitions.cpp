@@ -150,6 +150,137 @@ private:
 };
 
 
+// Right-hand side F(Y) of the scaled problem M dY/dt = F(Y) and its Jacobian, for the time stepping
+// by ImexRungeKutta (the Poisson equation has no time derivative).
+class ScaledWeakFormPNPImex : public WeakForm<double> {
+public:
+  ScaledWeakFormPNPImex(double epsilon) : WeakForm<double>(2) {
+      for(unsigned int i = 0; i < 2; i++) {
+        add_vector_form(new ScaledWeakFormPNPImex::Residual(i, epsilon));
+        for(unsigned int j = 0; j < 2; j++)
+          add_matrix_form(new ScaledWeakFormPNPImex::Jacobian(i, j, epsilon));
+      }
+    };
+
+private:
+  class Jacobian : public MatrixFormVol<double> {
+  public:
+    Jacobian(int i, int j, double epsilon) : MatrixFormVol<double>(i, j),
+          i(i), j(j), epsilon(epsilon) {}
+
+    template<typename Real, typename Scalar>
+    Real matrix_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u,
+                       Func<Real> *v, Geom<Real> *e, Func<Scalar>* *ext) const {
+      Real result = Real(0);
+      Func<Scalar>* prev_newton;
+      switch(i * 10 + j) {
+        case 0:
+          prev_newton = u_ext[1];
+          for (int i = 0; i < n; i++) {
+            result += wt[i] * (-this->epsilon * ((u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]) +
+                    u->val[i] * (prev_newton->dx[i] * v->dx[i] + prev_newton->dy[i] * v->dy[i])));
+          }
+          return result;
+          break;
+        case 1:
+          prev_newton = u_ext[0];
+          for (int i = 0; i < n; i++) {
+            result += wt[i] * (-this->epsilon * prev_newton->val[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]));
+          }
+          return result;
+          break;
+        case 10:
+          for (int i = 0; i < n; i++) {
+            result += wt[i] * (1.0/(2 * this->epsilon * this->epsilon) * u->val[i] * v->val[i]);
+          }
+          return result;
+          break;
+        case 11:
+          for (int i = 0; i < n; i++) {
+            result += wt[i] * (-1.0 * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]));
+          }
+          return result;
+          break;
+        default:
+
+          return result;
+      }
+    }
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                 Func<double> *v, Geom<double> *e, Func<double>* *ext) const {
+      return matrix_form<double, double>(n, wt, u_ext, u, v, e, ext);
+    }
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+            Geom<Ord> *e, Func<Ord>* *ext) const {
+      return matrix_form<Ord, Ord>(n, wt, u_ext, u, v, e, ext);
+    }
+
+    MatrixFormVol<double>* clone() const
+    {
+      return new Jacobian(*this);
+    }
+
+    // Members.
+    int i, j;
+    double epsilon;
+  };
+
+  class Residual : public VectorFormVol<double>
+      {
+      public:
+        Residual(int i, double epsilon)
+          : VectorFormVol<double>(i), i(i), epsilon(epsilon) {}
+
+        template<typename Real, typename Scalar>
+        Real vector_form(int n, double *wt, Func<Scalar> *u_ext[],
+                            Func<Real> *v, Geom<Real> *e, Func<Scalar>* *ext) const {
+          Real result = Real(0);
+          Func<Scalar>* C_prev_newton = u_ext[0];
+          Func<Scalar>* phi_prev_newton = u_ext[1];
+          switch(i) {
+            case 0:
+              for (int i = 0; i < n; i++) {
+                result += wt[i] * (-this->epsilon * ((C_prev_newton->dx[i] * v->dx[i] + C_prev_newton->dy[i] * v->dy[i]) +
+                      C_prev_newton->val[i] * (phi_prev_newton->dx[i] * v->dx[i] + phi_prev_newton->dy[i] * v->dy[i])));
+              }
+              return result;
+              break;
+            case 1:
+              for (int i = 0; i < n; i++) {
+                result += wt[i] * (-1.0 * (phi_prev_newton->dx[i] * v->dx[i] + phi_prev_newton->dy[i] * v->dy[i]) -
+                    v->val[i] * 1 / (2 * this->epsilon * this->epsilon) * (1 - C_prev_newton->val[i]));
+              }
+              return result;
+              break;
+            default:
+              return result;
+          }
+        }
+
+        virtual double value(int n, double *wt, Func<double> *u_ext[],
+                     Func<double> *v, Geom<double> *e, Func<double>* *ext) const {
+          return vector_form<double, double>(n, wt, u_ext, v, e, ext);
+        }
+
+        virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                Geom<Ord> *e, Func<Ord>* *ext) const {
+          return vector_form<Ord, Ord>(n, wt, u_ext, v, e, ext);
+        }
+
+        VectorFormVol<double>* clone() const
+        {
+          return new Residual(*this);
+        }
+
+        // Members.
+        int i;
+        double epsilon;
+      };
+};
+
+
 class WeakFormPNPCranic : public WeakForm<double> {
 public:
 
@@ -3,6 +3,7 @@
 #include "definitions.h"
 
 #include "timestep_controller.h"
+#include "../../common/imex_rk.h"
 
 /** \addtogroup e_newton_np_timedep_adapt_system Newton Time-dependant System with Adaptivity
  \{
@@ -11,7 +12,10 @@
  This example shows how to combine the automatic adaptivity with the
  Newton's method for a nonlinear time-dependent PDE system.
  The time discretization is done using implicit Euler or
- Crank Nicholson method (see parameter TIME_DISCR).
+ Crank Nicholson method (see parameter TIME_DISCR), or by default (see parameter IMEX)
+ using a linearly implicit IMEX Runge-Kutta method (common/imex_rk.h), which treats the
+ stiff drift and Poisson coupling implicitly linearized and needs no Newton's method,
+ with the time step controlled by its embedded estimate of the temporal error.
  The following PDE's are solved:
  Nernst-Planck (describes the diffusion and migration of charged particles):
  \f[dC/dt - D*div[grad(C)] - K*C*div[grad(\phi)]=0,\f]
@@ -104,6 +108,11 @@ const int REF_INIT = 3;
 const bool MULTIMESH = true;	                    
 // 1 for implicit Euler, 2 for Crank-Nicolson.
 const int TIME_DISCR = 2;                         
+// Use the IMEX Runge-Kutta method with the embedded error estimate (scaled problem only) instead of
+// the Newton's method on TIME_DISCR with the PID controller.
+bool IMEX = true;
+// Tolerance of the relative temporal error [%] of a time step in the IMEX method.
+const double TIME_ERR_TOL = 1.0;
 
 // Stopping criterion for Newton on coarse mesh.
 const double NEWTON_TOL_COARSE = 0.01;            
@@ -188,6 +197,10 @@ double SCALED_INIT_TAU = scaleTime(INIT_TAU);
 
 int main (int argc, char* argv[]) {
 
+  if (IMEX && !SCALED) {
+    Hermes::Mixins::Loggable::Static::warn("The IMEX method is implemented for the scaled problem only, turning it off.");
+    IMEX = false;
+  }
 
   // Load the mesh file.
   Mesh C_mesh, phi_mesh, basemesh;
@@ -277,36 +290,50 @@ int main (int argc, char* argv[]) {
   phiview.show(&phi_prev_time);
   phiordview.show(&phi_space);
 
-  // Newton's loop on the coarse mesh.
-  Hermes::Mixins::Loggable::Static::info("Solving on initial coarse mesh");
-  try
-  {
-    solver_coarse->set_newton_max_iter(NEWTON_MAX_ITER);
-    solver_coarse->set_newton_tol(NEWTON_TOL_COARSE);
-    solver_coarse->solve(coeff_vec_coarse);
-  }
-  catch(Hermes::Exceptions::Exception e)
-  {
-    e.print_msg();
-    throw Hermes::Exceptions::Exception("Newton's iteration failed.");
-  };
+  // Newton's loop on the coarse mesh, for the initial vector of the Newton's method on the fine mesh.
+  if (!IMEX) {
+    Hermes::Mixins::Loggable::Static::info("Solving on initial coarse mesh");
+    try
+    {
+      solver_coarse->set_newton_max_iter(NEWTON_MAX_ITER);
+      solver_coarse->set_newton_tol(NEWTON_TOL_COARSE);
+      solver_coarse->solve(coeff_vec_coarse);
+    }
+    catch(Hermes::Exceptions::Exception e)
+    {
+      e.print_msg();
+      throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+    };
 
-  //View::wait(HERMES_WAIT_KEYPRESS);
+    //View::wait(HERMES_WAIT_KEYPRESS);
 
-  // Translate the resulting coefficient vector into the Solution<double> sln.
-  Solution<double>::vector_to_solutions(solver_coarse->get_sln_vector(), Hermes::vector<const Space<double> *>(&C_space, &phi_space),
-      Hermes::vector<Solution<double> *>(&C_sln, &phi_sln));
+    // Translate the resulting coefficient vector into the Solution<double> sln.
+    Solution<double>::vector_to_solutions(solver_coarse->get_sln_vector(), Hermes::vector<const Space<double> *>(&C_space, &phi_space),
+        Hermes::vector<Solution<double> *>(&C_sln, &phi_sln));
 
-  Cview.show(&C_sln);
-  phiview.show(&phi_sln);
+    Cview.show(&C_sln);
+    phiview.show(&phi_sln);
+  }
 
   // Cleanup after the Newton loop on the coarse mesh.
   delete solver_coarse;
   delete[] coeff_vec_coarse;
   
   // Time stepping loop.
-  PidTimestepController pid(scaleTime(T_FINAL), true, scaleTime(INIT_TAU));
+  // The IMEX method controls the time step by its error estimate, the PID controller only keeps the time.
+  PidTimestepController pid(scaleTime(T_FINAL), !IMEX, scaleTime(INIT_TAU));
   TAU = pid.timestep;
+  EmbeddedTimestepController step_controller(TAU, TIME_ERR_TOL, 1);
+
+  ImexRungeKutta* imex = NULL;
+  WeakForm<double>* imex_wf = NULL;
+  if (IMEX) {
+    // The Poisson equation has no time derivative.
+    std::vector<bool> differential(2, true);
+    differential[1] = false;
+    imex_wf = new ScaledWeakFormPNPImex(epsilon);
+    imex = new ImexRungeKutta(imex_wf, Hermes::vector<const Space<double>*>(&C_space, &phi_space), differential);
+  }
   Hermes::Mixins::Loggable::Static::info("Starting time iteration with the step %g", *TAU);
 
 
@@ -349,50 +376,87 @@ int main (int argc, char* argv[]) {
       Hermes::vector<const Space<double>*> ref_spaces(ref_C_space, ref_phi_space);
       Hermes::vector<const Space<double>*> ref_spaces_const(ref_C_space, ref_phi_space);
 
-      DiscreteProblem<double>* dp = new DiscreteProblem<double>(wf, ref_spaces_const);
-      int ndof_ref = Space<double>::get_num_dofs(ref_spaces_const);
-
-      double* coeff_vec = new double[ndof_ref];
-
-      NewtonSolver<double>* solver = new NewtonSolver<double>(dp);
-
-      // Calculate initial coefficient vector for Newton on the fine mesh.
-      if (as == 1 && pid.get_timestep_number() == 1) {
-        Hermes::Mixins::Loggable::Static::info("Projecting coarse mesh solution to obtain coefficient vector on new fine mesh.");
-        OGProjection<double> ogProjection; ogProjection.project_global(ref_spaces_const,
-              Hermes::vector<MeshFunction<double> *>(&C_sln, &phi_sln),
-              coeff_vec);
+      if (IMEX) {
+        if (as > 1) {
+          // Now deallocate the previous mesh
+          Hermes::Mixins::Loggable::Static::info("Delallocating the previous mesh");
+          delete C_ref_sln.get_mesh();
+          delete phi_ref_sln.get_mesh();
+        }
+
+        // IMEX step on the fine mesh, repeated with a shorter time step until the temporal error is acceptable.
+        Solution<double> C_time_error, phi_time_error;
+        bool accepted = false;
+        while (!accepted) {
+          Hermes::Mixins::Loggable::Static::info("IMEX time step %g on fine mesh:", *TAU);
+          imex->set_spaces(ref_spaces_const);
+          imex->set_time_step(*TAU);
+          imex->rk_time_step(Hermes::vector<Solution<double> *>(&C_prev_time, &phi_prev_time),
+              Hermes::vector<Solution<double> *>(&C_ref_sln, &phi_ref_sln),
+              Hermes::vector<Solution<double> *>(&C_time_error, &phi_time_error));
+
+          double rel_err_time = std::max(
+              Global<double>::calc_norm(&C_time_error, HERMES_H1_NORM) / Global<double>::calc_norm(&C_ref_sln, HERMES_H1_NORM),
+              Global<double>::calc_norm(&phi_time_error, HERMES_H1_NORM) / Global<double>::calc_norm(&phi_ref_sln, HERMES_H1_NORM)) * 100;
+          Hermes::Mixins::Loggable::Static::info("rel_err_time: %g%%", rel_err_time);
+
+          accepted = step_controller.check_step(rel_err_time);
+          if (!accepted) {
+            pid.restart_step();
+            pid.begin_step();
+          }
+        }
       }
       else {
-        Hermes::Mixins::Loggable::Static::info("Projecting previous fine mesh solution to obtain coefficient vector on new fine mesh.");
-        OGProjection<double> ogProjection; ogProjection.project_global(ref_spaces_const,
-              Hermes::vector<MeshFunction<double> *>(&C_ref_sln, &phi_ref_sln),
-              coeff_vec);
-      }
-      if (as > 1) {
-        // Now deallocate the previous mesh
-        Hermes::Mixins::Loggable::Static::info("Delallocating the previous mesh");
-        delete C_ref_sln.get_mesh();
-        delete phi_ref_sln.get_mesh();
-      }
-
-      // Newton's loop on the fine mesh.
-      Hermes::Mixins::Loggable::Static::info("Solving on fine mesh:");
-      try
-      {
-        solver->set_newton_max_iter(NEWTON_MAX_ITER);
-        solver->set_newton_tol(NEWTON_TOL_FINE);
-        solver->solve(coeff_vec);
+        DiscreteProblem<double>* dp = new DiscreteProblem<double>(wf, ref_spaces_const);
+        int ndof_ref = Space<double>::get_num_dofs(ref_spaces_const);
+
+        double* coeff_vec = new double[ndof_ref];
+
+        NewtonSolver<double>* solver = new NewtonSolver<double>(dp);
+
+        // Calculate initial coefficient vector for Newton on the fine mesh.
+        if (as == 1 && pid.get_timestep_number() == 1) {
+          Hermes::Mixins::Loggable::Static::info("Projecting coarse mesh solution to obtain coefficient vector on new fine mesh.");
+          OGProjection<double> ogProjection; ogProjection.project_global(ref_spaces_const,
+                Hermes::vector<MeshFunction<double> *>(&C_sln, &phi_sln),
+                coeff_vec);
+        }
+        else {
+          Hermes::Mixins::Loggable::Static::info("Projecting previous fine mesh solution to obtain coefficient vector on new fine mesh.");
+          OGProjection<double> ogProjection; ogProjection.project_global(ref_spaces_const,
+                Hermes::vector<MeshFunction<double> *>(&C_ref_sln, &phi_ref_sln),
+                coeff_vec);
+        }
+        if (as > 1) {
+          // Now deallocate the previous mesh
+          Hermes::Mixins::Loggable::Static::info("Delallocating the previous mesh");
+          delete C_ref_sln.get_mesh();
+          delete phi_ref_sln.get_mesh();
+        }
+
+        // Newton's loop on the fine mesh.
+        Hermes::Mixins::Loggable::Static::info("Solving on fine mesh:");
+        try
+        {
+          solver->set_newton_max_iter(NEWTON_MAX_ITER);
+          solver->set_newton_tol(NEWTON_TOL_FINE);
+          solver->solve(coeff_vec);
+        }
+        catch(Hermes::Exceptions::Exception e)
+        {
+          e.print_msg();
+          throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+        };
+
+        // Store the result in ref_sln.
+        Solution<double>::vector_to_solutions(solver->get_sln_vector(), ref_spaces_const,
+            Hermes::vector<Solution<double> *>(&C_ref_sln, &phi_ref_sln));
+
+        delete solver;
+        delete dp;
+        delete [] coeff_vec;
       }
-      catch(Hermes::Exceptions::Exception e)
-      {
-        e.print_msg();
-        throw Hermes::Exceptions::Exception("Newton's iteration failed.");
-      };
-
-      // Store the result in ref_sln.
-      Solution<double>::vector_to_solutions(solver->get_sln_vector(), ref_spaces_const,
-          Hermes::vector<Solution<double> *>(&C_ref_sln, &phi_ref_sln));
 
       // Projecting reference solution onto the coarse mesh
       Hermes::Mixins::Loggable::Static::info("Projecting fine mesh solution on coarse mesh.");
@@ -459,17 +523,16 @@ int main (int argc, char* argv[]) {
       //View::wait(HERMES_WAIT_KEYPRESS);
 
       // Clean up.
-      delete solver;
       delete adaptivity;
       delete ref_C_space;
       delete ref_phi_space;
-      delete dp;
-      delete [] coeff_vec;
     }
     while (done == false);
 
     pid.end_step(Hermes::vector<Solution<double>*> (&C_ref_sln, &phi_ref_sln),
         Hermes::vector<Solution<double>*> (&C_prev_time, &phi_prev_time));
+    if (IMEX)
+      step_controller.next_step();
     // TODO! Time step reduction when necessary.
 
     // Copy last reference solution into sln_prev_time.
@@ -478,6 +541,9 @@ int main (int argc, char* argv[]) {
 
   } while (pid.has_next());
 
+  delete imex;
+  delete imex_wf;
+
   // Wait for all views to be closed.
   View::wait();
   return 0;
@@ -2,6 +2,9 @@
 
 #define PID_DEFAULT_TOLERANCE 0.25
 #define DEFAULT_STEP 0.1
+#define EMBEDDED_SAFETY_FACTOR 0.9
+#define EMBEDDED_MIN_RATIO 0.2
+#define EMBEDDED_MAX_RATIO 2.0
 
 class PidTimestepController {
 
@@ -11,6 +14,7 @@ public:
     this->delta = tolerance;
     this->final_time = final_time;
     this->time = 0;
+    this->step_begin_time = 0;
     this->step_number = 0;
     timestep = new double;
     (*timestep) = default_step;
@@ -24,6 +28,8 @@ public:
   // true if next time step can be run, false if the time step must be re-run with smaller time step.
   bool end_step(Hermes::vector<Solution<double>*> solutions, Hermes::vector<Solution<double> *> prev_solutions);
   void begin_step();
+  // Undoes begin_step(), so that the step can be begun again (with another time step).
+  void restart_step();
   bool has_next();
 
   // reference to the current calculated time step
@@ -34,6 +40,7 @@ private:
   double delta;
   double final_time;
   double time;
+  double step_begin_time;
   int step_number;
   std::vector<double> err_vector;
   bool finished;
@@ -53,6 +60,7 @@ const double PidTimestepController::kD = 0.01;
 
 void PidTimestepController::begin_step() {
 
+  step_begin_time = time;
   if ((time + (*timestep)) >= final_time) {
    Hermes::Mixins::Loggable::Static::info("Time step would exceed the final time... reducing");
     (*timestep) = final_time - time;
@@ -64,6 +72,12 @@ void PidTimestepController::begin_step() {
  Hermes::Mixins::Loggable::Static::info("begin_step processed, new step number: %i and cumulative time: %g", step_number, time);
 }
 
+void PidTimestepController::restart_step() {
+  time = step_begin_time;
+  step_number--;
+  finished = false;
+}
+
 bool PidTimestepController::end_step(Hermes::vector<Solution<double> *> solutions,
     Hermes::vector<Solution<double> *> prev_solutions) {
 
@@ -111,4 +125,57 @@ bool PidTimestepController::has_next() {
   return !finished;
 }
 
+// Step size control by an embedded estimate of the relative temporal error (in %) of the time steps in
+// 'timestep' (e.g. of a PidTimestepController with pid_on = false, which keeps the time):
+//   tau_new = tau * EMBEDDED_SAFETY_FACTOR * (tolerance / error)^(1 / (order + 1)),
+// with the ratio limited to [EMBEDDED_MIN_RATIO, EMBEDDED_MAX_RATIO], where 'order' is the order of the embedded
+// (lower order) solution.
+// Usage: check_step(..) after every attempt of the step (repeated while it returns false), next_step() when it is done.
+
+class EmbeddedTimestepController {
+
+public:
+  EmbeddedTimestepController(double *timestep, double tolerance, int order) {
+    this->timestep = timestep;
+    this->tolerance = tolerance;
+    this->order = order;
+    last_error = 0;
+  };
+
+  // false if the error is above the tolerance, the step has to be repeated with the reduced time step.
+  bool check_step(double rel_error);
+  // Sets the time step for the next step by the error of the last accepted one.
+  void next_step();
 
+private:
+  double ratio(double rel_error);
+
+  double *timestep;
+  double tolerance;
+  int order;
+  double last_error;
+};
+
+double EmbeddedTimestepController::ratio(double rel_error) {
+  if (rel_error <= 0)
+    return EMBEDDED_MAX_RATIO;
+  double r = EMBEDDED_SAFETY_FACTOR * Hermes::pow(tolerance / rel_error, 1.0 / (order + 1));
+  return std::min(EMBEDDED_MAX_RATIO, std::max(EMBEDDED_MIN_RATIO, r));
+}
+
+bool EmbeddedTimestepController::check_step(double rel_error) {
+  if (rel_error > tolerance) {
+    double new_step = (*timestep) * ratio(rel_error);
+    Hermes::Mixins::Loggable::Static::info("Temporal error %g%% above the tolerance %g%%, repeating the step with %g instead of %g",
+        rel_error, tolerance, new_step, *timestep);
+    (*timestep) = new_step;
+    return false;
+  }
+  last_error = rel_error;
+  return true;
+}
+
+void EmbeddedTimestepController::next_step() {
+  (*timestep) = (*timestep) * ratio(last_error);
+  Hermes::Mixins::Loggable::Static::info("Temporal error %g%%, new time step: %g", last_error, *timestep);
+}
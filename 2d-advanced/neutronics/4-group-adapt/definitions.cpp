@@ -109,10 +109,415 @@ int get_num_of_neg(MeshFunction<double> *sln)
   return n;
 }
 
+const double CoarseMeshAcceleration::TOL = 1e-10;
+
+CoarseMeshAcceleration::CoarseMeshAcceleration(const MaterialPropertyMaps& matprop, const Mesh* mesh, double cell_size)
+  : matprop(matprop)
+{
+  // Bounding boxes of the base elements, which must be axis-aligned rectangles.
+  std::vector<double> xs, ys;
+  std::vector<double> bounds;
+  std::vector<std::string> materials;
+  Element* e;
+  for_all_base_elements(e, mesh)
+  {
+    if (e->get_nvert() != 4)
+      throw Hermes::Exceptions::Exception("CMFD needs a base mesh of axis-aligned rectangles.");
+    double x0 = e->vn[0]->x, x1 = e->vn[0]->x, y0 = e->vn[0]->y, y1 = e->vn[0]->y;
+    for (int i = 1; i < 4; i++)
+    {
+      x0 = std::min(x0, e->vn[i]->x);
+      x1 = std::max(x1, e->vn[i]->x);
+      y0 = std::min(y0, e->vn[i]->y);
+      y1 = std::max(y1, e->vn[i]->y);
+    }
+    for (int i = 0; i < 4; i++)
+      if ((e->vn[i]->x != x0 && e->vn[i]->x != x1) || (e->vn[i]->y != y0 && e->vn[i]->y != y1))
+        throw Hermes::Exceptions::Exception("CMFD needs a base mesh of axis-aligned rectangles.");
+
+    bounds.push_back(x0);
+    bounds.push_back(x1);
+    bounds.push_back(y0);
+    bounds.push_back(y1);
+    materials.push_back(mesh->get_element_markers_conversion().get_user_marker(e->marker).marker);
+    xs.push_back(x0);
+    xs.push_back(x1);
+    ys.push_back(y0);
+    ys.push_back(y1);
+  }
+
+  // Tensor grid through all base vertices, every interval split into pieces not larger than 'cell_size',
+  // so that the cells do not cross material interfaces.
+  for (int dir = 0; dir < 2; dir++)
+  {
+    std::vector<double>& coords = dir == 0 ? xs : ys;
+    std::vector<double>& grid = dir == 0 ? x_grid : y_grid;
+    std::sort(coords.begin(), coords.end());
+    coords.erase(std::unique(coords.begin(), coords.end()), coords.end());
+    grid.clear();
+    for (unsigned int i = 0; i + 1 < coords.size(); i++)
+    {
+      int n = std::max(1, (int) ceil((coords[i + 1] - coords[i]) / cell_size - 1e-10));
+      for (int j = 0; j < n; j++)
+        grid.push_back(coords[i] + (coords[i + 1] - coords[i]) * j / n);
+    }
+    grid.push_back(coords.back());
+  }
+
+  // Cells of the grid covered by a base element.
+  int nx = x_grid.size() - 1, ny = y_grid.size() - 1;
+  cell_index.assign(nx * ny, -1);
+  for (int j = 0; j < ny; j++)
+    for (int i = 0; i < nx; i++)
+    {
+      double xc = (x_grid[i] + x_grid[i + 1]) / 2.0, yc = (y_grid[j] + y_grid[j + 1]) / 2.0;
+      for (unsigned int k = 0; k < materials.size(); k++)
+        if (xc > bounds[4*k] && xc < bounds[4*k + 1] && yc > bounds[4*k + 2] && yc < bounds[4*k + 3])
+        {
+          Cell cell;
+          cell.material = materials[k];
+          // Pappus's theorem.
+          cell.volume = 2.0 * M_PI * xc * (x_grid[i + 1] - x_grid[i]) * (y_grid[j + 1] - y_grid[j]);
+          cell_index[j*nx + i] = cells.size();
+          cells.push_back(cell);
+          break;
+        }
+    }
+
+  // Faces of the cells, those without a neighbouring cell are on the boundary. Faces on the 
+  // symmetry axis have zero area and do not contribute to the leakage.
+  for (int j = 0; j < ny; j++)
+    for (int i = 0; i < nx; i++)
+    {
+      int c = cell_index[j*nx + i];
+      if (c < 0)
+        continue;
+      double w = x_grid[i + 1] - x_grid[i], h = y_grid[j + 1] - y_grid[j];
+
+      // Vertical faces (cylinders) and horizontal faces (annuli), each interior face added once from its left/lower cell.
+      int left = i > 0 ? cell_index[j*nx + i - 1] : -1;
+      int right = i + 1 < nx ? cell_index[j*nx + i + 1] : -1;
+      int below = j > 0 ? cell_index[(j - 1)*nx + i] : -1;
+      int above = j + 1 < ny ? cell_index[(j + 1)*nx + i] : -1;
+      if (left < 0)
+        add_face(c, -1, w / 2.0, 0.0, 2.0 * M_PI * x_grid[i] * h);
+      if (below < 0)
+        add_face(c, -1, h / 2.0, 0.0, M_PI * (sqr(x_grid[i + 1]) - sqr(x_grid[i])));
+      add_face(c, right, w / 2.0, right < 0 ? 0.0 : (x_grid[i + 2] - x_grid[i + 1]) / 2.0, 2.0 * M_PI * x_grid[i + 1] * h);
+      add_face(c, above, h / 2.0, above < 0 ? 0.0 : (y_grid[j + 2] - y_grid[j + 1]) / 2.0, M_PI * (sqr(x_grid[i + 1]) - sqr(x_grid[i])));
+    }
+
+  Hermes::Mixins::Loggable::Static::info("CMFD on %d cells (%d x %d grid).", (int) cells.size(), nx, ny);
+}
+
+void CoarseMeshAcceleration::add_face(int c1, int c2, double dist1, double dist2, double area)
+{
+  Face face;
+  face.cell[0] = c1;
+  face.cell[1] = c2;
+  face.dist[0] = dist1;
+  face.dist[1] = dist2;
+  face.area = area;
+  faces.push_back(face);
+}
+
+int CoarseMeshAcceleration::find_cell(double x, double y) const
+{
+  int i = std::upper_bound(x_grid.begin(), x_grid.end(), x) - x_grid.begin() - 1;
+  int j = std::upper_bound(y_grid.begin(), y_grid.end(), y) - y_grid.begin() - 1;
+  int nx = x_grid.size() - 1, ny = y_grid.size() - 1;
+  i = std::max(0, std::min(nx - 1, i));
+  j = std::max(0, std::min(ny - 1, j));
+  return cell_index[j*nx + i];
+}
+
+void CoarseMeshAcceleration::cell_integrals(MeshFunction<double>* sln, std::vector<double>& integrals) const
+{
+  Quad2D* quad = &g_quad_2d_std;
+  sln->set_quad_2d(quad);
+
+  integrals.assign(cells.size(), 0.0);
+
+  // Every quadrature point contributes to the cell containing it. Elements larger than the
+  // cells are split between them only approximately, which does not change the fixed point:
+  // the coarse problem reproduces the balance of the cell averages whatever they are.
+  Element* e;
+  const Mesh* mesh = sln->get_mesh();
+  for_all_active_elements(e, mesh)
+  {
+    update_limit_table(e->get_mode());
+    sln->set_active_element(e);
+    RefMap* ru = sln->get_refmap();
+    int o = sln->get_fn_order() + ru->get_inv_ref_order() + 1;
+    limit_order(o, e->get_mode());
+    sln->set_quad_order(o, H2D_FN_VAL);
+    double* uval = sln->get_fn_values();
+    double* x = ru->get_phys_x(o);
+    double* y = ru->get_phys_y(o);
+    double3* pt = quad->get_points(o, e->get_mode());
+    int np = quad->get_num_points(o, e->get_mode());
+    double* jac = ru->is_jacobian_const() ? NULL : ru->get_jacobian(o);
+    for (int i = 0; i < np; i++)
+    {
+      int c = find_cell(x[i], y[i]);
+      if (c >= 0)
+        integrals[c] += 2.0 * M_PI * pt[i][2] * (jac == NULL ? ru->get_const_jacobian() : jac[i]) * x[i] * uval[i];
+    }
+  }
+}
+
+bool CoarseMeshAcceleration::lu_factorize(std::vector<double>& A, std::vector<int>& piv, int n)
+{
+  piv.resize(n);
+  for (int k = 0; k < n; k++)
+  {
+    int p = k;
+    for (int i = k + 1; i < n; i++)
+      if (fabs(A[i*n + k]) > fabs(A[p*n + k]))
+        p = i;
+    if (A[p*n + k] == 0.0)
+      return false;
+
+    piv[k] = p;
+    if (p != k)
+      for (int j = 0; j < n; j++)
+        std::swap(A[k*n + j], A[p*n + j]);
+
+    for (int i = k + 1; i < n; i++)
+    {
+      A[i*n + k] /= A[k*n + k];
+      for (int j = k + 1; j < n; j++)
+        A[i*n + j] -= A[i*n + k] * A[k*n + j];
+    }
+  }
+  return true;
+}
+
+void CoarseMeshAcceleration::lu_solve(const std::vector<double>& A, const std::vector<int>& piv, std::vector<double>& b, int n)
+{
+  for (int k = 0; k < n; k++)
+    std::swap(b[k], b[piv[k]]);
+  for (int i = 1; i < n; i++)
+    for (int j = 0; j < i; j++)
+      b[i] -= A[i*n + j] * b[j];
+  for (int i = n - 1; i >= 0; i--)
+  {
+    for (int j = i + 1; j < n; j++)
+      b[i] -= A[i*n + j] * b[j];
+    b[i] /= A[i*n + i];
+  }
+}
+
+bool CoarseMeshAcceleration::accelerate(const Hermes::vector<const Space<double>*>& spaces, 
+                                        const Hermes::vector<MeshFunction<double>*>& old_solutions,
+                                        const Hermes::vector<Solution<double>*>& new_solutions,
+                                        double* coeff_vec, double& keff)
+{
+  int G = matprop.get_G();
+  int N = cells.size();
+
+  // Cell-averaged fluxes before and after the last fine-mesh solve.
+  std::vector<std::vector<double> > phi_old(G), phi_new(G);
+  for (int g = 0; g < G; g++)
+  {
+    cell_integrals(old_solutions[g], phi_old[g]);
+    cell_integrals(new_solutions[g], phi_new[g]);
+    for (int c = 0; c < N; c++)
+    {
+      phi_old[g][c] /= cells[c].volume;
+      phi_new[g][c] /= cells[c].volume;
+    }
+  }
+
+  // Fission sources (per unit volume) of the old and new fluxes.
+  std::vector<double> fission_old(N, 0.0), fission_new(N, 0.0);
+  for (int c = 0; c < N; c++)
+  {
+    const rank1& nu = matprop.get_nu(cells[c].material);
+    const rank1& Sigma_f = matprop.get_Sigma_f(cells[c].material);
+    for (int g = 0; g < G; g++)
+    {
+      fission_old[c] += nu[g] * Sigma_f[g] * phi_old[g][c];
+      fission_new[c] += nu[g] * Sigma_f[g] * phi_new[g][c];
+    }
+  }
+
+  // Assemble the coarse-mesh diffusion matrix of each group and factorize it.
+  std::vector<std::vector<double> > matrices(G);
+  std::vector<std::vector<int> > pivots(G);
+  for (int g = 0; g < G; g++)
+  {
+    std::vector<double>& A = matrices[g];
+    A.assign(N*N, 0.0);
+
+    // Finite difference leakage.
+    for (unsigned int f = 0; f < faces.size(); f++)
+    {
+      const Face& face = faces[f];
+      int c1 = face.cell[0], c2 = face.cell[1];
+      double D1 = matprop.get_D(cells[c1].material)[g];
+      if (c2 < 0)
+      {
+        // Marshak condition, J = \phi / 2 on the boundary.
+        A[c1*N + c1] += face.area * D1 / (face.dist[0] + 2.0 * D1);
+      }
+      else
+      {
+        double D2 = matprop.get_D(cells[c2].material)[g];
+        double coupling = face.area / (face.dist[0] / D1 + face.dist[1] / D2);
+        A[c1*N + c1] += coupling;
+        A[c2*N + c2] += coupling;
+        A[c1*N + c2] -= coupling;
+        A[c2*N + c1] -= coupling;
+      }
+    }
+
+    for (int c = 0; c < N; c++)
+    {
+      const rank1& chi = matprop.get_chi(cells[c].material);
+      const rank1& Sigma_r = matprop.get_Sigma_r(cells[c].material);
+      const rank2& Sigma_s = matprop.get_Sigma_s(cells[c].material);
+      double V = cells[c].volume;
+
+      // Leakage of the new fine-mesh fluxes from the cell balance ...
+      double leakage = chi[g] / keff * fission_old[c] * V - Sigma_r[g] * phi_new[g][c] * V;
+      for (int gfrom = 0; gfrom < G; gfrom++)
+        if (gfrom != g)
+          leakage += Sigma_s[g][gfrom] * phi_new[gfrom][c] * V;
+
+      // ... and its finite difference approximation.
+      double leakage_fd = 0.0;
+      for (int c2 = 0; c2 < N; c2++)
+        leakage_fd += A[c*N + c2] * phi_new[g][c2];
+
+      // Nonlinear correction.
+      if (phi_new[g][c] > 0.0)
+        A[c*N + c] += (leakage - leakage_fd) / phi_new[g][c];
+
+      A[c*N + c] += Sigma_r[g] * V;
+      if (A[c*N + c] <= 0.0)
+        return false;
+    }
+
+    if (!lu_factorize(A, pivots[g], N))
+      return false;
+  }
+
+  // Coarse-mesh power iteration, sweeping over the groups.
+  std::vector<std::vector<double> > phi = phi_new;
+  double fission_total = 0.0;
+  for (int c = 0; c < N; c++)
+    fission_total += fission_new[c] * cells[c].volume;
+  if (fission_total <= 0.0)
+    return false;
+
+  double k = keff;
+  bool converged = false;
+  for (int it = 0; it < MAX_ITER && !converged; it++)
+  {
+    std::vector<double> fission(N, 0.0);
+    for (int c = 0; c < N; c++)
+    {
+      const rank1& nu = matprop.get_nu(cells[c].material);
+      const rank1& Sigma_f = matprop.get_Sigma_f(cells[c].material);
+      for (int g = 0; g < G; g++)
+        fission[c] += nu[g] * Sigma_f[g] * phi[g][c];
+    }
+
+    for (int g = 0; g < G; g++)
+    {
+      std::vector<double> b(N);
+      for (int c = 0; c < N; c++)
+      {
+        const rank1& chi = matprop.get_chi(cells[c].material);
+        const rank2& Sigma_s = matprop.get_Sigma_s(cells[c].material);
+        b[c] = chi[g] / k * fission[c];
+        for (int gfrom = 0; gfrom < G; gfrom++)
+          if (gfrom != g)
+            b[c] += Sigma_s[g][gfrom] * phi[gfrom][c];
+        b[c] *= cells[c].volume;
+      }
+      lu_solve(matrices[g], pivots[g], b, N);
+      phi[g] = b;
+    }
+
+    double total_old = 0.0, total_new = 0.0;
+    for (int c = 0; c < N; c++)
+    {
+      const rank1& nu = matprop.get_nu(cells[c].material);
+      const rank1& Sigma_f = matprop.get_Sigma_f(cells[c].material);
+      double fission_c = 0.0;
+      for (int g = 0; g < G; g++)
+        fission_c += nu[g] * Sigma_f[g] * phi[g][c];
+      total_old += fission[c] * cells[c].volume;
+      total_new += fission_c * cells[c].volume;
+    }
+    if (total_old <= 0.0 || total_new <= 0.0)
+      return false;
+
+    double k_new = k * total_new / total_old;
+    converged = fabs((k_new - k) / k_new) < TOL;
+    k = k_new;
+
+    // Keep the total fission source of the fine-mesh solution.
+    for (int g = 0; g < G; g++)
+      for (int c = 0; c < N; c++)
+        phi[g][c] *= fission_total / total_new;
+  }
+
+  if (!converged)
+    return false;
+
+  // Rescale the fine-mesh fluxes. Coefficients shared by several cells are scaled by
+  // the average of their factors to keep the fluxes continuous.
+  for (int g = 0; g < G; g++)
+  {
+    std::vector<double> factors(N, 1.0);
+    for (int c = 0; c < N; c++)
+      if (phi_new[g][c] > 0.0 && phi[g][c] > 0.0)
+        factors[c] = phi[g][c] / phi_new[g][c];
+
+    std::map<int, std::pair<double, int> > dof_factors;
+    Element* e;
+    for_all_active_elements(e, spaces[g]->get_mesh())
+    {
+      // The cell containing the centre of the element.
+      double xc = 0.0, yc = 0.0;
+      for (unsigned int i = 0; i < e->get_nvert(); i++)
+      {
+        xc += e->vn[i]->x / e->get_nvert();
+        yc += e->vn[i]->y / e->get_nvert();
+      }
+      int c = find_cell(xc, yc);
+      if (c < 0)
+        continue;
+
+      AsmList<double> al;
+      spaces[g]->get_element_assembly_list(e, &al);
+      for (unsigned int j = 0; j < al.get_cnt(); j++)
+      {
+        int dof = al.get_dof()[j];
+        if (dof < 0)
+          continue;
+        std::pair<double, int>& df = dof_factors[dof];
+        df.first += factors[c];
+        df.second++;
+      }
+    }
+
+    std::map<int, std::pair<double, int> >::iterator it;
+    for (it = dof_factors.begin(); it != dof_factors.end(); ++it)
+      coeff_vec[it->first] *= it->second.first / it->second.second;
+  }
+
+  keff = k;
+  return true;
+}
+
 int power_iteration(const MaterialPropertyMaps& matprop, 
                     const Hermes::vector<const Space<double>*>& spaces, DefaultWeakFormSourceIteration<double>* wf, 
-                    const Hermes::vector<MeshFunction<double> *>& solutions, const std::string& fission_region, 
-                    double tol, Hermes::MatrixSolverType matrix_solver)
+                    DiscreteProblem<double>* dp, const Hermes::vector<MeshFunction<double> *>& solutions, const std::string& fission_region, 
+                    double tol, Hermes::MatrixSolverType matrix_solver, CoarseMeshAcceleration* cmfd)
 {
   // Sanity checks.
   if (spaces.size() != solutions.size()) 
@@ -121,8 +526,8 @@ int power_iteration(const MaterialPropertyMaps& matprop,
   // Number of energy groups.
   int G = spaces.size();
   
-  // Initialize the discrete problem.
-  DiscreteProblem<double> dp(wf, spaces);
+  // The discrete problem persists across the power iterations and the calls, only its spaces change.
+  dp->set_spaces(spaces);
   int ndof = Space<double>::get_num_dofs(spaces);
     
   // The following variables will store pointers to solutions obtained at each iteration and will be needed for 
@@ -134,6 +539,12 @@ int power_iteration(const MaterialPropertyMaps& matprop,
   // Initial coefficient vector for the Newton's method.
   double* coeff_vec = new double[ndof];
   
+  // The Jacobian (including all the group coupling forms integrated over the union 
+  // meshes) depends neither on the eigenvalue nor on the power iterates, so it is 
+  // assembled and factorized only in the first iteration. The discrete problem also
+  // keeps its cached element data for the later right-hand side assemblings.
+  NewtonSolver<double> newton(dp);
+
   // Force the Jacobian assembling in the first iteration.
   bool Jacobian_changed = true;
   
@@ -142,11 +553,13 @@ int power_iteration(const MaterialPropertyMaps& matprop,
   {
     memset(coeff_vec, 0.0, ndof*sizeof(double));
 
-    NewtonSolver<double> newton(&dp);
-
     try
     {
-      newton.solve(coeff_vec);
+      if (Jacobian_changed)
+        newton.solve(coeff_vec);
+      else
+        newton.solve_keep_jacobian(coeff_vec);
+      Jacobian_changed = false;
     }
     catch(Hermes::Exceptions::Exception e)
     {
@@ -165,6 +578,20 @@ int power_iteration(const MaterialPropertyMaps& matprop,
     // Compute the eigenvalue for current iteration.
     double k_new = wf->get_keff() * (integrate(&new_source, fission_region) / integrate(&old_source, fission_region));
 
+    // Coarse-mesh acceleration of the new fluxes and eigenvalue.
+    if (cmfd != NULL)
+    {
+      memcpy(coeff_vec, newton.get_sln_vector(), ndof*sizeof(double));
+      double k_cmfd = wf->get_keff();
+      if (cmfd->accelerate(spaces, solutions, new_solutions, coeff_vec, k_cmfd))
+      {
+        Solution<double>::vector_to_solutions(coeff_vec, spaces, new_solutions);
+        k_new = k_cmfd;
+      }
+      else
+        Hermes::Mixins::Loggable::Static::warn("      coarse-mesh acceleration skipped.");
+    }
+
     Hermes::Mixins::Loggable::Static::info("      dominant eigenvalue (est): %g, rel. difference: %g", k_new, fabs((wf->get_keff() - k_new) / k_new));
 
     // Stopping criterion.
@@ -184,6 +611,23 @@ int power_iteration(const MaterialPropertyMaps& matprop,
   // Free memory.
   for (int g = 0; g < G; g++) 
     delete new_solutions[g];
+  delete [] coeff_vec;
   
   return it;
 }
+
+void transfer_iterates(const Hermes::vector<const Space<double>*>& spaces, 
+                       const Hermes::vector<MeshFunction<double> *>& iterates)
+{
+  int ndof = Space<double>::get_num_dofs(spaces);
+  double* coeff_vec = new double[ndof];
+
+  OGProjection<double> ogProjection; ogProjection.project_global(spaces, iterates, coeff_vec);
+
+  Hermes::vector<Solution<double>*> solutions;
+  for (unsigned int g = 0; g < iterates.size(); g++)
+    solutions.push_back(static_cast<Solution<double>*>(iterates[g]));
+  Solution<double>::vector_to_solutions(coeff_vec, spaces, solutions);
+
+  delete [] coeff_vec;
+}
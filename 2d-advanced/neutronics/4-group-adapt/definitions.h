@@ -9,6 +9,7 @@ using namespace Hermes::Hermes2D;
 using namespace Hermes::Hermes2D::Views;
 using namespace Hermes::Hermes2D::RefinementSelectors;
 using namespace WeakFormsNeutronics::Multigroup::CompleteWeakForms::Diffusion;
+using namespace WeakFormsNeutronics::Multigroup::MaterialProperties::Definitions;
 
 class CustomWeakForm : public DefaultWeakFormSourceIteration<double>
 {
@@ -128,6 +129,79 @@ private:
   }  
 };
 
+/// \brief Coarse-mesh finite difference (CMFD) acceleration of the power iteration.
+///
+/// The coarse cells form a tensor grid through the vertices of the base mesh (which must consist of
+/// axis-aligned rectangles), with every interval split into pieces not larger than 'cell_size', so the
+/// cells are aligned with the materials and fine enough to capture the flux shape on the scale of the
+/// diffusion length, which is what reduces the dominance ratio. After each fine-mesh solve, the
+/// group fluxes are averaged over the cells and a low-order diffusion eigenproblem is set up on them,
+/// with the usual finite difference coupling of neighbouring cells and with the cell cross-sections
+/// taken from the material properties. The leakage of each cell, obtained from the cell balance of the
+/// fine-mesh solution, is preserved by a nonlinear correction of the removal term, so that the converged
+/// fine-mesh solution is a fixed point of the acceleration. The coarse eigenvector then rescales the 
+/// fine-mesh fluxes cell by cell and hence the fission source of the next power iteration.
+class CoarseMeshAcceleration
+{
+public:
+  CoarseMeshAcceleration(const MaterialPropertyMaps& matprop, const Mesh* mesh, double cell_size);
+
+  /// \brief Solves the coarse-mesh eigenproblem and rescales the fine-mesh fluxes.
+  ///
+  /// \param[in]     spaces         Spaces of the fine-mesh fluxes.
+  /// \param[in]     old_solutions  Power iterate that defined the fission source of the last fine-mesh solve.
+  /// \param[in]     new_solutions  Result of the last fine-mesh solve.
+  /// \param[in,out] coeff_vec      Coefficient vector of 'new_solutions', rescaled on output.
+  /// \param[in,out] keff           Eigenvalue used in the last fine-mesh solve on input, 
+  ///                               eigenvalue of the coarse-mesh problem on output.
+  ///
+  /// \return  false if the coarse-mesh problem could not be solved, in which case nothing is changed.
+  ///
+  bool accelerate(const Hermes::vector<const Space<double>*>& spaces, 
+                  const Hermes::vector<MeshFunction<double>*>& old_solutions,
+                  const Hermes::vector<Solution<double>*>& new_solutions,
+                  double* coeff_vec, double& keff);
+
+private:
+  void add_face(int c1, int c2, double dist1, double dist2, double area);
+  // Index of the cell containing (x, y), -1 outside the domain.
+  int find_cell(double x, double y) const;
+  // Integrals of 2\pi r times the function over each coarse cell.
+  void cell_integrals(MeshFunction<double>* sln, std::vector<double>& integrals) const;
+
+  // Dense LU factorization with partial pivoting and the corresponding solve.
+  static bool lu_factorize(std::vector<double>& A, std::vector<int>& piv, int n);
+  static void lu_solve(const std::vector<double>& A, const std::vector<int>& piv, std::vector<double>& b, int n);
+
+  // Coarse cell: material and volume of the body of revolution.
+  struct Cell
+  {
+    std::string material;
+    double volume;
+  };
+
+  // Interface between two cells, or between a cell and the boundary (cell[1] == -1). 
+  // 'dist' are the distances of the cell centroids to the interface.
+  struct Face
+  {
+    int cell[2];
+    double dist[2];
+    double area;
+  };
+
+  const MaterialPropertyMaps& matprop;
+  std::vector<Cell> cells;
+  std::vector<Face> faces;
+
+  // Grid lines, and the cell of each grid rectangle (-1 if not in the domain).
+  std::vector<double> x_grid, y_grid;
+  std::vector<int> cell_index;
+
+  // Maximum number of iterations and tolerance of the coarse-mesh power iteration.
+  static const int MAX_ITER = 500;
+  static const double TOL;
+};
+
 /// \brief Power iteration. 
 ///
 /// Starts from an initial guess stored in the argument 'solutions' and updates it by the final result after the iteration
@@ -136,6 +210,7 @@ private:
 /// \param[in]     hermes2d   Class encapsulating global Hermes2D functions.
 /// \param[in]     spaces     Pointers to spaces on which the solutions are defined (one space for each energy group).
 /// \param[in]     wf         Pointer to the weak form of the problem.
+/// \param[in,out] dp         Discrete problem of 'wf', kept by the caller across the calls and switched to 'spaces'.
 /// \param[in,out] solution   A set of Solution* pointers to solution components (neutron fluxes in each group). 
 ///                           Initial guess for the iteration on input, converged result on output.
 /// \param[in] fission_region String specifiying the part of the solution domain where fission occurs.
@@ -143,10 +218,23 @@ private:
 /// \param[in,out] mat        Pointer to a matrix to which the system associated with the power iteration will be assembled.
 /// \param[in,out] rhs        Pointer to a vector to which the right hand sides of the power iteration will be successively assembled.
 /// \param[in]     solver     Solver for the resulting matrix problem (specified by \c mat and \c rhs).
+/// \param[in]     cmfd       Coarse-mesh acceleration applied after each fine-mesh solve (none if NULL).
 ///
 /// \return  number of iterations needed for convergence within the specified tolerance.
 ///
 int power_iteration(const MaterialPropertyMaps& matprop, 
                     const Hermes::vector<const Space<double>*>& spaces, DefaultWeakFormSourceIteration<double>* wf, 
-                    const Hermes::vector<MeshFunction<double> *>& solution, const std::string& fission_region, 
-                    double tol, Hermes::MatrixSolverType matrix_solver);
+                    DiscreteProblem<double>* dp, const Hermes::vector<MeshFunction<double> *>& solution, const std::string& fission_region, 
+                    double tol, Hermes::MatrixSolverType matrix_solver, CoarseMeshAcceleration* cmfd = NULL);
+
+/// \brief Transfers the power iterates onto new spaces by the orthogonal projection.
+///
+/// Used to prolongate the eigenvector to the reference spaces. If the iterates belong
+/// to subspaces of 'spaces' (e.g. the coarse spaces of the reference ones), the transfer is exact.
+///
+/// \param[in]     spaces     Target spaces (one space for each energy group).
+/// \param[in,out] iterates   Power iterates, replaced by their projections. They must be
+///                           Solution instances.
+///
+void transfer_iterates(const Hermes::vector<const Space<double>*>& spaces, 
+                       const Hermes::vector<MeshFunction<double> *>& iterates);
@@ -93,6 +93,10 @@ double k_eff = 1.0;
 double TOL_PIT_CM = 5e-5;   
 // Tolerance for eigenvalue convergence on the fine mesh.
 double TOL_PIT_RM = 5e-6;   
+// Accelerate the power iterations by the solution of a low-order diffusion problem
+// on a material-aligned grid of cells not larger than CMFD_CELL_SIZE (CMFD).
+const bool CMFD_ACCELERATION = true;
+const double CMFD_CELL_SIZE = 0.5;
 
 // Macros for simpler reporting (four group case).
 #define report_num_dofs(spaces) spaces[0]->get_num_dofs(), spaces[1]->get_num_dofs(),\
@@ -248,10 +252,22 @@ int main(int argc, char* argv[])
     proj_norms_l2.push_back(HERMES_L2_NORM);
   }
   
+  // Initialize the coarse-mesh acceleration (all group meshes share the base elements).
+  CoarseMeshAcceleration cmfd(matprop, meshes[0], CMFD_CELL_SIZE);
+  CoarseMeshAcceleration* acceleration = CMFD_ACCELERATION ? &cmfd : NULL;
+
+  // Discrete problem shared by all power iterations.
+  DiscreteProblem<double> dp(&wf, const_spaces);
+
   // Initial power iteration to obtain a coarse estimate of the eigenvalue and the fission source.
   Hermes::Mixins::Loggable::Static::info("Coarse mesh power iteration, %d + %d + %d + %d = %d ndof:", report_num_dofs(spaces));
-  power_iteration(matprop, const_spaces, &wf, power_iterates, core, TOL_PIT_CM, matrix_solver);
+  int total_pit = power_iteration(matprop, const_spaces, &wf, &dp, power_iterates, core, TOL_PIT_CM, matrix_solver, acceleration);
   
+  // Reference meshes and spaces from the previous adaptivity step, on which the
+  // power iterates are defined until they are transferred to the new ones.
+  Hermes::vector<const Space<double>*> prev_ref_spaces;
+  Hermes::vector<Mesh *> prev_ref_meshes;
+
   // Adaptivity loop:
   int as = 1; bool done = false;
   do 
@@ -291,18 +307,32 @@ int main(int argc, char* argv[])
     }
 #endif    
 
-    // Solve the fine mesh problem.
-    Hermes::Mixins::Loggable::Static::info("Fine mesh power iteration, %d + %d + %d + %d = %d ndof:", report_num_dofs(ref_spaces_const));
-    power_iteration(matprop, ref_spaces_const, &wf, power_iterates, core, TOL_PIT_RM, matrix_solver);
+    // Nested iteration: start from the latest eigenvector prolongated to the reference spaces. 
+    // In the first step, it is the coarse mesh solution and the transfer is exact. Later on,
+    // the reference solution from the previous step is used and no coarse mesh solve is needed.
+    // The eigenvalue is kept from the previous solve.
+    transfer_iterates(ref_spaces_const, power_iterates);
+    for (unsigned int g = 0; g < prev_ref_spaces.size(); g++) 
+    {
+      delete prev_ref_spaces[g];
+      delete prev_ref_meshes[g];
+    }
+
+    // Solve the fine mesh problem. The warm start only saves iterations, the tolerance is always 
+    // TOL_PIT_RM, so the reference-mesh k_eff (and the error estimate based on it) is unchanged.
+    Hermes::Mixins::Loggable::Static::info("Fine mesh power iteration, %d + %d + %d + %d = %d ndof:", 
+      report_num_dofs(ref_spaces_const));
+    total_pit += power_iteration(matprop, ref_spaces_const, &wf, &dp, power_iterates, core, TOL_PIT_RM, matrix_solver, acceleration);
     
     // Store the results.
     for (unsigned int g = 0; g < matprop.get_G(); g++) 
       fine_solutions[g]->copy((static_cast<Solution<double>*>(power_iterates[g])));
 
     Hermes::Mixins::Loggable::Static::info("Projecting fine mesh solutions on coarse meshes.");
-    // This is commented out as the appropriate method was deleted in the commit
-    // "Cleaning global projections" (b282194946225014faa1de37f20112a5a5d7ab5a).
-    //OGProjection<double> ogProjection; ogProjection.project_global(spaces, projection_jacobian, projection_residual, coarse_solutions);
+    // The projection in the axisymmetric H1 norm (projection_jacobian, projection_residual) is not 
+    // available since the commit "Cleaning global projections" (b282194946225014faa1de37f20112a5a5d7ab5a),
+    // the default H1 projection is used instead.
+    OGProjection<double> ogProjection; ogProjection.project_global(const_spaces, fine_solutions, coarse_solutions);
 
     // Time measurement.
     cpu_time.tick();
@@ -383,12 +413,9 @@ int main(int argc, char* argv[])
         done = true;
     }
 
-    // Free reference meshes and spaces.
-    for (unsigned int g = 0; g < matprop.get_G(); g++) 
-    {
-      delete ref_spaces_const[g];
-      delete ref_meshes[g];
-    }
+    // Keep the reference meshes and spaces until the power iterates are transferred.
+    prev_ref_spaces = ref_spaces_const;
+    prev_ref_meshes = ref_meshes;
 
     as++;
         
@@ -397,11 +424,13 @@ int main(int argc, char* argv[])
   while(done == false);
 
   Hermes::Mixins::Loggable::Static::info("Total running time: %g s", cpu_time.accumulated());
+  Hermes::Mixins::Loggable::Static::info("Total number of power iterations: %d", total_pit);
   
   for (unsigned int g = 0; g < matprop.get_G(); g++) 
   {
     delete spaces[g]; delete meshes[g];
     delete coarse_solutions[g], delete fine_solutions[g]; delete power_iterates[g];
+    delete prev_ref_spaces[g]; delete prev_ref_meshes[g];
   }
   
   delete mat;
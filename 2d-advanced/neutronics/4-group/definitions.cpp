@@ -1,6 +1,9 @@
 ////// Weak formulation in axisymmetric coordinate system  ////////////////////////////////////
 
 #include "definitions.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 CustomWeakForm::CustomWeakForm( const Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::MaterialProperties::Diffusion::MaterialPropertyMaps& matprop,
                                 Hermes::vector<MeshFunction<double>*>& iterates,
@@ -14,34 +17,343 @@ CustomWeakForm::CustomWeakForm( const Hermes::Hermes2D::WeakFormsNeutronics::Mul
   }
 }
 
-// Integral over the active core.
-double integrate(MeshFunction<double>* sln, std::string area)
+RegionIntegrator::RegionIntegrator(const Hermes::vector<const Space<double>*>& spaces, std::string area)
+  : spaces(spaces), mesh(spaces[0]->get_mesh())
 {
+  marker = mesh->get_element_markers_conversion().get_internal_marker(area).marker;
+}
+
+void RegionIntegrator::update()
+{
+  bool changed = space_seqs.size() != spaces.size();
+  for (unsigned int g = 0; g < spaces.size() && !changed; g++)
+    changed = space_seqs[g] != spaces[g]->get_seq();
+  if (!changed)
+    return;
+
+  space_seqs.clear();
+  for (unsigned int g = 0; g < spaces.size(); g++)
+    space_seqs.push_back(spaces[g]->get_seq());
+
+  elements.clear();
+  orders.clear();
+  offsets.clear();
+
+  // Quadrature orders. The integrand is r times a combination of the group 
+  // fluxes, so the highest polynomial degree among the groups is increased 
+  // by one and by the order of the inverse reference mapping.
   Quad2D* quad = &g_quad_2d_std;
-  sln->set_quad_2d(quad);
-  
-  double integral = 0.0;
+  RefMap rm;
+  rm.set_quad_2d(quad);
+  int num_points = 0;
   Element* e;
-  Mesh* mesh = const_cast<Mesh*>(sln->get_mesh());
-  int marker = mesh->get_element_markers_conversion().get_internal_marker(area).marker;
-  
   for_all_active_elements(e, mesh)
   {
-    if (e->marker == marker)
+    if (e->marker != marker)
+      continue;
+
+    int p = 0;
+    for (unsigned int g = 0; g < spaces.size(); g++)
+    {
+      int o = spaces[g]->get_element_order(e->id);
+      p = std::max(p, std::max(H2D_GET_H_ORDER(o), H2D_GET_V_ORDER(o)));
+    }
+
+    update_limit_table(e->get_mode());
+    rm.set_active_element(e);
+    int o = p + 1 + rm.get_inv_ref_order();
+    limit_order(o, e->get_mode());
+
+    elements.push_back(e);
+    orders.push_back(o);
+    offsets.push_back(num_points);
+    num_points += quad->get_num_points(o, e->get_mode());
+  }
+  weights.resize(num_points);
+
+  // Weights multiplied by the Jacobian and by r. Elements are independent, so
+  // each thread uses its own reference mapping.
+  int num_elements = elements.size();
+#pragma omp parallel
+  {
+    RefMap thread_rm;
+    thread_rm.set_quad_2d(quad);
+#pragma omp for
+    for (int k = 0; k < num_elements; k++)
     {
-      update_limit_table(e->get_mode());
-      sln->set_active_element(e);
-      RefMap* ru = sln->get_refmap();
-      int o = 20;
-      limit_order(o, e->get_mode());
-      sln->set_quad_order(o, H2D_FN_VAL);
-      double *uval = sln->get_fn_values();
-      double* x = ru->get_phys_x(o);
-      double result = 0.0;
-      h1_integrate_expression(x[i] * uval[i]);
-      integral += result;
+      Element* e = elements[k];
+      int o = orders[k];
+      thread_rm.set_active_element(e);
+      double3* pt = quad->get_points(o, e->get_mode());
+      int np = quad->get_num_points(o, e->get_mode());
+      double* x = thread_rm.get_phys_x(o);
+      double* w = &weights[offsets[k]];
+      if (thread_rm.is_jacobian_const())
+      {
+        double jac = thread_rm.get_const_jacobian();
+        for (int i = 0; i < np; i++)
+          w[i] = pt[i][2] * jac * x[i];
+      }
+      else
+      {
+        double* jac = thread_rm.get_jacobian(o);
+        for (int i = 0; i < np; i++)
+          w[i] = pt[i][2] * jac[i] * x[i];
+      }
     }
   }
-  
+}
+
+double RegionIntegrator::integrate(const Hermes::vector<MeshFunction<double>*>& fns, const std::vector<double>& coeffs)
+{
+  update();
+
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  // Every thread evaluates its own copies of the functions (they cache the values on the active element).
+  std::vector<std::vector<MeshFunction<double>*> > thread_fns(num_threads);
+  for (int t = 0; t < num_threads; t++)
+    for (unsigned int g = 0; g < fns.size(); g++)
+    {
+      thread_fns[t].push_back(fns[g]->clone());
+      thread_fns[t][g]->set_quad_2d(&g_quad_2d_std);
+    }
+
+  int num_elements = elements.size();
+  std::vector<double> element_integrals(num_elements, 0.0);
+#pragma omp parallel num_threads(num_threads)
+  {
+    int t = 0;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+#pragma omp for schedule(dynamic)
+    for (int k = 0; k < num_elements; k++)
+    {
+      const double* w = &weights[offsets[k]];
+      int np = (k + 1 < num_elements ? offsets[k + 1] : (int) weights.size()) - offsets[k];
+      for (unsigned int g = 0; g < fns.size(); g++)
+      {
+        if (coeffs[g] == 0.0)
+          continue;
+        MeshFunction<double>* fn = thread_fns[t][g];
+        fn->set_active_element(elements[k]);
+        fn->set_quad_order(orders[k], H2D_FN_VAL);
+        double* val = fn->get_fn_values();
+        double integral = 0.0;
+        for (int i = 0; i < np; i++)
+          integral += w[i] * val[i];
+        element_integrals[k] += coeffs[g] * integral;
+      }
+    }
+  }
+
+  for (int t = 0; t < num_threads; t++)
+    for (unsigned int g = 0; g < fns.size(); g++)
+      delete thread_fns[t][g];
+
+  // Summed in the order of the elements, so that the result does not depend on the number of threads.
+  double integral = 0.0;
+  for (int k = 0; k < num_elements; k++)
+    integral += element_integrals[k];
+
   return 2.0 * M_PI * integral;
 }
+
+SingleGroupWeakForm::SingleGroupWeakForm(const Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::MaterialProperties::Diffusion::MaterialPropertyMaps& matprop,
+                                         unsigned int g, Hermes::vector<MeshFunction<double>*>& iterates,
+                                         Hermes::vector<MeshFunction<double>*>& fluxes,
+                                         double init_keff, std::string bdy_vacuum)
+  : WeakForm<double>(1)
+{
+  unsigned int G = matprop.get_G();
+
+  MaterialPropertyMap1::const_iterator it;
+  for (it = matprop.get_D().begin(); it != matprop.get_D().end(); ++it)
+  {
+    std::string material = it->first;
+
+    add_matrix_form(new WeakFormsH1::DefaultJacobianDiffusion<double>(0, 0, material, 
+                      new Hermes1DFunction<double>(matprop.get_D(material)[g]), HERMES_SYM, HERMES_AXISYM_Y));
+    add_matrix_form(new WeakFormsH1::DefaultMatrixFormVol<double>(0, 0, material, 
+                      new Hermes2DFunction<double>(matprop.get_Sigma_r(material)[g]), HERMES_SYM, HERMES_AXISYM_Y));
+
+    const rank1& chi = matprop.get_chi(material);
+    const rank1& nu = matprop.get_nu(material);
+    const rank1& Sigma_f = matprop.get_Sigma_f(material);
+    const rank2& Sigma_s = matprop.get_Sigma_s(material);
+
+    rank1 fission(G, 0.0), scattering(G, 0.0);
+    for (unsigned int gfrom = 0; gfrom < G; gfrom++)
+    {
+      fission[gfrom] = chi[g] * nu[gfrom] * Sigma_f[gfrom];
+      if (gfrom != g)
+        scattering[gfrom] = Sigma_s[g][gfrom];
+    }
+
+    SourceForm* source = new SourceForm(material, fission, scattering, iterates, fluxes, init_keff);
+    source_forms.push_back(source);
+    add_vector_form(source);
+  }
+
+  add_matrix_form_surf(new Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::ElementaryForms::Diffusion::VacuumBoundaryCondition::Jacobian<double>(0, bdy_vacuum, HERMES_AXISYM_Y));
+}
+
+void SingleGroupWeakForm::update_keff(double new_keff)
+{
+  for (unsigned int i = 0; i < source_forms.size(); i++)
+    source_forms[i]->keff = new_keff;
+}
+
+SingleGroupWeakForm::SourceForm::SourceForm(std::string area, const rank1& fission, const rank1& scattering,
+                                            Hermes::vector<MeshFunction<double>*>& iterates,
+                                            Hermes::vector<MeshFunction<double>*>& fluxes, double keff)
+  : VectorFormVol<double>(0, area), fission(fission), scattering(scattering), keff(keff)
+{
+  for (unsigned int g = 0; g < iterates.size(); g++)
+    this->ext.push_back(iterates[g]);
+  for (unsigned int g = 0; g < fluxes.size(); g++)
+    this->ext.push_back(fluxes[g]);
+}
+
+template<typename Real, typename Scalar>
+Scalar SingleGroupWeakForm::SourceForm::vector_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *v,
+                                                    Geom<Real> *e, Func<Scalar>* *ext) const
+{
+  // The first G external functions are the previous power iterates, the next G
+  // the current group fluxes.
+  unsigned int G = fission.size();
+
+  Scalar result = (Scalar)0;
+  for (int i = 0; i < n; i++)
+  {
+    Scalar source = (Scalar)0;
+    for (unsigned int gfrom = 0; gfrom < G; gfrom++)
+      source += fission[gfrom] / keff * ext[gfrom]->val[i] + scattering[gfrom] * ext[G + gfrom]->val[i];
+    result += wt[i] * e->x[i] * source * v->val[i];
+  }
+  return result;
+}
+
+double SingleGroupWeakForm::SourceForm::value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                                              Geom<double> *e, Func<double>* *ext) const
+{
+  return vector_form<double, double>(n, wt, u_ext, v, e, ext);
+}
+
+Ord SingleGroupWeakForm::SourceForm::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                                         Geom<Ord> *e, Func<Ord>* *ext) const
+{
+  return vector_form<Ord, Ord>(n, wt, u_ext, v, e, ext);
+}
+
+VectorFormVol<double>* SingleGroupWeakForm::SourceForm::clone() const
+{
+  return new SingleGroupWeakForm::SourceForm(*this);
+}
+
+GroupSweepSolver::GroupSweepSolver(const Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::MaterialProperties::Diffusion::MaterialPropertyMaps& matprop,
+                                   const Hermes::vector<const Space<double>*>& spaces,
+                                   Hermes::vector<MeshFunction<double>*>& iterates,
+                                   const Hermes::vector<Solution<double>*>& solutions,
+                                   double init_keff, std::string bdy_vacuum)
+  : spaces(spaces), solutions(solutions), upscatter(false), factorized(false)
+{
+  unsigned int G = matprop.get_G();
+  if (spaces.size() != G || solutions.size() != G)
+    throw Hermes::Exceptions::Exception("Spaces and solutions supplied to GroupSweepSolver do not match the number of groups.");
+
+  // Scattering sources of the first sweep are taken from the initial guess.
+  int ndof = Space<double>::get_num_dofs(spaces);
+  double* coeff_vec = new double[ndof];
+  OGProjection<double> ogProjection; ogProjection.project_global(spaces, iterates, coeff_vec);
+  Solution<double>::vector_to_solutions(coeff_vec, spaces, solutions);
+  delete [] coeff_vec;
+
+  for (unsigned int g = 0; g < G; g++)
+    fluxes.push_back(solutions[g]);
+
+  // Sigma_s[g][g'] is the scattering from group g' to group g; groups are ordered 
+  // from the fastest one.
+  MaterialPropertyMap2::const_iterator it;
+  for (it = matprop.get_Sigma_s().begin(); it != matprop.get_Sigma_s().end(); ++it)
+    for (unsigned int g = 0; g < G; g++)
+      for (unsigned int gfrom = g + 1; gfrom < G; gfrom++)
+        if (it->second[g][gfrom] != 0.0)
+          upscatter = true;
+
+  for (unsigned int g = 0; g < G; g++)
+  {
+    wfs.push_back(new SingleGroupWeakForm(matprop, g, iterates, fluxes, init_keff, bdy_vacuum));
+    dps.push_back(new DiscreteProblem<double>(wfs[g], spaces[g]));
+    matrices.push_back(create_matrix<double>());
+    rhss.push_back(create_vector<double>());
+    solvers.push_back(create_linear_solver<double>(matrices[g], rhss[g]));
+  }
+}
+
+GroupSweepSolver::~GroupSweepSolver()
+{
+  for (unsigned int g = 0; g < wfs.size(); g++)
+  {
+    delete solvers[g];
+    delete rhss[g];
+    delete matrices[g];
+    delete dps[g];
+    delete wfs[g];
+  }
+}
+
+void GroupSweepSolver::solve(int max_upscatter_iter, double upscatter_tol)
+{
+  int max_sweeps = upscatter ? max_upscatter_iter : 1;
+  std::vector<std::vector<double> > previous(wfs.size());
+  int sweep = 0;
+  bool converged = false;
+  while (!converged && sweep < max_sweeps)
+  {
+    double change = 0.0, norm = 0.0;
+    for (unsigned int g = 0; g < wfs.size(); g++)
+    {
+      // Only the right-hand side changes after the first sweep.
+      if (factorized)
+        dps[g]->assemble(rhss[g]);
+      else
+        dps[g]->assemble(matrices[g], rhss[g]);
+
+      if (!solvers[g]->solve())
+        throw Hermes::Exceptions::Exception("Matrix solver failed for group %d.", g + 1);
+
+      if (!factorized)
+        solvers[g]->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+
+      const double* sln_vector = solvers[g]->get_sln_vector();
+      int ndof = spaces[g]->get_num_dofs();
+      if (sweep > 0)
+        for (int i = 0; i < ndof; i++)
+        {
+          change += sqr(sln_vector[i] - previous[g][i]);
+          norm += sqr(sln_vector[i]);
+        }
+      previous[g].assign(sln_vector, sln_vector + ndof);
+
+      Solution<double>::vector_to_solution(sln_vector, spaces[g], solutions[g]);
+    }
+    factorized = true;
+    sweep++;
+
+    // The first sweep only has the fluxes of the previous power iteration to compare with.
+    converged = !upscatter || (sweep > 1 && std::sqrt(change) <= upscatter_tol * std::sqrt(norm));
+  }
+
+  if (upscatter)
+    Hermes::Mixins::Loggable::Static::info("Group sweeps: %d%s.", sweep, converged ? "" : " (up-scattering not converged)");
+}
+
+void GroupSweepSolver::update_keff(double new_keff)
+{
+  for (unsigned int g = 0; g < wfs.size(); g++)
+    wfs[g]->update_keff(new_keff);
+}
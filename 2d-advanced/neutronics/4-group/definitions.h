@@ -10,6 +10,7 @@ using namespace Hermes::Hermes2D::Views;
 using namespace Hermes::Hermes2D::RefinementSelectors;
 using namespace Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::CompleteWeakForms::Diffusion;
 using namespace Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::SupportClasses;
+using namespace Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::MaterialProperties::Definitions;
 
 class CustomWeakForm : public DefaultWeakFormSourceIteration<double>
 {
@@ -20,5 +21,130 @@ class CustomWeakForm : public DefaultWeakFormSourceIteration<double>
         double init_keff, std::string bdy_vacuum);
 };
 
-// Integral over the active core.
-double integrate(MeshFunction<double>* sln, std::string area);
+// Integral over a material region of the axisymmetric domain,
+//
+//   \int_{area} 2\pi r \sum_g c_g f_g(r,z) dr dz.
+//
+// Quadrature weights multiplied by the Jacobian and by r are computed once
+// for all elements of the region and reused until the spaces change, so that
+// each call only evaluates the integrated functions. The quadrature order on
+// each element is derived from the polynomial degrees of the given spaces.
+// The elements are integrated in parallel, each thread with its own clones
+// of the functions.
+class RegionIntegrator
+{
+  public:
+    RegionIntegrator(const Hermes::vector<const Space<double>*>& spaces, std::string area);
+
+    double integrate(const Hermes::vector<MeshFunction<double>*>& fns, const std::vector<double>& coeffs);
+
+  private:
+    // Rebuilds the cached element data if any space has changed.
+    void update();
+
+    Hermes::vector<const Space<double>*> spaces;
+    const Mesh* mesh;
+    int marker;
+
+    // Sequence numbers of the spaces at the time of the last update.
+    std::vector<int> space_seqs;
+
+    // Active elements of the region, their quadrature orders and the offsets
+    // of their scaled weights in 'weights'.
+    std::vector<Element*> elements;
+    std::vector<int> orders;
+    std::vector<int> offsets;
+    std::vector<double> weights;
+};
+
+// Weak form of a single energy group g, with the fission source computed from the 
+// previous power iterate and the scattering from the other groups moved to the 
+// right-hand side:
+//
+//  - \nabla \cdot D_g \nabla \phi_g + \Sigma_{Rg}\phi_g =
+//  = \frac{\chi_g}{k_{eff}} \sum_{g'} \nu_{g'} \Sigma_{fg'}\phi_{g'}^{prev} + \sum_{g' \neq g} \Sigma_s^{g'\to g} \phi_{g'}
+//
+// The left-hand side depends neither on k_eff nor on the other groups, hence its
+// matrix may be assembled and factorized only once for all power iterations.
+class SingleGroupWeakForm : public WeakForm<double>
+{
+  public:
+    SingleGroupWeakForm(const Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::MaterialProperties::Diffusion::MaterialPropertyMaps& matprop,
+                        unsigned int g, Hermes::vector<MeshFunction<double>*>& iterates,
+                        Hermes::vector<MeshFunction<double>*>& fluxes,
+                        double init_keff, std::string bdy_vacuum);
+
+    void update_keff(double new_keff);
+
+  private:
+    class SourceForm : public VectorFormVol<double>
+    {
+      public:
+        SourceForm(std::string area, const rank1& fission, const rank1& scattering,
+                   Hermes::vector<MeshFunction<double>*>& iterates,
+                   Hermes::vector<MeshFunction<double>*>& fluxes, double keff);
+
+        template<typename Real, typename Scalar>
+        Scalar vector_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *v,
+                           Geom<Real> *e, Func<Scalar>* *ext) const;
+
+        virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                             Geom<double> *e, Func<double>* *ext) const;
+
+        virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                        Geom<Ord> *e, Func<Ord>* *ext) const;
+
+        VectorFormVol<double>* clone() const;
+
+        // Coefficients \chi_g \nu_{g'} \Sigma_{fg'} and \Sigma_s^{g'\to g} of the
+        // fission and scattering sources from group g'.
+        rank1 fission, scattering;
+        double keff;
+    };
+
+    Hermes::vector<SourceForm*> source_forms;
+};
+
+/// \brief Group-sweep solver for the power iteration.
+///
+/// Instead of solving one coupled system for all groups, the groups are solved one after 
+/// another (block Gauss-Seidel), each using the latest fluxes of the other groups in the 
+/// scattering source. Every group has its own matrix, which is assembled and factorized 
+/// in the first sweep and then reused, since only the right-hand sides change afterwards.
+/// With down-scattering only, one sweep per power iteration solves the groups exactly;
+/// otherwise the sweep may be repeated to converge the up-scattering.
+class GroupSweepSolver
+{
+  public:
+    /// \param[in]     matprop    Material properties.
+    /// \param[in]     spaces     Spaces for the group fluxes.
+    /// \param[in]     iterates   Previous power iterate, used for the fission source.
+    /// \param[in,out] solutions  Group fluxes. Initialized by projecting 'iterates' and 
+    ///                           updated by each call of solve().
+    GroupSweepSolver(const Hermes::Hermes2D::WeakFormsNeutronics::Multigroup::MaterialProperties::Diffusion::MaterialPropertyMaps& matprop,
+                     const Hermes::vector<const Space<double>*>& spaces,
+                     Hermes::vector<MeshFunction<double>*>& iterates,
+                     const Hermes::vector<Solution<double>*>& solutions,
+                     double init_keff, std::string bdy_vacuum);
+    ~GroupSweepSolver();
+
+    /// Sweeps over all groups once, or if any material scatters neutrons to higher energies,
+    /// until the relative change of the group fluxes (their coefficient vectors) between two
+    /// sweeps drops below 'upscatter_tol', at most 'max_upscatter_iter' times.
+    void solve(int max_upscatter_iter, double upscatter_tol);
+
+    void update_keff(double new_keff);
+
+  private:
+    Hermes::vector<const Space<double>*> spaces;
+    Hermes::vector<Solution<double>*> solutions;
+    Hermes::vector<MeshFunction<double>*> fluxes;
+    bool upscatter;
+    bool factorized;
+
+    Hermes::vector<SingleGroupWeakForm*> wfs;
+    Hermes::vector<DiscreteProblem<double>*> dps;
+    Hermes::vector<SparseMatrix<double>*> matrices;
+    Hermes::vector<Vector<double>*> rhss;
+    Hermes::vector<LinearMatrixSolver<double>*> solvers;
+};
@@ -50,6 +50,15 @@ const double ERROR_STOP = 1e-5;
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 MatrixSolverType matrix_solver = SOLVER_UMFPACK;  
 
+// Solve the groups one after another, each with its own matrix that is factorized
+// only once, instead of solving one coupled system for all groups.
+const bool GROUP_SWEEP = true;
+// Maximum number of group sweeps per power iteration and the relative change of the
+// group fluxes between two sweeps that stops them (only used if there is up-scattering,
+// otherwise one sweep is enough).
+const int MAX_UPSCATTER_ITER = 5;
+const double UPSCATTER_TOL = 1e-6;
+
 // Stopping criterion for the Newton's method.
 const double NEWTON_TOL = 1e-8;                   
 // Maximum allowed number of Newton iterations.
@@ -122,6 +131,20 @@ int main(int argc, char* argv[])
   // Initialize Newton solver.
   NewtonSolver<double> newton(&dp);
 
+  // Initialize the group-sweep solver.
+  GroupSweepSolver* sweep_solver = NULL;
+  if (GROUP_SWEEP)
+    sweep_solver = new GroupSweepSolver(matprop, spaces, iterates, solutions, k_eff, bdy_vacuum);
+
+  // Initialize the integrator of fission sources over the active core and
+  // evaluate the source corresponding to the initial guess. The fission
+  // source in the core is sum_g nu_g Sigma_f_g phi_g.
+  RegionIntegrator core_integrator(spaces, core);
+  std::vector<double> fission_coeffs;
+  for (unsigned int g = 0; g < matprop.get_G(); g++)
+    fission_coeffs.push_back(matprop.get_nu(core)[g] * matprop.get_Sigma_f(core)[g]);
+  double source_integral = core_integrator.integrate(iterates, fission_coeffs);
+
   // Time measurement.
   Hermes::Mixins::TimeMeasurable cpu_time;
       
@@ -131,27 +154,37 @@ int main(int argc, char* argv[])
   {
     Hermes::Mixins::Loggable::Static::info("------------ Power iteration %d:", it);
     
-    Hermes::Mixins::Loggable::Static::info("Newton's method.");
-    
-    // Perform Newton's iteration.
-    try
+    if (GROUP_SWEEP)
     {
-      newton.set_newton_max_iter(NEWTON_MAX_ITER);
-      newton.set_newton_tol(NEWTON_TOL);
-      newton.solve_keep_jacobian();
+      Hermes::Mixins::Loggable::Static::info("Group sweep.");
+
+      // The group fluxes are stored directly in 'solutions'.
+      sweep_solver->solve(MAX_UPSCATTER_ITER, UPSCATTER_TOL);
     }
-    catch(Hermes::Exceptions::Exception e)
+    else
     {
-      e.print_msg();
-      throw Hermes::Exceptions::Exception("Newton's iteration failed.");
-    }
+      Hermes::Mixins::Loggable::Static::info("Newton's method.");
+    
+      // Perform Newton's iteration.
+      try
+      {
+        newton.set_newton_max_iter(NEWTON_MAX_ITER);
+        newton.set_newton_tol(NEWTON_TOL);
+        newton.solve_keep_jacobian();
+      }
+      catch(Hermes::Exceptions::Exception e)
+      {
+        e.print_msg();
+        throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+      }
        
-    // Debug.
-    //printf("\n=================================================\n");
-    //for (int d = 0; d < ndof; d++) printf("%g ", newton.get_sln_vector()[d]);
+      // Debug.
+      //printf("\n=================================================\n");
+      //for (int d = 0; d < ndof; d++) printf("%g ", newton.get_sln_vector()[d]);
 
-    // Translate the resulting coefficient vector into a Solution.
-    Solution<double>::vector_to_solutions(newton.get_sln_vector(), spaces, solutions);
+      // Translate the resulting coefficient vector into a Solution.
+      Solution<double>::vector_to_solutions(newton.get_sln_vector(), spaces, solutions);
+    }
     
     // Show intermediate solutions.
     view1.show(&sln1);    
@@ -159,11 +192,11 @@ int main(int argc, char* argv[])
     view3.show(&sln3);    
     view4.show(&sln4);
     
-    // Compute eigenvalue.
-    SourceFilter source(solutions, &matprop, core);
-    SourceFilter source_prev(iterates, &matprop, core);
+    // Compute eigenvalue. The source integral of the previous iterate is 
+    // the one computed in the previous iteration.
+    double source_integral_new = core_integrator.integrate(Hermes::vector<MeshFunction<double>*>(&sln1, &sln2, &sln3, &sln4), fission_coeffs);
     
-    double k_new = k_eff * (integrate(&source, core) / integrate(&source_prev, core));
+    double k_new = k_eff * (source_integral_new / source_integral);
     Hermes::Mixins::Loggable::Static::info("Largest eigenvalue: %.8g, rel. difference from previous it.: %g", k_new, fabs((k_eff - k_new) / k_new));
     
     // Stopping criterion.
@@ -172,6 +205,9 @@ int main(int argc, char* argv[])
     // Update eigenvalue.
     k_eff = k_new;
     wf.update_keff(k_eff);
+    if (GROUP_SWEEP)
+      sweep_solver->update_keff(k_eff);
+    source_integral = source_integral_new;
     
     if (!done)
     {
@@ -198,6 +234,8 @@ int main(int argc, char* argv[])
   // Skip visualization time.
   cpu_time.tick(Hermes::Mixins::TimeMeasurable::HERMES_SKIP);
 
+  delete sweep_solver;
+
   // Print timing information.
   Hermes::Mixins::Loggable::Static::info("Total running time: %g s", cpu_time.accumulated());
     
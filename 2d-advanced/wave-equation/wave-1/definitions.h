@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "../../common/linear_rk.h"
 
 /* Namespaces used */
 
@@ -9,7 +9,9 @@
 // For a list of available R-K methods see the file hermes_common/tables.h.
 //
 // The function rk_time_step_newton() needs more optimisation, see a todo list at 
-// the beginning of file src/runge-kutta.h.
+// the beginning of file src/runge-kutta.h. Since the problem is linear and 
+// time-invariant, the default is the LinearRungeKutta stepper that assembles 
+// and factorizes the stage matrices only once (see common/linear_rk.h).
 //
 // PDE: \frac{1}{C_SQUARED}\frac{\partial^2 u}{\partial t^2} - \Delta u = 0,
 // converted into
@@ -30,6 +32,9 @@ const int P_INIT = 6;
 const double time_step = 0.01;                     
 // Final time.
 const double T_FINAL = 2.0;                        
+// Use the linear R-K stepper (explicit and diagonally implicit methods only), 
+// otherwise the Newton's method is used in each time step.
+const bool LINEAR_RK = true;
 // Matrix solver: SOLVER_AMESOS, SOLVER_AZTECOO, SOLVER_MUMPS,
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 MatrixSolverType matrix_solver = SOLVER_UMFPACK;   
@@ -101,6 +106,9 @@ int main(int argc, char* argv[])
 
   // Initialize Runge-Kutta time stepping.
   RungeKutta<double> runge_kutta(&wf, Hermes::vector<const Space<double>*>(&u_space, &v_space), &bt);
+  LinearRungeKutta* linear_rk = NULL;
+  if (LINEAR_RK)
+    linear_rk = new LinearRungeKutta(&wf, Hermes::vector<const Space<double>*>(&u_space, &v_space), &bt);
 
   // Time stepping loop.
   double current_time = 0; int ts = 1;
@@ -114,10 +122,19 @@ int main(int argc, char* argv[])
 
     try
     {
-      runge_kutta.set_time(current_time);
-      runge_kutta.set_time_step(time_step);
-
-      runge_kutta.rk_time_step_newton(slns, slns);
+      if (LINEAR_RK)
+      {
+        linear_rk->set_time(current_time);
+        linear_rk->set_time_step(time_step);
+        linear_rk->rk_time_step(slns, slns);
+      }
+      else
+      {
+        runge_kutta.set_time(current_time);
+        runge_kutta.set_time_step(time_step);
+
+        runge_kutta.rk_time_step_newton(slns, slns);
+      }
     }
     catch(Exceptions::Exception& e)
     {
@@ -138,6 +155,8 @@ int main(int argc, char* argv[])
 
   } while (current_time < T_FINAL);
 
+  delete linear_rk;
+
   // Wait for the view to be closed.
   View::wait();
 
@@ -1,5 +1,7 @@
 #define HERMES_REPORT_ALL
 #include "definitions.h"
+#include "../common/linear_newton_step.h"
+#include "../common/parallel_adapt.h"
 
 using namespace RefinementSelectors;
 
@@ -61,6 +63,9 @@ const double ERR_STOP = 0.01;
 // Adaptivity process stops when the number of degrees of freedom grows
 // over this limit. This is to prevent h-adaptivity to go on forever.
 const int NDOF_STOP = 60000;                      
+// Number of threads selecting the refinements of the elements (the error estimate uses all threads of OpenMP).
+// The refinements do not depend on it.
+const int NUM_THREADS = 4;
 // Matrix solver: SOLVER_AMESOS, SOLVER_AZTECOO, SOLVER_MUMPS,
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 Hermes::MatrixSolverType matrix_solver = Hermes::SOLVER_UMFPACK;  
@@ -98,8 +103,10 @@ int main(int argc, char* argv[])
   // Initialize approximate solution.
   Solution<double> sln;
   
-  // Initialize refinement selector.
-  H1ProjBasedSelector<double> selector(CAND_LIST, CONV_EXP, H2DRS_DEFAULT_ORDER);
+  // Initialize refinement selectors, one for every thread.
+  Hermes::vector<Selector<double>*> selectors;
+  for (int i = 0; i < NUM_THREADS; i++)
+    selectors.push_back(new H1ProjBasedSelector<double>(CAND_LIST, CONV_EXP, H2DRS_DEFAULT_ORDER));
 
   // Initialize views.
   Views::ScalarView sview("Solution", new Views::WinGeom(0, 0, 440, 350));
@@ -135,22 +142,22 @@ int main(int argc, char* argv[])
     // Assemble the discrete problem.    
     DiscreteProblem<double> dp(&wf, ref_space);
     
-    NewtonSolver<double> newton(&dp);
-    //newton.set_verbose_output(false);
+    // The problem is linear: one assembling and one solution instead of Newton's iteration.
+    LinearNewtonStep<double> solver(&dp);
     
     Solution<double> ref_sln;
     try
     {
-      newton.solve();
+      solver.solve();
     }
     catch(Hermes::Exceptions::Exception e)
     {
       e.print_msg();
-      throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+      throw Hermes::Exceptions::Exception("Linear solver failed.");
     };
 
     // Translate the resulting coefficient vector into the instance of Solution.
-    Solution<double>::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
+    Solution<double>::vector_to_solution(solver.get_sln_vector(), ref_space, &ref_sln);
     
     cpu_time.tick();
     Hermes::Mixins::Loggable::Static::info("Solution: %g s", cpu_time.last());
@@ -160,7 +167,7 @@ int main(int argc, char* argv[])
     OGProjection<double> ogProjection; ogProjection.project_global(&space, &ref_sln, &sln);
 
     // Calculate element errors and total error estimate.
-    Adapt<double> adaptivity(&space);
+    ParallelAdapt adaptivity(&space);
     double err_est_rel = adaptivity.calc_err_est(&sln, &ref_sln) * 100;
 
     // Calculate exact error.
@@ -198,7 +205,7 @@ int main(int argc, char* argv[])
     if (err_exact_rel < ERR_STOP || space.get_num_dofs() >= NDOF_STOP) 
       done = true;
     else
-      done = adaptivity.adapt(&selector, THRESHOLD, STRATEGY, MESH_REGULARITY);
+      done = adaptivity.adapt(selectors, THRESHOLD, STRATEGY, MESH_REGULARITY);
    
     cpu_time.tick();
     Hermes::Mixins::Loggable::Static::info("Adaptation: %g s", cpu_time.last());
@@ -214,6 +221,9 @@ int main(int argc, char* argv[])
   
   Hermes::Mixins::Loggable::Static::info("Total running time: %g s", cpu_time.accumulated());
 
+  for (int i = 0; i < NUM_THREADS; i++)
+    delete selectors[i];
+
   // Wait for all views to be closed.
   Views::View::wait();
   return 0;
@@ -1,5 +1,7 @@
 #define HERMES_REPORT_ALL
 #include "definitions.h"
+#include "../common/linear_newton_step.h"
+#include "../common/two_level_solver.h"
 
 using namespace RefinementSelectors;
 
@@ -59,6 +61,9 @@ const double CONV_EXP = 0.3;
 // Adaptivity process stops when the number of degrees of freedom grows
 // over this limit. This is to prevent h-adaptivity to go on forever.
 const int NDOF_STOP = 60000;                      
+// Solve the reference problems by the conjugate gradient method preconditioned by the coarse problem
+// (TwoLevelSolver) instead of the direct solver, for large problems (raise NDOF_STOP).
+const bool ITERATIVE_SOLVER = false;
 // Matrix solver: SOLVER_AMESOS, SOLVER_AZTECOO, SOLVER_MUMPS,
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 MatrixSolverType matrix_solver = SOLVER_UMFPACK; 
@@ -115,26 +120,32 @@ int main(int argc, char* argv[])
     Space<double>* ref_space = refSpaceCreator.create_ref_space();
     int ndof_ref = ref_space->get_num_dofs();
 
-    // Initialize fine mesh problem.
+    // Solve on the fine mesh.
     Hermes::Mixins::Loggable::Static::info("Solving on fine mesh.");
-    DiscreteProblem<double> dp(&wf, ref_space);
-    
-    NewtonSolver<double> newton(&dp);
-    newton.set_verbose_output(true);
-
-    // Perform Newton's iteration.
     try
     {
-      newton.solve();
+      if (ITERATIVE_SOLVER)
+      {
+        // The initial guess is the solution of the coarse problem.
+        TwoLevelSolver solver(&wf, &space, ref_space);
+        if (!solver.solve())
+          throw Hermes::Exceptions::Exception("The iterative solver did not converge.");
+        Solution<double>::vector_to_solution(solver.get_sln_vector(), ref_space, &ref_sln);
+      }
+      else
+      {
+        // The problem is linear: one assembling and one solution instead of Newton's iteration.
+        DiscreteProblem<double> dp(&wf, ref_space);
+        LinearNewtonStep<double> solver(&dp);
+        solver.solve();
+        Solution<double>::vector_to_solution(solver.get_sln_vector(), ref_space, &ref_sln);
+      }
     }
     catch(Hermes::Exceptions::Exception e)
     {
       e.print_msg();
-      throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+      throw Hermes::Exceptions::Exception("Linear solver failed.");
     }
-
-    // Translate the resulting coefficient vector into the instance of Solution.
-    Solution<double>::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
     
     // Project the fine mesh solution onto the coarse mesh.
     Hermes::Mixins::Loggable::Static::info("Projecting fine mesh solution on coarse mesh.");
@@ -1,6 +1,7 @@
 #define HERMES_REPORT_ALL
 #define HERMES_REPORT_FILE "application.log"
 #include "definitions.h"
+#include "../common/linear_newton_step.h"
 
 using namespace RefinementSelectors;
 
@@ -132,22 +133,22 @@ int main(int argc, char* argv[])
     // Assemble the discrete problem.    
     DiscreteProblem<double> dp(&wf, ref_space);
     
-    NewtonSolver<double> newton(&dp);
-    //newton.set_verbose_output(false);
+    // The problem is linear: one assembling and one solution instead of Newton's iteration.
+    LinearNewtonStep<double> solver(&dp);
     
     Solution<double> ref_sln;
     try
     {
-      newton.solve();
+      solver.solve();
     }
     catch(Hermes::Exceptions::Exception e)
     {
       e.print_msg();
-      throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+      throw Hermes::Exceptions::Exception("Linear solver failed.");
     };
 
     // Translate the resulting coefficient vector into the instance of Solution.
-    Solution<double>::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
+    Solution<double>::vector_to_solution(solver.get_sln_vector(), ref_space, &ref_sln);
     
     cpu_time.tick();
     Hermes::Mixins::Loggable::Static::info("Solution: %g s", cpu_time.last());
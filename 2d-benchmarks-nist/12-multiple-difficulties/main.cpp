@@ -1,5 +1,7 @@
 #define HERMES_REPORT_ALL
 #include "definitions.h"
+#include "../common/linear_newton_step.h"
+#include "../common/two_level_solver.h"
 
 using namespace RefinementSelectors;
 
@@ -65,6 +67,9 @@ const double ERR_STOP = 1.0;
 // Adaptivity process stops when the number of degrees of freedom grows
 // over this limit. This is to prevent h-adaptivity to go on forever.
 const int NDOF_STOP = 60000;
+// Solve the reference problems by the conjugate gradient method preconditioned by the coarse problem
+// (TwoLevelSolver) instead of the direct solver, for large problems (raise NDOF_STOP).
+const bool ITERATIVE_SOLVER = false;
 // Matrix solver: SOLVER_AMESOS, SOLVER_AZTECOO, SOLVER_MUMPS,
 // SOLVER_PETSC, SOLVER_SUPERLU, SOLVER_UMFPACK.
 Hermes::MatrixSolverType matrix_solver = Hermes::SOLVER_UMFPACK;                     
@@ -133,25 +138,31 @@ int main(int argc, char* argv[])
     
     Hermes::Mixins::Loggable::Static::info("Solving on reference mesh.");
     
-    // Assemble the discrete problem.    
-    DiscreteProblem<double> dp(&wf, ref_space);
-    
-    NewtonSolver<double> newton(&dp);
-    //newton.set_verbose_output(false);
-    
     Solution<double> ref_sln;
     try
     {
-      newton.solve();
+      if (ITERATIVE_SOLVER)
+      {
+        // The initial guess is the solution of the coarse problem.
+        TwoLevelSolver solver(&wf, &space, ref_space);
+        if (!solver.solve())
+          throw Hermes::Exceptions::Exception("The iterative solver did not converge.");
+        Solution<double>::vector_to_solution(solver.get_sln_vector(), ref_space, &ref_sln);
+      }
+      else
+      {
+        // The problem is linear: one assembling and one solution instead of Newton's iteration.
+        DiscreteProblem<double> dp(&wf, ref_space);
+        LinearNewtonStep<double> solver(&dp);
+        solver.solve();
+        Solution<double>::vector_to_solution(solver.get_sln_vector(), ref_space, &ref_sln);
+      }
     }
     catch(Hermes::Exceptions::Exception e)
     {
       e.print_msg();
-      throw Hermes::Exceptions::Exception("Newton's iteration failed.");
+      throw Hermes::Exceptions::Exception("Linear solver failed.");
     };
-
-    // Translate the resulting coefficient vector into the instance of Solution.
-    Solution<double>::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
     
     cpu_time.tick();
     Hermes::Mixins::Loggable::Static::info("Solution: %g s", cpu_time.last());
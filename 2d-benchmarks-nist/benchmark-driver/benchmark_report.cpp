@@ -0,0 +1,283 @@
+#include "benchmark_report.h"
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+static const char* phase_names[BenchmarkReport::NUM_PHASES] =
+{
+  "reference", "assembly", "solve", "projection", "error_estimate", "exact_error", "adapt"
+};
+
+// JSON string literal.
+static std::string quote(const std::string& s)
+{
+  std::string result = "\"";
+  for (unsigned int i = 0; i < s.length(); i++)
+  {
+    if (s[i] == '"' || s[i] == '\\')
+      result += '\\';
+    result += s[i];
+  }
+  return result + "\"";
+}
+
+// JSON number, null for unknown (negative errors) and non-finite values.
+static std::string number(double value, bool nonnegative = false)
+{
+  if (value != value || (nonnegative && value < 0.0) || std::abs(value) > 1e300)
+    return "null";
+  char buffer[32];
+  sprintf(buffer, "%.10g", value);
+  return buffer;
+}
+
+BenchmarkReport::BenchmarkReport()
+{
+}
+
+const char* BenchmarkReport::get_phase_name(Phase phase)
+{
+  return phase_names[phase];
+}
+
+long BenchmarkReport::get_peak_rss()
+{
+#ifdef _WIN32
+  return -1;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  // Bytes on Mac OS X.
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+void BenchmarkReport::begin_run(const std::string& benchmark, const std::string& mesh, const std::string& candidates)
+{
+  Run run;
+  run.benchmark = benchmark;
+  run.mesh = mesh;
+  run.candidates = candidates;
+  run.failed = false;
+  runs.push_back(run);
+}
+
+void BenchmarkReport::fail_run(const std::string& message)
+{
+  if (runs.empty())
+    throw Hermes::Exceptions::Exception("BenchmarkReport::fail_run() outside of a run.");
+  runs.back().failed = true;
+  runs.back().message = message;
+}
+
+void BenchmarkReport::begin_step()
+{
+  memset(&current, 0, sizeof(Step));
+}
+
+void BenchmarkReport::add_time(Phase phase, double time)
+{
+  current.time[phase] += time;
+}
+
+void BenchmarkReport::end_step(int ndof_coarse, int ndof_ref, double err_est_rel, double err_exact_rel)
+{
+  if (runs.empty())
+    throw Hermes::Exceptions::Exception("BenchmarkReport::end_step() outside of a run.");
+  current.ndof_coarse = ndof_coarse;
+  current.ndof_ref = ndof_ref;
+  current.err_est_rel = err_est_rel;
+  current.err_exact_rel = err_exact_rel;
+  current.peak_rss = get_peak_rss();
+  runs.back().steps.push_back(current);
+}
+
+void BenchmarkReport::save_json(const char* filename) const
+{
+  FILE* f = fopen(filename, "w");
+  if (f == NULL)
+    throw Hermes::Exceptions::Exception("Could not open the file %s.", filename);
+
+  fprintf(f, "{\n  \"runs\": [");
+  for (unsigned int r = 0; r < runs.size(); r++)
+  {
+    const Run& run = runs[r];
+    fprintf(f, "%s\n    {\n", r > 0 ? "," : "");
+    fprintf(f, "      \"benchmark\": %s,\n", quote(run.benchmark).c_str());
+    fprintf(f, "      \"mesh\": %s,\n", quote(run.mesh).c_str());
+    fprintf(f, "      \"candidates\": %s,\n", quote(run.candidates).c_str());
+    fprintf(f, "      \"status\": %s,\n", run.failed ? "\"failed\"" : "\"ok\"");
+    if (run.failed)
+      fprintf(f, "      \"message\": %s,\n", quote(run.message).c_str());
+
+    double total[NUM_PHASES];
+    memset(total, 0, sizeof(total));
+    fprintf(f, "      \"steps\": [");
+    for (unsigned int s = 0; s < run.steps.size(); s++)
+    {
+      const Step& step = run.steps[s];
+      fprintf(f, "%s\n        { \"step\": %d, \"ndof_coarse\": %d, \"ndof_ref\": %d, \"err_est_rel\": %s, \"err_exact_rel\": %s, \"process_peak_rss_kb\": %s, \"time\": {",
+              s > 0 ? "," : "", s + 1, step.ndof_coarse, step.ndof_ref, number(step.err_est_rel).c_str(),
+              number(step.err_exact_rel, true).c_str(), number(step.peak_rss, true).c_str());
+      for (int p = 0; p < NUM_PHASES; p++)
+      {
+        fprintf(f, "%s \"%s\": %s", p > 0 ? "," : "", phase_names[p], number(step.time[p]).c_str());
+        total[p] += step.time[p];
+      }
+      fprintf(f, " } }");
+    }
+    fprintf(f, "\n      ],\n      \"total_time\": {");
+    for (int p = 0; p < NUM_PHASES; p++)
+      fprintf(f, "%s \"%s\": %s", p > 0 ? "," : "", phase_names[p], number(total[p]).c_str());
+    fprintf(f, " }\n    }");
+  }
+  fprintf(f, "\n  ]\n}\n");
+  fclose(f);
+}
+
+void BenchmarkReport::save_csv(const char* filename) const
+{
+  FILE* f = fopen(filename, "w");
+  if (f == NULL)
+    throw Hermes::Exceptions::Exception("Could not open the file %s.", filename);
+
+  fprintf(f, "benchmark,mesh,candidates,status,step,ndof_coarse,ndof_ref,err_est_rel,err_exact_rel,process_peak_rss_kb");
+  for (int p = 0; p < NUM_PHASES; p++)
+    fprintf(f, ",%s", phase_names[p]);
+  fprintf(f, "\n");
+
+  for (unsigned int r = 0; r < runs.size(); r++)
+  {
+    const Run& run = runs[r];
+    // Failed runs have one row without data.
+    if (run.failed)
+    {
+      fprintf(f, "%s,%s,%s,failed,0,0,0,,,", run.benchmark.c_str(), run.mesh.c_str(), run.candidates.c_str());
+      for (int p = 0; p < NUM_PHASES; p++)
+        fprintf(f, ",");
+      fprintf(f, "\n");
+      continue;
+    }
+    for (unsigned int s = 0; s < run.steps.size(); s++)
+    {
+      const Step& step = run.steps[s];
+      fprintf(f, "%s,%s,%s,ok,%d,%d,%d,%.10g,%.10g,%ld", run.benchmark.c_str(), run.mesh.c_str(), run.candidates.c_str(),
+              s + 1, step.ndof_coarse, step.ndof_ref, step.err_est_rel, step.err_exact_rel, step.peak_rss);
+      for (int p = 0; p < NUM_PHASES; p++)
+        fprintf(f, ",%.6f", step.time[p]);
+      fprintf(f, "\n");
+    }
+  }
+  fclose(f);
+}
+
+int BenchmarkReport::compare(const char* baseline_filename, double tolerance, double min_time) const
+{
+  // Totals of the runs of the baseline.
+  std::map<std::string, Summary> baseline;
+
+  FILE* f = fopen(baseline_filename, "r");
+  if (f == NULL)
+    throw Hermes::Exceptions::Exception("Could not open the baseline %s.", baseline_filename);
+  char line[2048];
+  bool header = true;
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if (header)
+    {
+      header = false;
+      continue;
+    }
+    std::vector<std::string> fields;
+    std::string field;
+    for (char* c = line; *c != '\0' && *c != '\n' && *c != '\r'; c++)
+    {
+      if (*c == ',')
+      {
+        fields.push_back(field);
+        field.clear();
+      }
+      else
+        field += *c;
+    }
+    fields.push_back(field);
+    if (fields.size() != 10 + NUM_PHASES)
+      continue;
+
+    std::string key = fields[0] + "/" + fields[1] + "/" + fields[2];
+    if (baseline.find(key) == baseline.end())
+    {
+      Summary summary;
+      memset(&summary, 0, sizeof(Summary));
+      baseline[key] = summary;
+    }
+    Summary& summary = baseline[key];
+    if (fields[3] != "ok")
+    {
+      summary.failed = true;
+      continue;
+    }
+    summary.steps++;
+    summary.ndof_coarse = atoi(fields[5].c_str());
+    for (int p = 0; p < NUM_PHASES; p++)
+      summary.time[p] += atof(fields[10 + p].c_str());
+  }
+  fclose(f);
+
+  int regressions = 0;
+  for (unsigned int r = 0; r < runs.size(); r++)
+  {
+    const Run& run = runs[r];
+    std::map<std::string, Summary>::const_iterator it = baseline.find(run.key());
+    if (it == baseline.end())
+    {
+      Hermes::Mixins::Loggable::Static::info("%s: not in the baseline.", run.key().c_str());
+      continue;
+    }
+    const Summary& base = it->second;
+    if (run.failed)
+    {
+      if (!base.failed)
+      {
+        Hermes::Mixins::Loggable::Static::warn("REGRESSION %s: failed (%s).", run.key().c_str(), run.message.c_str());
+        regressions++;
+      }
+      continue;
+    }
+    if (base.failed)
+      continue;
+
+    // The times are only comparable if the adaptivity took the same course.
+    int ndof_coarse = run.steps.empty() ? 0 : run.steps.back().ndof_coarse;
+    if ((int) run.steps.size() != base.steps || ndof_coarse != base.ndof_coarse)
+    {
+      Hermes::Mixins::Loggable::Static::warn("REGRESSION %s: %d steps to %d dofs, the baseline took %d steps to %d dofs.",
+                                            run.key().c_str(), (int) run.steps.size(), ndof_coarse, base.steps, base.ndof_coarse);
+      regressions++;
+      continue;
+    }
+
+    double total = 0.0, base_total = 0.0;
+    for (int p = 0; p < NUM_PHASES; p++)
+    {
+      double time = 0.0;
+      for (unsigned int s = 0; s < run.steps.size(); s++)
+        time += run.steps[s].time[p];
+      total += time;
+      base_total += base.time[p];
+      if (time > (1.0 + tolerance) * base.time[p] && time - base.time[p] > min_time)
+      {
+        Hermes::Mixins::Loggable::Static::warn("REGRESSION %s: %s %g s, baseline %g s.", run.key().c_str(),
+                                              phase_names[p], time, base.time[p]);
+        regressions++;
+      }
+    }
+    Hermes::Mixins::Loggable::Static::info("%s: total %g s, baseline %g s.", run.key().c_str(), total, base_total);
+  }
+  return regressions;
+}
@@ -0,0 +1,88 @@
+#ifndef BENCHMARK_REPORT_H
+#define BENCHMARK_REPORT_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Per-phase performance report of adaptive runs.
+///
+/// Every adaptivity step records the time spent in each phase, the peak resident set size of the process,
+/// the numbers of dofs and the errors. The report is written as JSON (nested by run) or CSV (one row per step),
+/// and can be compared to a baseline CSV written by an earlier version.
+class BenchmarkReport
+{
+public:
+  enum Phase
+  {
+    PHASE_REFERENCE,
+    PHASE_ASSEMBLY,
+    PHASE_SOLVE,
+    PHASE_PROJECTION,
+    PHASE_ERROR_ESTIMATE,
+    PHASE_EXACT_ERROR,
+    PHASE_ADAPT,
+    NUM_PHASES
+  };
+
+  BenchmarkReport();
+
+  /// Starts a run, the key of the comparison with the baseline.
+  void begin_run(const std::string& benchmark, const std::string& mesh, const std::string& candidates);
+  /// Marks the run as failed (e.g. an exception was thrown).
+  void fail_run(const std::string& message);
+
+  void begin_step();
+  /// Adds the time (in seconds) to the phase of the current step.
+  void add_time(Phase phase, double time);
+  /// Finishes the step; a negative exact error means that it is not known.
+  void end_step(int ndof_coarse, int ndof_ref, double err_est_rel, double err_exact_rel);
+
+  void save_json(const char* filename) const;
+  void save_csv(const char* filename) const;
+
+  /// Compares the total times of the phases with those of the baseline (CSV) and reports (through
+  /// Loggable::warn) the runs slower by more than the relative 'tolerance' (and 'min_time' seconds), and
+  /// those whose adaptivity took a different course. Returns the number of regressions.
+  int compare(const char* baseline_filename, double tolerance, double min_time) const;
+
+  static const char* get_phase_name(Phase phase);
+
+  /// Peak resident set size of the process in kB (-1 if not available). It is the high-water mark of
+  /// the whole process up to now, not of the current run, so a run after a larger one reports the larger peak.
+  static long get_peak_rss();
+
+private:
+  struct Step
+  {
+    int ndof_coarse, ndof_ref;
+    double err_est_rel, err_exact_rel;
+    // Process high-water mark at the end of the step (reported as process_peak_rss_kb).
+    long peak_rss;
+    double time[NUM_PHASES];
+  };
+
+  struct Run
+  {
+    std::string benchmark, mesh, candidates;
+    bool failed;
+    std::string message;
+    std::vector<Step> steps;
+
+    std::string key() const { return benchmark + "/" + mesh + "/" + candidates; }
+  };
+
+  /// Totals of a run of the baseline.
+  struct Summary
+  {
+    bool failed;
+    int steps, ndof_coarse;
+    double time[NUM_PHASES];
+  };
+
+  std::vector<Run> runs;
+  Step current;
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include "benchmarks.h"
+
+namespace nist01
+{
+#include "../01-analytic-solution/definitions.cpp"
+
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("01-analytic-solution", "../01-analytic-solution/square_quad.mesh", 1, 1, H2D_HP_ANISO_H, 0.5, 0.01, 60000, true, true),
+      f(10), lambda(1.0) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, 10);
+      wf = new WeakFormsH1::DefaultWeakFormPoisson<double>(HERMES_ANY, &lambda, &f);
+      set_residual(1.0, &f);
+      set_dirichlet("Bdy");
+    }
+
+    CustomRightHandSide f;
+    Hermes1DFunction<double> lambda;
+  };
+}
+
+namespace nist02
+{
+#include "../02-reentrant-corner/definitions.cpp"
+
+  // PARAM = 1, i.e. the angle 3 pi / 2.
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("02-reentrant-corner", "../02-reentrant-corner/geom1.mesh", 3, 1, H2D_HP_ANISO_H, 1.0, 0.1, 60000, true, true),
+      lambda(1.0) {};
+
+    void init(Mesh* mesh)
+    {
+      double omega = 3.0 * M_PI / 2.0;
+      exact_sln = new CustomExactSolution(mesh, M_PI / omega);
+      wf = new WeakFormsH1::DefaultWeakFormLaplace<double>(HERMES_ANY, &lambda);
+      set_residual(1.0, NULL);
+      set_dirichlet("Bdy");
+    }
+
+    Hermes1DFunction<double> lambda;
+  };
+}
+
+namespace nist04
+{
+#include "../04-exponential-peak/definitions.cpp"
+
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("04-exponential-peak", "../04-exponential-peak/square_quad.mesh", 1, 2, H2D_HP_ANISO_H, 0.5, 0.01, 60000, true, true),
+      f(1000, 0.5, 0.5), lambda(1.0) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, 1000, 0.5, 0.5);
+      wf = new WeakFormsH1::DefaultWeakFormPoisson<double>(HERMES_ANY, &lambda, &f);
+      set_residual(1.0, &f);
+      set_dirichlet("Bdy");
+    }
+
+    CustomRightHandSide f;
+    Hermes1DFunction<double> lambda;
+  };
+}
+
+namespace nist05
+{
+#include "../05-battery/definitions.cpp"
+
+  // No exact solution, natural boundary conditions.
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("05-battery", "../05-battery/battery.mesh", 2, 1, H2D_HP_ANISO, 0.3, 1.0, 60000, true, true) {};
+
+    void init(Mesh* mesh)
+    {
+      wf = new CustomWeakFormPoisson("e1", "e2", "e3", "e4", "e5", "Bdy_left", "Bdy_top", "Bdy_right", "Bdy_bottom", mesh);
+    }
+  };
+}
+
+namespace nist06
+{
+#include "../06-boundary-layer/definitions.cpp"
+
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("06-boundary-layer", "../06-boundary-layer/square_quad.mesh", 2, 1, H2D_HP_ANISO, 1.0, 1e-3, 100000, true, false),
+      f(1e-1) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, 1e-1);
+      wf = new CustomWeakForm(&f);
+      set_dirichlet("Bdy");
+    }
+
+    CustomRightHandSide f;
+  };
+}
+
+namespace nist07
+{
+#include "../07-boundary-line-singularity/definitions.cpp"
+
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("07-boundary-line-singularity", "../07-boundary-line-singularity/square_quad.mesh", 1, 2, H2D_HP_ANISO, 0.5, 1.5, 60000, true, true),
+      f(0.6), lambda(1.0) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, 0.6);
+      wf = new WeakFormsH1::DefaultWeakFormPoisson<double>(HERMES_ANY, &lambda, &f);
+      set_residual(1.0, &f);
+      set_dirichlet("Bdy");
+    }
+
+    CustomRightHandSide f;
+    Hermes1DFunction<double> lambda;
+  };
+}
+
+namespace nist08
+{
+#include "../08-oscillatory/definitions.cpp"
+
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("08-oscillatory", "../08-oscillatory/square_quad.mesh", 2, 1, H2D_HP_ANISO, 1.0, 0.5, 100000, true, false),
+      f(1 / (10 * M_PI)) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, 1 / (10 * M_PI));
+      wf = new CustomWeakForm(&f);
+      set_dirichlet("Bdy");
+    }
+
+    CustomRightHandSide f;
+  };
+}
+
+namespace nist09
+{
+#include "../09-wave-front/definitions.cpp"
+
+  // PARAM = 3, the well in the middle of the domain.
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("09-wave-front", "../09-wave-front/square_quad.mesh", 1, 2, H2D_HP_ANISO, 1.0, 0.5, 60000, true, true),
+      f(50, 0.5, 0.5, 0.25) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, 50, 0.5, 0.5, 0.25);
+      wf = new CustomWeakForm(&f);
+      set_residual(1.0, &f);
+      set_dirichlet("Bdy");
+    }
+
+    CustomRightHandSide f;
+  };
+}
+
+namespace nist10
+{
+#include "../10-interior-line-singularity/definitions.cpp"
+
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("10-interior-line-singularity", "../10-interior-line-singularity/square_quad.mesh", 2, 0, H2D_HP_ANISO, 1.0, 1e-3, 100000, true, true),
+      f(M_PI / 2, 2.01), lambda(1.0) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, M_PI / 2, 2.01);
+      wf = new WeakFormsH1::DefaultWeakFormPoisson<double>(HERMES_ANY, &lambda, &f);
+      set_residual(1.0, &f);
+      set_dirichlet("Bdy_dirichlet_rest");
+    }
+
+    CustomRightHandSide f;
+    Hermes1DFunction<double> lambda;
+  };
+}
+
+namespace nist11
+{
+#include "../11-kellogg/definitions.cpp"
+
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("11-kellogg", "../11-kellogg/square_quad.mesh", 2, 1, H2D_HP_ANISO, 1.0, 5.0, 100000, true, true) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, -14.92256510455152, 0.1, M_PI / 4.);
+      wf = new CustomWeakFormPoisson("Mat_0", 161.4476387975881, "Mat_1");
+      set_dirichlet("Bdy");
+    }
+  };
+}
+
+namespace nist12
+{
+#include "../12-multiple-difficulties/definitions.cpp"
+
+  class Benchmark : public NistBenchmark
+  {
+  public:
+    Benchmark() : NistBenchmark("12-multiple-difficulties", "../12-multiple-difficulties/lshape.mesh", 3, 1, H2D_HP_ANISO_H, 1.0, 1.0, 60000, true, true),
+      f(200.0, 1000.0, 0.0, -3.0 / 4.0, 3.0 / 4.0, 3.0 * M_PI / 2.0, 1.0 / 100.0, -Hermes::sqrt(5.0) / 4.0, -1.0 / 4.0),
+      lambda(1.0) {};
+
+    void init(Mesh* mesh)
+    {
+      exact_sln = new CustomExactSolution(mesh, 200.0, 1000.0, 0.0, -3.0 / 4.0, 3.0 / 4.0, 3.0 * M_PI / 2.0, 1.0 / 100.0,
+                                          -Hermes::sqrt(5.0) / 4.0, -1.0 / 4.0);
+      wf = new WeakFormsH1::DefaultWeakFormPoisson<double>(HERMES_ANY, &lambda, &f);
+      set_residual(1.0, &f);
+      set_dirichlet("Bdy");
+    }
+
+    CustomRightHandSide f;
+    Hermes1DFunction<double> lambda;
+  };
+}
+
+Hermes::vector<std::string> get_nist_benchmark_names()
+{
+  Hermes::vector<std::string> names;
+  for (int number = 1; number <= 12; number++)
+  {
+    char buffer[4];
+    sprintf(buffer, "%02d", number);
+    NistBenchmark* benchmark = create_nist_benchmark(buffer);
+    if (benchmark != NULL)
+      names.push_back(benchmark->name);
+    delete benchmark;
+  }
+  return names;
+}
+
+NistBenchmark* create_nist_benchmark(const std::string& name)
+{
+  // The number, possibly without the leading zero, or the full name.
+  int number = atoi(name.c_str());
+  if (name.find('-') != std::string::npos)
+    number = (name.length() > 3 && name[2] == '-') ? atoi(name.substr(0, 2).c_str()) : 0;
+
+  NistBenchmark* benchmark = NULL;
+  switch (number)
+  {
+  case 1: benchmark = new nist01::Benchmark(); break;
+  case 2: benchmark = new nist02::Benchmark(); break;
+  case 4: benchmark = new nist04::Benchmark(); break;
+  case 5: benchmark = new nist05::Benchmark(); break;
+  case 6: benchmark = new nist06::Benchmark(); break;
+  case 7: benchmark = new nist07::Benchmark(); break;
+  case 8: benchmark = new nist08::Benchmark(); break;
+  case 9: benchmark = new nist09::Benchmark(); break;
+  case 10: benchmark = new nist10::Benchmark(); break;
+  case 11: benchmark = new nist11::Benchmark(); break;
+  case 12: benchmark = new nist12::Benchmark(); break;
+  default: return NULL;
+  }
+  if (name.find('-') != std::string::npos && benchmark->name != name)
+  {
+    delete benchmark;
+    return NULL;
+  }
+  return benchmark;
+}
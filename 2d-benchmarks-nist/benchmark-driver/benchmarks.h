@@ -0,0 +1,74 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+using namespace Hermes::Hermes2D::RefinementSelectors;
+
+/// \brief Setup of one of the (scalar) NIST benchmarks, with the parameters of its standalone executable.
+///
+/// The classes of the benchmarks are compiled from their definitions.cpp, each in its own namespace.
+class NistBenchmark
+{
+public:
+  NistBenchmark(const char* name, const char* mesh_file, int p_init, int init_ref_num, CandList cand_list,
+                double conv_exp, double err_stop, int ndof_stop, bool linear, bool spd)
+    : name(name), mesh_file(mesh_file), p_init(p_init), init_ref_num(init_ref_num), cand_list(cand_list),
+      conv_exp(conv_exp), err_stop(err_stop), ndof_stop(ndof_stop), linear(linear), spd(spd), has_residual(false), diffusion(1.0), rhs(NULL),
+      exact_sln(NULL), wf(NULL), bcs(NULL), bc(NULL) {};
+  virtual ~NistBenchmark() { delete bcs; delete bc; delete wf; delete exact_sln; };
+
+  /// Creates the exact solution (if known), the weak form and the boundary conditions (if any) on the mesh.
+  virtual void init(Mesh* mesh) = 0;
+
+  std::string name;
+  /// Relative to the directory of the driver.
+  std::string mesh_file;
+  int p_init, init_ref_num;
+  CandList cand_list;
+  double conv_exp;
+  /// The stopping criterion is on the exact error if the exact solution is known, on the estimate otherwise.
+  double err_stop;
+  int ndof_stop;
+  /// The problem is linear (its Jacobian does not depend on the solution), see LinearNewtonStep.
+  bool linear;
+  /// The (linear) problem is symmetric and positive definite, as TwoLevelSolver requires.
+  bool spd;
+  /// The equation is -div(diffusion grad u) + rhs = 0 with a constant diffusion (rhs NULL for zero),
+  /// so that the residual error estimator applies (see set_residual()).
+  bool has_residual;
+  double diffusion;
+  const Hermes2DFunction<double>* rhs;
+
+  ExactSolutionScalar<double>* exact_sln;
+  WeakForm<double>* wf;
+  EssentialBCs<double>* bcs;
+
+protected:
+  /// Dirichlet conditions given by the exact solution on 'marker'.
+  void set_dirichlet(const std::string& marker)
+  {
+    bc = new DefaultEssentialBCNonConst<double>(marker, exact_sln);
+    bcs = new EssentialBCs<double>(bc);
+  }
+
+  void set_residual(double diffusion, const Hermes2DFunction<double>* rhs)
+  {
+    this->has_residual = true;
+    this->diffusion = diffusion;
+    this->rhs = rhs;
+  }
+
+private:
+  DefaultEssentialBCNonConst<double>* bc;
+};
+
+/// Names of the benchmarks.
+Hermes::vector<std::string> get_nist_benchmark_names();
+
+/// The benchmark with the given name or its number ("01", "1"); NULL if there is none.
+NistBenchmark* create_nist_benchmark(const std::string& name);
+
+#endif
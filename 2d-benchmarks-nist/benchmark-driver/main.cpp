@@ -0,0 +1,431 @@
+#define HERMES_REPORT_ALL
+#include "benchmarks.h"
+#include "benchmark_report.h"
+#include "../common/linear_newton_step.h"
+#include "../common/two_level_solver.h"
+#include "../common/parallel_adapt.h"
+#include "../../2d-advanced/common/kelly_estimators.h"
+
+//  Driver of the NIST benchmarks: runs the adaptivity of the benchmarks (headless, with the parameters
+//  of their standalone executables) and records the time spent in each phase of every adaptivity step.
+//
+//  Usage: nist-benchmarks [options] [benchmark ...]
+//
+//  The benchmarks are given by name (04-exponential-peak) or number (04, 4), all of them if none is given.
+//  Options:
+//    --mesh default|quad|tri ... the mesh of the benchmark, or the mesh converted to quadrilaterals / triangles,
+//    --candidates LIST ......... candidate list (H2D_P_ISO, ..., H2D_HP_ANISO) instead of that of the benchmark,
+//    --json FILE, --csv FILE ... where to save the report,
+//    --baseline FILE ........... CSV report of an earlier version to compare with,
+//    --tolerance T ............. relative slowdown of a phase reported as a regression (default 0.1),
+//    --min-time S .............. slowdowns shorter than S seconds are ignored (default 0.05),
+//    --newton .................. solve the linear benchmarks by Newton's method as well (for comparison),
+//    --iterative ............... solve the symmetric positive definite benchmarks by CG with the coarse problem
+//                                as a preconditioner (the other linear ones by one direct solution),
+//    --threads N ............... estimate the errors and select the refinements in parallel (ParallelAdapt), with
+//                                N selectors; 0 (default) uses Adapt. Both integrate the errors with the same
+//                                quadrature orders and pick the elements by the same strategy,
+//    --kelly ................... in every step, solve on the coarse space as well and log the reference-free estimate
+//                                of its error (jumps of the normal derivative and the element residual, see
+//                                2d-advanced/common/kelly_estimators.h), its effectivity index against the exact
+//                                error and its time against the reference-solution estimate. The adaptivity is
+//                                still driven by the reference solution.
+//
+//  The exit code is nonzero if a regression has been found.
+
+// Adaptivity parameters common to all benchmarks.
+const double THRESHOLD = 0.3;
+const int STRATEGY = 0;
+const int MESH_REGULARITY = -1;
+// Stopping criterion of Newton's method (as in NewtonSolver).
+const double NEWTON_TOL = 1e-8;
+const int NEWTON_MAX_ITER = 100;
+
+static const struct
+{
+  const char* name;
+  CandList cand_list;
+} cand_lists[] =
+{
+  { "H2D_P_ISO", H2D_P_ISO }, { "H2D_P_ANISO", H2D_P_ANISO }, { "H2D_H_ISO", H2D_H_ISO }, { "H2D_H_ANISO", H2D_H_ANISO },
+  { "H2D_HP_ISO", H2D_HP_ISO }, { "H2D_HP_ANISO_H", H2D_HP_ANISO_H }, { "H2D_HP_ANISO_P", H2D_HP_ANISO_P },
+  { "H2D_HP_ANISO", H2D_HP_ANISO }
+};
+static const int num_cand_lists = sizeof(cand_lists) / sizeof(cand_lists[0]);
+
+static const char* get_cand_list_name(CandList cand_list)
+{
+  for (int i = 0; i < num_cand_lists; i++)
+    if (cand_lists[i].cand_list == cand_list)
+      return cand_lists[i].name;
+  return "unknown";
+}
+
+// One assembling and one solution for the linear benchmarks.
+static void solve_linear(const WeakForm<double>* wf, const Space<double>* space, double* coeff_vec,
+                         BenchmarkReport& report, Hermes::Mixins::TimeMeasurable& timer)
+{
+  DiscreteProblem<double> dp(wf, space);
+  LinearNewtonStep<double> solver(&dp);
+
+  timer.tick();
+  solver.assemble();
+  timer.tick();
+  report.add_time(BenchmarkReport::PHASE_ASSEMBLY, timer.last());
+
+  solver.solve();
+  memcpy(coeff_vec, solver.get_sln_vector(), space->get_num_dofs() * sizeof(double));
+  timer.tick();
+  report.add_time(BenchmarkReport::PHASE_SOLVE, timer.last());
+}
+
+// CG preconditioned by the coarse problem for the symmetric positive definite benchmarks; the setup counts as assembling.
+static void solve_iterative(const WeakForm<double>* wf, const Space<double>* space, const Space<double>* ref_space,
+                            double* coeff_vec, BenchmarkReport& report, Hermes::Mixins::TimeMeasurable& timer)
+{
+  timer.tick();
+  TwoLevelSolver solver(wf, space, ref_space);
+  timer.tick();
+  report.add_time(BenchmarkReport::PHASE_ASSEMBLY, timer.last());
+
+  if (!solver.solve())
+    throw Hermes::Exceptions::Exception("The iterative solver did not converge.");
+  memcpy(coeff_vec, solver.get_sln_vector(), ref_space->get_num_dofs() * sizeof(double));
+  timer.tick();
+  report.add_time(BenchmarkReport::PHASE_SOLVE, timer.last());
+}
+
+// Newton's method as in NewtonSolver, with the assembling and the solution timed separately.
+static void solve_newton(const WeakForm<double>* wf, const Space<double>* space, double* coeff_vec,
+                         BenchmarkReport& report, Hermes::Mixins::TimeMeasurable& timer)
+{
+  int ndof = space->get_num_dofs();
+  DiscreteProblem<double> dp(wf, space);
+  SparseMatrix<double>* matrix = create_matrix<double>();
+  Vector<double>* rhs = create_vector<double>();
+  LinearMatrixSolver<double>* solver = create_linear_solver<double>(matrix, rhs);
+
+  for (int it = 1; ; it++)
+  {
+    // Residual.
+    timer.tick();
+    dp.assemble(coeff_vec, rhs);
+    timer.tick();
+    report.add_time(BenchmarkReport::PHASE_ASSEMBLY, timer.last());
+
+    double residual_norm = 0.0;
+    for (int i = 0; i < ndof; i++)
+      residual_norm += rhs->get(i) * rhs->get(i);
+    if (std::sqrt(residual_norm) < NEWTON_TOL)
+      break;
+    if (it > NEWTON_MAX_ITER)
+    {
+      delete solver; delete matrix; delete rhs;
+      throw Hermes::Exceptions::Exception("Newton's iteration did not converge.");
+    }
+
+    // Jacobian.
+    timer.tick();
+    dp.assemble(coeff_vec, matrix);
+    timer.tick();
+    report.add_time(BenchmarkReport::PHASE_ASSEMBLY, timer.last());
+
+    rhs->change_sign();
+    if (!solver->solve())
+    {
+      delete solver; delete matrix; delete rhs;
+      throw Hermes::Exceptions::Exception("Matrix solver failed.");
+    }
+    for (int i = 0; i < ndof; i++)
+      coeff_vec[i] += solver->get_sln_vector()[i];
+    timer.tick();
+    report.add_time(BenchmarkReport::PHASE_SOLVE, timer.last());
+  }
+
+  delete solver;
+  delete matrix;
+  delete rhs;
+}
+
+// Reference-free (Kelly type) estimate of the error of the solution on the coarse space, compared with the exact
+// error; 'ref_time' is the time of the estimate by the reference solution in the same step.
+static void compare_kelly(NistBenchmark* benchmark, Space<double>* space, int as, double ref_time)
+{
+  Hermes::Mixins::TimeMeasurable timer;
+  timer.tick();
+
+  DiscreteProblem<double> dp(benchmark->wf, space);
+  Solution<double> sln;
+  if (benchmark->linear)
+  {
+    LinearNewtonStep<double> solver(&dp);
+    solver.solve();
+    Solution<double>::vector_to_solution(solver.get_sln_vector(), space, &sln);
+  }
+  else
+  {
+    NewtonSolver<double> newton(&dp);
+    newton.set_verbose_output(false);
+    newton.solve();
+    Solution<double>::vector_to_solution(newton.get_sln_vector(), space, &sln);
+  }
+
+  KellyTypeAdapt<double>* adaptivity = create_kelly_adapt(Hermes::vector<Space<double>*>(space));
+  if (benchmark->has_residual)
+    adaptivity->add_error_estimator_vol(new H1ResidualEstimatorForm(0, benchmark->diffusion, benchmark->rhs));
+  double err_est = adaptivity->calc_err_est(&sln, HERMES_TOTAL_ERROR_ABS | HERMES_ELEMENT_ERROR_ABS);
+  delete adaptivity;
+  timer.tick();
+
+  const char* estimator = benchmark->has_residual ? "jumps and residual" : "jumps only";
+  if (benchmark->exact_sln == NULL)
+  {
+    Hermes::Mixins::Loggable::Static::info("%s, step %d: Kelly estimate (%s): %g, no exact solution; %g s (reference solution: %g s).",
+                                           benchmark->name.c_str(), as, estimator, err_est, timer.last(), ref_time);
+    return;
+  }
+  double err_exact = Global<double>::calc_abs_error(&sln, benchmark->exact_sln, HERMES_H1_NORM);
+  Hermes::Mixins::Loggable::Static::info("%s, step %d: Kelly estimate (%s): %g, exact error: %g, effectivity index: %g; %g s (reference solution: %g s).",
+                                         benchmark->name.c_str(), as, estimator, err_est, err_exact,
+                                         err_exact > 0.0 ? err_est / err_exact : 0.0, timer.last(), ref_time);
+}
+
+static void run(NistBenchmark* benchmark, const std::string& mesh_type, Hermes::vector<Selector<double>*> selectors,
+                bool newton, bool iterative, bool parallel_adapt, bool kelly, BenchmarkReport& report)
+{
+  // Load the mesh.
+  Mesh mesh;
+  MeshReaderH2D mloader;
+  mloader.load(benchmark->mesh_file.c_str(), &mesh);
+  if (mesh_type == "quad")
+    mesh.convert_triangles_to_quads();
+  else if (mesh_type == "tri")
+    mesh.convert_quads_to_triangles();
+  for (int i = 0; i < benchmark->init_ref_num; i++) mesh.refine_all_elements();
+
+  benchmark->init(&mesh);
+  if (iterative && !(benchmark->linear && benchmark->spd))
+    Hermes::Mixins::Loggable::Static::info("%s is not symmetric positive definite, solved directly instead of by CG.", benchmark->name.c_str());
+  H1Space<double> space(&mesh, benchmark->bcs, benchmark->p_init);
+
+  Solution<double> sln;
+  Hermes::Mixins::TimeMeasurable timer;
+  // Time of the estimate by the reference solution (reference space, solution, projection, estimate) in a step.
+  Hermes::Mixins::TimeMeasurable step_timer;
+
+  // Adaptivity loop:
+  int as = 1; bool done = false;
+  do
+  {
+    report.begin_step();
+    step_timer.tick();
+
+    // Construct globally refined reference mesh and setup reference space.
+    timer.tick();
+    Mesh::ReferenceMeshCreator refMeshCreator(&mesh);
+    Mesh* ref_mesh = refMeshCreator.create_ref_mesh();
+    Space<double>::ReferenceSpaceCreator refSpaceCreator(&space, ref_mesh);
+    Space<double>* ref_space = refSpaceCreator.create_ref_space();
+    int ndof_ref = ref_space->get_num_dofs();
+    timer.tick();
+    report.add_time(BenchmarkReport::PHASE_REFERENCE, timer.last());
+
+    // Solve on the reference mesh (Newton's method starts from zero as NewtonSolver does).
+    double* coeff_vec = new double[ndof_ref];
+    memset(coeff_vec, 0, ndof_ref * sizeof(double));
+    try
+    {
+      if (benchmark->linear && benchmark->spd && iterative)
+        solve_iterative(benchmark->wf, &space, ref_space, coeff_vec, report, timer);
+      else if (benchmark->linear && !newton)
+        solve_linear(benchmark->wf, ref_space, coeff_vec, report, timer);
+      else
+        solve_newton(benchmark->wf, ref_space, coeff_vec, report, timer);
+    }
+    catch (...)
+    {
+      delete [] coeff_vec;
+      delete ref_space;
+      delete ref_mesh;
+      throw;
+    }
+
+    // Project the fine mesh solution onto the coarse mesh.
+    timer.tick();
+    Solution<double> ref_sln;
+    Solution<double>::vector_to_solution(coeff_vec, ref_space, &ref_sln);
+    OGProjection<double> ogProjection; ogProjection.project_global(&space, &ref_sln, &sln);
+    timer.tick();
+    report.add_time(BenchmarkReport::PHASE_PROJECTION, timer.last());
+
+    // Calculate element errors and total error estimate.
+    Adapt<double> adaptivity(&space);
+    ParallelAdapt parallel_adaptivity(&space);
+    double err_est_rel = (parallel_adapt ? parallel_adaptivity.calc_err_est(&sln, &ref_sln)
+                                         : adaptivity.calc_err_est(&sln, &ref_sln)) * 100;
+    timer.tick();
+    report.add_time(BenchmarkReport::PHASE_ERROR_ESTIMATE, timer.last());
+    step_timer.tick();
+
+    // Calculate exact error (if the exact solution is known).
+    double err_exact_rel = -1.0;
+    if (benchmark->exact_sln != NULL)
+      err_exact_rel = Global<double>::calc_rel_error(&sln, benchmark->exact_sln, HERMES_H1_NORM) * 100;
+    timer.tick();
+    report.add_time(BenchmarkReport::PHASE_EXACT_ERROR, timer.last());
+
+    int ndof_coarse = space.get_num_dofs();
+    Hermes::Mixins::Loggable::Static::info("%s, step %d: ndof_coarse: %d, ndof_fine: %d, err_est_rel: %g%%, err_exact_rel: %g%%",
+                                           benchmark->name.c_str(), as, ndof_coarse, ndof_ref, err_est_rel, err_exact_rel);
+
+    // Not a phase of the adaptivity.
+    if (kelly)
+    {
+      compare_kelly(benchmark, &space, as, step_timer.last());
+      timer.tick();
+    }
+
+    // If the error is too large, adapt the mesh.
+    double err = benchmark->exact_sln != NULL ? err_exact_rel : err_est_rel;
+    if (err < benchmark->err_stop || ndof_coarse >= benchmark->ndof_stop)
+      done = true;
+    else if (parallel_adapt)
+      done = parallel_adaptivity.adapt(selectors, THRESHOLD, STRATEGY, MESH_REGULARITY);
+    else
+      done = adaptivity.adapt(selectors[0], THRESHOLD, STRATEGY, MESH_REGULARITY);
+    timer.tick();
+    report.add_time(BenchmarkReport::PHASE_ADAPT, timer.last());
+
+    report.end_step(ndof_coarse, ndof_ref, err_est_rel, err_exact_rel);
+
+    // Clean up.
+    delete [] coeff_vec;
+    delete ref_space;
+    delete ref_mesh;
+
+    // Increase the counter of adaptivity steps.
+    if (!done)
+      as++;
+  }
+  while (!done);
+}
+
+int main(int argc, char* argv[])
+{
+  std::string mesh_type = "default";
+  std::string cand_list_name;
+  const char* json_file = NULL;
+  const char* csv_file = NULL;
+  const char* baseline_file = NULL;
+  double tolerance = 0.1, min_time = 0.05;
+  int threads = 0;
+  bool newton = false, iterative = false, kelly = false;
+  Hermes::vector<std::string> names;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--newton")
+    {
+      newton = true;
+      continue;
+    }
+    if (arg == "--iterative")
+    {
+      iterative = true;
+      continue;
+    }
+    if (arg == "--kelly")
+    {
+      kelly = true;
+      continue;
+    }
+    bool has_value = i + 1 < argc;
+    if (arg.compare(0, 2, "--") == 0 && !has_value)
+      throw Hermes::Exceptions::Exception("Missing the value of %s.", arg.c_str());
+    if (arg == "--mesh")
+    {
+      mesh_type = argv[++i];
+      if (mesh_type != "default" && mesh_type != "quad" && mesh_type != "tri")
+        throw Hermes::Exceptions::Exception("Unknown mesh type %s.", mesh_type.c_str());
+    }
+    else if (arg == "--candidates")
+      cand_list_name = argv[++i];
+    else if (arg == "--json")
+      json_file = argv[++i];
+    else if (arg == "--csv")
+      csv_file = argv[++i];
+    else if (arg == "--baseline")
+      baseline_file = argv[++i];
+    else if (arg == "--tolerance")
+      tolerance = atof(argv[++i]);
+    else if (arg == "--min-time")
+      min_time = atof(argv[++i]);
+    else if (arg == "--threads")
+    {
+      threads = atoi(argv[++i]);
+      if (threads < 0)
+        throw Hermes::Exceptions::Exception("Invalid number of threads %d.", threads);
+    }
+    else if (arg.compare(0, 2, "--") == 0)
+      throw Hermes::Exceptions::Exception("Unknown option %s.", arg.c_str());
+    else
+      names.push_back(arg);
+  }
+  if (names.empty())
+    names = get_nist_benchmark_names();
+  if (newton && iterative)
+    throw Hermes::Exceptions::Exception("--newton and --iterative exclude each other.");
+
+  int cand_list_index = -1;
+  if (!cand_list_name.empty())
+  {
+    for (int i = 0; i < num_cand_lists; i++)
+      if (cand_list_name == cand_lists[i].name)
+        cand_list_index = i;
+    if (cand_list_index < 0)
+      throw Hermes::Exceptions::Exception("Unknown candidate list %s.", cand_list_name.c_str());
+  }
+
+  BenchmarkReport report;
+  for (unsigned int i = 0; i < names.size(); i++)
+  {
+    NistBenchmark* benchmark = create_nist_benchmark(names[i]);
+    if (benchmark == NULL)
+      throw Hermes::Exceptions::Exception("Unknown benchmark %s.", names[i].c_str());
+    CandList cand_list = cand_list_index < 0 ? benchmark->cand_list : cand_lists[cand_list_index].cand_list;
+
+    Hermes::Mixins::Loggable::Static::info("---- Benchmark %s (mesh %s, %s):", benchmark->name.c_str(),
+                                           mesh_type.c_str(), get_cand_list_name(cand_list));
+    report.begin_run(benchmark->name, mesh_type, get_cand_list_name(cand_list));
+    Hermes::vector<Selector<double>*> selectors;
+    for (int t = 0; t < std::max(threads, 1); t++)
+      selectors.push_back(new H1ProjBasedSelector<double>(cand_list, benchmark->conv_exp, H2DRS_DEFAULT_ORDER));
+    try
+    {
+      run(benchmark, mesh_type, selectors, newton, iterative, threads > 0, kelly, report);
+    }
+    catch (std::exception& e)
+    {
+      Hermes::Mixins::Loggable::Static::warn("%s failed: %s", benchmark->name.c_str(), e.what());
+      report.fail_run(e.what());
+    }
+    for (unsigned int t = 0; t < selectors.size(); t++)
+      delete selectors[t];
+    delete benchmark;
+  }
+
+  if (json_file != NULL)
+    report.save_json(json_file);
+  if (csv_file != NULL)
+    report.save_csv(csv_file);
+
+  int regressions = 0;
+  if (baseline_file != NULL)
+  {
+    regressions = report.compare(baseline_file, tolerance, min_time);
+    Hermes::Mixins::Loggable::Static::info("%d regression(s) against %s.", regressions, baseline_file);
+  }
+
+  return regressions > 0 ? 1 : 0;
+}
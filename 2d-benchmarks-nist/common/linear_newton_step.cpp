@@ -0,0 +1,53 @@
+#include "linear_newton_step.h"
+
+template<typename Scalar>
+LinearNewtonStep<Scalar>::LinearNewtonStep(DiscreteProblem<Scalar>* dp) : dp(dp), assembled(false)
+{
+  ndof = dp->get_num_dofs();
+  matrix = create_matrix<Scalar>();
+  rhs = create_vector<Scalar>();
+  matrix_solver = create_linear_solver<Scalar>(matrix, rhs);
+  sln_vector = new Scalar[ndof];
+  memset(sln_vector, 0, ndof * sizeof(Scalar));
+}
+
+template<typename Scalar>
+LinearNewtonStep<Scalar>::~LinearNewtonStep()
+{
+  delete matrix_solver;
+  delete matrix;
+  delete rhs;
+  delete [] sln_vector;
+}
+
+template<typename Scalar>
+void LinearNewtonStep<Scalar>::assemble()
+{
+  // The forms are evaluated at the zero coefficient vector (plus the Dirichlet lift).
+  memset(sln_vector, 0, ndof * sizeof(Scalar));
+  dp->assemble(sln_vector, matrix, rhs);
+  assembled = true;
+}
+
+template<typename Scalar>
+void LinearNewtonStep<Scalar>::solve()
+{
+  if (!assembled)
+    assemble();
+
+  // J u = -F(0).
+  rhs->change_sign();
+  if (!matrix_solver->solve())
+    throw Hermes::Exceptions::Exception("Matrix solver failed in LinearNewtonStep.");
+  memcpy(sln_vector, matrix_solver->get_sln_vector(), ndof * sizeof(Scalar));
+  assembled = false;
+}
+
+template<typename Scalar>
+Scalar* LinearNewtonStep<Scalar>::get_sln_vector()
+{
+  return sln_vector;
+}
+
+template class LinearNewtonStep<double>;
+template class LinearNewtonStep<std::complex<double> >;
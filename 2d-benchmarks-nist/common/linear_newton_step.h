@@ -0,0 +1,40 @@
+#ifndef LINEAR_NEWTON_STEP_H
+#define LINEAR_NEWTON_STEP_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Solver of linear problems whose weak form is written for Newton's method (Jacobian and residual).
+///
+/// The Jacobian of a linear problem does not depend on the solution, so one Newton step from the zero initial
+/// guess is exact: the matrix and the residual are assembled in one pass and the system is solved once, while
+/// NewtonSolver assembles the residual, the Jacobian, and the residual again to check the convergence.
+/// The problem has to be linear, this is not checked.
+template<typename Scalar>
+class LinearNewtonStep
+{
+public:
+  LinearNewtonStep(DiscreteProblem<Scalar>* dp);
+  ~LinearNewtonStep();
+
+  /// Assembles the matrix and the residual at zero.
+  void assemble();
+  /// Solves the system, assembling it first unless assemble() has been called.
+  void solve();
+
+  /// Coefficient vector of the solution.
+  Scalar* get_sln_vector();
+
+private:
+  DiscreteProblem<Scalar>* dp;
+  SparseMatrix<Scalar>* matrix;
+  Vector<Scalar>* rhs;
+  LinearMatrixSolver<Scalar>* matrix_solver;
+  Scalar* sln_vector;
+  int ndof;
+  bool assembled;
+};
+
+#endif
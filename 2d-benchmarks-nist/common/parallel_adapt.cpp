@@ -0,0 +1,308 @@
+#include "parallel_adapt.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+ParallelAdapt::ParallelAdapt(Space<double>* space)
+  : space(space), errors_squared_sum(0.0), have_errors(false), ref_sln(NULL)
+{
+  if (space->get_type() == HERMES_H1_SPACE)
+    h1_norm = true;
+  else if (space->get_type() == HERMES_L2_SPACE)
+    h1_norm = false;
+  else
+    throw Hermes::Exceptions::Exception("ParallelAdapt supports H1 and L2 spaces only.");
+}
+
+ParallelAdapt::~ParallelAdapt()
+{
+}
+
+void ParallelAdapt::add_element_error(Element* e, Element* ref_e, std::vector<int>& sons, Solution<double>* sln,
+                                      Solution<double>* ref_sln, double& error, double& norm) const
+{
+  if (!ref_e->active)
+  {
+    // Quadrilaterals split in two use the transformations 4 - 7.
+    bool iso = ref_e->sons[0] != NULL && ref_e->sons[2] != NULL;
+    for (int k = 0; k < 4; k++)
+    {
+      if (ref_e->sons[k] == NULL)
+        continue;
+      sons.push_back(ref_e->is_triangle() || iso ? k : k + 4);
+      add_element_error(e, ref_e->sons[k], sons, sln, ref_sln, error, norm);
+      sons.pop_back();
+    }
+    return;
+  }
+
+  // The coarse solution on the part of 'e' covered by 'ref_e'.
+  sln->set_active_element(e);
+  for (unsigned int i = 0; i < sons.size(); i++)
+    sln->push_transform(sons[i]);
+  ref_sln->set_active_element(ref_e);
+
+  // The order of Adapt<double>::calc_err_est(): that of the error form with both functions of the order
+  // of the reference solution, on the reference element.
+  RefMap* rm = ref_sln->get_refmap();
+  ElementMode2D mode = ref_e->get_mode();
+  int o = std::min(2 * ref_sln->get_fn_order() + rm->get_inv_ref_order(), (int) limited_orders[mode].size() - 1);
+  o = limited_orders[mode][o];
+  int mask = h1_norm ? H2D_FN_VAL | H2D_FN_DX | H2D_FN_DY : H2D_FN_VAL;
+  sln->set_quad_order(o, mask);
+  ref_sln->set_quad_order(o, mask);
+
+  Quad2D* quad = &g_quad_2d_std;
+  double3* pt = quad->get_points(o, mode);
+  int np = quad->get_num_points(o, mode);
+  double* jac = rm->is_jacobian_const() ? NULL : rm->get_jacobian(o);
+  double const_jac = rm->is_jacobian_const() ? rm->get_const_jacobian() : 0.0;
+
+  double* u = sln->get_fn_values();
+  double* ru = ref_sln->get_fn_values();
+  double *dudx = NULL, *dudy = NULL, *rdudx = NULL, *rdudy = NULL;
+  if (h1_norm)
+  {
+    sln->get_dx_dy_values(dudx, dudy);
+    ref_sln->get_dx_dy_values(rdudx, rdudy);
+  }
+
+  for (int i = 0; i < np; i++)
+  {
+    double w = pt[i][2] * (jac == NULL ? const_jac : jac[i]);
+    double err = sqr(ru[i] - u[i]);
+    double nrm = sqr(ru[i]);
+    if (h1_norm)
+    {
+      err += sqr(rdudx[i] - dudx[i]) + sqr(rdudy[i] - dudy[i]);
+      nrm += sqr(rdudx[i]) + sqr(rdudy[i]);
+    }
+    error += w * err;
+    norm += w * nrm;
+  }
+}
+
+double ParallelAdapt::calc_err_est(Solution<double>* sln, Solution<double>* ref_sln)
+{
+  const Mesh* mesh = space->get_mesh();
+  const Mesh* ref_mesh = ref_sln->get_mesh();
+  this->ref_sln = ref_sln;
+
+  std::vector<Element*> elements;
+  Element* e;
+  for_all_active_elements(e, mesh)
+    elements.push_back(e);
+  int num_elements = elements.size();
+
+  // limit_order() reads global tables set by update_limit_table(), so it is evaluated here for all the orders
+  // and both element types and the threads only look the results up.
+  for (int mode = 0; mode < 2; mode++)
+  {
+    // Up to the largest order of the quadrature, limit_order() gives that for all the larger ones.
+    limited_orders[mode].resize(g_quad_2d_std.get_max_order((ElementMode2D) mode) + 1);
+    update_limit_table((ElementMode2D) mode);
+    for (int o = 0; o < (int) limited_orders[mode].size(); o++)
+    {
+      int limited = o;
+      limit_order(limited, (ElementMode2D) mode);
+      limited_orders[mode][o] = limited;
+    }
+  }
+
+  errors.assign(mesh->get_max_element_id() + 1, 0.0);
+  std::vector<double> norms(num_elements, 0.0);
+  std::vector<double> element_errors(num_elements, 0.0);
+
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  // Every thread evaluates its own copies of the solutions (they cache the values on the active element).
+  std::vector<Solution<double>*> slns(num_threads), ref_slns(num_threads);
+  for (int t = 0; t < num_threads; t++)
+  {
+    slns[t] = static_cast<Solution<double>*>(sln->clone());
+    ref_slns[t] = static_cast<Solution<double>*>(ref_sln->clone());
+    slns[t]->set_quad_2d(&g_quad_2d_std);
+    ref_slns[t]->set_quad_2d(&g_quad_2d_std);
+  }
+
+#pragma omp parallel num_threads(num_threads)
+  {
+    int t = 0;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+    std::vector<int> sons;
+
+#pragma omp for schedule(dynamic)
+    for (int i = 0; i < num_elements; i++)
+    {
+      // The reference mesh is a copy of the coarse one refined, the elements keep their ids.
+      Element* ref_e = ref_mesh->get_element(elements[i]->id);
+      add_element_error(elements[i], ref_e, sons, slns[t], ref_slns[t], element_errors[i], norms[i]);
+    }
+  }
+
+  for (int t = 0; t < num_threads; t++)
+  {
+    delete slns[t];
+    delete ref_slns[t];
+  }
+
+  // Summed in the order of the elements, so that the result does not depend on the number of threads.
+  double error_sum = 0.0, norm_sum = 0.0;
+  for (int i = 0; i < num_elements; i++)
+  {
+    error_sum += element_errors[i];
+    norm_sum += norms[i];
+  }
+  if (norm_sum == 0.0)
+    throw Hermes::Exceptions::Exception("The reference solution is zero in ParallelAdapt::calc_err_est().");
+
+  errors_squared_sum = 0.0;
+  for (int i = 0; i < num_elements; i++)
+  {
+    errors[elements[i]->id] = element_errors[i] / norm_sum;
+    errors_squared_sum += errors[elements[i]->id];
+  }
+  have_errors = true;
+
+  return std::sqrt(error_sum / norm_sum);
+}
+
+// Larger errors first, the ids break the ties.
+struct CompareElementErrors
+{
+  CompareElementErrors(const std::vector<double>& errors) : errors(errors) {}
+  bool operator()(int a, int b) const
+  {
+    return errors[a] > errors[b] || (errors[a] == errors[b] && a < b);
+  }
+  const std::vector<double>& errors;
+};
+
+bool ParallelAdapt::adapt(Hermes::vector<Selector<double>*> selectors, double thr, int strategy, int regularize)
+{
+  if (!have_errors)
+    throw Hermes::Exceptions::Exception("ParallelAdapt::calc_err_est() has to be called before adapt().");
+  if (regularize != -1)
+    throw Hermes::Exceptions::Exception("ParallelAdapt does not support mesh regularization.");
+  if (selectors.empty())
+    throw Hermes::Exceptions::Exception("ParallelAdapt::adapt() needs at least one selector.");
+  have_errors = false;
+
+  Mesh* mesh = space->get_mesh();
+  std::vector<int> ids;
+  bool triangles = false, quads = false;
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    ids.push_back(e->id);
+    if (e->is_triangle())
+      triangles = true;
+    else
+      quads = true;
+  }
+  std::sort(ids.begin(), ids.end(), CompareElementErrors(errors));
+
+  // The elements to refine, by the strategy of Adapt.
+  double max_error = ids.empty() ? 0.0 : errors[ids[0]];
+  double err0 = 1000.0, processed_error = 0.0;
+  int num_selected = 0;
+  for (; num_selected < (int) ids.size(); num_selected++)
+  {
+    double err = errors[ids[num_selected]];
+    if (strategy == 0 && processed_error > std::sqrt(thr) * errors_squared_sum && std::fabs((err - err0) / err0) > 1e-3)
+      break;
+    if (strategy == 1 && err < thr * max_error)
+      break;
+    if (strategy == 2 && err < thr)
+      break;
+    err0 = err;
+    processed_error += err;
+  }
+
+  // The selectors call update_limit_table() on their elements, which sets global tables for the element type.
+  // The threads thus write these tables concurrently whatever the types are; on a mesh of one type they are set
+  // here already, so that the threads only write the values they hold, and a mesh of both types (where
+  // the threads would overwrite each other's tables) is processed by one thread.
+  int num_threads = (triangles && quads) ? 1 : selectors.size();
+  if (!ids.empty())
+    update_limit_table(mesh->get_element(ids[0])->get_mode());
+  std::vector<Solution<double>*> ref_slns(num_threads);
+  for (int t = 0; t < num_threads; t++)
+    ref_slns[t] = static_cast<Solution<double>*>(ref_sln->clone());
+
+  std::vector<ElementToRefine> refinements(num_selected);
+  std::vector<char> refined(num_selected, 0);
+  // Reduced over the threads, no thread reads it during the selection.
+  bool failed = false;
+
+#pragma omp parallel num_threads(num_threads)
+  {
+    int t = 0;
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+
+#pragma omp for schedule(dynamic) reduction(||:failed)
+    for (int i = 0; i < num_selected; i++)
+    {
+      int id = ids[i];
+      try
+      {
+        refinements[i] = ElementToRefine(id, 0);
+        refined[i] = selectors[t]->select_refinement(mesh->get_element(id), space->get_element_order(id),
+                                                     ref_slns[t], refinements[i]);
+      }
+      catch (Hermes::Exceptions::Exception&)
+      {
+        failed = true;
+      }
+    }
+  }
+
+  for (int t = 0; t < num_threads; t++)
+    delete ref_slns[t];
+  if (failed)
+    throw Hermes::Exceptions::Exception("Selection of a refinement failed in ParallelAdapt::adapt().");
+
+  // Applied in the order of the errors, as by Adapt.
+  bool done = true;
+  for (int i = 0; i < num_selected; i++)
+  {
+    if (!refined[i])
+      continue;
+    apply_refinement(refinements[i]);
+    done = false;
+  }
+  if (!done)
+    space->assign_dofs();
+
+  return done;
+}
+
+void ParallelAdapt::apply_refinement(const ElementToRefine& refinement)
+{
+  Mesh* mesh = space->get_mesh();
+  Element* e = mesh->get_element(refinement.id);
+
+  if (refinement.split == H2D_REFINEMENT_P)
+    space->set_element_order(refinement.id, refinement.p[0]);
+  else if (refinement.split == H2D_REFINEMENT_H)
+  {
+    if (e->active)
+      mesh->refine_element_id(refinement.id);
+    for (int j = 0; j < 4; j++)
+      space->set_element_order(e->sons[j]->id, refinement.p[j]);
+  }
+  else
+  {
+    if (e->active)
+      mesh->refine_element_id(refinement.id, refinement.split);
+    // Horizontal splitting creates the sons 0, 1, vertical the sons 2, 3.
+    for (int j = 0; j < 2; j++)
+      space->set_element_order(e->sons[refinement.split == H2D_REFINEMENT_ANISO_H ? j : j + 2]->id, refinement.p[j]);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef PARALLEL_ADAPT_H
+#define PARALLEL_ADAPT_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+using namespace Hermes::Hermes2D::RefinementSelectors;
+
+/// \brief Adaptivity of one space with the element errors and the hp candidate selection computed in parallel.
+///
+/// Replaces Adapt<double> for one H1 or L2 space. calc_err_est() evaluates ||ref_sln - sln||^2 (in the H1 or L2
+/// norm, by the type of the space) on the elements in parallel, every thread on its own copies of the solutions,
+/// with the quadrature orders of Adapt<double>; the errors are stored per element and summed in a fixed order. adapt() picks the elements to refine as Adapt
+/// does (by decreasing error and the strategy), runs the selectors on them in parallel, one selector per thread
+/// (each keeps its own cache of the candidate projection matrices per element type and order), and applies the
+/// refinements serially in the order of the errors. The refinements thus do not depend on the number of threads.
+/// Mesh regularization is not supported.
+class ParallelAdapt
+{
+public:
+  ParallelAdapt(Space<double>* space);
+  ~ParallelAdapt();
+
+  /// Computes the element errors, returns the relative error estimate ||ref_sln - sln|| / ||ref_sln||.
+  double calc_err_est(Solution<double>* sln, Solution<double>* ref_sln);
+
+  /// Refines the elements with the largest errors:
+  ///   strategy 0 ... until sqrt(thr) times the total error is processed (elements of similar errors together),
+  ///   strategy 1 ... those with errors larger than thr times the largest one,
+  ///   strategy 2 ... those with relative errors larger than thr.
+  /// 'selectors' are independent instances (e.g. H1ProjBasedSelector with the same parameters), one for every
+  /// thread. Returns true if no element was refined.
+  bool adapt(Hermes::vector<Selector<double>*> selectors, double thr, int strategy = 0, int regularize = -1);
+
+  /// Relative squared error of the element.
+  double get_element_error_squared(int id) const { return errors[id]; }
+
+private:
+  // Adds the squared error and norm on the element of the reference mesh 'ref_e' lying in the element 'e'
+  // of the coarse mesh, reached from 'e' by the transformations 'sons'.
+  void add_element_error(Element* e, Element* ref_e, std::vector<int>& sons, Solution<double>* sln,
+                         Solution<double>* ref_sln, double& error, double& norm) const;
+  void apply_refinement(const ElementToRefine& refinement);
+
+  Space<double>* space;
+  bool h1_norm;
+  // limit_order() of the quadrature orders for triangles and quadrilaterals.
+  std::vector<int> limited_orders[2];
+  std::vector<double> errors;
+  double errors_squared_sum;
+  bool have_errors;
+  Solution<double>* ref_sln;
+};
+
+#endif
@@ -0,0 +1,466 @@
+#include "two_level_solver.h"
+
+// In-place Cholesky factorization of the dense symmetric matrix 'a' (n x n, row-major) into its lower factor.
+static bool cholesky(double* a, int n)
+{
+  for (int j = 0; j < n; j++)
+  {
+    double d = a[j * n + j];
+    for (int k = 0; k < j; k++)
+      d -= a[j * n + k] * a[j * n + k];
+    if (d <= 0.0)
+      return false;
+    a[j * n + j] = std::sqrt(d);
+    for (int i = j + 1; i < n; i++)
+    {
+      double s = a[i * n + j];
+      for (int k = 0; k < j; k++)
+        s -= a[i * n + k] * a[j * n + k];
+      a[i * n + j] = s / a[j * n + j];
+    }
+  }
+  return true;
+}
+
+// Solves L L^T x = b in place, 'l' from cholesky().
+static void cholesky_solve(const double* l, int n, double* x)
+{
+  for (int i = 0; i < n; i++)
+  {
+    for (int k = 0; k < i; k++)
+      x[i] -= l[i * n + k] * x[k];
+    x[i] /= l[i * n + i];
+  }
+  for (int i = n - 1; i >= 0; i--)
+  {
+    for (int k = i + 1; k < n; k++)
+      x[i] -= l[k * n + i] * x[k];
+    x[i] /= l[i * n + i];
+  }
+}
+
+TwoLevelSolver::TwoLevelSolver(const WeakForm<double>* wf, const Space<double>* coarse_space, const Space<double>* ref_space)
+  : coarse_space(coarse_space), ref_space(ref_space), tol(1e-10), max_iters(1000), smoothing_steps(1),
+    coarse_factorized(false), num_iters(0), residual(0.0)
+{
+  ndof = ref_space->get_num_dofs();
+  coarse_ndof = coarse_space->get_num_dofs();
+
+  SparseMatrix<double>* sparse = create_matrix<double>();
+  matrix = dynamic_cast<CSCMatrix<double>*>(sparse);
+  if (matrix == NULL)
+  {
+    delete sparse;
+    throw Hermes::Exceptions::Exception("TwoLevelSolver needs CSC matrices (e.g. SOLVER_UMFPACK).");
+  }
+
+  // The reference matrix and the right-hand side -F(0).
+  rhs = create_vector<double>();
+  std::vector<double> zero(ndof, 0.0);
+  DiscreteProblem<double> dp(wf, ref_space);
+  dp.assemble(&zero[0], matrix, rhs);
+  rhs->change_sign();
+
+  // The coarse matrix, factorized at its first use.
+  coarse_matrix = create_matrix<double>();
+  coarse_rhs = create_vector<double>();
+  std::vector<double> coarse_zero(coarse_ndof, 0.0);
+  DiscreteProblem<double> coarse_dp(wf, coarse_space);
+  coarse_dp.assemble(&coarse_zero[0], coarse_matrix, coarse_rhs);
+  coarse_solver = create_linear_solver<double>(coarse_matrix, coarse_rhs);
+
+  init_prolongation();
+  init_blocks();
+}
+
+TwoLevelSolver::~TwoLevelSolver()
+{
+  delete coarse_solver;
+  delete coarse_matrix;
+  delete coarse_rhs;
+  delete matrix;
+  delete rhs;
+}
+
+void TwoLevelSolver::init_prolongation()
+{
+  std::vector<std::map<int, double> > rows(ndof);
+
+  // The reference mesh is a copy of the coarse one with the active elements refined, the ids are kept.
+  Mesh* coarse_mesh = coarse_space->get_mesh();
+  Mesh* ref_mesh = ref_space->get_mesh();
+  Element* e;
+  for_all_active_elements(e, coarse_mesh)
+  {
+    Element* fine_e = e->id < ref_mesh->get_max_element_id() ? ref_mesh->get_element(e->id) : NULL;
+    if (fine_e == NULL || !fine_e->used)
+      throw Hermes::Exceptions::Exception("TwoLevelSolver: the reference mesh is not a refinement of the coarse mesh.");
+    double m[2] = { 1.0, 1.0 }, t[2] = { 0.0, 0.0 };
+    add_prolongation(e, fine_e, m, t, rows);
+  }
+
+  p_row_ptr.resize(ndof + 1);
+  p_row_ptr[0] = 0;
+  for (int i = 0; i < ndof; i++)
+    p_row_ptr[i + 1] = p_row_ptr[i] + rows[i].size();
+  p_col.resize(p_row_ptr[ndof]);
+  p_val.resize(p_row_ptr[ndof]);
+  for (int i = 0; i < ndof; i++)
+  {
+    int k = p_row_ptr[i];
+    for (std::map<int, double>::const_iterator it = rows[i].begin(); it != rows[i].end(); ++it, k++)
+    {
+      p_col[k] = it->first;
+      p_val[k] = it->second;
+    }
+  }
+}
+
+void TwoLevelSolver::add_prolongation(Element* coarse_e, Element* fine_e, double m[2], double t[2],
+                                      std::vector<std::map<int, double> >& rows)
+{
+  if (!fine_e->active)
+  {
+    // Quadrilaterals split in two use the transformations 4 - 7.
+    bool iso = fine_e->sons[0] != NULL && fine_e->sons[2] != NULL;
+    for (int k = 0; k < 4; k++)
+    {
+      if (fine_e->sons[k] == NULL)
+        continue;
+      Trf* trf = fine_e->is_triangle() ? &tri_trf[k] : &quad_trf[iso ? k : k + 4];
+      double son_m[2] = { m[0] * trf->m[0], m[1] * trf->m[1] };
+      double son_t[2] = { m[0] * trf->t[0] + t[0], m[1] * trf->t[1] + t[1] };
+      add_prolongation(coarse_e, fine_e->sons[k], son_m, son_t, rows);
+    }
+    return;
+  }
+
+  AsmList<double> coarse_al, fine_al;
+  coarse_space->get_element_assembly_list(coarse_e, &coarse_al);
+  ref_space->get_element_assembly_list(fine_e, &fine_al);
+  Shapeset* coarse_shapeset = coarse_space->get_shapeset();
+  Shapeset* fine_shapeset = ref_space->get_shapeset();
+  ElementMode2D mode = fine_e->get_mode();
+
+  // The shape functions of the element (an index may occur more times in the assembly list with constraints).
+  std::vector<int> shapes, occurrences;
+  for (unsigned int i = 0; i < fine_al.get_cnt(); i++)
+  {
+    int idx = fine_al.get_idx()[i];
+    unsigned int a = std::find(shapes.begin(), shapes.end(), idx) - shapes.begin();
+    if (a == shapes.size())
+    {
+      shapes.push_back(idx);
+      occurrences.push_back(0);
+    }
+    occurrences[a]++;
+  }
+  int num_shapes = shapes.size();
+
+  // The coarse functions are polynomials of the orders of the element at most, the projection onto the shape
+  // functions (in the reference coordinates) is exact.
+  int o = ref_space->get_element_order(fine_e->id);
+  o = 2 * std::max(H2D_GET_H_ORDER(o), H2D_GET_V_ORDER(o));
+  Quad2D* quad = &g_quad_2d_std;
+  update_limit_table(mode);
+  limit_order(o, mode);
+  double3* pt = quad->get_points(o, mode);
+  int np = quad->get_num_points(o, mode);
+
+  std::vector<double> phi(num_shapes * np);
+  for (int a = 0; a < num_shapes; a++)
+    for (int q = 0; q < np; q++)
+      phi[a * np + q] = fine_shapeset->get_fn_value(shapes[a], pt[q][0], pt[q][1], 0, mode);
+
+  std::vector<double> gram(num_shapes * num_shapes);
+  for (int a = 0; a < num_shapes; a++)
+    for (int b = 0; b <= a; b++)
+    {
+      double s = 0.0;
+      for (int q = 0; q < np; q++)
+        s += pt[q][2] * phi[a * np + q] * phi[b * np + q];
+      gram[a * num_shapes + b] = gram[b * num_shapes + a] = s;
+    }
+  if (!cholesky(&gram[0], num_shapes))
+    throw Hermes::Exceptions::Exception("TwoLevelSolver: singular Gram matrix of the shape functions.");
+
+  // The coarse basis functions on the element, at the points mapped to the coarse element.
+  std::vector<int> coarse_dofs;
+  std::vector<double> values, coeffs(num_shapes);
+  for (unsigned int i = 0; i < coarse_al.get_cnt(); i++)
+  {
+    int dof = coarse_al.get_dof()[i];
+    if (dof < 0 || std::find(coarse_dofs.begin(), coarse_dofs.end(), dof) != coarse_dofs.end())
+      continue;
+    coarse_dofs.push_back(dof);
+
+    values.assign(np, 0.0);
+    for (unsigned int j = i; j < coarse_al.get_cnt(); j++)
+    {
+      if (coarse_al.get_dof()[j] != dof)
+        continue;
+      for (int q = 0; q < np; q++)
+        values[q] += coarse_al.get_coef()[j] * coarse_shapeset->get_fn_value(coarse_al.get_idx()[j],
+                       m[0] * pt[q][0] + t[0], m[1] * pt[q][1] + t[1], 0, mode);
+    }
+
+    for (int a = 0; a < num_shapes; a++)
+    {
+      double s = 0.0;
+      for (int q = 0; q < np; q++)
+        s += pt[q][2] * phi[a * np + q] * values[q];
+      coeffs[a] = s;
+    }
+    cholesky_solve(&gram[0], num_shapes, &coeffs[0]);
+
+    // The coefficient of a shape function belonging to one reference basis function only is the coefficient
+    // of that basis function; the others are determined on the elements where their functions are not constrained.
+    for (unsigned int j = 0; j < fine_al.get_cnt(); j++)
+    {
+      int fine_dof = fine_al.get_dof()[j];
+      int a = std::find(shapes.begin(), shapes.end(), fine_al.get_idx()[j]) - shapes.begin();
+      if (fine_dof < 0 || occurrences[a] != 1)
+        continue;
+      double value = coeffs[a] / fine_al.get_coef()[j];
+      if (std::abs(value) > 1e-12)
+        rows[fine_dof][dof] = value;
+    }
+  }
+}
+
+void TwoLevelSolver::init_blocks()
+{
+  // The elements every dof is supported on.
+  std::vector<std::vector<int> > supports(ndof);
+  AsmList<double> al;
+  Element* e;
+  for_all_active_elements(e, ref_space->get_mesh())
+  {
+    ref_space->get_element_assembly_list(e, &al);
+    for (unsigned int i = 0; i < al.get_cnt(); i++)
+    {
+      int dof = al.get_dof()[i];
+      if (dof >= 0 && (supports[dof].empty() || supports[dof].back() != e->id))
+        supports[dof].push_back(e->id);
+    }
+  }
+
+  std::map<std::vector<int>, int> support_blocks;
+  dof_block.resize(ndof);
+  std::vector<int> block_sizes;
+  for (int i = 0; i < ndof; i++)
+  {
+    std::sort(supports[i].begin(), supports[i].end());
+    supports[i].erase(std::unique(supports[i].begin(), supports[i].end()), supports[i].end());
+    std::map<std::vector<int>, int>::iterator it = support_blocks.find(supports[i]);
+    if (it == support_blocks.end())
+    {
+      it = support_blocks.insert(std::make_pair(supports[i], (int) block_sizes.size())).first;
+      block_sizes.push_back(0);
+    }
+    dof_block[i] = it->second;
+    block_sizes[it->second]++;
+    std::vector<int>().swap(supports[i]);
+  }
+
+  int num_blocks = block_sizes.size();
+  block_ptr.resize(num_blocks + 1);
+  factor_ptr.resize(num_blocks + 1);
+  block_ptr[0] = factor_ptr[0] = 0;
+  for (int b = 0; b < num_blocks; b++)
+  {
+    block_ptr[b + 1] = block_ptr[b] + block_sizes[b];
+    factor_ptr[b + 1] = factor_ptr[b] + block_sizes[b] * block_sizes[b];
+  }
+  block_dofs.resize(ndof);
+  dof_position.resize(ndof);
+  std::vector<int> fill(num_blocks, 0);
+  for (int i = 0; i < ndof; i++)
+  {
+    int b = dof_block[i];
+    dof_position[i] = fill[b]++;
+    block_dofs[block_ptr[b] + dof_position[i]] = i;
+  }
+
+  // The diagonal blocks from the columns of the matrix.
+  int* Ap = matrix->get_Ap();
+  int* Ai = matrix->get_Ai();
+  double* Ax = matrix->get_Ax();
+  factors.assign(factor_ptr[num_blocks], 0.0);
+  for (int c = 0; c < ndof; c++)
+  {
+    int b = dof_block[c];
+    int n = block_sizes[b];
+    for (int k = Ap[c]; k < Ap[c + 1]; k++)
+      if (dof_block[Ai[k]] == b)
+        factors[factor_ptr[b] + dof_position[Ai[k]] * n + dof_position[c]] += Ax[k];
+  }
+  for (int b = 0; b < num_blocks; b++)
+    if (!cholesky(&factors[factor_ptr[b]], block_sizes[b]))
+      throw Hermes::Exceptions::Exception("TwoLevelSolver: the matrix is not positive definite.");
+}
+
+void TwoLevelSolver::multiply(const double* x, double* y) const
+{
+  int* Ap = matrix->get_Ap();
+  int* Ai = matrix->get_Ai();
+  double* Ax = matrix->get_Ax();
+  memset(y, 0, ndof * sizeof(double));
+  for (int c = 0; c < ndof; c++)
+    for (int k = Ap[c]; k < Ap[c + 1]; k++)
+      y[Ai[k]] += Ax[k] * x[c];
+}
+
+void TwoLevelSolver::smooth(const double* b, double* x, bool forward) const
+{
+  int* Ap = matrix->get_Ap();
+  int* Ai = matrix->get_Ai();
+  double* Ax = matrix->get_Ax();
+  int num_blocks = block_ptr.size() - 1;
+  std::vector<double> r;
+  for (int bi = 0; bi < num_blocks; bi++)
+  {
+    int block = forward ? bi : num_blocks - 1 - bi;
+    int n = block_ptr[block + 1] - block_ptr[block];
+    const int* dofs = &block_dofs[block_ptr[block]];
+    r.resize(n);
+    // The matrix is symmetric, its row is the column.
+    for (int l = 0; l < n; l++)
+    {
+      double val = b[dofs[l]];
+      for (int k = Ap[dofs[l]]; k < Ap[dofs[l] + 1]; k++)
+        val -= Ax[k] * x[Ai[k]];
+      r[l] = val;
+    }
+    cholesky_solve(&factors[factor_ptr[block]], n, &r[0]);
+    for (int l = 0; l < n; l++)
+      x[dofs[l]] += r[l];
+  }
+}
+
+void TwoLevelSolver::apply_preconditioner(const double* r, double* z) const
+{
+  memset(z, 0, ndof * sizeof(double));
+  for (int s = 0; s < smoothing_steps; s++)
+    smooth(r, z, true);
+
+  // The coarse correction of the residual.
+  std::vector<double> fine(ndof), coarse(coarse_ndof);
+  multiply(z, &fine[0]);
+  for (int i = 0; i < ndof; i++)
+    fine[i] = r[i] - fine[i];
+  restrict_to_coarse(&fine[0], &coarse[0]);
+  solve_coarse(&coarse[0], &coarse[0]);
+  prolongate(&coarse[0], &fine[0]);
+  for (int i = 0; i < ndof; i++)
+    z[i] += fine[i];
+
+  for (int s = 0; s < smoothing_steps; s++)
+    smooth(r, z, false);
+}
+
+void TwoLevelSolver::solve_coarse(const double* rhs, double* sln) const
+{
+  for (int i = 0; i < coarse_ndof; i++)
+    coarse_rhs->set(i, rhs[i]);
+  if (!coarse_solver->solve())
+    throw Hermes::Exceptions::Exception("Matrix solver failed on the coarse problem in TwoLevelSolver.");
+  memcpy(sln, coarse_solver->get_sln_vector(), coarse_ndof * sizeof(double));
+  if (!coarse_factorized)
+  {
+    coarse_solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    coarse_factorized = true;
+  }
+}
+
+void TwoLevelSolver::prolongate(const double* coarse, double* fine) const
+{
+  for (int i = 0; i < ndof; i++)
+  {
+    double val = 0.0;
+    for (int k = p_row_ptr[i]; k < p_row_ptr[i + 1]; k++)
+      val += p_val[k] * coarse[p_col[k]];
+    fine[i] = val;
+  }
+}
+
+void TwoLevelSolver::restrict_to_coarse(const double* fine, double* coarse) const
+{
+  memset(coarse, 0, coarse_ndof * sizeof(double));
+  for (int i = 0; i < ndof; i++)
+    for (int k = p_row_ptr[i]; k < p_row_ptr[i + 1]; k++)
+      coarse[p_col[k]] += p_val[k] * fine[i];
+}
+
+double TwoLevelSolver::dot(const double* x, const double* y) const
+{
+  double result = 0.0;
+  for (int i = 0; i < ndof; i++)
+    result += x[i] * y[i];
+  return result;
+}
+
+bool TwoLevelSolver::solve(const double* coarse_sln_vector)
+{
+  std::vector<double> b(ndof);
+  for (int i = 0; i < ndof; i++)
+    b[i] = rhs->get(i);
+
+  // The initial guess.
+  std::vector<double> coarse(coarse_ndof);
+  if (coarse_sln_vector != NULL)
+    memcpy(&coarse[0], coarse_sln_vector, coarse_ndof * sizeof(double));
+  else
+  {
+    restrict_to_coarse(&b[0], &coarse[0]);
+    solve_coarse(&coarse[0], &coarse[0]);
+  }
+  sln_vector.resize(ndof);
+  double* x = &sln_vector[0];
+  prolongate(&coarse[0], x);
+
+  // Preconditioned conjugate gradients.
+  std::vector<double> r(ndof), z(ndof), p(ndof), q(ndof);
+  multiply(x, &q[0]);
+  for (int i = 0; i < ndof; i++)
+    r[i] = b[i] - q[i];
+  double norm_b = std::sqrt(dot(&b[0], &b[0]));
+  if (norm_b == 0.0)
+    norm_b = 1.0;
+  residual = std::sqrt(dot(&r[0], &r[0])) / norm_b;
+  num_iters = 0;
+  bool converged = residual <= tol;
+
+  if (!converged)
+  {
+    apply_preconditioner(&r[0], &z[0]);
+    p = z;
+    double rz = dot(&r[0], &z[0]);
+    while (num_iters < max_iters)
+    {
+      multiply(&p[0], &q[0]);
+      double alpha = rz / dot(&p[0], &q[0]);
+      for (int i = 0; i < ndof; i++)
+      {
+        x[i] += alpha * p[i];
+        r[i] -= alpha * q[i];
+      }
+      num_iters++;
+      residual = std::sqrt(dot(&r[0], &r[0])) / norm_b;
+      if (residual <= tol)
+      {
+        converged = true;
+        break;
+      }
+      apply_preconditioner(&r[0], &z[0]);
+      double rz_new = dot(&r[0], &z[0]);
+      double beta = rz_new / rz;
+      rz = rz_new;
+      for (int i = 0; i < ndof; i++)
+        p[i] = z[i] + beta * p[i];
+    }
+  }
+
+  Hermes::Mixins::Loggable::Static::info("Two-level CG: %d iterations, relative residual %g.", num_iters, residual);
+  return converged;
+}
@@ -0,0 +1,103 @@
+#ifndef TWO_LEVEL_SOLVER_H
+#define TWO_LEVEL_SOLVER_H
+
+#include "hermes2d.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+/// \brief Iterative solver of the reference problem with the coarse problem as the second level of a multigrid.
+///
+/// The reference space (the coarse mesh refined, the orders increased) contains the coarse space, so the coarse
+/// basis functions are combinations of the reference ones. The prolongation P is computed element by element from
+/// these combinations, and the coarse matrix assembled on the coarse space equals P^T A P. The linear reference
+/// problem A u = b (with the weak form written for Newton's method, as in LinearNewtonStep) is solved by the
+/// conjugate gradient method preconditioned by a symmetric two-level V-cycle: forward block Gauss-Seidel, the
+/// coarse correction, backward block Gauss-Seidel. A block consists of the dofs supported on the same elements,
+/// i.e. the bubbles of an element, the edge functions of an edge, a vertex function. The initial guess is the
+/// coarse solution prolongated to the reference space.
+///
+/// Only the coarse problem is factorized (by the matrix solver, which has to use CSC matrices, e.g. UMFPACK);
+/// the reference matrix, P and the factorized diagonal blocks grow linearly with the number of dofs.
+/// The problem has to be linear, symmetric and positive definite.
+class TwoLevelSolver
+{
+public:
+  TwoLevelSolver(const WeakForm<double>* wf, const Space<double>* coarse_space, const Space<double>* ref_space);
+  ~TwoLevelSolver();
+
+  /// Relative tolerance of the residual, maximum number of iterations and the number of block Gauss-Seidel
+  /// sweeps before and after the coarse correction.
+  void set_tolerance(double tol) { this->tol = tol; }
+  void set_max_iters(int max_iters) { this->max_iters = max_iters; }
+  void set_smoothing_steps(int smoothing_steps) { this->smoothing_steps = smoothing_steps; }
+
+  /// Solves the reference problem starting from the coarse solution prolongated to the reference space, given
+  /// by its coefficient vector in the coarse space or, if NULL, the solution of the coarse problem with the
+  /// restricted right-hand side. Returns false if the tolerance was not reached.
+  bool solve(const double* coarse_sln_vector = NULL);
+
+  /// Coefficient vector of the solution in the reference space.
+  double* get_sln_vector() { return &sln_vector[0]; }
+
+  /// fine = P coarse.
+  void prolongate(const double* coarse, double* fine) const;
+  /// coarse = P^T fine.
+  void restrict_to_coarse(const double* fine, double* coarse) const;
+
+  int get_num_iters() const { return num_iters; }
+  double get_residual() const { return residual; }
+
+private:
+  // P in the CSR format.
+  void init_prolongation();
+  // Adds the rows of P for the element of the reference mesh 'fine_e' lying in 'coarse_e', with the reference
+  // coordinates of 'fine_e' mapped to those of 'coarse_e' by x -> m x + t.
+  void add_prolongation(Element* coarse_e, Element* fine_e, double m[2], double t[2],
+                        std::vector<std::map<int, double> >& rows);
+  // Blocks of the smoother and the Cholesky factors of their diagonal blocks.
+  void init_blocks();
+
+  // y = A x.
+  void multiply(const double* x, double* y) const;
+  // One sweep of the block Gauss-Seidel on A x = b, over the blocks forward or backward.
+  void smooth(const double* b, double* x, bool forward) const;
+  // z = B r by the V-cycle.
+  void apply_preconditioner(const double* r, double* z) const;
+  // Solution of the coarse problem with the right-hand side 'rhs'.
+  void solve_coarse(const double* rhs, double* sln) const;
+
+  double dot(const double* x, const double* y) const;
+
+  const Space<double>* coarse_space;
+  const Space<double>* ref_space;
+  int ndof, coarse_ndof;
+  double tol;
+  int max_iters, smoothing_steps;
+
+  CSCMatrix<double>* matrix;
+  Vector<double>* rhs;
+  SparseMatrix<double>* coarse_matrix;
+  Vector<double>* coarse_rhs;
+  LinearMatrixSolver<double>* coarse_solver;
+  mutable bool coarse_factorized;
+
+  std::vector<int> p_row_ptr;
+  std::vector<int> p_col;
+  std::vector<double> p_val;
+
+  // Dofs of the blocks (block_ptr[b] ... block_ptr[b + 1] - 1), the block of every dof and its position in it,
+  // and the lower Cholesky factors of the diagonal blocks stored densely from factor_ptr[b].
+  std::vector<int> block_ptr;
+  std::vector<int> block_dofs;
+  std::vector<int> dof_block;
+  std::vector<int> dof_position;
+  std::vector<int> factor_ptr;
+  std::vector<double> factors;
+
+  std::vector<double> sln_vector;
+  int num_iters;
+  double residual;
+};
+
+#endif